@@ -1,10 +1,9 @@
-// Definitions for dynamic array.
+// Definitions for dynamic arrays.
 //
-// TODO(timo): Create a single header file library of this
-// TODO(timo): More functions for the interface:
-//      - pop
-//      - get (get_item)
-//      - set (set_item)
+// There is two kinds of arrays. The general use array saves only pointers to
+// the items. The typed arrays defined with the macro TYPED_ARRAY are header
+// only and they save the items inline in a contiguous block of memory, so
+// e.g. the token stream and the instruction stream are not pointer chased.
 //
 // File(s): array.c
 //
@@ -14,7 +13,11 @@
 #ifndef t_array_h
 #define t_array_h
 
+#include "memory.h"     // for x-allocators
 #include <stddef.h>     // for size_t, NULL
+#include <stdlib.h>     // for free
+#include <string.h>     // for memcpy
+#include <assert.h>     // for assertions
 
 
 // General use dynamic array
@@ -66,4 +69,102 @@ void array_free(array* arr);
 void array_push(array* arr, void* item);
 
 
+// Number of items the typed arrays can save without allocating any memory.
+// Most of the lists in the programs (statements in a block, parameters,
+// arguments) are short, so they fit in here.
+#define ARRAY_SMALL_CAPACITY 4
+
+
+// Defines a typed dynamic array which saves the items inline. The first
+// ARRAY_SMALL_CAPACITY items are saved into the small buffer inside the
+// structure itself and the memory is allocated only after that. Because the
+// items can point to the structure itself, the array must not be copied or
+// moved after it is initialized.
+//
+// The macro defines the structure 'name' and the following functions, where
+// 'prefix' is the prefix of the function names:
+//
+//      prefix_init(arr, capacity): Initializes the array with initial capacity.
+//      prefix_free(arr): Frees the memory allocated for the items.
+//      prefix_reserve(arr, capacity): Makes sure there is room for the items.
+//      prefix_push(arr, item): Appends the item, returns pointer to it.
+//      prefix_pop(arr): Removes and returns the last item.
+//      prefix_get(arr, index): Returns the item at the index.
+//      prefix_set(arr, index, item): Sets the item at the index.
+//
+// Arguments
+//      name: Name of the array structure.
+//      prefix: Prefix for the functions of the array.
+//      type: Type of the items saved into the array.
+#define TYPED_ARRAY(name, prefix, type)                                         \
+    typedef struct name                                                         \
+    {                                                                           \
+        type* items;                                                            \
+        int length;                                                             \
+        int capacity;                                                           \
+        type small[ARRAY_SMALL_CAPACITY];                                       \
+    } name;                                                                     \
+                                                                                \
+    static inline void prefix##_reserve(name* arr, int capacity)                \
+    {                                                                           \
+        if (capacity <= arr->capacity) return;                                  \
+                                                                                \
+        if (arr->items == arr->small)                                           \
+        {                                                                       \
+            arr->items = xmalloc(capacity * sizeof (type));                     \
+            memcpy(arr->items, arr->small, arr->length * sizeof (type));        \
+        }                                                                       \
+        else                                                                    \
+            arr->items = xrealloc(arr->items, capacity * sizeof (type));        \
+                                                                                \
+        arr->capacity = capacity;                                               \
+    }                                                                           \
+                                                                                \
+    static inline void prefix##_init(name* arr, int capacity)                   \
+    {                                                                           \
+        arr->items = arr->small;                                                \
+        arr->length = 0;                                                        \
+        arr->capacity = ARRAY_SMALL_CAPACITY;                                   \
+        prefix##_reserve(arr, capacity);                                        \
+    }                                                                           \
+                                                                                \
+    static inline void prefix##_free(name* arr)                                 \
+    {                                                                           \
+        if (arr->items != arr->small)                                           \
+            free(arr->items);                                                   \
+                                                                                \
+        arr->items = arr->small;                                                \
+        arr->length = 0;                                                        \
+        arr->capacity = ARRAY_SMALL_CAPACITY;                                   \
+    }                                                                           \
+                                                                                \
+    static inline type* prefix##_push(name* arr, type item)                     \
+    {                                                                           \
+        if (arr->length == arr->capacity)                                       \
+            prefix##_reserve(arr, arr->capacity * 2);                           \
+                                                                                \
+        arr->items[arr->length] = item;                                         \
+                                                                                \
+        return &arr->items[arr->length++];                                      \
+    }                                                                           \
+                                                                                \
+    static inline type prefix##_pop(name* arr)                                  \
+    {                                                                           \
+        assert(arr->length > 0);                                                \
+        return arr->items[--arr->length];                                       \
+    }                                                                           \
+                                                                                \
+    static inline type prefix##_get(const name* arr, int index)                 \
+    {                                                                           \
+        assert(index >= 0 && index < arr->length);                              \
+        return arr->items[index];                                               \
+    }                                                                           \
+                                                                                \
+    static inline void prefix##_set(name* arr, int index, type item)            \
+    {                                                                           \
+        assert(index >= 0 && index < arr->length);                              \
+        arr->items[index] = item;                                               \
+    }
+
+
 #endif
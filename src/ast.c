@@ -10,14 +10,11 @@
 #include "t.h"
 
 
-AST_Declaration* function_declaration(Token* identifier, Type_Specifier specifier, AST_Expression* initializer)
+AST_Declaration* function_declaration(arena* arena, Token* identifier, Type_Specifier specifier, AST_Expression* initializer)
 {
-    AST_Declaration* declaration = xmalloc(sizeof (AST_Declaration));
+    AST_Declaration* declaration = arena_calloc(arena, 1, sizeof (AST_Declaration));
     declaration->kind = DECLARATION_FUNCTION;
-    declaration->position = (Position) { .line_start = identifier->position.line_start,
-                                         .column_start = identifier->position.column_start,
-                                         .line_end = initializer->position.line_end,
-                                         .column_end = initializer->position.column_end };
+    declaration->position = (Position) { .start = identifier->position.start, .end = initializer->position.end };
     declaration->identifier = identifier;
     declaration->specifier = specifier;
     declaration->initializer = initializer;
@@ -26,14 +23,11 @@ AST_Declaration* function_declaration(Token* identifier, Type_Specifier specifie
 }
 
 
-AST_Declaration* variable_declaration(Token* identifier, Type_Specifier specifier, AST_Expression* initializer)
+AST_Declaration* variable_declaration(arena* arena, Token* identifier, Type_Specifier specifier, AST_Expression* initializer)
 {
-    AST_Declaration* declaration = xmalloc(sizeof (AST_Declaration));
+    AST_Declaration* declaration = arena_calloc(arena, 1, sizeof (AST_Declaration));
     declaration->kind = DECLARATION_VARIABLE;
-    declaration->position = (Position) { .line_start = identifier->position.line_start,
-                                         .column_start = identifier->position.column_start,
-                                         .line_end = initializer->position.line_end,
-                                         .column_end = initializer->position.column_end };
+    declaration->position = (Position) { .start = identifier->position.start, .end = initializer->position.end };
     declaration->identifier = identifier;
     declaration->specifier = specifier;
     declaration->initializer = initializer;
@@ -42,9 +36,9 @@ AST_Declaration* variable_declaration(Token* identifier, Type_Specifier specifie
 }
 
 
-AST_Statement* expression_statement(AST_Expression* expression)
+AST_Statement* expression_statement(arena* arena, AST_Expression* expression)
 {
-    AST_Statement* statement = xmalloc(sizeof (AST_Statement));
+    AST_Statement* statement = arena_calloc(arena, 1, sizeof (AST_Statement));
     statement->kind = STATEMENT_EXPRESSION;
     statement->position = (Position){0}; // TODO(timo)
     statement->expression = expression;
@@ -53,9 +47,9 @@ AST_Statement* expression_statement(AST_Expression* expression)
 }
 
 
-AST_Statement* block_statement(array* statements, int statements_length)
+AST_Statement* block_statement(arena* arena, array* statements, int statements_length)
 {
-    AST_Statement* statement = xmalloc(sizeof (AST_Statement));
+    AST_Statement* statement = arena_calloc(arena, 1, sizeof (AST_Statement));
     statement->kind = STATEMENT_BLOCK;
     statement->position = (Position){0}; // TODO(timo)
     statement->block.statements = statements;
@@ -65,9 +59,9 @@ AST_Statement* block_statement(array* statements, int statements_length)
 }
 
 
-AST_Statement* if_statement(AST_Expression* condition, AST_Statement* then, AST_Statement* _else)
+AST_Statement* if_statement(arena* arena, AST_Expression* condition, AST_Statement* then, AST_Statement* _else)
 {
-    AST_Statement* statement = xmalloc(sizeof (AST_Statement));
+    AST_Statement* statement = arena_calloc(arena, 1, sizeof (AST_Statement));
     statement->kind = STATEMENT_IF;
     statement->position = (Position){0}; // TODO(timo)
     statement->_if.condition = condition;
@@ -78,9 +72,9 @@ AST_Statement* if_statement(AST_Expression* condition, AST_Statement* then, AST_
 }
 
 
-AST_Statement* while_statement(AST_Expression* condition, AST_Statement* body)
+AST_Statement* while_statement(arena* arena, AST_Expression* condition, AST_Statement* body)
 {
-    AST_Statement* statement = xmalloc(sizeof (AST_Statement));
+    AST_Statement* statement = arena_calloc(arena, 1, sizeof (AST_Statement));
     statement->kind = STATEMENT_WHILE;
     statement->position = (Position){0}; // TODO(timo)
     statement->_while.condition = condition;
@@ -90,9 +84,9 @@ AST_Statement* while_statement(AST_Expression* condition, AST_Statement* body)
 }
 
 
-AST_Statement* break_statement()
+AST_Statement* break_statement(arena* arena)
 {
-    AST_Statement* statement = xmalloc(sizeof (AST_Statement));
+    AST_Statement* statement = arena_calloc(arena, 1, sizeof (AST_Statement));
     statement->position = (Position){0}; // TODO(timo)
     statement->kind = STATEMENT_BREAK;
 
@@ -100,9 +94,9 @@ AST_Statement* break_statement()
 }
 
 
-AST_Statement* continue_statement()
+AST_Statement* continue_statement(arena* arena)
 {
-    AST_Statement* statement = xmalloc(sizeof (AST_Statement));
+    AST_Statement* statement = arena_calloc(arena, 1, sizeof (AST_Statement));
     statement->position = (Position){0}; // TODO(timo)
     statement->kind = STATEMENT_CONTINUE;
 
@@ -110,9 +104,9 @@ AST_Statement* continue_statement()
 }
 
 
-AST_Statement* return_statement(AST_Expression* value)
+AST_Statement* return_statement(arena* arena, AST_Expression* value)
 {
-    AST_Statement* statement = xmalloc(sizeof (AST_Statement));
+    AST_Statement* statement = arena_calloc(arena, 1, sizeof (AST_Statement));
     statement->kind = STATEMENT_RETURN;
     statement->position = (Position){0}; // TODO(timo)
     statement->_return.value = value;
@@ -121,9 +115,9 @@ AST_Statement* return_statement(AST_Expression* value)
 }
 
 
-AST_Statement* declaration_statement(AST_Declaration* declaration)
+AST_Statement* declaration_statement(arena* arena, AST_Declaration* declaration)
 {
-    AST_Statement* statement = xmalloc(sizeof (AST_Statement));
+    AST_Statement* statement = arena_calloc(arena, 1, sizeof (AST_Statement));
     statement->kind = STATEMENT_DECLARATION;
     statement->position = (Position){0}; // TODO(timo)
     statement->declaration = declaration;
@@ -132,9 +126,9 @@ AST_Statement* declaration_statement(AST_Declaration* declaration)
 }
 
 
-AST_Expression* literal_expression(Token* literal)
+AST_Expression* literal_expression(arena* arena, Token* literal)
 {
-    AST_Expression* expression = xcalloc(1, sizeof (AST_Expression));
+    AST_Expression* expression = arena_calloc(arena, 1, sizeof (AST_Expression));
     expression->kind = EXPRESSION_LITERAL;
     expression->position = literal->position;
     expression->literal = literal;
@@ -144,14 +138,11 @@ AST_Expression* literal_expression(Token* literal)
 }
 
 
-AST_Expression* unary_expression(Token* _operator, AST_Expression* operand)
+AST_Expression* unary_expression(arena* arena, Token* _operator, AST_Expression* operand)
 {
-    AST_Expression* expression = xcalloc(1, sizeof (AST_Expression));
+    AST_Expression* expression = arena_calloc(arena, 1, sizeof (AST_Expression));
     expression->kind = EXPRESSION_UNARY;
-    expression->position = (Position) { .line_start = _operator->position.line_start,
-                                        .column_start = _operator->position.column_start,
-                                        .line_end = operand->position.line_end,
-                                        .column_end = operand->position.column_end };
+    expression->position = (Position) { .start = _operator->position.start, .end = operand->position.end };
     expression->unary._operator = _operator;
     expression->unary.operand = operand;
     expression->value = (Value){ .type = VALUE_NONE };
@@ -160,14 +151,11 @@ AST_Expression* unary_expression(Token* _operator, AST_Expression* operand)
 }
 
 
-AST_Expression* binary_expression(AST_Expression* left, Token* _operator, AST_Expression* right)
+AST_Expression* binary_expression(arena* arena, AST_Expression* left, Token* _operator, AST_Expression* right)
 {
-    AST_Expression* expression = xcalloc(1, sizeof (AST_Expression));
+    AST_Expression* expression = arena_calloc(arena, 1, sizeof (AST_Expression));
     expression->kind = EXPRESSION_BINARY;
-    expression->position = (Position) { .line_start = left->position.line_start,
-                                        .column_start = left->position.column_start,
-                                        .line_end = right->position.line_end,
-                                        .column_end = right->position.column_end };
+    expression->position = (Position) { .start = left->position.start, .end = right->position.end };
     expression->binary.left = left;
     expression->binary._operator = _operator;
     expression->binary.right = right;
@@ -177,9 +165,9 @@ AST_Expression* binary_expression(AST_Expression* left, Token* _operator, AST_Ex
 }
 
 
-AST_Expression* variable_expression(Token* identifier)
+AST_Expression* variable_expression(arena* arena, Token* identifier)
 {
-    AST_Expression* expression = xcalloc(1, sizeof (AST_Expression));
+    AST_Expression* expression = arena_calloc(arena, 1, sizeof (AST_Expression));
     expression->kind = EXPRESSION_VARIABLE;
     expression->position = identifier->position;
     expression->identifier = identifier;
@@ -189,14 +177,11 @@ AST_Expression* variable_expression(Token* identifier)
 }
 
 
-AST_Expression* assignment_expression(AST_Expression* variable, AST_Expression* value)
+AST_Expression* assignment_expression(arena* arena, AST_Expression* variable, AST_Expression* value)
 {
-    AST_Expression* expression = xcalloc(1, sizeof (AST_Expression));
+    AST_Expression* expression = arena_calloc(arena, 1, sizeof (AST_Expression));
     expression->kind = EXPRESSION_ASSIGNMENT;
-    expression->position = (Position) { .line_start = variable->position.line_start,
-                                        .column_start = variable->position.column_start,
-                                        .line_end = value->position.line_end,
-                                        .column_end = value->position.column_end };
+    expression->position = (Position) { .start = variable->position.start, .end = value->position.end };
     expression->assignment.variable = variable;
     expression->assignment.value = value;
     expression->value = (Value){ .type = VALUE_NONE };
@@ -205,14 +190,11 @@ AST_Expression* assignment_expression(AST_Expression* variable, AST_Expression*
 }
 
 
-AST_Expression* index_expression(AST_Expression* variable, AST_Expression* value)
+AST_Expression* index_expression(arena* arena, AST_Expression* variable, AST_Expression* value)
 {
-    AST_Expression* expression = xcalloc(1, sizeof (AST_Expression));
+    AST_Expression* expression = arena_calloc(arena, 1, sizeof (AST_Expression));
     expression->kind = EXPRESSION_INDEX;
-    expression->position = (Position) { .line_start = variable->position.line_start,
-                                        .column_start = variable->position.column_start,
-                                        .line_end = value->position.line_end,
-                                        .column_end = value->position.column_end };
+    expression->position = (Position) { .start = variable->position.start, .end = value->position.end };
     expression->index.variable = variable;
     expression->index.value = value;
     expression->value = (Value){ .type = VALUE_NONE };
@@ -221,9 +203,9 @@ AST_Expression* index_expression(AST_Expression* variable, AST_Expression* value
 }
 
 
-Parameter* function_parameter(Token* identifier, Type_Specifier specifier)
+Parameter* function_parameter(arena* arena, Token* identifier, Type_Specifier specifier)
 {
-    Parameter* parameter = xcalloc(1, sizeof (Parameter));
+    Parameter* parameter = arena_calloc(arena, 1, sizeof (Parameter));
     // TODO(timo): This position doesn't take into account the type specifier part
     parameter->position = identifier->position;
     parameter->identifier = identifier;
@@ -233,12 +215,13 @@ Parameter* function_parameter(Token* identifier, Type_Specifier specifier)
 }
 
 
-AST_Expression* function_expression(array* parameters, int arity, AST_Statement* body)
+AST_Expression* function_expression(arena* arena, array* parameters, int arity, AST_Statement* body)
 {
-    AST_Expression* expression = xcalloc(1, sizeof (AST_Expression));
+    AST_Expression* expression = arena_calloc(arena, 1, sizeof (AST_Expression));
     expression->kind = EXPRESSION_FUNCTION;
     // TODO(timo): This position doesn't take into account the parameter list part
-    expression->position = body->position;
+    // NOTE(timo): The body is NULL if the parsing of the body is postponed
+    expression->position = body ? body->position : (Position){0};
     expression->function.parameters = parameters;
     expression->function.arity = arity;
     expression->function.body = body;
@@ -248,9 +231,9 @@ AST_Expression* function_expression(array* parameters, int arity, AST_Statement*
 }
 
 
-AST_Expression* call_expression(AST_Expression* variable, array* arguments)
+AST_Expression* call_expression(arena* arena, AST_Expression* variable, array* arguments)
 {
-    AST_Expression* expression = xcalloc(1, sizeof (AST_Expression));
+    AST_Expression* expression = arena_calloc(arena, 1, sizeof (AST_Expression));
     expression->kind = EXPRESSION_CALL;
     // TODO(timo): This position doesn't take into account the argument list part
     expression->position = variable->position;
@@ -262,9 +245,9 @@ AST_Expression* call_expression(AST_Expression* variable, array* arguments)
 }
 
 
-AST_Expression* error_expression()
+AST_Expression* error_expression(arena* arena)
 {
-    AST_Expression* expression = xmalloc(sizeof (AST_Expression));
+    AST_Expression* expression = arena_calloc(arena, 1, sizeof (AST_Expression));
     expression->kind = EXPRESSION_NONE;
     // TODO(timo): Should this get at least a position?
 
@@ -272,6 +255,176 @@ AST_Expression* error_expression()
 }
 
 
+// Key of a pure expression in the Expression_Table. The children are already
+// shared, so comparing the pointers of the children compares the subtrees.
+typedef struct Expression_Key
+{
+    Expression_Kind kind;
+    Token_Kind token;
+    const char* lexeme;
+    const AST_Expression* left;
+    const AST_Expression* right;
+} Expression_Key;
+
+
+static Expression_Key expression_key(const AST_Expression* expression)
+{
+    switch (expression->kind)
+    {
+        case EXPRESSION_LITERAL:
+            return (Expression_Key){ expression->kind, expression->literal->kind, expression->literal->lexeme, NULL, NULL };
+        case EXPRESSION_VARIABLE:
+            return (Expression_Key){ expression->kind, expression->identifier->kind, expression->identifier->lexeme, NULL, NULL };
+        case EXPRESSION_UNARY:
+            return (Expression_Key){ expression->kind, expression->unary._operator->kind, NULL, expression->unary.operand, NULL };
+        case EXPRESSION_BINARY:
+            return (Expression_Key){ expression->kind, expression->binary._operator->kind, NULL, expression->binary.left, expression->binary.right };
+        default:
+            assert(false && "Only pure expressions can be shared");
+            return (Expression_Key){ 0 };
+    }
+}
+
+
+static inline bool expression_keys_equal(const Expression_Key* a, const Expression_Key* b)
+{
+    return a->kind == b->kind && a->token == b->token && a->lexeme == b->lexeme && a->left == b->left && a->right == b->right;
+}
+
+
+static inline uint32_t expression_key_hash(const Expression_Key* key)
+{
+    uint64_t hash = (uint64_t)key->kind << 8 | (uint64_t)key->token;
+
+    hash = (hash ^ (uintptr_t)key->lexeme) * 0x9e3779b97f4a7c15;
+    hash = (hash ^ (uintptr_t)key->left) * 0x9e3779b97f4a7c15;
+    hash = (hash ^ (uintptr_t)key->right) * 0x9e3779b97f4a7c15;
+
+    return (uint32_t)(hash >> 32);
+}
+
+
+void expression_table_init(Expression_Table* table)
+{
+    table->capacity = 0;
+    table->count = 0;
+    table->slots = NULL;
+}
+
+
+void expression_table_free(Expression_Table* table)
+{
+    free(table->slots);
+    expression_table_init(table);
+}
+
+
+void expression_table_clear(Expression_Table* table)
+{
+    if (table->count > 0)
+        memset(table->slots, 0, table->capacity * sizeof (AST_Expression*));
+
+    table->count = 0;
+}
+
+
+AST_Expression* expression_table_get(const Expression_Table* table, const Expression_Kind kind, const Token* token, const AST_Expression* left, const AST_Expression* right)
+{
+    if (table->count == 0)
+        return NULL;
+
+    // NOTE(timo): The operators are compared only by their kinds, the lexemes
+    // of the literals and the identifiers by their interned pointers
+    const bool leaf = kind == EXPRESSION_LITERAL || kind == EXPRESSION_VARIABLE;
+    Expression_Key key = { kind, token->kind, leaf ? token->lexeme : NULL, left, right };
+    uint32_t mask = table->capacity - 1;
+
+    for (uint32_t i = expression_key_hash(&key) & mask; table->slots[i] != NULL; i = (i + 1) & mask)
+    {
+        Expression_Key other = expression_key(table->slots[i]);
+
+        if (expression_keys_equal(&key, &other))
+            return table->slots[i];
+    }
+
+    return NULL;
+}
+
+
+void expression_table_put(Expression_Table* table, AST_Expression* expression)
+{
+    if ((table->count + 1) * 4 > table->capacity * 3)
+    {
+        AST_Expression** slots = table->slots;
+        int capacity = table->capacity;
+
+        table->capacity = capacity ? capacity * 2 : 64;
+        table->slots = xcalloc(table->capacity, sizeof (AST_Expression*));
+
+        for (int i = 0; i < capacity; i++)
+        {
+            if (slots[i] == NULL)
+                continue;
+
+            Expression_Key key = expression_key(slots[i]);
+            uint32_t j = expression_key_hash(&key) & (table->capacity - 1);
+
+            while (table->slots[j] != NULL)
+                j = (j + 1) & (table->capacity - 1);
+
+            table->slots[j] = slots[i];
+        }
+
+        free(slots);
+    }
+
+    Expression_Key key = expression_key(expression);
+    uint32_t mask = table->capacity - 1;
+    uint32_t i = expression_key_hash(&key) & mask;
+
+    while (table->slots[i] != NULL)
+        i = (i + 1) & mask;
+
+    table->slots[i] = expression;
+    table->count++;
+}
+
+
+void expression_add_occurrence(arena* arena, AST_Expression* expression, const Position position)
+{
+    Occurrence* occurrence = arena_alloc(arena, sizeof (Occurrence));
+    Occurrence* last = expression->occurrences;
+
+    occurrence->position = position;
+    occurrence->next = last ? last->next : occurrence;
+
+    if (last)
+        last->next = occurrence;
+
+    expression->occurrences = occurrence;
+}
+
+
+bool expression_next_occurrence(AST_Expression* expression)
+{
+    Occurrence* last = expression->occurrences;
+
+    if (last == NULL)
+        return false;
+
+    Occurrence* first = last->next;
+
+    if (first == last)
+        expression->occurrences = NULL;
+    else
+        last->next = first->next;
+
+    expression->position = first->position;
+
+    return true;
+}
+
+
 const char* expression_to_string(const AST_Expression* expression)
 {
     stringbuilder* sb = sb_init();
@@ -386,109 +539,22 @@ const char* type_specifier_str(const Type_Specifier specifier)
 }
 
 
+// NOTE(timo): The nodes and the lists inside them are allocated from the
+// parsers arena and they are released all at once by parser_free(). These
+// functions are kept so the callers don't have to care who owns the tree.
 void expression_free(AST_Expression* expression)
 {
-    switch (expression->kind)
-    {
-        case EXPRESSION_LITERAL:
-            // NOTE(timo); Lexer will free the literal token 
-            // and there is nothing else allocated
-            break;
-        case EXPRESSION_UNARY:
-            expression_free(expression->unary.operand);
-            break;
-        case EXPRESSION_BINARY:
-            expression_free(expression->binary.left);
-            expression_free(expression->binary.right);
-            break;
-        case EXPRESSION_VARIABLE:
-            // NOTE(timo); This can be just free'd since the expression
-            // only has the identifier, and lexer will free the token
-            break;
-        case EXPRESSION_ASSIGNMENT:
-            expression_free(expression->assignment.variable);
-            expression_free(expression->assignment.value);
-            break;
-        case EXPRESSION_INDEX:
-            expression_free(expression->index.variable);
-            expression_free(expression->index.value);
-            break;
-        case EXPRESSION_FUNCTION:
-            for (int i = 0; i < expression->function.parameters->length; i++)
-            {
-                // NOTE(timo): These are the unresolved parameters which 
-                // have no types etc. so this free is enough
-                free(expression->function.parameters->items[i]);
-                expression->function.parameters->items[i] = NULL;
-            }
-            array_free(expression->function.parameters);
-            statement_free(expression->function.body);
-            break; 
-        case EXPRESSION_CALL:
-            expression_free(expression->call.variable);
-            for (int i = 0; i < expression->call.arguments->length; i++)
-            {
-                AST_Expression* argument = expression->call.arguments->items[i];
-                expression_free(argument);
-                // NOTE(timo): The array item gets freed and assigned to NULL 
-                // when the expression is freed so no need to do it in here
-                expression->call.arguments->items[i] = NULL;
-            }
-            array_free(expression->call.arguments);
-            break;
-        case EXPRESSION_NONE:
-            break;
-    }
-
-    free(expression);
-    expression = NULL;
+    (void)expression;
 }
 
 
 void statement_free(AST_Statement* statement)
 {
-    switch (statement->kind)
-    {
-        case STATEMENT_EXPRESSION:
-            expression_free(statement->expression);
-            break;
-        case STATEMENT_BLOCK:
-            for (int i = 0; i < statement->block.statements->length; i++)
-            {
-                statement_free((AST_Statement*)statement->block.statements->items[i]);
-                statement->block.statements->items[i] = NULL;
-            }
-
-            array_free(statement->block.statements);
-            break;
-        case STATEMENT_IF:
-            expression_free(statement->_if.condition);
-            statement_free(statement->_if.then);
-            if (statement->_if._else != NULL)
-                statement_free(statement->_if._else);
-            break;
-        case STATEMENT_WHILE:
-            expression_free(statement->_while.condition);
-            statement_free(statement->_while.body);
-            break;
-        case STATEMENT_BREAK:
-            break;
-        case STATEMENT_RETURN:
-            expression_free(statement->_return.value);
-            break;
-        case STATEMENT_DECLARATION:
-            declaration_free(statement->declaration);
-            break;
-    }
-
-    free(statement);
-    statement = NULL;
+    (void)statement;
 }
 
 
 void declaration_free(AST_Declaration* declaration)
 {
-    expression_free(declaration->initializer);
-    free(declaration);
-    declaration = NULL;
+    (void)declaration;
 }
@@ -0,0 +1,2085 @@
+// Implementation of the cache of the resolved abstract syntax trees.
+//
+// The tree is flattened into the AST_Pool and the arrays of the pool are
+// written into a file named after the hash of the source. The file starts with
+// a header which tells the version of the format and the build of the compiler
+// which wrote it, so the cache is invalidated automatically whenever the
+// source, the format or the compiler changes. The arrays are written as they
+// are in the memory, so loading the tree is a single mapping of the file. The
+// pool is only the file format of the cache, so it is implemented here too.
+//
+// The results of the resolver are written after the tree: the types, the
+// scopes and the symbols of the program and the type, the symbol and the value
+// of every declaration and expression. The pointers between them are written
+// as indices, which start from 1 so the index 0 can be used for NULL. The 
+// declarations and the expressions are numbered in the order the tree is 
+// walked, so they don't need indices of their own.
+//
+// The lexemes of the tokens are pointers, so they are not written at all. The
+// source has to be at hand anyway to check the hash, so the lexemes are
+// interned again from the source when the tree is loaded.
+//
+// NOTE(timo): The hash tells only that the file was written from the same
+// source, not that the file is intact. Everything after the header has its
+// own checksum, the tokens are checked against the source lexed again and
+// every index and offset read from the file is checked before it is used,
+// so a broken file is just a cache miss.
+//
+// Author: Timo Mehto
+// Date: 2021/05/12
+
+#include "t.h"
+#include <fcntl.h>      // for open
+#include <unistd.h>     // for close, getpid
+#include <sys/mman.h>   // for mmap, munmap
+#include <sys/stat.h>   // for fstat, mkdir
+
+
+#define AST_CACHE_MAGIC "TAST"
+#define AST_CACHE_VERSION 4
+
+// NOTE(timo): The whole compiler is compiled at once, so the time of the
+// compilation of this file identifies the build of the whole compiler
+#define AST_CACHE_BUILD __DATE__ " " __TIME__
+
+
+// Header of the cache file. The arrays follow the header in the order of 
+// their alignment: resolved nodes, symbols, tokens, operands, positions, main
+// tokens, extra data, types, parameter types, scopes, strings and the kinds of
+// the nodes.
+//
+// Members
+//      magic: Identifies the file as a cache file.
+//      version: Version of the format.
+//      build: Build of the compiler which wrote the file.
+//      hash: Hash of the source.
+//      size: Size of the source.
+//      checksum: Hash of everything after the header.
+//      nodes: Number of the nodes.
+//      extra: Length of the extra data.
+//      tokens: Number of the tokens.
+//      declarations: Index of the list of the top level declarations.
+//      lazy: If the tree was resolved lazily. The bodies of the unused 
+//            functions are left unresolved then, so the file can be used only
+//            by the lazy resolving.
+//      share: If the identical expressions were shared. The shared nodes are
+//             saved only once, so the file can be used only when sharing.
+//      resolved: Number of the resolved declarations and expressions.
+//      symbols: Number of the symbols.
+//      types: Number of the types.
+//      parameters: Number of the parameter types of the function types.
+//      scopes: Number of the scopes.
+//      strings: Size of the names of the symbols and the scopes.
+typedef struct AST_Cache_Header
+{
+    char magic[4];
+    uint32_t version;
+    char build[24];
+    uint64_t hash;
+    uint64_t size;
+    uint64_t checksum;
+    uint32_t nodes;
+    uint32_t extra;
+    uint32_t tokens;
+    uint32_t declarations;
+    uint32_t lazy;
+    uint32_t share;
+    uint32_t resolved;
+    uint32_t symbols;
+    uint32_t types;
+    uint32_t parameters;
+    uint32_t scopes;
+    uint32_t strings;
+} AST_Cache_Header;
+
+
+// Results of the resolver for a declaration or an expression.
+//
+// Members
+//      value: Value of the expression.
+//      type: Index of the type of the expression.
+//      symbol: Index of the symbol bound to the declaration or the expression.
+//      scope: Index of the local scope of the function expression.
+typedef struct Cache_Node
+{
+    Value value;
+    uint32_t type;
+    uint32_t symbol;
+    uint32_t scope;
+    uint32_t padding;
+} Cache_Node;
+
+
+// Symbol of the program. The symbols are saved scope by scope in the order of
+// declaration, so declaring them again gives the same indices and offsets.
+//
+// Members
+//      value: Value of the symbol.
+//      kind: Kind of the symbol.
+//      state: Resolving state of the symbol.
+//      scope: Index of the scope the symbol is declared into.
+//      identifier: Offset of the identifier in the strings.
+//      type: Index of the type of the symbol.
+//      local: Index of the local scope of a function.
+//      slot: Slot of the symbol in the frame of its function.
+typedef struct Cache_Symbol
+{
+    Value value;
+    uint32_t kind;
+    uint32_t state;
+    uint32_t scope;
+    uint32_t identifier;
+    uint32_t type;
+    uint32_t local;
+    int32_t slot;
+    uint32_t padding;
+} Cache_Symbol;
+
+
+// Type of the program. The component types are saved before the types using
+// them, so the canonical types can be created again in the saved order.
+//
+// Members
+//      kind: Kind of the type.
+//      inner: Index of the element type of an array or the return type of a
+//             function.
+//      arity: Number of the parameters of a function.
+//      parameters: Offset of the parameter types of a function.
+typedef struct Cache_Type
+{
+    uint32_t kind;
+    uint32_t inner;
+    uint32_t arity;
+    uint32_t parameters;
+} Cache_Type;
+
+
+// Scope of the program. The global scope is always the first one and the
+// local scopes come after the scopes they are declared in.
+//
+// Members
+//      name: Offset of the name in the strings.
+//      enclosing: Index of the enclosing scope.
+//      frame_size: Number of the slots in the frame of the function.
+typedef struct Cache_Scope
+{
+    uint32_t name;
+    uint32_t enclosing;
+    int32_t frame_size;
+} Cache_Scope;
+
+
+// Declaration or expression of the tree in the order the tree is walked.
+typedef struct Cache_Item
+{
+    AST_Node_Class class;
+    void* node;
+} Cache_Item;
+
+
+TYPED_ARRAY(Cache_Node_Array, cache_node_array, Cache_Node)
+TYPED_ARRAY(Cache_Symbol_Array, cache_symbol_array, Cache_Symbol)
+TYPED_ARRAY(Cache_Type_Array, cache_type_array, Cache_Type)
+TYPED_ARRAY(Cache_Scope_Array, cache_scope_array, Cache_Scope)
+TYPED_ARRAY(Cache_String_Buffer, cache_string_buffer, char)
+TYPED_ARRAY(Cache_Item_Array, cache_item_array, Cache_Item)
+
+
+// Map from the addresses of the objects to their indices in the cache. The
+// map is open addressing table with linear probing, so the objects are found
+// just by their addresses. The index 0 means that the object isn't saved.
+//
+// Members
+//      capacity: Number of the slots. Always a power of two.
+//      count: Number of the saved objects.
+//      keys: Addresses of the saved objects.
+//      indices: Indices of the saved objects.
+typedef struct Index_Map
+{
+    int capacity;
+    int count;
+    const void** keys;
+    uint32_t* indices;
+} Index_Map;
+
+
+#define INDEX_MAP_INITIAL_CAPACITY 64
+
+
+static void index_map_init(Index_Map* map, int capacity)
+{
+    map->capacity = capacity;
+    map->count = 0;
+    map->keys = xcalloc(capacity, sizeof (void*));
+    map->indices = xcalloc(capacity, sizeof (uint32_t));
+}
+
+
+static void index_map_free(Index_Map* map)
+{
+    free(map->keys);
+    map->keys = NULL;
+
+    free(map->indices);
+    map->indices = NULL;
+
+    map->capacity = 0;
+    map->count = 0;
+}
+
+
+// Returns the slot of the object or the empty slot where it belongs.
+static int index_map_slot(const Index_Map* map, const void* key)
+{
+    // NOTE(timo): The low bits of the addresses are mostly the same because of
+    // the alignment, so the bits are mixed before they are used as the slot
+    uint64_t hash = (uint64_t)(uintptr_t)key;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccd;
+    hash ^= hash >> 33;
+
+    int slot = (int)(hash & (uint64_t)(map->capacity - 1));
+
+    while (map->keys[slot] != NULL && map->keys[slot] != key)
+        slot = (slot + 1) & (map->capacity - 1);
+
+    return slot;
+}
+
+
+static uint32_t index_map_get(const Index_Map* map, const void* key)
+{
+    return map->indices[index_map_slot(map, key)];
+}
+
+
+static void index_map_put(Index_Map* map, const void* key, uint32_t index)
+{
+    if ((map->count + 1) * 4 > map->capacity * 3)
+    {
+        Index_Map grown;
+        index_map_init(&grown, map->capacity * 2);
+
+        for (int i = 0; i < map->capacity; i++)
+        {
+            if (map->keys[i] != NULL)
+                index_map_put(&grown, map->keys[i], map->indices[i]);
+        }
+
+        index_map_free(map);
+        *map = grown;
+    }
+
+    int slot = index_map_slot(map, key);
+
+    if (map->keys[slot] == NULL)
+        map->count++;
+
+    map->keys[slot] = key;
+    map->indices[slot] = index;
+}
+
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325
+
+
+// Fowler-Noll-Vo-1a hash function with 64-bit hash, so the collisions between
+// the sources are practically impossible. The hash of data in many parts is
+// computed by continuing from the hash of the previous part.
+// https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function
+static uint64_t fnv1a_hash(uint64_t hash, const void* data, const size_t size)
+{
+    const uint8_t* bytes = data;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3;
+    }
+
+    return hash;
+}
+
+
+static inline uint64_t source_hash(const char* source, const size_t size)
+{
+    return fnv1a_hash(FNV_OFFSET_BASIS, source, size);
+}
+
+
+// Creates the header for the source.
+static AST_Cache_Header cache_header(const char* source)
+{
+    AST_Cache_Header header = { .magic = AST_CACHE_MAGIC, .version = AST_CACHE_VERSION };
+
+    strncpy(header.build, AST_CACHE_BUILD, sizeof (header.build));
+    header.size = strlen(source);
+    header.hash = source_hash(source, header.size);
+
+    return header;
+}
+
+
+// Creates the path of the cache file from the hash of the source.
+static void cache_path(char* path, const size_t size, const char* directory, const uint64_t hash)
+{
+    snprintf(path, size, "%s/%016llx.ast", directory, (unsigned long long)hash);
+}
+
+
+// Size of the cache file with the arrays of the sizes in the header.
+static uint64_t cache_size(const AST_Cache_Header* header)
+{
+    // NOTE(timo): The sizes are computed with 64 bits, so the sizes read from
+    // a broken file can't overflow into a size matching the file
+    return sizeof (AST_Cache_Header) +
+           (uint64_t)header->resolved * sizeof (Cache_Node) +
+           (uint64_t)header->symbols * sizeof (Cache_Symbol) +
+           (uint64_t)header->tokens * sizeof (Token) +
+           (uint64_t)header->nodes * (sizeof (AST_Node_Data) + sizeof (Position) + sizeof (AST_Index) + sizeof (uint8_t)) +
+           (uint64_t)header->extra * sizeof (AST_Index) +
+           (uint64_t)header->types * sizeof (Cache_Type) +
+           (uint64_t)header->parameters * sizeof (AST_Index) +
+           (uint64_t)header->scopes * sizeof (Cache_Scope) +
+           (uint64_t)header->strings * sizeof (char);
+}
+
+
+#define AST_POOL_INITIAL_CAPACITY 256
+
+
+// Adds a new node into the pool. The operands are set after the children of
+// the node are added, so the parent comes before its children.
+//
+// Arguments
+//      pool: Pointer to initialized AST_Pool.
+//      class: Class of the node.
+//      kind: Kind of the declaration, statement or expression.
+//      position: Position of the node.
+// Returns
+//      Index of the new node.
+static AST_Index pool_node(AST_Pool* pool, const AST_Node_Class class, const int kind, const Position position)
+{
+    if (pool->length == pool->capacity)
+    {
+        pool->capacity = pool->capacity ? pool->capacity * 2 : AST_POOL_INITIAL_CAPACITY;
+        pool->kinds = xrealloc(pool->kinds, pool->capacity * sizeof (uint8_t));
+        pool->main_tokens = xrealloc(pool->main_tokens, pool->capacity * sizeof (AST_Index));
+        pool->positions = xrealloc(pool->positions, pool->capacity * sizeof (Position));
+        pool->data = xrealloc(pool->data, pool->capacity * sizeof (AST_Node_Data));
+    }
+
+    AST_Index index = pool->length++;
+
+    pool->kinds[index] = AST_NODE_KIND(class, kind);
+    pool->main_tokens[index] = 0;
+    pool->positions[index] = position;
+    pool->data[index] = (AST_Node_Data){ 0 };
+
+    return index;
+}
+
+
+static inline AST_Index pool_token(AST_Pool* pool, const Token* token)
+{
+    token_array_push(&pool->tokens, *token);
+
+    return pool->tokens.length - 1;
+}
+
+
+void ast_pool_init(AST_Pool* pool)
+{
+    pool->length = 0;
+    pool->capacity = 0;
+    pool->kinds = NULL;
+    pool->main_tokens = NULL;
+    pool->positions = NULL;
+    pool->data = NULL;
+    pool->declarations = 0;
+    pool->shared = false;
+
+    ast_index_array_init(&pool->extra, 0);
+    token_array_init(&pool->tokens, 0);
+
+    // NOTE(timo): The node 0 and the token 0 are reserved for the missing
+    // nodes and the nodes without a main token
+    token_array_push(&pool->tokens, (Token){ .kind = TOKEN_EOF });
+    pool_node(pool, NODE_NONE, 0, (Position){ 0 });
+}
+
+
+void ast_pool_free(AST_Pool* pool)
+{
+    free(pool->kinds);
+    pool->kinds = NULL;
+
+    free(pool->main_tokens);
+    pool->main_tokens = NULL;
+
+    free(pool->positions);
+    pool->positions = NULL;
+
+    free(pool->data);
+    pool->data = NULL;
+
+    ast_index_array_free(&pool->extra);
+    token_array_free(&pool->tokens);
+
+    pool->length = 0;
+    pool->capacity = 0;
+}
+
+
+// Saves the list of children into the extra data. The list is saved with its
+// length first.
+//
+// Arguments
+//      pool: Pointer to initialized AST_Pool.
+//      items: Indices of the children.
+//      length: Number of the children.
+// Returns
+//      Index of the list in the extra data.
+static AST_Index pool_list(AST_Pool* pool, const AST_Index* items, const int length)
+{
+    AST_Index index = pool->extra.length;
+
+    ast_index_array_push(&pool->extra, length);
+
+    for (int i = 0; i < length; i++)
+        ast_index_array_push(&pool->extra, items[i]);
+
+    return index;
+}
+
+
+// Returns the number of the children of the node in the tree. The parameters
+// of a function are not counted, they are leaves flattened with the function.
+static int item_children(const Cache_Item item)
+{
+    switch (item.class)
+    {
+        case NODE_DECLARATION:
+            return 1;
+        case NODE_STATEMENT:
+        {
+            const AST_Statement* statement = item.node;
+
+            switch (statement->kind)
+            {
+                case STATEMENT_EXPRESSION:
+                case STATEMENT_RETURN:
+                case STATEMENT_DECLARATION:
+                    return 1;
+                case STATEMENT_BLOCK:
+                    return statement->block.statements->length;
+                case STATEMENT_IF:
+                    return 3;
+                case STATEMENT_WHILE:
+                    return 2;
+                default:
+                    return 0;
+            }
+        }
+        case NODE_EXPRESSION:
+        {
+            const AST_Expression* expression = item.node;
+
+            switch (expression->kind)
+            {
+                case EXPRESSION_UNARY:
+                case EXPRESSION_FUNCTION:
+                    return 1;
+                case EXPRESSION_BINARY:
+                case EXPRESSION_ASSIGNMENT:
+                case EXPRESSION_INDEX:
+                    return 2;
+                case EXPRESSION_CALL:
+                    return 1 + expression->call.arguments->length;
+                default:
+                    return 0;
+            }
+        }
+        default:
+            return 0;
+    }
+}
+
+
+// Returns the child of the node in the tree at the index. The children are in
+// the order of the source, which is the order they are saved in. The missing 
+// children, e.g. the else branch of an if statement without one, are NULL.
+static Cache_Item item_child(const Cache_Item item, const int index)
+{
+    switch (item.class)
+    {
+        case NODE_DECLARATION:
+        {
+            const AST_Declaration* declaration = item.node;
+            return (Cache_Item){ NODE_EXPRESSION, declaration->initializer };
+        }
+        case NODE_STATEMENT:
+        {
+            const AST_Statement* statement = item.node;
+
+            switch (statement->kind)
+            {
+                case STATEMENT_EXPRESSION:
+                    return (Cache_Item){ NODE_EXPRESSION, statement->expression };
+                case STATEMENT_BLOCK:
+                    return (Cache_Item){ NODE_STATEMENT, statement->block.statements->items[index] };
+                case STATEMENT_IF:
+                    if (index == 0)
+                        return (Cache_Item){ NODE_EXPRESSION, statement->_if.condition };
+                    return (Cache_Item){ NODE_STATEMENT, index == 1 ? statement->_if.then : statement->_if._else };
+                case STATEMENT_WHILE:
+                    if (index == 0)
+                        return (Cache_Item){ NODE_EXPRESSION, statement->_while.condition };
+                    return (Cache_Item){ NODE_STATEMENT, statement->_while.body };
+                case STATEMENT_RETURN:
+                    return (Cache_Item){ NODE_EXPRESSION, statement->_return.value };
+                case STATEMENT_DECLARATION:
+                    return (Cache_Item){ NODE_DECLARATION, statement->declaration };
+                default:
+                    break;
+            }
+            break;
+        }
+        case NODE_EXPRESSION:
+        {
+            const AST_Expression* expression = item.node;
+
+            switch (expression->kind)
+            {
+                case EXPRESSION_UNARY:
+                    return (Cache_Item){ NODE_EXPRESSION, expression->unary.operand };
+                case EXPRESSION_BINARY:
+                    return (Cache_Item){ NODE_EXPRESSION, index == 0 ? expression->binary.left : expression->binary.right };
+                case EXPRESSION_ASSIGNMENT:
+                    return (Cache_Item){ NODE_EXPRESSION, index == 0 ? expression->assignment.variable : expression->assignment.value };
+                case EXPRESSION_INDEX:
+                    return (Cache_Item){ NODE_EXPRESSION, index == 0 ? expression->index.variable : expression->index.value };
+                case EXPRESSION_FUNCTION:
+                    return (Cache_Item){ NODE_STATEMENT, expression->function.body };
+                case EXPRESSION_CALL:
+                    return (Cache_Item){ NODE_EXPRESSION, index == 0 ? expression->call.variable : expression->call.arguments->items[index - 1] };
+                default:
+                    break;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+
+    return (Cache_Item){ NODE_NONE, NULL };
+}
+
+
+// Node of the tree waiting on the explicit stack for its children to be 
+// flattened.
+//
+// Members
+//      item: Node of the tree.
+//      index: Index of the node in the pool.
+//      children: Number of the children of the node.
+//      next: Index of the next child to be flattened.
+typedef struct Flatten_Frame
+{
+    Cache_Item item;
+    AST_Index index;
+    int children;
+    int next;
+} Flatten_Frame;
+
+
+TYPED_ARRAY(Flatten_Frame_Stack, flatten_frame_stack, Flatten_Frame)
+
+
+static AST_Index flatten_parameters(AST_Pool* pool, const array* parameters)
+{
+    AST_Index_Array nodes;
+    ast_index_array_init(&nodes, parameters->length);
+
+    for (int i = 0; i < parameters->length; i++)
+    {
+        Parameter* parameter = parameters->items[i];
+        AST_Index node = pool_node(pool, NODE_PARAMETER, 0, parameter->position);
+
+        pool->main_tokens[node] = pool_token(pool, parameter->identifier);
+        pool->data[node].lhs = parameter->specifier;
+        ast_index_array_push(&nodes, node);
+    }
+
+    AST_Index list = pool_list(pool, nodes.items, nodes.length);
+    ast_index_array_free(&nodes);
+
+    return list;
+}
+
+
+// Adds the node into the pool before its children and pushes it to the stack
+// to wait for them. The missing nodes get the index 0 right away and so do
+// the shared expressions already in the pool get their index.
+static void flatten_push(AST_Pool* pool, Flatten_Frame_Stack* stack, AST_Index_Array* flattened, Index_Map* expressions, const Cache_Item item)
+{
+    AST_Index index;
+
+    if (item.node == NULL)
+    {
+        ast_index_array_push(flattened, 0);
+        return;
+    }
+
+    if (item.class == NODE_EXPRESSION && (index = index_map_get(expressions, item.node)) != 0)
+    {
+        ast_index_array_push(flattened, index);
+        pool->shared = true;
+        return;
+    }
+
+    switch (item.class)
+    {
+        case NODE_DECLARATION:
+        {
+            const AST_Declaration* declaration = item.node;
+            index = pool_node(pool, NODE_DECLARATION, declaration->kind, declaration->position);
+            pool->main_tokens[index] = pool_token(pool, declaration->identifier);
+            break;
+        }
+        case NODE_STATEMENT:
+        {
+            const AST_Statement* statement = item.node;
+            index = pool_node(pool, NODE_STATEMENT, statement->kind, statement->position);
+            break;
+        }
+        default:
+        {
+            const AST_Expression* expression = item.node;
+            index = pool_node(pool, NODE_EXPRESSION, expression->kind, expression->position);
+            index_map_put(expressions, expression, index);
+
+            switch (expression->kind)
+            {
+                case EXPRESSION_LITERAL:
+                case EXPRESSION_VARIABLE:
+                    pool->main_tokens[index] = pool_token(pool, expression->literal);
+                    break;
+                case EXPRESSION_UNARY:
+                    pool->main_tokens[index] = pool_token(pool, expression->unary._operator);
+                    break;
+                case EXPRESSION_BINARY:
+                    pool->main_tokens[index] = pool_token(pool, expression->binary._operator);
+                    break;
+                case EXPRESSION_FUNCTION:
+                {
+                    // NOTE(timo): Adding the parameters can move the arrays of
+                    // the pool, so the index of the list is saved only after
+                    AST_Index parameters = flatten_parameters(pool, expression->function.parameters);
+                    pool->data[index].lhs = parameters;
+                    break;
+                }
+                default:
+                    break;
+            }
+            break;
+        }
+    }
+
+    flatten_frame_stack_push(stack, (Flatten_Frame){ .item = item, .index = index, .children = item_children(item) });
+}
+
+
+// Sets the operands of the node after its children are flattened. The 
+// indices of the children are replaced with the index of the node.
+static void flatten_pop(AST_Pool* pool, const Flatten_Frame frame, AST_Index_Array* flattened)
+{
+    const AST_Index* children = &flattened->items[flattened->length - frame.children];
+    AST_Node_Data* data = &pool->data[frame.index];
+
+    switch (frame.item.class)
+    {
+        case NODE_DECLARATION:
+        {
+            const AST_Declaration* declaration = frame.item.node;
+            data->lhs = declaration->specifier;
+            data->rhs = children[0];
+            break;
+        }
+        case NODE_STATEMENT:
+        {
+            const AST_Statement* statement = frame.item.node;
+
+            switch (statement->kind)
+            {
+                case STATEMENT_BLOCK:
+                    data->lhs = pool_list(pool, children, frame.children);
+                    break;
+                case STATEMENT_IF:
+                    data->lhs = children[0];
+                    data->rhs = pool_list(pool, &children[1], 2);
+                    break;
+                case STATEMENT_WHILE:
+                    data->lhs = children[0];
+                    data->rhs = children[1];
+                    break;
+                case STATEMENT_EXPRESSION:
+                case STATEMENT_RETURN:
+                case STATEMENT_DECLARATION:
+                    data->lhs = children[0];
+                    break;
+                default:
+                    break;
+            }
+            break;
+        }
+        default:
+        {
+            const AST_Expression* expression = frame.item.node;
+
+            switch (expression->kind)
+            {
+                case EXPRESSION_UNARY:
+                    data->lhs = children[0];
+                    break;
+                case EXPRESSION_BINARY:
+                case EXPRESSION_ASSIGNMENT:
+                case EXPRESSION_INDEX:
+                    data->lhs = children[0];
+                    data->rhs = children[1];
+                    break;
+                case EXPRESSION_FUNCTION:
+                    data->rhs = children[0];
+                    break;
+                case EXPRESSION_CALL:
+                    data->lhs = children[0];
+                    data->rhs = pool_list(pool, &children[1], frame.children - 1);
+                    break;
+                default:
+                    break;
+            }
+            break;
+        }
+    }
+
+    flattened->length -= frame.children;
+    ast_index_array_push(flattened, frame.index);
+}
+
+
+// NOTE(timo): The tree is flattened with an explicit stack, since the 
+// expressions can be nested deeper than the call stack allows. The nodes are
+// added when they are pushed and their operands are set when they are popped,
+// so the pool is the same as the one flattened recursively.
+void ast_pool_flatten(AST_Pool* pool, const array* declarations)
+{
+    Flatten_Frame_Stack stack;
+    AST_Index_Array flattened;
+    Index_Map expressions;
+
+    flatten_frame_stack_init(&stack, 0);
+    ast_index_array_init(&flattened, 0);
+    index_map_init(&expressions, INDEX_MAP_INITIAL_CAPACITY);
+
+    for (int i = 0; i < declarations->length; i++)
+    {
+        flatten_push(pool, &stack, &flattened, &expressions, (Cache_Item){ NODE_DECLARATION, declarations->items[i] });
+
+        while (stack.length > 0)
+        {
+            Flatten_Frame* top = &stack.items[stack.length - 1];
+
+            if (top->next < top->children)
+            {
+                Cache_Item child = item_child(top->item, top->next++);
+                flatten_push(pool, &stack, &flattened, &expressions, child);
+            }
+            else
+                flatten_pop(pool, flatten_frame_stack_pop(&stack), &flattened);
+        }
+    }
+
+    pool->declarations = pool_list(pool, flattened.items, flattened.length);
+
+    flatten_frame_stack_free(&stack);
+    ast_index_array_free(&flattened);
+    index_map_free(&expressions);
+}
+
+
+// Context for checking the pool before it is expanded.
+//
+// Members
+//      pool: Pool being checked.
+//      referenced: Flags of the nodes already referred by their parent.
+typedef struct Validator
+{
+    const AST_Pool* pool;
+    uint8_t* referenced;
+} Validator;
+
+
+// Checks that the child of the node is a node of the class after the node and
+// that no other node refers to it. Index 0 is accepted for the optional nodes.
+// The expressions of a shared pool can have more parents after the first one.
+static bool valid_child(Validator* validator, AST_Index parent, AST_Index child, AST_Node_Class class, bool optional)
+{
+    const AST_Pool* pool = validator->pool;
+
+    if (child == 0)
+        return optional;
+
+    if (child >= (AST_Index)pool->length || AST_NODE_CLASS(pool->kinds[child]) != class)
+        return false;
+
+    // NOTE(timo): The later parents of a shared expression can come after it,
+    // so the cycles are checked separately for the shared pools
+    if (validator->referenced[child])
+        return pool->shared && class == NODE_EXPRESSION;
+
+    // NOTE(timo): The children come after their first parents, so there can't
+    // be cycles in the pools without shared nodes
+    if (child <= parent)
+        return false;
+
+    validator->referenced[child] = 1;
+
+    return true;
+}
+
+
+// Checks that the list fits into the extra data and that the items of the
+// list are valid children of the node.
+static bool valid_list(Validator* validator, AST_Index parent, AST_Index list, AST_Node_Class class)
+{
+    const AST_Index_Array* extra = &validator->pool->extra;
+
+    if (list >= (AST_Index)extra->length || extra->items[list] > (AST_Index)extra->length - list - 1)
+        return false;
+
+    for (AST_Index i = 0; i < extra->items[list]; i++)
+    {
+        if (! valid_child(validator, parent, extra->items[list + 1 + i], class, false))
+            return false;
+    }
+
+    return true;
+}
+
+
+// Checks the kind and the operands of the node.
+static bool valid_node(Validator* validator, AST_Index index)
+{
+    const AST_Pool* pool = validator->pool;
+    AST_Node_Data data = pool->data[index];
+    AST_Index token = pool->main_tokens[index];
+    int kind = AST_NODE_SUBKIND(pool->kinds[index]);
+
+    if (token >= (AST_Index)pool->tokens.length)
+        return false;
+
+    switch (AST_NODE_CLASS(pool->kinds[index]))
+    {
+        case NODE_DECLARATION:
+            return (kind == DECLARATION_VARIABLE || kind == DECLARATION_FUNCTION) && token != 0 &&
+                   data.lhs <= TYPE_SPECIFIER_BOOL &&
+                   valid_child(validator, index, data.rhs, NODE_EXPRESSION, false);
+        case NODE_PARAMETER:
+            return kind == 0 && token != 0 && data.lhs <= TYPE_SPECIFIER_BOOL;
+        case NODE_STATEMENT:
+            switch (kind)
+            {
+                case STATEMENT_EXPRESSION:
+                case STATEMENT_RETURN:
+                    return valid_child(validator, index, data.lhs, NODE_EXPRESSION, false);
+                case STATEMENT_BLOCK:
+                    return valid_list(validator, index, data.lhs, NODE_STATEMENT);
+                case STATEMENT_IF:
+                {
+                    const AST_Index_Array* extra = &pool->extra;
+
+                    // NOTE(timo): The else branch is the only optional node
+                    return valid_child(validator, index, data.lhs, NODE_EXPRESSION, false) &&
+                           data.rhs < (AST_Index)extra->length && extra->items[data.rhs] == 2 &&
+                           extra->length - data.rhs > 2 &&
+                           valid_child(validator, index, extra->items[data.rhs + 1], NODE_STATEMENT, false) &&
+                           valid_child(validator, index, extra->items[data.rhs + 2], NODE_STATEMENT, true);
+                }
+                case STATEMENT_WHILE:
+                    return valid_child(validator, index, data.lhs, NODE_EXPRESSION, false) &&
+                           valid_child(validator, index, data.rhs, NODE_STATEMENT, false);
+                case STATEMENT_BREAK:
+                case STATEMENT_CONTINUE:
+                    return true;
+                case STATEMENT_DECLARATION:
+                    return valid_child(validator, index, data.lhs, NODE_DECLARATION, false);
+                default:
+                    return false;
+            }
+        case NODE_EXPRESSION:
+            switch (kind)
+            {
+                case EXPRESSION_LITERAL:
+                case EXPRESSION_VARIABLE:
+                    return token != 0;
+                case EXPRESSION_UNARY:
+                    return token != 0 && valid_child(validator, index, data.lhs, NODE_EXPRESSION, false);
+                case EXPRESSION_BINARY:
+                    return token != 0 && 
+                           valid_child(validator, index, data.lhs, NODE_EXPRESSION, false) &&
+                           valid_child(validator, index, data.rhs, NODE_EXPRESSION, false);
+                case EXPRESSION_ASSIGNMENT:
+                case EXPRESSION_INDEX:
+                    return valid_child(validator, index, data.lhs, NODE_EXPRESSION, false) &&
+                           valid_child(validator, index, data.rhs, NODE_EXPRESSION, false);
+                case EXPRESSION_FUNCTION:
+                    return valid_list(validator, index, data.lhs, NODE_PARAMETER) &&
+                           valid_child(validator, index, data.rhs, NODE_STATEMENT, false);
+                case EXPRESSION_CALL:
+                    return valid_child(validator, index, data.lhs, NODE_EXPRESSION, false) &&
+                           valid_list(validator, index, data.rhs, NODE_EXPRESSION);
+                default:
+                    return false;
+            }
+        default:
+            return false;
+    }
+}
+
+
+static int pool_children(const AST_Pool* pool, const AST_Index index);
+static AST_Index pool_child(const AST_Pool* pool, const AST_Index index, const int child);
+
+
+// Checks that no node of the pool is its own descendant. The nodes are walked
+// depth first with an explicit stack and a node found again while it is still
+// on the stack closes a cycle. The walked nodes are marked, so the shared 
+// nodes are walked only once.
+static bool acyclic(const AST_Pool* pool)
+{
+    // NOTE(timo): 0 = not walked yet, 1 = on the stack, 2 = walked
+    uint8_t* states = xcalloc(pool->length, sizeof (uint8_t));
+    AST_Index_Array stack;
+    AST_Index_Array next;
+    bool valid = true;
+
+    ast_index_array_init(&stack, 0);
+    ast_index_array_init(&next, 0);
+
+    for (AST_Index i = 1; valid && i < (AST_Index)pool->length; i++)
+    {
+        if (states[i] != 0)
+            continue;
+
+        states[i] = 1;
+        ast_index_array_push(&stack, i);
+        ast_index_array_push(&next, 0);
+
+        while (valid && stack.length > 0)
+        {
+            AST_Index top = stack.items[stack.length - 1];
+            AST_Index* child_index = &next.items[next.length - 1];
+
+            if ((int)*child_index == pool_children(pool, top))
+            {
+                states[top] = 2;
+                stack.length--;
+                next.length--;
+                continue;
+            }
+
+            AST_Index child = pool_child(pool, top, (*child_index)++);
+
+            if (child == 0 || states[child] == 2)
+                continue;
+
+            if (states[child] == 1)
+            {
+                valid = false;
+                break;
+            }
+
+            states[child] = 1;
+            ast_index_array_push(&stack, child);
+            ast_index_array_push(&next, 0);
+        }
+    }
+
+    ast_index_array_free(&stack);
+    ast_index_array_free(&next);
+    free(states);
+
+    return valid;
+}
+
+
+bool ast_pool_valid(const AST_Pool* pool)
+{
+    if (pool->length < 1 || pool->tokens.length < 1)
+        return false;
+
+    Validator validator = { .pool = pool, .referenced = xcalloc(pool->length, sizeof (uint8_t)) };
+    bool valid = valid_list(&validator, 0, pool->declarations, NODE_DECLARATION);
+
+    for (AST_Index i = 1; valid && i < (AST_Index)pool->length; i++)
+        valid = valid_node(&validator, i);
+
+    free(validator.referenced);
+
+    // NOTE(timo): The lists are checked above, so the children can be walked
+    return valid && (! pool->shared || acyclic(pool));
+}
+
+
+// Context for expanding the pool back into a tree.
+//
+// Members
+//      pool: Pool being expanded.
+//      arena: Arena the tree is allocated from.
+//      tokens: Copies of the tokens of the pool in the arena.
+//      nodes: Expanded nodes by their indices, so the shared nodes are 
+//             expanded only once and shared in the tree too.
+typedef struct Expander
+{
+    const AST_Pool* pool;
+    arena* arena;
+    Token* tokens;
+    void** nodes;
+} Expander;
+
+
+// Node of the pool waiting on the explicit stack for its children to be 
+// expanded.
+//
+// Members
+//      index: Index of the node in the pool.
+//      children: Number of the children of the node.
+//      next: Index of the next child to be expanded.
+typedef struct Expand_Frame
+{
+    AST_Index index;
+    int children;
+    int next;
+} Expand_Frame;
+
+
+TYPED_ARRAY(Expand_Frame_Stack, expand_frame_stack, Expand_Frame)
+TYPED_ARRAY(Expanded_Stack, expanded_stack, void*)
+
+
+// Returns the number of the children of the node in the pool. The pool is
+// checked before, so the lists are in the bounds of the extra data.
+static int pool_children(const AST_Pool* pool, const AST_Index index)
+{
+    AST_Node_Data data = pool->data[index];
+    const AST_Index* extra = pool->extra.items;
+    int kind = AST_NODE_SUBKIND(pool->kinds[index]);
+
+    switch (AST_NODE_CLASS(pool->kinds[index]))
+    {
+        case NODE_DECLARATION:
+            return 1;
+        case NODE_STATEMENT:
+            switch (kind)
+            {
+                case STATEMENT_EXPRESSION:
+                case STATEMENT_RETURN:
+                case STATEMENT_DECLARATION:
+                    return 1;
+                case STATEMENT_BLOCK:
+                    return extra[data.lhs];
+                case STATEMENT_IF:
+                    return 3;
+                case STATEMENT_WHILE:
+                    return 2;
+                default:
+                    return 0;
+            }
+        case NODE_EXPRESSION:
+            switch (kind)
+            {
+                case EXPRESSION_UNARY:
+                    return 1;
+                case EXPRESSION_BINARY:
+                case EXPRESSION_ASSIGNMENT:
+                case EXPRESSION_INDEX:
+                    return 2;
+                case EXPRESSION_FUNCTION:
+                    return extra[data.lhs] + 1;
+                case EXPRESSION_CALL:
+                    return 1 + extra[data.rhs];
+                default:
+                    return 0;
+            }
+        default:
+            return 0;
+    }
+}
+
+
+// Returns the index of the child of the node in the pool. The parameters of a
+// function come before its body.
+static AST_Index pool_child(const AST_Pool* pool, const AST_Index index, const int child)
+{
+    AST_Node_Data data = pool->data[index];
+    const AST_Index* extra = pool->extra.items;
+    int kind = AST_NODE_SUBKIND(pool->kinds[index]);
+
+    switch (AST_NODE_CLASS(pool->kinds[index]))
+    {
+        case NODE_DECLARATION:
+            return data.rhs;
+        case NODE_STATEMENT:
+            switch (kind)
+            {
+                case STATEMENT_BLOCK:   return extra[data.lhs + 1 + child];
+                case STATEMENT_IF:      return child == 0 ? data.lhs : extra[data.rhs + child];
+                case STATEMENT_WHILE:   return child == 0 ? data.lhs : data.rhs;
+                default:                return data.lhs;
+            }
+        case NODE_EXPRESSION:
+            switch (kind)
+            {
+                case EXPRESSION_FUNCTION:
+                    return child < (int)extra[data.lhs] ? extra[data.lhs + 1 + child] : data.rhs;
+                case EXPRESSION_CALL:
+                    return child == 0 ? data.lhs : extra[data.rhs + child];
+                default:
+                    return child == 0 ? data.lhs : data.rhs;
+            }
+        default:
+            return 0;
+    }
+}
+
+
+// Allocates the list of children from the arena in the same way the parser
+// does, so the expanded tree looks exactly like the parsed one.
+static array* expand_list(Expander* expander, void** children, const int length)
+{
+    array* result = arena_alloc(expander->arena, sizeof (array));
+    result->items = arena_alloc(expander->arena, sizeof (void*) * length);
+    result->length = length;
+    result->capacity = length;
+    result->item_size = sizeof (void*);
+
+    for (int i = 0; i < length; i++)
+        result->items[i] = children[i];
+
+    return result;
+}
+
+
+static Parameter* expand_parameter(Expander* expander, AST_Index index)
+{
+    const AST_Pool* pool = expander->pool;
+    Parameter* parameter = function_parameter(expander->arena, &expander->tokens[pool->main_tokens[index]], pool->data[index].lhs);
+    parameter->position = pool->positions[index];
+
+    return parameter;
+}
+
+
+static AST_Expression* expand_expression(Expander* expander, AST_Index index, void** children, const int count)
+{
+    const AST_Pool* pool = expander->pool;
+    Token* token = &expander->tokens[pool->main_tokens[index]];
+    AST_Expression* expression;
+
+    switch (AST_NODE_SUBKIND(pool->kinds[index]))
+    {
+        case EXPRESSION_LITERAL:
+            expression = literal_expression(expander->arena, token);
+            break;
+        case EXPRESSION_VARIABLE:
+            expression = variable_expression(expander->arena, token);
+            break;
+        case EXPRESSION_UNARY:
+            expression = unary_expression(expander->arena, token, children[0]);
+            break;
+        case EXPRESSION_BINARY:
+            expression = binary_expression(expander->arena, children[0], token, children[1]);
+            break;
+        case EXPRESSION_ASSIGNMENT:
+            expression = assignment_expression(expander->arena, children[0], children[1]);
+            break;
+        case EXPRESSION_INDEX:
+            expression = index_expression(expander->arena, children[0], children[1]);
+            break;
+        case EXPRESSION_FUNCTION:
+        {
+            array* parameters = expand_list(expander, children, count - 1);
+            expression = function_expression(expander->arena, parameters, parameters->length, children[count - 1]);
+            break;
+        }
+        case EXPRESSION_CALL:
+            expression = call_expression(expander->arena, children[0], expand_list(expander, &children[1], count - 1));
+            break;
+        default:
+            expression = error_expression(expander->arena);
+            break;
+    }
+
+    // NOTE(timo): Some of the factory functions don't set the positions yet,
+    // so the saved positions are restored as they were
+    expression->position = pool->positions[index];
+
+    return expression;
+}
+
+
+static AST_Statement* expand_statement(Expander* expander, AST_Index index, void** children, const int count)
+{
+    const AST_Pool* pool = expander->pool;
+    Statement_Kind kind = AST_NODE_SUBKIND(pool->kinds[index]);
+    AST_Statement* statement;
+
+    switch (kind)
+    {
+        case STATEMENT_EXPRESSION:
+            statement = expression_statement(expander->arena, children[0]);
+            break;
+        case STATEMENT_BLOCK:
+        {
+            array* statements = expand_list(expander, children, count);
+            statement = block_statement(expander->arena, statements, statements->length);
+            break;
+        }
+        case STATEMENT_IF:
+            statement = if_statement(expander->arena, children[0], children[1], children[2]);
+            break;
+        case STATEMENT_WHILE:
+            statement = while_statement(expander->arena, children[0], children[1]);
+            break;
+        case STATEMENT_RETURN:
+            statement = return_statement(expander->arena, children[0]);
+            break;
+        case STATEMENT_BREAK:
+            statement = break_statement(expander->arena);
+            break;
+        case STATEMENT_CONTINUE:
+            statement = continue_statement(expander->arena);
+            break;
+        case STATEMENT_DECLARATION:
+            statement = declaration_statement(expander->arena, children[0]);
+            break;
+        default:
+            statement = arena_calloc(expander->arena, 1, sizeof (AST_Statement));
+            statement->kind = kind;
+            break;
+    }
+
+    statement->position = pool->positions[index];
+
+    return statement;
+}
+
+
+static AST_Declaration* expand_declaration(Expander* expander, AST_Index index, void** children)
+{
+    const AST_Pool* pool = expander->pool;
+    AST_Node_Data data = pool->data[index];
+    Token* identifier = &expander->tokens[pool->main_tokens[index]];
+    AST_Declaration* declaration;
+
+    if (AST_NODE_SUBKIND(pool->kinds[index]) == DECLARATION_FUNCTION)
+        declaration = function_declaration(expander->arena, identifier, data.lhs, children[0]);
+    else
+        declaration = variable_declaration(expander->arena, identifier, data.lhs, children[0]);
+
+    declaration->kind = AST_NODE_SUBKIND(pool->kinds[index]);
+    declaration->position = pool->positions[index];
+
+    return declaration;
+}
+
+
+// Expands any node based on its class. The children of the node are already
+// expanded.
+static void* expand_node(Expander* expander, AST_Index index, void** children, const int count)
+{
+    switch (AST_NODE_CLASS(expander->pool->kinds[index]))
+    {
+        case NODE_DECLARATION:  return expand_declaration(expander, index, children);
+        case NODE_PARAMETER:    return expand_parameter(expander, index);
+        case NODE_STATEMENT:    return expand_statement(expander, index, children, count);
+        case NODE_EXPRESSION:   return expand_expression(expander, index, children, count);
+        default:                return NULL;
+    }
+}
+
+
+// Pushes the node to the stack to wait for its children. The missing nodes are
+// expanded into NULL and the already expanded nodes into themselves right away.
+static void expand_push(Expander* expander, Expand_Frame_Stack* stack, Expanded_Stack* expanded, const AST_Index index)
+{
+    if (index == 0 || expander->nodes[index] != NULL)
+        expanded_stack_push(expanded, expander->nodes[index]);
+    else
+        expand_frame_stack_push(stack, (Expand_Frame){ .index = index, .children = pool_children(expander->pool, index) });
+}
+
+
+// NOTE(timo): The pool is expanded with an explicit stack, since the 
+// expressions can be nested deeper than the call stack allows. The children 
+// are expanded before their parents, which are created from them.
+void ast_pool_expand(const AST_Pool* pool, arena* arena, array* declarations)
+{
+    Expander expander = { .pool = pool, .arena = arena, .nodes = xcalloc(pool->length, sizeof (void*)) };
+    Expand_Frame_Stack stack;
+    Expanded_Stack expanded;
+
+    expander.tokens = arena_alloc(arena, pool->tokens.length * sizeof (Token));
+    memcpy(expander.tokens, pool->tokens.items, pool->tokens.length * sizeof (Token));
+
+    expand_frame_stack_init(&stack, 0);
+    expanded_stack_init(&expanded, 0);
+
+    const AST_Index* list = &pool->extra.items[pool->declarations];
+
+    for (AST_Index i = 0; i < list[0]; i++)
+    {
+        expand_push(&expander, &stack, &expanded, list[1 + i]);
+
+        while (stack.length > 0)
+        {
+            Expand_Frame* top = &stack.items[stack.length - 1];
+
+            if (top->next < top->children)
+            {
+                AST_Index child = pool_child(pool, top->index, top->next++);
+                expand_push(&expander, &stack, &expanded, child);
+                continue;
+            }
+
+            Expand_Frame frame = expand_frame_stack_pop(&stack);
+            void** children = &expanded.items[expanded.length - frame.children];
+            void* node = expand_node(&expander, frame.index, children, frame.children);
+
+            expanded.length -= frame.children;
+            expanded_stack_push(&expanded, node);
+            expander.nodes[frame.index] = node;
+        }
+
+        array_push(declarations, expanded_stack_pop(&expanded));
+    }
+
+    expand_frame_stack_free(&stack);
+    expanded_stack_free(&expanded);
+    free(expander.nodes);
+}
+
+
+// Collects the declarations and the expressions of the tree in the order the
+// results of the resolver are saved. The tree is walked with an explicit 
+// stack, since the expressions can be nested deeper than the call stack 
+// allows. Both the saving and the loading walk the tree with this, so the
+// order is always the same.
+static void collect_items(const array* declarations, Cache_Item_Array* items)
+{
+    Cache_Item_Array stack;
+    cache_item_array_init(&stack, 0);
+
+    for (int i = declarations->length - 1; i >= 0; i--)
+        cache_item_array_push(&stack, (Cache_Item){ NODE_DECLARATION, declarations->items[i] });
+
+    while (stack.length > 0)
+    {
+        Cache_Item item = cache_item_array_pop(&stack);
+
+        if (item.node == NULL)
+            continue;
+
+        if (item.class != NODE_STATEMENT)
+            cache_item_array_push(items, item);
+
+        // NOTE(timo): The children are pushed in reverse order, so they are
+        // collected in the order of the source
+        for (int i = item_children(item) - 1; i >= 0; i--)
+            cache_item_array_push(&stack, item_child(item, i));
+    }
+
+    cache_item_array_free(&stack);
+}
+
+
+// Array written into the cache file.
+//
+// Members
+//      data: Start of the array.
+//      size: Size of the array in bytes.
+typedef struct Cache_Section
+{
+    const void* data;
+    size_t size;
+} Cache_Section;
+
+
+// Context for saving the results of the resolver.
+//
+// Members
+//      indices: Indices of the saved types, scopes and symbols by their 
+//               addresses.
+//      scope_list: Scopes in the order they are saved.
+//      nodes: Results of the declarations and the expressions.
+//      symbols: Saved symbols.
+//      types: Saved types.
+//      parameters: Parameter types of the function types.
+//      scopes: Saved scopes.
+//      strings: Names of the symbols and the scopes.
+typedef struct Cache_Writer
+{
+    Index_Map indices;
+    array* scope_list;
+    Cache_Node_Array nodes;
+    Cache_Symbol_Array symbols;
+    Cache_Type_Array types;
+    AST_Index_Array parameters;
+    Cache_Scope_Array scopes;
+    Cache_String_Buffer strings;
+} Cache_Writer;
+
+
+// Returns the saved index of the object or 0 if it hasn't been saved. The
+// types, the scopes and the symbols are all different objects, so their
+// addresses can be kept in the same map.
+static inline uint32_t saved_index(const Cache_Writer* writer, const void* pointer)
+{
+    return pointer ? index_map_get(&writer->indices, pointer) : 0;
+}
+
+
+static inline void save_index(Cache_Writer* writer, const void* pointer, uint32_t index)
+{
+    index_map_put(&writer->indices, pointer, index);
+}
+
+
+static uint32_t save_string(Cache_Writer* writer, const char* string)
+{
+    uint32_t offset = writer->strings.length;
+
+    do
+        cache_string_buffer_push(&writer->strings, *string);
+    while (*string++);
+
+    return offset;
+}
+
+
+// Saves the type after its component types.
+static uint32_t save_type(Cache_Writer* writer, const Type* type)
+{
+    if (type == NULL)
+        return 0;
+
+    uint32_t index = saved_index(writer, type);
+
+    if (index)
+        return index;
+
+    Cache_Type saved = { .kind = type->kind };
+
+    if (type->kind == TYPE_ARRAY)
+        saved.inner = save_type(writer, type->array.element_type);
+    else if (type->kind == TYPE_FUNCTION)
+    {
+        saved.inner = save_type(writer, type->function.return_type);
+        saved.arity = type->function.arity;
+
+        for (int i = 0; i < type->function.arity; i++)
+            save_type(writer, type->function.parameters->items[i]);
+
+        saved.parameters = writer->parameters.length;
+
+        for (int i = 0; i < type->function.arity; i++)
+            ast_index_array_push(&writer->parameters, saved_index(writer, type->function.parameters->items[i]));
+    }
+
+    cache_type_array_push(&writer->types, saved);
+    save_index(writer, type, writer->types.length);
+
+    return writer->types.length;
+}
+
+
+// Saves the scopes and the symbols starting from the global scope. The local
+// scopes of the functions are saved after the scope of the function, so the
+// enclosing scopes are always created first when the scopes are loaded.
+static void save_scopes(Cache_Writer* writer, Scope* global)
+{
+    array_push(writer->scope_list, global);
+    save_index(writer, global, 1);
+
+    for (int i = 0; i < writer->scope_list->length; i++)
+    {
+        const Scope* scope = writer->scope_list->items[i];
+
+        for (int j = 0; j < scope->symbols->count; j++)
+        {
+            Symbol* symbol = scope->symbols->entries[j].value;
+
+            if (symbol != NULL && symbol->local != NULL)
+            {
+                array_push(writer->scope_list, symbol->local);
+                save_index(writer, symbol->local, writer->scope_list->length);
+            }
+        }
+    }
+
+    for (int i = 0; i < writer->scope_list->length; i++)
+    {
+        const Scope* scope = writer->scope_list->items[i];
+
+        cache_scope_array_push(&writer->scopes, (Cache_Scope){
+            .name = save_string(writer, scope->name),
+            .enclosing = scope->enclosing ? saved_index(writer, scope->enclosing) : 0,
+            .frame_size = scope->frame_size });
+
+        for (int j = 0; j < scope->symbols->count; j++)
+        {
+            Symbol* symbol = scope->symbols->entries[j].value;
+
+            if (symbol == NULL)
+                continue;
+
+            cache_symbol_array_push(&writer->symbols, (Cache_Symbol){
+                .value = symbol->value,
+                .kind = symbol->kind,
+                .state = symbol->state,
+                .scope = i + 1,
+                .identifier = save_string(writer, symbol->identifier),
+                .type = save_type(writer, symbol->type),
+                .local = symbol->local ? saved_index(writer, symbol->local) : 0,
+                .slot = symbol->slot });
+            save_index(writer, symbol, writer->symbols.length);
+        }
+    }
+}
+
+
+// Saves the results of the resolver for the declarations and the expressions.
+static void save_nodes(Cache_Writer* writer, const array* declarations)
+{
+    Cache_Item_Array items;
+    cache_item_array_init(&items, 0);
+    collect_items(declarations, &items);
+
+    for (int i = 0; i < items.length; i++)
+    {
+        Cache_Node saved = { 0 };
+
+        if (items.items[i].class == NODE_DECLARATION)
+        {
+            AST_Declaration* declaration = items.items[i].node;
+            saved.symbol = saved_index(writer, declaration->symbol);
+        }
+        else
+        {
+            AST_Expression* expression = items.items[i].node;
+            saved.value = expression->value;
+            saved.type = save_type(writer, expression->type);
+            saved.symbol = saved_index(writer, expression->symbol);
+
+            if (expression->kind == EXPRESSION_FUNCTION && expression->function.scope)
+                saved.scope = saved_index(writer, expression->function.scope);
+        }
+
+        cache_node_array_push(&writer->nodes, saved);
+    }
+
+    cache_item_array_free(&items);
+}
+
+
+void ast_cache_save(const char* directory, const char* source, const array* declarations, const Resolver* resolver)
+{
+    AST_Cache_Header header = cache_header(source);
+    AST_Pool pool;
+    Cache_Writer writer = { .scope_list = array_init(sizeof (Scope*)) };
+    char path[4096];
+    // NOTE(timo): Room for the process id after the path
+    char temporary[sizeof (path) + 16];
+
+    ast_pool_init(&pool);
+    ast_pool_flatten(&pool, declarations);
+
+    index_map_init(&writer.indices, INDEX_MAP_INITIAL_CAPACITY);
+    cache_node_array_init(&writer.nodes, 0);
+    cache_symbol_array_init(&writer.symbols, 0);
+    cache_type_array_init(&writer.types, 0);
+    ast_index_array_init(&writer.parameters, 0);
+    cache_scope_array_init(&writer.scopes, 0);
+    cache_string_buffer_init(&writer.strings, 0);
+
+    save_scopes(&writer, resolver->global);
+    save_nodes(&writer, declarations);
+
+    header.nodes = pool.length;
+    header.extra = pool.extra.length;
+    header.tokens = pool.tokens.length;
+    header.declarations = pool.declarations;
+    header.lazy = resolver->lazy;
+    header.share = resolver->shared;
+    header.resolved = writer.nodes.length;
+    header.symbols = writer.symbols.length;
+    header.types = writer.types.length;
+    header.parameters = writer.parameters.length;
+    header.scopes = writer.scopes.length;
+    header.strings = writer.strings.length;
+
+    for (int i = 0; i < pool.tokens.length; i++)
+        pool.tokens.items[i].lexeme = NULL;
+
+    // NOTE(timo): The file is written under a temporary name and renamed
+    // after, so the other compilations never see a partially written file
+    mkdir(directory, 0755);
+    cache_path(path, sizeof (path), directory, header.hash);
+    snprintf(temporary, sizeof (temporary), "%s.%d", path, (int)getpid());
+
+    // NOTE(timo): The arrays are written in the order of their alignment
+    const Cache_Section sections[] =
+    {
+        { writer.nodes.items, writer.nodes.length * sizeof (Cache_Node) },
+        { writer.symbols.items, writer.symbols.length * sizeof (Cache_Symbol) },
+        { pool.tokens.items, pool.tokens.length * sizeof (Token) },
+        { pool.data, pool.length * sizeof (AST_Node_Data) },
+        { pool.positions, pool.length * sizeof (Position) },
+        { pool.main_tokens, pool.length * sizeof (AST_Index) },
+        { pool.extra.items, pool.extra.length * sizeof (AST_Index) },
+        { writer.types.items, writer.types.length * sizeof (Cache_Type) },
+        { writer.parameters.items, writer.parameters.length * sizeof (AST_Index) },
+        { writer.scopes.items, writer.scopes.length * sizeof (Cache_Scope) },
+        { writer.strings.items, writer.strings.length * sizeof (char) },
+        { pool.kinds, pool.length * sizeof (uint8_t) },
+    };
+    const int count = sizeof (sections) / sizeof (*sections);
+
+    header.checksum = FNV_OFFSET_BASIS;
+
+    for (int i = 0; i < count; i++)
+        header.checksum = fnv1a_hash(header.checksum, sections[i].data, sections[i].size);
+
+    FILE* file = fopen(temporary, "wb");
+
+    if (file != NULL)
+    {
+        bool written = fwrite(&header, sizeof (AST_Cache_Header), 1, file) == 1;
+
+        for (int i = 0; i < count && written; i++)
+            written = fwrite(sections[i].data, 1, sections[i].size, file) == sections[i].size;
+
+        if (fclose(file) == 0 && written)
+            rename(temporary, path);
+        else
+            remove(temporary);
+    }
+
+    cache_node_array_free(&writer.nodes);
+    cache_symbol_array_free(&writer.symbols);
+    cache_type_array_free(&writer.types);
+    ast_index_array_free(&writer.parameters);
+    cache_scope_array_free(&writer.scopes);
+    cache_string_buffer_free(&writer.strings);
+    array_free(writer.scope_list);
+    index_map_free(&writer.indices);
+    ast_pool_free(&pool);
+}
+
+
+// View to the contents of the mapped cache file.
+typedef struct Cache_View
+{
+    const AST_Cache_Header* header;
+    AST_Pool pool;
+    Cache_Node* nodes;
+    Cache_Symbol* symbols;
+    Cache_Type* types;
+    AST_Index* parameters;
+    Cache_Scope* scopes;
+    const char* strings;
+} Cache_View;
+
+
+// Sets the arrays of the view to point into the contents of the file. The 
+// size of the file has to be checked before.
+static void view_contents(Cache_View* view, char* contents)
+{
+    const AST_Cache_Header* header = (AST_Cache_Header*)contents;
+    char* data = contents + sizeof (AST_Cache_Header);
+
+    view->header = header;
+    view->pool = (AST_Pool){ .length = header->nodes,
+                             .capacity = header->nodes,
+                             .declarations = header->declarations,
+                             .shared = header->share };
+
+    view->nodes = (Cache_Node*)data;
+    data += header->resolved * sizeof (Cache_Node);
+
+    view->symbols = (Cache_Symbol*)data;
+    data += header->symbols * sizeof (Cache_Symbol);
+
+    view->pool.tokens.items = (Token*)data;
+    view->pool.tokens.length = header->tokens;
+    data += header->tokens * sizeof (Token);
+
+    view->pool.data = (AST_Node_Data*)data;
+    data += header->nodes * sizeof (AST_Node_Data);
+
+    view->pool.positions = (Position*)data;
+    data += header->nodes * sizeof (Position);
+
+    view->pool.main_tokens = (AST_Index*)data;
+    data += header->nodes * sizeof (AST_Index);
+
+    view->pool.extra.items = (AST_Index*)data;
+    view->pool.extra.length = header->extra;
+    data += header->extra * sizeof (AST_Index);
+
+    view->types = (Cache_Type*)data;
+    data += header->types * sizeof (Cache_Type);
+
+    view->parameters = (AST_Index*)data;
+    data += header->parameters * sizeof (AST_Index);
+
+    view->scopes = (Cache_Scope*)data;
+    data += header->scopes * sizeof (Cache_Scope);
+
+    view->strings = data;
+    data += header->strings * sizeof (char);
+
+    view->pool.kinds = (uint8_t*)data;
+}
+
+
+static inline bool valid_position(const Position position, const uint64_t size)
+{
+    // NOTE(timo): Not every node has its end set, so the ends are only kept
+    // inside of the source
+    return position.start >= 0 && position.end >= 0 && 
+           (uint64_t)position.start <= size && (uint64_t)position.end <= size;
+}
+
+
+static inline bool valid_value(const Value value)
+{
+    return value.type == VALUE_NONE || value.type == VALUE_INTEGER || value.type == VALUE_BOOLEAN;
+}
+
+
+// Checks the tokens and the nodes of the tree.
+static bool valid_tree(const Cache_View* view)
+{
+    const AST_Pool* pool = &view->pool;
+    const uint64_t size = view->header->size;
+
+    for (int i = 1; i < pool->tokens.length; i++)
+    {
+        const Token* token = &pool->tokens.items[i];
+
+        if (token->position.start < 0 || token->lexeme_length < 0 ||
+            (uint64_t)token->position.start + (uint64_t)token->lexeme_length > size)
+            return false;
+    }
+
+    for (int i = 0; i < pool->length; i++)
+    {
+        if (! valid_position(pool->positions[i], size))
+            return false;
+    }
+
+    return ast_pool_valid(pool);
+}
+
+
+// Checks that the tokens are the same as the ones lexed again from the source
+// at their positions. The positions are checked before.
+static bool valid_tokens(const Cache_View* view, const char* source)
+{
+    const AST_Pool* pool = &view->pool;
+    bool valid = true;
+    Lexer lexer;
+
+    lexer_init_range(&lexer, source, source, source + view->header->size);
+
+    // NOTE(timo): The token 0 is the reserved token without a lexeme
+    for (int i = 1; i < pool->tokens.length && valid; i++)
+    {
+        const Token* token = &pool->tokens.items[i];
+
+        lexer.stream = source + token->position.start;
+        Token lexed = next_token(&lexer);
+
+        valid = lexed.kind == token->kind &&
+                lexed.position.start == token->position.start &&
+                lexed.position.end == token->position.end &&
+                lexed.lexeme_length == token->lexeme_length &&
+                (lexed.kind != TOKEN_INTEGER_LITERAL || lexed.integer == token->integer);
+    }
+
+    lexer_free(&lexer);
+
+    return valid;
+}
+
+
+// Checks that the indices of the results of the resolver are in bounds and 
+// that they refer only to the objects created before them.
+static bool valid_resolved(const Cache_View* view)
+{
+    const AST_Cache_Header* header = view->header;
+    // NOTE(timo): The local scope of every function has to be owned by
+    // exactly one function symbol, so the scopes are freed exactly once
+    uint8_t* owned = xcalloc(header->scopes + 1, sizeof (uint8_t));
+    bool valid = header->scopes > 0 && view->scopes[0].enclosing == 0 &&
+                 (header->strings == 0 || view->strings[header->strings - 1] == 0);
+
+    for (uint32_t i = 0; valid && i < header->types; i++)
+    {
+        const Cache_Type* type = &view->types[i];
+
+        switch (type->kind)
+        {
+            case TYPE_NONE:
+            case TYPE_INTEGER:
+            case TYPE_BOOLEAN:
+                break;
+            case TYPE_ARRAY:
+                valid = type->inner > 0 && type->inner <= i;
+                break;
+            case TYPE_FUNCTION:
+                valid = type->inner <= i && type->parameters <= header->parameters &&
+                        type->arity <= header->parameters - type->parameters;
+
+                for (uint32_t j = 0; valid && j < type->arity; j++)
+                    valid = view->parameters[type->parameters + j] > 0 && view->parameters[type->parameters + j] <= i;
+                break;
+            default:
+                valid = false;
+                break;
+        }
+    }
+
+    for (uint32_t i = 0; valid && i < header->scopes; i++)
+    {
+        const Cache_Scope* scope = &view->scopes[i];
+        valid = scope->name < header->strings && scope->frame_size >= 0 &&
+                (i == 0 || (scope->enclosing > 0 && scope->enclosing <= i));
+    }
+
+    for (uint32_t i = 0; valid && i < header->symbols; i++)
+    {
+        const Cache_Symbol* symbol = &view->symbols[i];
+        valid = (symbol->kind == SYMBOL_VARIABLE || symbol->kind == SYMBOL_PARAMETER || symbol->kind == SYMBOL_FUNCTION) &&
+                symbol->state <= STATE_RESOLVED && valid_value(symbol->value) &&
+                symbol->scope > 0 && symbol->scope <= header->scopes &&
+                symbol->identifier < header->strings &&
+                symbol->type > 0 && symbol->type <= header->types;
+
+        if (! valid)
+            break;
+
+        if (symbol->kind == SYMBOL_FUNCTION)
+        {
+            valid = view->types[symbol->type - 1].kind == TYPE_FUNCTION &&
+                    symbol->local > symbol->scope && symbol->local <= header->scopes &&
+                    ! owned[symbol->local];
+
+            if (valid)
+                owned[symbol->local] = 1;
+        }
+        else
+            valid = symbol->local == 0;
+    }
+
+    for (uint32_t i = 2; valid && i <= header->scopes; i++)
+        valid = owned[i];
+
+    for (uint32_t i = 0; valid && i < header->resolved; i++)
+    {
+        const Cache_Node* node = &view->nodes[i];
+        valid = valid_value(node->value) && node->type <= header->types &&
+                node->symbol <= header->symbols && node->scope <= header->scopes;
+    }
+
+    free(owned);
+
+    return valid;
+}
+
+
+// Creates the types, the scopes and the symbols again and binds them to the
+// expanded tree. Everything has to be checked before.
+static void load_resolved(const Cache_View* view, const Cache_Item_Array* items, Resolver* resolver)
+{
+    const AST_Cache_Header* header = view->header;
+    Type** types = xmalloc((header->types + 1) * sizeof (Type*));
+    Scope** scopes = xmalloc((header->scopes + 1) * sizeof (Scope*));
+    Symbol** symbols = xmalloc((header->symbols + 1) * sizeof (Symbol*));
+    Type** parameters = xmalloc((header->parameters + 1) * sizeof (Type*));
+
+    types[0] = NULL;
+    scopes[0] = NULL;
+    symbols[0] = NULL;
+
+    for (uint32_t i = 0; i < header->types; i++)
+    {
+        const Cache_Type* type = &view->types[i];
+
+        switch (type->kind)
+        {
+            case TYPE_NONE:     types[i + 1] = hashtable_get(resolver->type_table, "none"); break;
+            case TYPE_INTEGER:  types[i + 1] = hashtable_get(resolver->type_table, "int"); break;
+            case TYPE_BOOLEAN:  types[i + 1] = hashtable_get(resolver->type_table, "bool"); break;
+            case TYPE_ARRAY:    types[i + 1] = type_array(resolver->type_table, types[type->inner]); break;
+            case TYPE_FUNCTION:
+                for (uint32_t j = 0; j < type->arity; j++)
+                    parameters[j] = types[view->parameters[type->parameters + j]];
+
+                types[i + 1] = type_function(resolver->type_table, types[type->inner], parameters, type->arity);
+                break;
+        }
+    }
+
+    scopes[1] = resolver->global;
+    scopes[1]->frame_size = view->scopes[0].frame_size;
+
+    for (uint32_t i = 1; i < header->scopes; i++)
+    {
+        const Cache_Scope* scope = &view->scopes[i];
+        scopes[i + 1] = scope_init(scopes[scope->enclosing], str_intern(view->strings + scope->name));
+        scopes[i + 1]->frame_size = scope->frame_size;
+    }
+
+    for (uint32_t i = 0; i < header->symbols; i++)
+    {
+        const Cache_Symbol* saved = &view->symbols[i];
+        Scope* scope = scopes[saved->scope];
+        const char* identifier = view->strings + saved->identifier;
+        Symbol* symbol;
+
+        switch (saved->kind)
+        {
+            case SYMBOL_PARAMETER:  symbol = symbol_parameter(scope, identifier, types[saved->type]); break;
+            case SYMBOL_FUNCTION:   symbol = symbol_function(scope, identifier, types[saved->type]); break;
+            default:                symbol = symbol_variable(scope, identifier, types[saved->type]); break;
+        }
+
+        symbol->state = saved->state;
+        symbol->value = saved->value;
+        symbol->slot = saved->slot;
+        symbol->local = scopes[saved->local];
+        scope_declare(scope, symbol);
+        symbols[i + 1] = symbol;
+    }
+
+    for (int i = 0; i < items->length; i++)
+    {
+        const Cache_Node* saved = &view->nodes[i];
+
+        if (items->items[i].class == NODE_DECLARATION)
+        {
+            AST_Declaration* declaration = items->items[i].node;
+            declaration->symbol = symbols[saved->symbol];
+        }
+        else
+        {
+            AST_Expression* expression = items->items[i].node;
+            expression->type = types[saved->type];
+            expression->value = saved->value;
+            expression->symbol = symbols[saved->symbol];
+
+            if (expression->kind == EXPRESSION_FUNCTION)
+                expression->function.scope = scopes[saved->scope];
+        }
+    }
+
+    free(types);
+    free(scopes);
+    free(symbols);
+    free(parameters);
+}
+
+
+bool ast_cache_load(const char* directory, const char* source, arena* arena, array* declarations, Resolver* resolver)
+{
+    AST_Cache_Header expected = cache_header(source);
+    char path[4096];
+    cache_path(path, sizeof (path), directory, expected.hash);
+
+    int descriptor = open(path, O_RDONLY);
+    struct stat info;
+
+    if (descriptor < 0)
+        return false;
+
+    if (fstat(descriptor, &info) != 0 || (size_t)info.st_size < sizeof (AST_Cache_Header))
+    {
+        close(descriptor);
+        return false;
+    }
+
+    // NOTE(timo): The mapping is private and writable, so the lexemes of the
+    // tokens can be set in place without touching the file itself
+    size_t size = (size_t)info.st_size;
+    char* contents = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+
+    if (contents == MAP_FAILED)
+        return false;
+
+    AST_Cache_Header* header = (AST_Cache_Header*)contents;
+    Cache_View view;
+
+    if (memcmp(header->magic, expected.magic, sizeof (header->magic)) != 0 ||
+        header->version != expected.version ||
+        memcmp(header->build, expected.build, sizeof (header->build)) != 0 ||
+        header->hash != expected.hash ||
+        header->size != expected.size ||
+        header->lazy != resolver->lazy ||
+        header->share != resolver->shared ||
+        header->nodes > INT_MAX || header->tokens > INT_MAX || header->extra > INT_MAX || header->resolved > INT_MAX ||
+        cache_size(header) != size ||
+        fnv1a_hash(FNV_OFFSET_BASIS, contents + sizeof (AST_Cache_Header), size - sizeof (AST_Cache_Header)) != header->checksum)
+    {
+        munmap(contents, size);
+        return false;
+    }
+
+    view_contents(&view, contents);
+
+    if (! valid_tree(&view) || ! valid_tokens(&view, source) || ! valid_resolved(&view))
+    {
+        munmap(contents, size);
+        return false;
+    }
+
+    // NOTE(timo): The token 0 is the reserved token without a lexeme
+    for (int i = 1; i < view.pool.tokens.length; i++)
+    {
+        Token* token = &view.pool.tokens.items[i];
+        token->lexeme = str_intern_range(source + token->position.start, token->lexeme_length);
+    }
+
+    int length = declarations->length;
+    Cache_Item_Array items;
+    cache_item_array_init(&items, 0);
+
+    ast_pool_expand(&view.pool, arena, declarations);
+    collect_items(declarations, &items);
+
+    // NOTE(timo): The number of the results can be checked only after the
+    // tree is expanded, the expanded tree is just dropped if they don't match
+    bool loaded = (uint32_t)items.length == header->resolved;
+
+    if (loaded)
+        load_resolved(&view, &items, resolver);
+    else
+        declarations->length = length;
+
+    cache_item_array_free(&items);
+    munmap(contents, size);
+
+    return loaded;
+}
@@ -87,7 +87,7 @@ static int allocate_register(Code_Generator* generator)
 }
 
 
-void code_generator_init(Code_Generator* generator, Scope* global, array* instructions)
+void code_generator_init(Code_Generator* generator, Scope* global, Instruction_Array* instructions)
 {
     *generator = (Code_Generator) { .global = global,
                                     .diagnostics = array_init(sizeof (Diagnostic*)),
@@ -127,8 +127,8 @@ void code_generate_instruction(Code_Generator* generator, Instruction* instructi
             // TODO(timo): Assignment to global variable
 
             // This result will always be set, since it is temporary
-            Symbol* result = scope_lookup(generator->local, instruction->result);
-            Symbol* arg = scope_lookup(generator->local, instruction->arg1);
+            Symbol* result = instruction->result_symbol;
+            Symbol* arg = instruction->arg1_symbol;
 
             // Arg can be NULL, if the operand of the copy is a constant
             if (arg != NULL)
@@ -162,22 +162,22 @@ void code_generate_instruction(Code_Generator* generator, Instruction* instructi
             {
                 if (result->type->kind == TYPE_INTEGER)
                     fprintf(generator->output,
-                        "    mov    qword [rbp-%d], %s      ; move integer constant to stack\n", 
-                        result->offset, instruction->arg1);
+                        "    mov    qword [rbp-%d], %lld      ; move integer constant to stack\n", 
+                        result->offset, (long long)instruction->value.integer);
                 else if (result->type->kind == TYPE_BOOLEAN)
                     fprintf(generator->output,
                         "    mov    rax, [%s]               ; dereference the boolean value to rax\n"
                         "    mov    qword [rbp-%d], rax     ; move the integer value of the boolean to the stack\n",
-                        instruction->arg1, result->offset);
+                        instruction->value.boolean ? "true" : "false", result->offset);
             }
 
             break;
         }
         case OP_ADD: // https://www.felixcloutier.com/x86/add
         {
-            Symbol* destination = scope_lookup(generator->local, instruction->arg1);
-            Symbol* source = scope_lookup(generator->local, instruction->arg2);
-            Symbol* result = scope_lookup(generator->local, instruction->result);
+            Symbol* destination = instruction->arg1_symbol;
+            Symbol* source = instruction->arg2_symbol;
+            Symbol* result = instruction->result_symbol;
             int temp_reg = allocate_register(generator);
             
             fprintf(generator->output,
@@ -193,9 +193,9 @@ void code_generate_instruction(Code_Generator* generator, Instruction* instructi
         }
         case OP_SUB: // https://www.felixcloutier.com/x86/sub
         {
-            Symbol* destination = scope_lookup(generator->local, instruction->arg1);
-            Symbol* source = scope_lookup(generator->local, instruction->arg2);
-            Symbol* result = scope_lookup(generator->local, instruction->result);
+            Symbol* destination = instruction->arg1_symbol;
+            Symbol* source = instruction->arg2_symbol;
+            Symbol* result = instruction->result_symbol;
             int temp_reg = allocate_register(generator);
 
             fprintf(generator->output,
@@ -211,9 +211,9 @@ void code_generate_instruction(Code_Generator* generator, Instruction* instructi
         }
         case OP_MUL: // https://www.felixcloutier.com/x86/mul
         {
-            Symbol* destination = scope_lookup(generator->local, instruction->arg1);
-            Symbol* source = scope_lookup(generator->local, instruction->arg2);
-            Symbol* result = scope_lookup(generator->local, instruction->result);
+            Symbol* destination = instruction->arg1_symbol;
+            Symbol* source = instruction->arg2_symbol;
+            Symbol* result = instruction->result_symbol;
 
             fprintf(generator->output,
                 "    mov    rax, [rbp-%d]           ; move the variable being multiplied from the stack to the rax\n"
@@ -227,9 +227,9 @@ void code_generate_instruction(Code_Generator* generator, Instruction* instructi
         }
         case OP_DIV: // https://www.felixcloutier.com/x86/div
         {
-            Symbol* destination = scope_lookup(generator->local, instruction->arg1);
-            Symbol* source = scope_lookup(generator->local, instruction->arg2);
-            Symbol* result = scope_lookup(generator->local, instruction->result);
+            Symbol* destination = instruction->arg1_symbol;
+            Symbol* source = instruction->arg2_symbol;
+            Symbol* result = instruction->result_symbol;
 
             fprintf(generator->output,
                 "    mov    rdx, 0                  ; setting rdx to 0 because it represents the top bits of the divident\n"
@@ -244,8 +244,8 @@ void code_generate_instruction(Code_Generator* generator, Instruction* instructi
         }
         case OP_MINUS: // https://www.felixcloutier.com/x86/neg
         {
-            Symbol* arg = scope_lookup(generator->local, instruction->arg1);
-            Symbol* result = scope_lookup(generator->local, instruction->result);
+            Symbol* arg = instruction->arg1_symbol;
+            Symbol* result = instruction->result_symbol;
             int temp_reg = allocate_register(generator);
 
             fprintf(generator->output,
@@ -266,9 +266,9 @@ void code_generate_instruction(Code_Generator* generator, Instruction* instructi
         case OP_GT:
         case OP_GTE:
         {
-            Symbol* destination = scope_lookup(generator->local, instruction->arg1);
-            Symbol* source = scope_lookup(generator->local, instruction->arg2);
-            Symbol* result = scope_lookup(generator->local, instruction->result);
+            Symbol* destination = instruction->arg1_symbol;
+            Symbol* source = instruction->arg2_symbol;
+            Symbol* result = instruction->result_symbol;
             int temp_reg_1 = allocate_register(generator);
             int temp_reg_2 = allocate_register(generator);
 
@@ -356,8 +356,8 @@ void code_generate_instruction(Code_Generator* generator, Instruction* instructi
         }
         case OP_NOT: // https://www.felixcloutier.com/x86/not
         {
-            Symbol* arg = scope_lookup(generator->local, instruction->arg1);
-            Symbol* result = scope_lookup(generator->local, instruction->result);
+            Symbol* arg = instruction->arg1_symbol;
+            Symbol* result = instruction->result_symbol;
             
             fprintf(generator->output,
                 "    mov    rax, [rbp-%d]           ; \n"
@@ -370,9 +370,9 @@ void code_generate_instruction(Code_Generator* generator, Instruction* instructi
         }
         case OP_AND: // https://www.felixcloutier.com/x86/and
         {
-            Symbol* destination = scope_lookup(generator->local, instruction->arg1);
-            Symbol* source = scope_lookup(generator->local, instruction->arg2);
-            Symbol* result = scope_lookup(generator->local, instruction->result);
+            Symbol* destination = instruction->arg1_symbol;
+            Symbol* source = instruction->arg2_symbol;
+            Symbol* result = instruction->result_symbol;
             
             fprintf(generator->output,
                 "    mov    rax, [rbp-%d]           ; \n"
@@ -386,9 +386,9 @@ void code_generate_instruction(Code_Generator* generator, Instruction* instructi
         }
         case OP_OR: // https://www.felixcloutier.com/x86/or
         {
-            Symbol* destination = scope_lookup(generator->local, instruction->arg1);
-            Symbol* source = scope_lookup(generator->local, instruction->arg2);
-            Symbol* result = scope_lookup(generator->local, instruction->result);
+            Symbol* destination = instruction->arg1_symbol;
+            Symbol* source = instruction->arg2_symbol;
+            Symbol* result = instruction->result_symbol;
             
             fprintf(generator->output,
                 "    mov    rax, [rbp-%d]           ; \n"
@@ -402,7 +402,7 @@ void code_generate_instruction(Code_Generator* generator, Instruction* instructi
         }
         case OP_GOTO_IF_FALSE: 
         {
-            Symbol* arg = scope_lookup(generator->local, instruction->arg1);
+            Symbol* arg = instruction->arg1_symbol;
             int temp_reg = allocate_register(generator);
 
             fprintf(generator->output,
@@ -429,8 +429,8 @@ void code_generate_instruction(Code_Generator* generator, Instruction* instructi
         case OP_FUNCTION_BEGIN:
         {
             // Change the scope to the functions scope
-            Symbol* symbol = scope_lookup(generator->local, instruction->label);
-            generator->local = symbol->type->function.scope;
+            Symbol* symbol = instruction->arg1_symbol;
+            generator->local = symbol->local;
             
             // NOTE(timo): Even if the user does not use the command line
             // arguments, we will save them.
@@ -456,7 +456,7 @@ void code_generate_instruction(Code_Generator* generator, Instruction* instructi
         }
         case OP_PARAM_PUSH:
         {
-            Symbol* parameter = scope_lookup(generator->local, instruction->arg1);
+            Symbol* parameter = instruction->arg1_symbol;
 
             fprintf(generator->output,
                 "    push   qword[rbp-%d]           ; pushing function parameter\n", 
@@ -466,7 +466,7 @@ void code_generate_instruction(Code_Generator* generator, Instruction* instructi
         }
         case OP_PARAM_POP:
         {
-            Symbol* parameter = scope_lookup(generator->local, instruction->arg1);
+            Symbol* parameter = instruction->arg1_symbol;
             
             fprintf(generator->output,
                 "    pop    qword [rbp-%d]          ; popping function parameter\n", 
@@ -505,7 +505,7 @@ void code_generate_instruction(Code_Generator* generator, Instruction* instructi
         }
         case OP_RETURN:
         {
-            Symbol* value = scope_lookup(generator->local, instruction->arg1);
+            Symbol* value = instruction->arg1_symbol;
             
             // NOTE(timo): Jump to function epilogue is really not necessary 
             // right now since we only allow one return per function but so
@@ -524,8 +524,8 @@ void code_generate_instruction(Code_Generator* generator, Instruction* instructi
         }
         case OP_CALL:
         {
-            Symbol* value = scope_lookup(generator->local, instruction->arg1);
-            Symbol* result = scope_lookup(generator->local, instruction->result);
+            Symbol* value = instruction->arg1_symbol;
+            Symbol* result = instruction->result_symbol;
             
             fprintf(generator->output,
                 "    call   %s                      ; Calling the function\n"
@@ -549,8 +549,8 @@ void code_generate_instruction(Code_Generator* generator, Instruction* instructi
             // we have something to dereference like this, is the argv in
             // the main program. Later this should of course be changed.
 
-            Symbol* variable = scope_lookup(generator->local, instruction->arg1);
-            Symbol* result = scope_lookup(generator->local, instruction->result);
+            Symbol* variable = instruction->arg1_symbol;
+            Symbol* result = instruction->result_symbol;
 
             fprintf(generator->output,
                 "    mov    rax, [rbp-%d]           ; \n"
@@ -605,7 +605,7 @@ void code_generate(Code_Generator* generator)
             generator->asm_file);
     
     // Generate the global variables from the symbol table
-    for (int i = 0; i < generator->global->symbols->capacity; i++)
+    for (int i = 0; i < generator->global->symbols->count; i++)
     {
         Symbol* symbol = generator->global->symbols->entries[i].value;
 
@@ -621,7 +621,7 @@ void code_generate(Code_Generator* generator)
     
     // Generate the instructions
     for (int i = 0; i < generator->instructions->length; i++)
-        code_generate_instruction(generator, generator->instructions->items[i]);
+        code_generate_instruction(generator, &generator->instructions->items[i]);
     
     // TODO(timo):
     // Should the main function has its own beginning and end operations?
@@ -631,7 +631,7 @@ void code_generate(Code_Generator* generator)
     // The end is generated based on the return type of the program. Since it
     // is possible to return booleans as well, the booleans will be represented
     // in their canonical form in the return message and not just by 0 and 1.
-    Symbol* main = scope_lookup(generator->global, "main");
+    Symbol* main = scope_lookup(generator->global, str_intern("main"));
 
     if (type_is_integer(main->type->function.return_type))
     {
@@ -8,14 +8,22 @@
 #include <stdlib.h>     // for malloc
 #include <stdio.h>      // for FILE, size_t, NULL
 #include <string.h>     // for strcmp, memcpy
+#include <fcntl.h>      // for open
+#include <unistd.h>     // for close, sysconf
+#include <sys/mman.h>   // for mmap, munmap
+#include <sys/stat.h>   // for fstat
 
 
-const char* read_file(const char* path)
+// Size of the first chunk when reading files in chunks
+#define READ_CHUNK_SIZE (64 * 1024)
+
+
+const char* read_file(const char* path, size_t* size)
 {
     // Try to open the file and read it's contents. If no file could not be
     // opened, the `file` will be NULL, error will be printed and the program 
     // will be exited.
-    FILE* file = fopen(path, "r");
+    FILE* file = str_equals(path, "-") ? stdin : fopen(path, "r");
 
     if (file == NULL)
     {
@@ -23,28 +31,26 @@ const char* read_file(const char* path)
         exit(1);
     }
 
-    // Find the end of the file and save the size of the file based on that.
-    fseek(file, 0L, SEEK_END);
-    size_t file_size = ftell(file);
+    // NOTE(timo): The size of the file is not asked beforehand, since it can't
+    // be known for pipes. Instead the file is read in chunks and the buffer is
+    // grown when it gets full.
+    size_t capacity = READ_CHUNK_SIZE;
+    size_t file_size = 0;
+    char* buffer = xmalloc(capacity * sizeof (char) + 1);
 
-    // Rewind the file back to beginning and allocate memory for the buffer
-    // to save the contents of the file. If the allocation fails, error will
-    // be printed and the program will be exited.
-    rewind(file);
-    char* buffer = malloc(file_size * sizeof (char) + 1);
-    
-    if (buffer == NULL)
+    while (true)
     {
-        printf("Malloc failed. Not enough memory to read file '%s'\n", path);
-        exit(1);
-    }
+        size_t bytes_read = fread(buffer + file_size, sizeof (char), capacity - file_size, file);
+        file_size += bytes_read;
 
-    // Try to read the contents of the file and save them to the allocated
-    // buffer. If the reading fails, error will be printed and the program
-    // will be exited.
-    size_t bytes_read = fread(buffer, sizeof (char), file_size, file);
+        if (file_size < capacity)
+            break;
 
-    if (bytes_read < file_size)
+        capacity *= 2;
+        buffer = xrealloc(buffer, capacity * sizeof (char) + 1);
+    }
+
+    if (ferror(file))
     {
         printf("Could not read file '%s'\n", path);
         exit(1);
@@ -52,13 +58,77 @@ const char* read_file(const char* path)
 
     // Set the last character to 0 and close the file handle before returning
     // the buffer.
-    buffer[bytes_read] = 0;
-    fclose(file);
+    buffer[file_size] = 0;
+
+    if (size != NULL)
+        *size = file_size;
+
+    if (file != stdin)
+        fclose(file);
     
     return buffer;
 }
 
 
+Source_File load_file(const char* path)
+{
+    Source_File source = { 0 };
+    int descriptor = str_equals(path, "-") ? -1 : open(path, O_RDONLY);
+    struct stat info;
+
+    if (descriptor >= 0 && fstat(descriptor, &info) == 0 && S_ISREG(info.st_mode))
+    {
+        size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+        size_t size = (size_t)info.st_size;
+
+        // NOTE(timo): The rest of the last page after the end of the file is
+        // filled with zeros, so the mapped contents are terminated with 0 for
+        // free. If the file fills the last page completely, there is no room
+        // for the 0 and the file is read normally. Empty files can't be mapped.
+        if (size > 0 && size % page_size != 0)
+        {
+            void* contents = mmap(NULL, size + 1, PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+            if (contents != MAP_FAILED)
+            {
+                close(descriptor);
+
+                source.contents = contents;
+                source.size = size;
+                source.mapped = true;
+
+                return source;
+            }
+        }
+    }
+
+    if (descriptor >= 0)
+        close(descriptor);
+
+    // NOTE(timo): The size is the number of bytes read instead of the length
+    // of the string, so contents with 0 bytes in them are not cut short.
+    source.contents = read_file(path, &source.size);
+    source.mapped = false;
+
+    return source;
+}
+
+
+void unload_file(Source_File* file)
+{
+    if (file->contents == NULL)
+        return;
+
+    if (file->mapped)
+        munmap((void*)file->contents, file->size + 1);
+    else
+        free((char*)file->contents);
+
+    file->contents = NULL;
+    file->size = 0;
+}
+
+
 const char* shift(int* argc, char*** argv)
 {
     const char* arg = **argv;
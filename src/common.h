@@ -9,18 +9,66 @@
 #define t_common_h
 
 #include <stdbool.h>        // for bool type
+#include <stddef.h>         // for size_t
+
+
+// Contents of a source file loaded into the memory.
+//
+// Members
+//      contents: Pointer to the start of the contents. The contents are always
+//                terminated with 0, so they can be used as a normal string.
+//      size: Size of the contents in bytes without the terminating 0.
+//      mapped: If the contents are memory mapped straight from the file
+//              instead of being read into an allocated buffer.
+typedef struct Source_File
+{
+    const char* contents;
+    size_t size;
+    bool mapped;
+} Source_File;
 
 
 // Reads file from given path and returns the contents of the file.
 //
+// The file is read in chunks, so it works also with streams which size is not
+// known beforehand, like pipes and the standard input. Path "-" reads the
+// standard input.
+//
 // If error is detected anywhere in the process of reading the file, error will
 // be printed and the program will exit right away.
 //
 // Arguments
 //      path: Path pointing to the file wanted to be read.
+//      size: Receives the number of bytes read without the terminating 0.
+//            Can be NULL if the size is not needed.
 // Returns
 //      Pointer to the start of the buffer containing the contents of the file.
-const char* read_file(const char* path);
+const char* read_file(const char* path, size_t* size);
+
+
+// Loads the file from given path into the memory.
+//
+// Regular files are memory mapped, so their contents are not copied at all
+// and the pages are read in lazily by the operating system. Everything else
+// (pipes, character devices, files which size is exact multiple of the page
+// size and therefore have no room for the terminating 0) falls back to
+// reading the file with read_file.
+//
+// If error is detected anywhere in the process of loading the file, error
+// will be printed and the program will exit right away.
+//
+// Arguments
+//      path: Path pointing to the file wanted to be loaded.
+// Returns
+//      The loaded source file.
+Source_File load_file(const char* path);
+
+
+// Releases the memory of the loaded source file.
+//
+// Arguments
+//      file: Source file loaded with load_file.
+void unload_file(Source_File* file);
 
 
 // Shifts the pointer of the argument vector to the right by one and decreases
@@ -31,14 +31,74 @@ Diagnostic* diagnostic(const Diagnostic_Kind kind, const Position position, cons
 }
 
 
-void print_diagnostic(const Diagnostic* diagnostic)
+void line_table_init(Line_Table* table, const char* source)
 {
-    printf(":%d:%d%s\n", diagnostic->position.line_start, diagnostic->position.column_start, diagnostic->message);
+    *table = (Line_Table){ .starts = xmalloc(sizeof (int) * 64),
+                           .length = 1,
+                           .capacity = 64 };
+
+    // NOTE(timo): The first line always starts from the beginning of the
+    // source even if the source is empty
+    table->starts[0] = 0;
+
+    for (const char* newline = strchr(source, '\n'); newline != NULL; newline = strchr(newline + 1, '\n'))
+    {
+        if (table->length == table->capacity)
+        {
+            table->capacity *= 2;
+            table->starts = xrealloc(table->starts, sizeof (int) * table->capacity);
+        }
+
+        table->starts[table->length++] = newline - source + 1;
+    }
+}
+
+
+void line_table_free(Line_Table* table)
+{
+    free(table->starts);
+    *table = (Line_Table){ 0 };
+}
+
+
+Location line_table_location(const Line_Table* table, const int offset)
+{
+    // Binary search for the last line which starts before or at the offset
+    int low = 0;
+    int high = table->length - 1;
+
+    while (low < high)
+    {
+        int middle = low + (high - low + 1) / 2;
+
+        if (table->starts[middle] <= offset)
+            low = middle;
+        else
+            high = middle - 1;
+    }
+
+    return (Location){ .line = low + 1, .column = offset - table->starts[low] + 1 };
 }
 
 
-void print_diagnostics(const array* diagnostics)
+void print_diagnostic(const Diagnostic* diagnostic, const Line_Table* lines)
 {
+    Location location = line_table_location(lines, diagnostic->position.start);
+
+    printf(":%d:%d%s\n", location.line, location.column, diagnostic->message);
+}
+
+
+void print_diagnostics(const array* diagnostics, const char* source)
+{
+    if (diagnostics->length == 0)
+        return;
+
+    Line_Table lines;
+    line_table_init(&lines, source);
+
     for (int i = 0; i < diagnostics->length; i++)
-        print_diagnostic(diagnostics->items[i]);
+        print_diagnostic(diagnostics->items[i], &lines);
+
+    line_table_free(&lines);
 }
@@ -0,0 +1,633 @@
+// Implementation of the incremental checking of a document being edited.
+//
+// The source of the document is split into units, one for each top level
+// declaration. After an edit, the units touched by the edit are lexed and
+// parsed again as a single region of the source. The region is grown with
+// the next unit until the tokens after the region continue from the same
+// place as before and the region ends with a declaration parsed without
+// errors. That way the result is the same as if the whole source was parsed
+// again, but the work done depends only on the size of the edited region.
+//
+// The resolving is done in the order of the units, since the declarations
+// see only the identifiers declared before them. Only the new declarations
+// and the declarations which looked up any of the identifiers declared or
+// undeclared since the last resolving are resolved again. The global scope
+// is kept between the checks and the symbols of the rest of the units stay
+// in it as they were. The units before the edit are not looked at all.
+//
+// Author: Timo Mehto
+// Date: 2021/05/12
+
+#include "t.h"
+
+
+#define DOCUMENT_INITIAL_CAPACITY 4096
+
+
+// Frees the diagnostics in the array. The array itself is kept and it can
+// be reused.
+//
+// Arguments
+//      diagnostics: Array of diagnostics to be freed.
+static void clear_diagnostics(array* diagnostics)
+{
+    for (int i = 0; i < diagnostics->length; i++)
+    {
+        Diagnostic* diagnostic = diagnostics->items[i];
+
+        free((char*)diagnostic->message);
+        diagnostic->message = NULL;
+
+        free(diagnostic);
+        diagnostic = NULL;
+    }
+
+    diagnostics->length = 0;
+}
+
+
+// Removes the symbol from the global scope. The symbol is freed only after
+// the next resolving, since the declarations depending on it still refer to
+// its type until they are resolved again.
+//
+// Arguments
+//      document: Document of the symbol.
+//      symbol: Symbol to be released.
+static void release_symbol(Document* document, Symbol* symbol)
+{
+    Scope* global = document->resolver.global;
+
+    // NOTE(timo): The table has no removal, so the entry is left without
+    // the symbol, which is the same as not declared for the scope
+    if (scope_get(global, symbol->identifier) == symbol)
+        hashtable_put(global->symbols, symbol->identifier, NULL);
+
+    hashtable_put(document->changed, symbol->identifier, (void*)symbol->identifier);
+    array_push(document->released, symbol);
+}
+
+
+// Counts the unit to the number of units with syntax errors.
+//
+// Arguments
+//      document: Document of the unit.
+//      unit: Unit to be counted.
+//      count: 1 when the unit is added and -1 when it is removed.
+static void count_errors(Document* document, const Document_Unit* unit, int count)
+{
+    if (unit->lexer_diagnostics->length > 0) document->lexer_errors += count;
+    if (unit->parser_diagnostics->length > 0) document->parser_errors += count;
+}
+
+
+// Initializes new unit for a declaration parsed into the tree.
+//
+// Arguments
+//      tree: Arena of the declaration.
+//      declaration: Parsed declaration or NULL.
+//      start: Offset of the start of the unit.
+// Returns
+//      The new unit.
+static Document_Unit unit_init(Document_Tree* tree, AST_Declaration* declaration, int start)
+{
+    tree->references++;
+
+    return (Document_Unit){ .start = start,
+                            .end = start,
+                            .shift = 0,
+                            .tree = tree,
+                            .declaration = declaration,
+                            .symbol = NULL,
+                            .dirty = true,
+                            .lexer_diagnostics = array_init(sizeof (Diagnostic*)),
+                            .parser_diagnostics = array_init(sizeof (Diagnostic*)),
+                            .resolver_diagnostics = array_init(sizeof (Diagnostic*)),
+                            .dependencies = array_init(sizeof (char*)),
+                            .reported = 0 };
+}
+
+
+// Frees the memory allocated for a unit. The symbol of the unit is released.
+//
+// Arguments
+//      document: Document of the unit.
+//      unit: Unit to be freed.
+static void unit_free(Document* document, Document_Unit* unit)
+{
+    if (unit->symbol)
+    {
+        release_symbol(document, unit->symbol);
+        unit->symbol = NULL;
+    }
+
+    clear_diagnostics(unit->lexer_diagnostics);
+    clear_diagnostics(unit->parser_diagnostics);
+    clear_diagnostics(unit->resolver_diagnostics);
+
+    // NOTE(timo): These functions will set the arrays to NULL after freeing
+    array_free(unit->lexer_diagnostics);
+    array_free(unit->parser_diagnostics);
+    array_free(unit->resolver_diagnostics);
+    array_free(unit->dependencies);
+
+    if (--unit->tree->references == 0)
+    {
+        arena_free(&unit->tree->arena);
+        free(unit->tree);
+    }
+
+    unit->tree = NULL;
+    unit->declaration = NULL;
+}
+
+
+// Finds the unit containing the offset.
+//
+// Arguments
+//      units: Array of units in the order of the source.
+//      offset: Offset in the source.
+// Returns
+//      Pointer to the last unit starting at or before the offset.
+static Document_Unit* unit_at(Document_Unit_Array* units, int offset)
+{
+    int low = 0;
+    int high = units->length - 1;
+
+    while (low < high)
+    {
+        int middle = (low + high + 1) / 2;
+
+        if (units->items[middle].start <= offset)
+            low = middle;
+        else
+            high = middle - 1;
+    }
+
+    return &units->items[low];
+}
+
+
+// Checks that the tokens after the region are the same as before when the
+// region is lexed again. If a token or a comment of the region continues
+// past the end of the region, the region needs to be grown.
+//
+// Arguments
+//      document: Document being checked.
+//      start: Offset of the start of the region.
+//      end: Offset of the end of the region, which is the start of the first
+//           token after the region.
+// Returns
+//      Value true if the region ends before the same token as before.
+static bool region_in_sync(const Document* document, int start, int end)
+{
+    if (end >= document->length)
+        return true;
+
+    Lexer lexer;
+    Token token;
+
+    lexer_init_range(&lexer, document->source, document->source + start, document->source + document->length);
+
+    do
+        token = next_token(&lexer);
+    while (token.kind != TOKEN_EOF && token.position.end < end);
+
+    lexer_free(&lexer);
+
+    return token.position.start == end;
+}
+
+
+// Lexes and parses the region into new units. The units are split at the
+// first tokens of the declarations.
+//
+// Arguments
+//      document: Document being checked.
+//      start: Offset of the start of the region.
+//      end: Offset of the end of the region.
+//      parsed: Array where the new units are pushed to.
+static void parse_region(Document* document, int start, int end, Document_Unit_Array* parsed)
+{
+    Lexer lexer;
+    Parser parser;
+
+    lexer_init_range(&lexer, document->source, document->source + start, document->source + end);
+    parser_init_streaming(&parser, &lexer);
+
+    Document_Tree* tree = xmalloc(sizeof (Document_Tree));
+    *tree = (Document_Tree){ .references = 0 };
+
+    while (parser.current_token->kind != TOKEN_EOF)
+    {
+        int unit_start = parsed->length == 0 ? start : parser.current_token->position.start;
+        int diagnostics = parser.diagnostics->length;
+
+        AST_Declaration* declaration = parse_top_level_declaration(&parser);
+        Document_Unit* unit = document_unit_array_push(parsed, unit_init(tree, declaration, unit_start));
+
+        // NOTE(timo): The errors of the declaration can be found only at the
+        // first token of the next declaration, so the diagnostics are given
+        // to the units in the order they were found instead of their positions
+        for (int i = diagnostics; i < parser.diagnostics->length; i++)
+            array_push(unit->parser_diagnostics, parser.diagnostics->items[i]);
+    }
+
+    // NOTE(timo): The arena of the parser is moved to the tree, since the
+    // declarations outlive the parser
+    tree->arena = parser.arena;
+    arena_init(&parser.arena, 0);
+
+    // NOTE(timo): Region with only whitespace and comments still needs a
+    // unit to cover it
+    if (parsed->length == 0 && end > start)
+        document_unit_array_push(parsed, unit_init(tree, NULL, start));
+
+    for (int i = 0; i < parsed->length; i++)
+        parsed->items[i].end = i + 1 < parsed->length ? parsed->items[i + 1].start : end;
+
+    for (int i = 0; i < lexer.diagnostics->length; i++)
+    {
+        Diagnostic* diagnostic = lexer.diagnostics->items[i];
+        array_push(unit_at(parsed, diagnostic->position.start)->lexer_diagnostics, diagnostic);
+    }
+
+    if (tree->references == 0)
+    {
+        arena_free(&tree->arena);
+        free(tree);
+    }
+
+    // NOTE(timo): The diagnostics were moved to the units
+    lexer.diagnostics->length = 0;
+    parser.diagnostics->length = 0;
+
+    parser_free(&parser);
+    lexer_free(&lexer);
+}
+
+
+// Lexes and parses the units from first to last (exclusive) again. The new
+// units replace the old ones.
+//
+// Arguments
+//      document: Document being checked.
+//      first: Index of the first unit to be parsed again.
+//      last: Index of the unit after the last unit to be parsed again.
+static void parse_units(Document* document, int first, int last)
+{
+    Document_Unit_Array* units = &document->units;
+    Document_Unit_Array parsed;
+
+    // NOTE(timo): The units cover the whole source, so the region starts
+    // where the unit before it ends
+    const int start = first > 0 ? units->items[first - 1].end : 0;
+
+    document_unit_array_init(&parsed, 0);
+
+    while (true)
+    {
+        const int end = last < units->length ? units->items[last].start : document->length;
+
+        if (!region_in_sync(document, start, end))
+        {
+            last++;
+            continue;
+        }
+
+        parse_region(document, start, end, &parsed);
+
+        // NOTE(timo): If the last declaration had errors, the parser might
+        // have continued to the next declaration if the whole source was
+        // parsed, so the next unit is parsed together with it.
+        if (last < units->length &&
+            parsed.length > 0 && parsed.items[parsed.length - 1].parser_diagnostics->length > 0)
+        {
+            for (int i = 0; i < parsed.length; i++)
+                unit_free(document, &parsed.items[i]);
+
+            parsed.length = 0;
+            last++;
+            continue;
+        }
+
+        break;
+    }
+
+    for (int i = first; i < last; i++)
+    {
+        count_errors(document, &units->items[i], -1);
+        unit_free(document, &units->items[i]);
+    }
+
+    for (int i = 0; i < parsed.length; i++)
+        count_errors(document, &parsed.items[i], 1);
+
+    // Replace the old units with the new ones
+    const int tail = units->length - last;
+    const int length = first + parsed.length + tail;
+
+    if (length > units->capacity)
+        document_unit_array_reserve(units, length > units->capacity * 2 ? length : units->capacity * 2);
+
+    memmove(&units->items[first + parsed.length], &units->items[last], tail * sizeof (Document_Unit));
+    memcpy(&units->items[first], parsed.items, parsed.length * sizeof (Document_Unit));
+    units->length = length;
+
+    // NOTE(timo): The symbols are indexed with their units, so the symbols
+    // of the units after the new ones are indexed again if the units moved
+    if (parsed.length != last - first)
+    {
+        for (int i = first + parsed.length; i < length; i++)
+        {
+            if (units->items[i].symbol)
+                units->items[i].symbol->index = i;
+        }
+    }
+
+    document_unit_array_free(&parsed);
+}
+
+
+// Resolves the units from the first one which are dirty or depend on the
+// changed identifiers.
+//
+// Arguments
+//      document: Document being checked.
+//      first: Index of the first unit which might need resolving.
+static void resolve_units(Document* document, int first)
+{
+    Document_Unit_Array* units = &document->units;
+    Resolver* resolver = &document->resolver;
+    Scope* global = resolver->global;
+    array* diagnostics = resolver->diagnostics;
+
+    for (int i = first; i < units->length; i++)
+    {
+        Document_Unit* unit = &units->items[i];
+        AST_Declaration* declaration = unit->declaration;
+
+        if (declaration == NULL)
+            continue;
+
+        const char* identifier = declaration->identifier->lexeme;
+        bool stale = unit->dirty || hashtable_contains(document->changed, identifier);
+
+        for (int j = 0; j < unit->dependencies->length && !stale; j++)
+            stale = hashtable_contains(document->changed, unit->dependencies->items[j]);
+
+        if (!stale)
+            continue;
+
+        if (unit->symbol)
+        {
+            release_symbol(document, unit->symbol);
+            unit->symbol = NULL;
+        }
+
+        // NOTE(timo): The symbol of the same identifier declared by a unit
+        // after this one is replaced by the symbol of this one, and the
+        // unit declaring it is resolved again as a redeclaration
+        Symbol* previous = scope_get(global, identifier);
+
+        if (previous && previous->index > i)
+        {
+            Document_Unit* redeclaration = &units->items[previous->index];
+
+            release_symbol(document, previous);
+            redeclaration->symbol = NULL;
+            redeclaration->dirty = true;
+            previous = NULL;
+        }
+
+        clear_diagnostics(unit->resolver_diagnostics);
+        unit->dependencies->length = 0;
+
+        // NOTE(timo): The symbols of the units after this one are still in
+        // the global scope, so they are hidden like in the parallel resolving
+        resolver->diagnostics = unit->resolver_diagnostics;
+        resolver->dependencies = unit->dependencies;
+        resolver->visible = i;
+        resolve_declaration(resolver, declaration);
+
+        // NOTE(timo): Redeclarations don't declare anything
+        Symbol* symbol = scope_get(global, identifier);
+        unit->symbol = symbol != previous ? symbol : NULL;
+        unit->dirty = false;
+
+        if (unit->symbol)
+            unit->symbol->index = i;
+
+        // NOTE(timo): The symbol is new, so the declarations depending on it
+        // have to be resolved again too
+        hashtable_put(document->changed, identifier, (void*)identifier);
+    }
+
+    resolver->diagnostics = diagnostics;
+    resolver->dependencies = NULL;
+    resolver->visible = -1;
+
+    for (int i = 0; i < document->released->length; i++)
+        symbol_free(document->released->items[i]);
+
+    document->released->length = 0;
+
+    hashtable_free(document->changed);
+    document->changed = hashtable_init_interned(0);
+}
+
+
+// Reports the diagnostics of the unit with the positions of the current source.
+//
+// Arguments
+//      document: Document being checked.
+//      unit: Unit of the diagnostics.
+//      diagnostics: Diagnostics to be reported.
+static void report_diagnostics(Document* document, const Document_Unit* unit, const array* diagnostics)
+{
+    for (int i = 0; i < diagnostics->length; i++)
+    {
+        Diagnostic* reported = xmalloc(sizeof (Diagnostic));
+        *reported = *(Diagnostic*)diagnostics->items[i];
+
+        // NOTE(timo): Some of the nodes don't have their positions set, so
+        // only the offsets which are set are moved. The unit at the start of
+        // the source is never moved, so no actual offset can be 0 here.
+        if (reported->position.start != 0) reported->position.start += unit->shift;
+        if (reported->position.end != 0) reported->position.end += unit->shift;
+
+        array_push(document->diagnostics, reported);
+    }
+}
+
+
+// Checks the units from first to last (exclusive) again and reports the
+// diagnostics of the document. The diagnostics of the units before the
+// checked ones are kept unless the kind of the reported diagnostics changes.
+//
+// Arguments
+//      document: Document being checked.
+//      first: Index of the first unit to be checked again.
+//      last: Index of the unit after the last unit to be checked again.
+static void check(Document* document, int first, int last)
+{
+    Document_Unit_Array* units = &document->units;
+    const bool lexer_errors = document->lexer_errors > 0;
+    const bool parser_errors = document->parser_errors > 0;
+
+    parse_units(document, first, last);
+
+    if (first < document->unresolved)
+        document->unresolved = first;
+
+    // NOTE(timo): The diagnostics are reported in the same order as in the
+    // compiler, the lexer first, then the parser and then the resolver. If
+    // the kind of the reported diagnostics changes, all of them are reported
+    // again.
+    int from = first;
+
+    if ((document->lexer_errors > 0) != lexer_errors ||
+        (document->lexer_errors == 0 && (document->parser_errors > 0) != parser_errors))
+        from = 0;
+
+    if (document->lexer_errors == 0 && document->parser_errors == 0)
+    {
+        if (document->unresolved < from)
+            from = document->unresolved;
+
+        resolve_units(document, document->unresolved);
+        document->unresolved = units->length;
+    }
+
+    // NOTE(timo): The reported diagnostics share the messages with the
+    // diagnostics of the units, so only the copies are freed
+    const int reported = from > 0 ? units->items[from - 1].reported : 0;
+
+    for (int i = reported; i < document->diagnostics->length; i++)
+        free(document->diagnostics->items[i]);
+
+    document->diagnostics->length = reported;
+
+    for (int i = from; i < units->length; i++)
+    {
+        Document_Unit* unit = &units->items[i];
+
+        // NOTE(timo): Only the diagnostics of the first declaration with
+        // errors from the parser are reported
+        if (document->lexer_errors > 0)
+            report_diagnostics(document, unit, unit->lexer_diagnostics);
+        else if (document->parser_errors > 0 && document->diagnostics->length == 0)
+            report_diagnostics(document, unit, unit->parser_diagnostics);
+        else if (document->parser_errors == 0)
+            report_diagnostics(document, unit, unit->resolver_diagnostics);
+
+        unit->reported = document->diagnostics->length;
+    }
+}
+
+
+void document_init(Document* document, const char* source)
+{
+    const int length = strlen(source);
+    int capacity = DOCUMENT_INITIAL_CAPACITY;
+
+    while (capacity <= length)
+        capacity *= 2;
+
+    document->source = xmalloc(capacity);
+    document->length = length;
+    document->capacity = capacity;
+    memcpy(document->source, source, length + 1);
+
+    document_unit_array_init(&document->units, 0);
+    document->type_table = type_table_init();
+    resolver_init(&document->resolver, document->type_table);
+    document->changed = hashtable_init_interned(0);
+    document->released = array_init(sizeof (Symbol*));
+    document->diagnostics = array_init(sizeof (Diagnostic*));
+    document->lexer_errors = 0;
+    document->parser_errors = 0;
+    document->unresolved = 0;
+
+    check(document, 0, 0);
+}
+
+
+void document_free(Document* document)
+{
+    // NOTE(timo): The symbols in the global scope might have been released
+    // already, so they are freed through the units and the released symbols
+    // instead of the global scope
+    hashtable_free(document->resolver.global->symbols);
+    document->resolver.global->symbols = hashtable_init_interned(0);
+
+    for (int i = 0; i < document->units.length; i++)
+        unit_free(document, &document->units.items[i]);
+
+    for (int i = 0; i < document->released->length; i++)
+        symbol_free(document->released->items[i]);
+
+    for (int i = 0; i < document->diagnostics->length; i++)
+        free(document->diagnostics->items[i]);
+
+    array_free(document->diagnostics);
+    array_free(document->released);
+    hashtable_free(document->changed);
+    resolver_free(&document->resolver);
+    type_table_free(document->type_table);
+    document_unit_array_free(&document->units);
+
+    free(document->source);
+    document->source = NULL;
+}
+
+
+void document_edit(Document* document, int start, int end, const char* text)
+{
+    assert(0 <= start && start <= end && end <= document->length);
+
+    const int length = strlen(text);
+    const int delta = length - (end - start);
+
+    // Replace the range of the source with the text
+    if (document->length + delta >= document->capacity)
+    {
+        while (document->length + delta >= document->capacity)
+            document->capacity *= 2;
+
+        document->source = xrealloc(document->source, document->capacity);
+    }
+
+    memmove(document->source + start + length, document->source + end, document->length - end + 1);
+    memcpy(document->source + start, text, length);
+    document->length += delta;
+
+    // Find the units touched by the edit. The units right next to the edit
+    // are included too, since the edit can join their tokens together.
+    Document_Unit* units = document->units.items;
+    const int count = document->units.length;
+    int first = 0;
+    int last;
+
+    while (first < count && units[first].end < start)
+        first++;
+
+    for (last = first; last < count && units[last].start <= end; last++)
+        ;
+
+    // NOTE(timo): The error recovery of the parser can skip the first token
+    // of the next declaration, so the unit before the edit is parsed again
+    // if it had errors
+    if (first > 0 && units[first - 1].parser_diagnostics->length > 0)
+        first--;
+
+    // NOTE(timo): Only the offsets of the units after the edit are moved.
+    // The positions inside the units are moved when they are reported.
+    for (int i = last; i < count; i++)
+    {
+        units[i].start += delta;
+        units[i].end += delta;
+        units[i].shift += delta;
+    }
+
+    check(document, first, last);
+}
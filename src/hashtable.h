@@ -1,13 +1,21 @@
 // Implementation for simple hashtable with key-value pairs. All keys are
 // strings and values can be arbitrary pointers.
 //
+// The table is split into two parts. The entries (key-value pairs) are saved
+// densely in the insertion order, so iterating the table only touches the
+// saved entries. The slots are the actual open addressing table with power of
+// two capacity, where each slot saves the hash and the length of the key and
+// the index of the entry. Collisions are resolved with Robin Hood hashing,
+// which keeps the probe sequences short and lets the lookups stop early.
+//
 // Author: Timo Mehto
 // Date: 2021/05/12
 
-#ifndef T_HASHTABLE_H 
-#define T_HASHTABLE_H 
+#ifndef T_HASHTABLE_H
+#define T_HASHTABLE_H
 
 #include "memory.h"     // for x-allocators
+#include "intern.h"     // for interned keys
 #include <string.h>     // for memory comparisons and strlen
 #include <stdlib.h>     // for memory allocation
 #include <assert.h>     // for assertions
@@ -16,7 +24,7 @@
 
 #define LOAD_FACTOR 0.75
 #define GROWTH_FACTOR 2
-#define INITIAL_CAPACITY 128
+#define INITIAL_CAPACITY 16
 
 
 // Structure for hashtable entry which is represents key-value pairs saved
@@ -31,21 +39,46 @@ typedef struct hashtable_entry {
 } hashtable_entry;
 
 
-// Hash table/map to save key-value pairs. 
+// Slot of the open addressing table.
+//
+// Fields
+//      hash: Saved hash of the key so it doesn't have to be computed again.
+//      length: Saved length of the key.
+//      index: Index of the entry + 1. Value 0 means the slot is empty.
+typedef struct hashtable_slot {
+    uint32_t hash;
+    uint32_t length;
+    int32_t index;
+} hashtable_slot;
+
+
+// Hash table/map to save key-value pairs.
+//
+// Keys are strings but the values can be any type of pointer. The saved
+// entries can be iterated in the insertion order with
 //
-// Keys are strings but the values can be any type of pointer.
+//      for (int i = 0; i < table->count; i++)
+//          hashtable_entry* entry = &table->entries[i];
 //
 // Fields
-//      capacity: Maximum capacity of the hash table.
-//      count: Current number of the symbols in the hash table.
+//      capacity: Number of slots in the hash table. Always a power of two.
+//      mask: Mask used to wrap the slot indices, capacity - 1.
+//      count: Current number of the entries in the hash table.
 //      threshold: Count after which the table will be resized.
-//      entries: Pointer to the start of the symbol table entries.
+//      interned: If the keys are interned strings. Interned keys are not
+//                copied, their hashes are not computed again and they are
+//                compared with each other by their pointers.
+//      slots: Pointer to the start of the slots.
+//      entries: Pointer to the start of the dense array of entries.
 typedef struct hashtable
 {
     int capacity;
+    int mask;
     int count;
     int threshold;
-    
+    bool interned;
+
+    hashtable_slot* slots;
     hashtable_entry* entries;
 } hashtable;
 
@@ -53,7 +86,8 @@ typedef struct hashtable
 // Initializes new hashtable with initial capacity.
 //
 // If the passed initial capacity is less than INITIAL_CAPACITY, the initial
-// capacity will be INITIAL_CAPACITY.
+// capacity will be INITIAL_CAPACITY. Otherwise it will be rounded up to the
+// next power of two.
 //
 // Arguments
 //      capacity: The initial capacity.
@@ -62,6 +96,16 @@ typedef struct hashtable
 hashtable* hashtable_init(int capacity);
 
 
+// Initializes new hashtable which keys are interned strings. All the keys
+// passed to the table have to be interned with str_intern.
+//
+// Arguments
+//      capacity: The initial capacity.
+// Returns
+//      Pointer to the new hash table
+hashtable* hashtable_init_interned(int capacity);
+
+
 // Frees all the memory allocated for a hash table.
 //
 // Arguments
@@ -99,19 +143,38 @@ const bool hashtable_contains(const hashtable* table, const char* key);
 #ifdef T_HASHTABLE_IMPLEMENTATION
 
 
+static void hashtable_allocate(hashtable* table, int capacity)
+{
+    table->capacity = capacity;
+    table->mask = capacity - 1;
+    table->threshold = capacity * LOAD_FACTOR;
+    table->slots = xcalloc(capacity, sizeof (hashtable_slot));
+    table->entries = xrealloc(table->entries, table->threshold * sizeof (hashtable_entry));
+}
+
+
 hashtable* hashtable_init(int capacity)
 {
     hashtable* table = xmalloc(sizeof (hashtable));
+    int power_of_two = INITIAL_CAPACITY;
+
+    while (power_of_two < capacity)
+        power_of_two *= 2;
 
-    if (capacity < INITIAL_CAPACITY)
-        capacity = INITIAL_CAPACITY;
-    
-    table->capacity = capacity;
-    table->threshold = capacity * LOAD_FACTOR;
     table->count = 0;
+    table->interned = false;
+    table->entries = NULL;
+
+    hashtable_allocate(table, power_of_two);
+
+    return table;
+}
 
-    table->entries = xmalloc(capacity * sizeof (hashtable_entry));
-    memset(table->entries, 0, capacity * sizeof (hashtable_entry));
+
+hashtable* hashtable_init_interned(int capacity)
+{
+    hashtable* table = hashtable_init(capacity);
+    table->interned = true;
 
     return table;
 }
@@ -119,17 +182,18 @@ hashtable* hashtable_init(int capacity)
 
 void hashtable_free(hashtable* table)
 {
-    for (int i = 0; i < table->capacity; i++)
+    if (!table->interned)
     {
-        hashtable_entry entry = table->entries[i];
-
-        if (entry.key) 
+        for (int i = 0; i < table->count; i++)
         {
-            free(entry.key);
-            entry.key = NULL;
+            free(table->entries[i].key);
+            table->entries[i].key = NULL;
         }
     }
 
+    free(table->slots);
+    table->slots = NULL;
+
     free(table->entries);
     table->entries = NULL;
 
@@ -138,115 +202,165 @@ void hashtable_free(hashtable* table)
 }
 
 
-// Fowler-Noll-Vo-1a hash function 
-// https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function                                        
-static uint32_t fnv1a_hash(const char* key)
+// Fowler-Noll-Vo-1a hash function
+// https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function
+static uint32_t fnv1a_hash(const char* key, uint32_t* length)
 {
     uint32_t hash = 0x811c9dc5;
+    int i = 0;
 
-    for (int i = 0; key[i] != 0; i++)
+    for (; key[i] != 0; i++)
     {
         hash ^= (uint8_t)key[i];
         hash *= 0x01000193;
     }
 
+    *length = i;
+
     return hash;
 }
 
 
-static void hashtable_resize(hashtable* table)
+// Computes the hash and the length of the key. Interned keys already have
+// them saved so they are just read from the interned string.
+static inline uint32_t hashtable_hash(const hashtable* table, const char* key, uint32_t* length)
 {
-    int old_capacity = table->capacity;
-    hashtable_entry* old_entries = table->entries;
-    
-    table->capacity *= GROWTH_FACTOR;
-    table->threshold = table->capacity * LOAD_FACTOR;
-    table->count = 0;
-    table->entries = xmalloc(table->capacity * sizeof (hashtable_entry));
-    memset(table->entries, 0, table->capacity * sizeof (hashtable_entry));
-    
-    for (int i = 0; i < old_capacity; i++)
+    if (table->interned)
     {
-        hashtable_entry* entry = &old_entries[i];
+        *length = interned_length(key);
+        return interned_hash(key);
+    }
+
+    return fnv1a_hash(key, length);
+}
+
 
-        if (entry->key)
+// Places the slot into the table with Robin Hood hashing. If the probed slot
+// is closer to its home slot than the slot being placed, the slots are swapped
+// and the placing continues with the swapped slot.
+static void hashtable_place(hashtable* table, hashtable_slot slot)
+{
+    uint32_t position = slot.hash & table->mask;
+    uint32_t distance = 0;
+
+    while (table->slots[position].index != 0)
+    {
+        hashtable_slot* current = &table->slots[position];
+        uint32_t current_distance = (position - (current->hash & table->mask)) & table->mask;
+
+        if (current_distance < distance)
         {
-            hashtable_put(table, entry->key, entry->value);
-            free(entry->key);
+            hashtable_slot temp = *current;
+            *current = slot;
+            slot = temp;
+            distance = current_distance;
         }
+
+        position = (position + 1) & table->mask;
+        distance++;
     }
 
-    free(old_entries);
+    table->slots[position] = slot;
 }
 
 
-void* hashtable_get(const hashtable* table, const char* key)            
+static void hashtable_resize(hashtable* table)
 {
-    size_t key_length = strlen(key);
-    uint32_t hash = fnv1a_hash(key);
+    hashtable_slot* old_slots = table->slots;
+    int old_capacity = table->capacity;
+
+    // NOTE(timo): The entries (and the keys) stay where they are, only the
+    // slots are placed again based on the saved hashes
+    hashtable_allocate(table, old_capacity * GROWTH_FACTOR);
 
-    for (int i = 0; i < table->capacity; i++)
+    for (int i = 0; i < old_capacity; i++)
     {
-        hashtable_entry* entry = &table->entries[(hash + i) % table->capacity];
-        
-        if (entry->key && memcmp(entry->key, key, key_length) == 0)
-            return entry->value;
-        if (entry->key == NULL) 
-            return NULL;
+        if (old_slots[i].index != 0)
+            hashtable_place(table, old_slots[i]);
     }
 
-    return NULL;
+    free(old_slots);
 }
 
 
-void hashtable_put(hashtable* table, const char* key, void* value)
+// Finds the entry for the key or returns NULL if the key is not found.
+static hashtable_entry* hashtable_find(const hashtable* table, const char* key, uint32_t hash, uint32_t length)
 {
-    if (table->count + 1 >= table->threshold) 
-        hashtable_resize(table);
-
-    size_t key_length = strlen(key);
-    uint32_t hash = fnv1a_hash(key);
+    uint32_t position = hash & table->mask;
+    uint32_t distance = 0;
 
-    for (int i = 0; i < table->capacity; i++)
+    while (true)
     {
-        hashtable_entry* entry = &table->entries[(hash + i) % table->capacity];
-    
-        if (entry->key && memcmp(entry->key, key, key_length) == 0)
-        {
-            entry->value = value;
-            return;
-        }
-        if (entry->key == NULL)
-        {
-            entry->key = xmalloc(key_length * sizeof (char) + 1);
-            memcpy(entry->key, key, key_length); 
-            entry->key[key_length] = 0;
-            entry->value = value;
+        hashtable_slot* slot = &table->slots[position];
 
-            table->count++;
+        // NOTE(timo): With Robin Hood hashing the key can't be further than
+        // any of the keys met during the probing, so we can stop early
+        if (slot->index == 0 || ((position - (slot->hash & table->mask)) & table->mask) < distance)
+            return NULL;
 
-            return;
+        if (slot->hash == hash && slot->length == length)
+        {
+            hashtable_entry* entry = &table->entries[slot->index - 1];
+
+            if (table->interned ? entry->key == key : memcmp(entry->key, key, length) == 0)
+                return entry;
         }
+
+        position = (position + 1) & table->mask;
+        distance++;
     }
 }
 
 
-const bool hashtable_contains(const hashtable* table, const char* key)
+void* hashtable_get(const hashtable* table, const char* key)
+{
+    uint32_t length;
+    uint32_t hash = hashtable_hash(table, key, &length);
+    hashtable_entry* entry = hashtable_find(table, key, hash, length);
+
+    return entry ? entry->value : NULL;
+}
+
+
+void hashtable_put(hashtable* table, const char* key, void* value)
 {
-    size_t key_length = strlen(key);
-    uint32_t hash = fnv1a_hash(key);
+    uint32_t length;
+    uint32_t hash = hashtable_hash(table, key, &length);
+    hashtable_entry* entry = hashtable_find(table, key, hash, length);
+
+    if (entry)
+    {
+        entry->value = value;
+        return;
+    }
 
-    for (int i = 0; i < table->capacity; i++)
+    if (table->count + 1 >= table->threshold)
+        hashtable_resize(table);
+
+    entry = &table->entries[table->count];
+    entry->value = value;
+
+    if (table->interned)
+        entry->key = (char*)key;
+    else
     {
-        hashtable_entry* entry = &table->entries[(hash + i) % table->capacity];
-        
-        if (entry->key == NULL) 
-            return false;
-        if (entry->key && memcmp(entry->key, key, key_length) == 0)
-            return true;
+        entry->key = xmalloc(length * sizeof (char) + 1);
+        memcpy(entry->key, key, length);
+        entry->key[length] = 0;
     }
 
-    return false;
+    table->count++;
+
+    hashtable_place(table, (hashtable_slot){ .hash = hash, .length = length, .index = table->count });
+}
+
+
+const bool hashtable_contains(const hashtable* table, const char* key)
+{
+    uint32_t length;
+    uint32_t hash = hashtable_hash(table, key, &length);
+
+    return hashtable_find(table, key, hash, length) != NULL;
 }
 
 
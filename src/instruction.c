@@ -1,5 +1,7 @@
-// Implementations for factorcy functions to create new instructions,
-// freeing the memory allocated for them and to print the instructions.
+// Implementations for factorcy functions to create new instructions and to
+// print the instructions. Instructions are returned by value and saved into
+// the contiguous instruction stream of the IR generator. The operands and
+// labels are interned strings.
 //
 // Author: Timo Mehto
 // Date: 2021/05/12
@@ -7,336 +9,324 @@
 #include "t.h"
 
 
-void instruction_free(Instruction* instruction)
+Instruction instruction_copy(char* arg, char* result)
 {
-    if (instruction->arg1)
-    {
-        free(instruction->arg1);
-        instruction->arg1 = NULL;
-    }
-    if (instruction->arg2)
-    {
-        free(instruction->arg2);
-        instruction->arg2 = NULL;
-    }
-    if (instruction->result)
-    {
-        free(instruction->result);
-        instruction->result = NULL;
-    }
-    if (instruction->label)
-    {
-        free((char*)instruction->label);
-        instruction->label = NULL;
-    }
+    Instruction instruction = { 0 };
+    instruction.operation = OP_COPY;
+    instruction.arg1 = (char*)str_intern(arg);
+    instruction.arg2 = NULL;
+    instruction.result = (char*)str_intern(result);
 
-    free(instruction);
-    instruction = NULL;
+    return instruction;
 }
 
 
-Instruction* instruction_copy(char* arg, char* result)
+Instruction instruction_copy_constant(Value value, char* result)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_COPY;
-    instruction->arg1 = str_copy(arg);
-    instruction->arg2 = NULL;
-    instruction->result = str_copy(result);
+    char arg[24];
+
+    if (value_is_integer(value))
+        snprintf(arg, sizeof (arg), "%lld", (long long)value.integer);
+    else
+        snprintf(arg, sizeof (arg), "%s", value.boolean ? "true" : "false");
+
+    Instruction instruction = instruction_copy(arg, result);
+    instruction.value = value;
 
     return instruction;
 }
 
 
-Instruction* instruction_add(char* arg1, char* arg2, char* result)
+Instruction instruction_add(char* arg1, char* arg2, char* result)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_ADD;
-    instruction->arg1 = str_copy(arg1);
-    instruction->arg2 = str_copy(arg2);
-    instruction->result = str_copy(result);
+    Instruction instruction = { 0 };
+    instruction.operation = OP_ADD;
+    instruction.arg1 = (char*)str_intern(arg1);
+    instruction.arg2 = (char*)str_intern(arg2);
+    instruction.result = (char*)str_intern(result);
 
     return instruction;
 }
 
 
-Instruction* instruction_sub(char* arg1, char* arg2, char* result)
+Instruction instruction_sub(char* arg1, char* arg2, char* result)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_SUB;
-    instruction->arg1 = str_copy(arg1);
-    instruction->arg2 = str_copy(arg2);
-    instruction->result = str_copy(result);
+    Instruction instruction = { 0 };
+    instruction.operation = OP_SUB;
+    instruction.arg1 = (char*)str_intern(arg1);
+    instruction.arg2 = (char*)str_intern(arg2);
+    instruction.result = (char*)str_intern(result);
 
     return instruction;
 }
 
 
-Instruction* instruction_mul(char* arg1, char* arg2, char* result)
+Instruction instruction_mul(char* arg1, char* arg2, char* result)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_MUL;
-    instruction->arg1 = str_copy(arg1);
-    instruction->arg2 = str_copy(arg2);
-    instruction->result = str_copy(result);
+    Instruction instruction = { 0 };
+    instruction.operation = OP_MUL;
+    instruction.arg1 = (char*)str_intern(arg1);
+    instruction.arg2 = (char*)str_intern(arg2);
+    instruction.result = (char*)str_intern(result);
 
     return instruction;
 }
 
 
-Instruction* instruction_div(char* arg1, char* arg2, char* result)
+Instruction instruction_div(char* arg1, char* arg2, char* result)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_DIV;
-    instruction->arg1 = str_copy(arg1);
-    instruction->arg2 = str_copy(arg2);
-    instruction->result = str_copy(result);
+    Instruction instruction = { 0 };
+    instruction.operation = OP_DIV;
+    instruction.arg1 = (char*)str_intern(arg1);
+    instruction.arg2 = (char*)str_intern(arg2);
+    instruction.result = (char*)str_intern(result);
 
     return instruction;
 }
 
 
-Instruction* instruction_eq(char* arg1, char* arg2, char* result)
+Instruction instruction_eq(char* arg1, char* arg2, char* result)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_EQ;
-    instruction->arg1 = str_copy(arg1);
-    instruction->arg2 = str_copy(arg2);
-    instruction->result = str_copy(result);
+    Instruction instruction = { 0 };
+    instruction.operation = OP_EQ;
+    instruction.arg1 = (char*)str_intern(arg1);
+    instruction.arg2 = (char*)str_intern(arg2);
+    instruction.result = (char*)str_intern(result);
 
     return instruction;
 }
 
 
-Instruction* instruction_neq(char* arg1, char* arg2, char* result)
+Instruction instruction_neq(char* arg1, char* arg2, char* result)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_NEQ;
-    instruction->arg1 = str_copy(arg1);
-    instruction->arg2 = str_copy(arg2);
-    instruction->result = str_copy(result);
+    Instruction instruction = { 0 };
+    instruction.operation = OP_NEQ;
+    instruction.arg1 = (char*)str_intern(arg1);
+    instruction.arg2 = (char*)str_intern(arg2);
+    instruction.result = (char*)str_intern(result);
 
     return instruction;
 }
 
 
-Instruction* instruction_lt(char* arg1, char* arg2, char* result)
+Instruction instruction_lt(char* arg1, char* arg2, char* result)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_LT;
-    instruction->arg1 = str_copy(arg1);
-    instruction->arg2 = str_copy(arg2);
-    instruction->result = str_copy(result);
+    Instruction instruction = { 0 };
+    instruction.operation = OP_LT;
+    instruction.arg1 = (char*)str_intern(arg1);
+    instruction.arg2 = (char*)str_intern(arg2);
+    instruction.result = (char*)str_intern(result);
 
     return instruction;
 }
 
 
-Instruction* instruction_lte(char* arg1, char* arg2, char* result)
+Instruction instruction_lte(char* arg1, char* arg2, char* result)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_LTE;
-    instruction->arg1 = str_copy(arg1);
-    instruction->arg2 = str_copy(arg2);
-    instruction->result = str_copy(result);
+    Instruction instruction = { 0 };
+    instruction.operation = OP_LTE;
+    instruction.arg1 = (char*)str_intern(arg1);
+    instruction.arg2 = (char*)str_intern(arg2);
+    instruction.result = (char*)str_intern(result);
 
     return instruction;
 }
 
 
-Instruction* instruction_gt(char* arg1, char* arg2, char* result)
+Instruction instruction_gt(char* arg1, char* arg2, char* result)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_GT;
-    instruction->arg1 = str_copy(arg1);
-    instruction->arg2 = str_copy(arg2);
-    instruction->result = str_copy(result);
+    Instruction instruction = { 0 };
+    instruction.operation = OP_GT;
+    instruction.arg1 = (char*)str_intern(arg1);
+    instruction.arg2 = (char*)str_intern(arg2);
+    instruction.result = (char*)str_intern(result);
 
     return instruction;
 }
 
 
-Instruction* instruction_gte(char* arg1, char* arg2, char* result)
+Instruction instruction_gte(char* arg1, char* arg2, char* result)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_GTE;
-    instruction->arg1 = str_copy(arg1);
-    instruction->arg2 = str_copy(arg2);
-    instruction->result = str_copy(result);
+    Instruction instruction = { 0 };
+    instruction.operation = OP_GTE;
+    instruction.arg1 = (char*)str_intern(arg1);
+    instruction.arg2 = (char*)str_intern(arg2);
+    instruction.result = (char*)str_intern(result);
 
     return instruction;
 }
 
 
-Instruction* instruction_and(char* arg1, char* arg2, char* result)
+Instruction instruction_and(char* arg1, char* arg2, char* result)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_AND;
-    instruction->arg1 = str_copy(arg1);
-    instruction->arg2 = str_copy(arg2);
-    instruction->result = str_copy(result);
+    Instruction instruction = { 0 };
+    instruction.operation = OP_AND;
+    instruction.arg1 = (char*)str_intern(arg1);
+    instruction.arg2 = (char*)str_intern(arg2);
+    instruction.result = (char*)str_intern(result);
 
     return instruction;
 }
 
 
-Instruction* instruction_or(char* arg1, char* arg2, char* result)
+Instruction instruction_or(char* arg1, char* arg2, char* result)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_OR;
-    instruction->arg1 = str_copy(arg1);
-    instruction->arg2 = str_copy(arg2);
-    instruction->result = str_copy(result);
+    Instruction instruction = { 0 };
+    instruction.operation = OP_OR;
+    instruction.arg1 = (char*)str_intern(arg1);
+    instruction.arg2 = (char*)str_intern(arg2);
+    instruction.result = (char*)str_intern(result);
 
     return instruction;
 }
 
 
-Instruction* instruction_minus(char* arg, char* result)
+Instruction instruction_minus(char* arg, char* result)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_MINUS;
-    instruction->arg1 = str_copy(arg);
-    instruction->arg2 = NULL;
-    instruction->result = str_copy(result);
+    Instruction instruction = { 0 };
+    instruction.operation = OP_MINUS;
+    instruction.arg1 = (char*)str_intern(arg);
+    instruction.arg2 = NULL;
+    instruction.result = (char*)str_intern(result);
 
     return instruction;
 }
 
 
-Instruction* instruction_not(char* arg, char* result)
+Instruction instruction_not(char* arg, char* result)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_NOT;
-    instruction->arg1 = str_copy(arg);
-    instruction->arg2 = NULL;
-    instruction->result = str_copy(result);
+    Instruction instruction = { 0 };
+    instruction.operation = OP_NOT;
+    instruction.arg1 = (char*)str_intern(arg);
+    instruction.arg2 = NULL;
+    instruction.result = (char*)str_intern(result);
 
     return instruction;
 }
 
 
-Instruction* instruction_function_begin(char* label)
+Instruction instruction_function_begin(char* label)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_FUNCTION_BEGIN;
-    instruction->arg1 = NULL;
-    instruction->arg2 = NULL;
-    instruction->result = NULL;
-    instruction->label = str_copy(label);
-    instruction->size = 0;
+    Instruction instruction = { 0 };
+    instruction.operation = OP_FUNCTION_BEGIN;
+    instruction.arg1 = NULL;
+    instruction.arg2 = NULL;
+    instruction.result = NULL;
+    instruction.label = (char*)str_intern(label);
+    instruction.size = 0;
 
     return instruction;
 }
 
 
-Instruction* instruction_function_end(char* label)
+Instruction instruction_function_end(char* label)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_FUNCTION_END;
-    instruction->arg1 = NULL;
-    instruction->arg2 = NULL;
-    instruction->result = NULL;
-    instruction->label = str_copy(label);
+    Instruction instruction = { 0 };
+    instruction.operation = OP_FUNCTION_END;
+    instruction.arg1 = NULL;
+    instruction.arg2 = NULL;
+    instruction.result = NULL;
+    instruction.label = (char*)str_intern(label);
 
     return instruction;
 }
 
 
-Instruction* instruction_param_push(char* arg)
+Instruction instruction_param_push(char* arg)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_PARAM_PUSH;
-    instruction->arg1 = str_copy(arg);
-    instruction->arg2 = NULL;
-    instruction->result = NULL;
+    Instruction instruction = { 0 };
+    instruction.operation = OP_PARAM_PUSH;
+    instruction.arg1 = (char*)str_intern(arg);
+    instruction.arg2 = NULL;
+    instruction.result = NULL;
 
     return instruction;
 }
 
 
-Instruction* instruction_param_pop(char* arg)
+Instruction instruction_param_pop(char* arg)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_PARAM_POP;
-    instruction->arg1 = str_copy(arg);
-    instruction->arg2 = NULL;
-    instruction->result = NULL;
+    Instruction instruction = { 0 };
+    instruction.operation = OP_PARAM_POP;
+    instruction.arg1 = (char*)str_intern(arg);
+    instruction.arg2 = NULL;
+    instruction.result = NULL;
 
     return instruction;
 }
 
 
-Instruction* instruction_call(char* arg, char* result, int n)
+Instruction instruction_call(char* arg, char* result, int n)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_CALL;
-    instruction->arg1 = str_copy(arg);
-    instruction->arg2 = NULL;
-    instruction->result = str_copy(result);
-    instruction->size = n;
+    Instruction instruction = { 0 };
+    instruction.operation = OP_CALL;
+    instruction.arg1 = (char*)str_intern(arg);
+    instruction.arg2 = NULL;
+    instruction.result = (char*)str_intern(result);
+    instruction.size = n;
 
     return instruction;
 }
 
 
-Instruction* instruction_return(char* arg)
+Instruction instruction_return(char* arg)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_RETURN;
-    instruction->arg1 = str_copy(arg);
-    instruction->arg2 = NULL;
-    instruction->result = NULL;
+    Instruction instruction = { 0 };
+    instruction.operation = OP_RETURN;
+    instruction.arg1 = (char*)str_intern(arg);
+    instruction.arg2 = NULL;
+    instruction.result = NULL;
 
     return instruction;
 }
 
 
-Instruction* instruction_label(char* label)
+Instruction instruction_label(char* label)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_LABEL;
-    instruction->arg1 = NULL;
-    instruction->arg2 = NULL;
-    instruction->result = NULL;
-    instruction->label = str_copy(label); // TODO(timo): Now that I think of it, this could be just a arg1
+    Instruction instruction = { 0 };
+    instruction.operation = OP_LABEL;
+    instruction.arg1 = NULL;
+    instruction.arg2 = NULL;
+    instruction.result = NULL;
+    instruction.label = (char*)str_intern(label); // TODO(timo): Now that I think of it, this could be just a arg1
 
     return instruction;
 }
 
 
-Instruction* instruction_goto(char* label)
+Instruction instruction_goto(char* label)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_GOTO;
-    instruction->arg1 = NULL;
-    instruction->arg2 = NULL;
-    instruction->result = NULL;
-    instruction->label = str_copy(label); // TODO(timo): Now that I think of it, this could be just a arg1
+    Instruction instruction = { 0 };
+    instruction.operation = OP_GOTO;
+    instruction.arg1 = NULL;
+    instruction.arg2 = NULL;
+    instruction.result = NULL;
+    instruction.label = (char*)str_intern(label); // TODO(timo): Now that I think of it, this could be just a arg1
 
     return instruction;
 }
 
 
-Instruction* instruction_goto_if_false(char* arg, char* label)
+Instruction instruction_goto_if_false(char* arg, char* label)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_GOTO_IF_FALSE;
-    instruction->arg1 = str_copy(arg);
-    instruction->arg2 = NULL;
-    instruction->result = NULL;
-    instruction->label = str_copy(label); // TODO(timo): Now that I think of it, this could be just a arg1
+    Instruction instruction = { 0 };
+    instruction.operation = OP_GOTO_IF_FALSE;
+    instruction.arg1 = (char*)str_intern(arg);
+    instruction.arg2 = NULL;
+    instruction.result = NULL;
+    instruction.label = (char*)str_intern(label); // TODO(timo): Now that I think of it, this could be just a arg1
 
     return instruction;
 }
 
 
-Instruction* instruction_dereference(char* arg1, char* result, int offset)
+Instruction instruction_dereference(char* arg1, char* result, int offset)
 {
-    Instruction* instruction = xcalloc(1, sizeof (Instruction));
-    instruction->operation = OP_DEREFERENCE;
-    instruction->arg1 = str_copy(arg1);
-    instruction->arg2 = NULL;
-    instruction->result = str_copy(result);
+    Instruction instruction = { 0 };
+    instruction.operation = OP_DEREFERENCE;
+    instruction.arg1 = (char*)str_intern(arg1);
+    instruction.arg2 = NULL;
+    instruction.result = (char*)str_intern(result);
 
     return instruction;
 }
@@ -428,7 +418,7 @@ void dump_instruction(Instruction* instruction)
 }
 
 
-void dump_instructions(array* instructions)
+void dump_instructions(Instruction_Array* instructions)
 {
     printf("\n");
     printf("-----===== INSTRUCTION DUMP =====-----\n");
@@ -436,7 +426,7 @@ void dump_instructions(array* instructions)
     for (int i = 0; i < instructions->length; i++)
     {
         printf("%d  ", i);
-        dump_instruction(instructions->items[i]);
+        dump_instruction(&instructions->items[i]);
     }
 
     printf("-----=====||||||||||||||||||=====-----\n");
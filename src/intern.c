@@ -0,0 +1,184 @@
+// Implementation of the global string interning. Interned strings are saved
+// into an open addressing table with linear probing. Each string is allocated
+// from an arena together with a small header containing its hash and length.
+//
+// The table is split into shards based on the hash of the string and each
+// shard has its own lock, so the strings can be interned from multiple
+// threads at the same time without them waiting for each other most of the
+// time.
+//
+// Author: Timo Mehto
+// Date: 2021/05/12
+
+#include "intern.h"
+#include "memory.h"     // for x-allocators and arena
+#include <string.h>     // for memcmp, memcpy, strlen
+#include <stdlib.h>     // for free
+#include <pthread.h>    // for mutexes
+
+#define INTERN_INITIAL_CAPACITY 256
+#define INTERN_SHARD_BITS 4
+#define INTERN_SHARDS (1 << INTERN_SHARD_BITS)
+
+
+// Header saved right before the characters of each interned string.
+typedef struct interned_header
+{
+    uint32_t hash;
+    uint32_t length;
+} interned_header;
+
+
+// Single shard of the intern table.
+typedef struct intern_shard
+{
+    pthread_mutex_t lock;
+    const char** slots;
+    size_t capacity;
+    size_t count;
+    arena strings;
+} intern_shard;
+
+
+// NOTE(timo): The table is global on purpose, since the whole point is that
+// there is only one copy of each string in the whole program.
+static intern_shard interns[INTERN_SHARDS] = 
+{ 
+    [0 ... INTERN_SHARDS - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER } 
+};
+
+
+static inline interned_header* header(const char* interned)
+{
+    return (interned_header*)interned - 1;
+}
+
+
+// Fowler-Noll-Vo-1a hash function 
+// https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function                                        
+static uint32_t fnv1a_hash(const char* str, size_t length)
+{
+    uint32_t hash = 0x811c9dc5;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (uint8_t)str[i];
+        hash *= 0x01000193;
+    }
+
+    return hash;
+}
+
+
+static void interns_grow(intern_shard* shard)
+{
+    size_t old_capacity = shard->capacity;
+    const char** old_slots = shard->slots;
+
+    shard->capacity = old_capacity ? old_capacity * 2 : INTERN_INITIAL_CAPACITY;
+    shard->slots = xcalloc(shard->capacity, sizeof (const char*));
+
+    if (old_slots == NULL)
+        arena_init(&shard->strings, ARENA_BLOCK_SIZE);
+
+    // NOTE(timo): The strings themselves are not moved, only the pointers
+    // are placed into the new slots based on the saved hashes
+    for (size_t i = 0; i < old_capacity; i++)
+    {
+        const char* interned = old_slots[i];
+
+        if (interned == NULL) continue;
+
+        size_t index = header(interned)->hash & (shard->capacity - 1);
+
+        while (shard->slots[index] != NULL)
+            index = (index + 1) & (shard->capacity - 1);
+
+        shard->slots[index] = interned;
+    }
+
+    free(old_slots);
+}
+
+
+const char* str_intern_range(const char* str, size_t length)
+{
+    uint32_t hash = fnv1a_hash(str, length);
+
+    // NOTE(timo): The highest bits select the shard and the lowest bits the
+    // slot inside the shard, so they don't depend on each other
+    intern_shard* shard = &interns[hash >> (32 - INTERN_SHARD_BITS)];
+
+    pthread_mutex_lock(&shard->lock);
+
+    // NOTE(timo): The table is kept at most half full
+    if ((shard->count + 1) * 2 > shard->capacity)
+        interns_grow(shard);
+
+    size_t index = hash & (shard->capacity - 1);
+
+    while (shard->slots[index] != NULL)
+    {
+        const char* interned = shard->slots[index];
+        interned_header* h = header(interned);
+
+        if (h->hash == hash && h->length == length && memcmp(interned, str, length) == 0)
+        {
+            pthread_mutex_unlock(&shard->lock);
+            return interned;
+        }
+
+        index = (index + 1) & (shard->capacity - 1);
+    }
+
+    interned_header* h = arena_alloc(&shard->strings, sizeof (interned_header) + length + 1);
+    h->hash = hash;
+    h->length = length;
+
+    char* interned = (char*)(h + 1);
+    memcpy(interned, str, length);
+    interned[length] = 0;
+
+    shard->slots[index] = interned;
+    shard->count++;
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return interned;
+}
+
+
+const char* str_intern(const char* str)
+{
+    return str_intern_range(str, strlen(str));
+}
+
+
+uint32_t interned_hash(const char* interned)
+{
+    return header(interned)->hash;
+}
+
+
+size_t interned_length(const char* interned)
+{
+    return header(interned)->length;
+}
+
+
+void interns_free()
+{
+    for (int i = 0; i < INTERN_SHARDS; i++)
+    {
+        intern_shard* shard = &interns[i];
+
+        if (shard->slots == NULL) continue;
+
+        free(shard->slots);
+        arena_free(&shard->strings);
+
+        shard->slots = NULL;
+        shard->capacity = 0;
+        shard->count = 0;
+    }
+}
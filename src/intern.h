@@ -0,0 +1,67 @@
+// Global string interning. Every distinct string (lexemes, identifiers, names
+// of the temporaries and labels in the IR) is saved only once, so interned
+// strings can be compared with each other just by comparing the pointers.
+//
+// Interned strings are never freed one by one. They live until the whole
+// intern table is released with interns_free() at the end of the program.
+//
+// The strings can be interned from multiple threads at the same time, but
+// interns_free() must be called only after all the other threads are done.
+//
+// File(s): intern.c
+//
+// Author: Timo Mehto
+// Date: 2021/05/12
+
+#ifndef t_intern_h
+#define t_intern_h
+
+#include <stddef.h>     // for size_t
+#include <stdint.h>     // for uint32_t
+
+
+// Interns the string and returns the canonical copy of it.
+//
+// Arguments
+//      str: Null terminated string to be interned.
+// Returns
+//      Pointer to the interned string.
+const char* str_intern(const char* str);
+
+
+// Interns the first length characters of the string. The string doesn't have
+// to be null terminated, so this can be used straight with the source.
+//
+// Arguments
+//      str: Pointer to the start of the string.
+//      length: Number of characters to be interned.
+// Returns
+//      Pointer to the null terminated interned string.
+const char* str_intern_range(const char* str, size_t length);
+
+
+// Returns the hash computed for the string when it was interned, so the users
+// of the interned strings don't have to hash them again.
+//
+// Arguments
+//      interned: String returned by str_intern or str_intern_range.
+// Returns
+//      Hash of the interned string.
+uint32_t interned_hash(const char* interned);
+
+
+// Returns the length of the interned string without using strlen.
+//
+// Arguments
+//      interned: String returned by str_intern or str_intern_range.
+// Returns
+//      Length of the interned string.
+size_t interned_length(const char* interned);
+
+
+// Frees all the interned strings and the intern table itself. All the
+// pointers returned by the interning functions are invalid after this.
+void interns_free();
+
+
+#endif
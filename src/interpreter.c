@@ -14,9 +14,10 @@ void interpreter_init(Interpreter* interpreter, Scope* global)
 
 void interpreter_free(Interpreter* interpreter)
 {
-    // NOTE(timo): At the moment there is no need to free anything since the
-    // global scope is being freed by the resolver and thats pretty much
-    // everything there is right now to be freed
+    // NOTE(timo): The global scope is being freed by the resolver, so the 
+    // frame is pretty much everything there is right now to be freed
+    free(interpreter->frame);
+    interpreter->frame = NULL;
 
     // scope_free(interpreter->global);
 
@@ -40,9 +41,8 @@ static Value evaluate_literal_expression(AST_Expression* expression)
 }
 
 
-static Value evaluate_unary_expression(Interpreter* interpreter, AST_Expression* expression)
+static Value evaluate_unary_expression(AST_Expression* expression, Value operand)
 {
-    Value operand = evaluate_expression(interpreter, expression->unary.operand);
     Token* _operator = expression->unary._operator;
 
     switch (_operator->kind)
@@ -62,10 +62,8 @@ static Value evaluate_unary_expression(Interpreter* interpreter, AST_Expression*
 }
 
 
-static Value evaluate_binary_expression(Interpreter* interpreter, AST_Expression* expression)
+static Value evaluate_binary_expression(AST_Expression* expression, Value left, Value right)
 {
-    Value left = evaluate_expression(interpreter, expression->binary.left);
-    Value right = evaluate_expression(interpreter, expression->binary.right);
     Token* _operator = expression->binary._operator;
 
     switch (_operator->kind)
@@ -107,26 +105,104 @@ static Value evaluate_binary_expression(Interpreter* interpreter, AST_Expression
 }
 
 
-Value evaluate_variable_expression(Interpreter* interpreter, AST_Expression* expression)
+// Finds the place of the value of the variable. The parameters and the local
+// variables live in the slots of the current frame and the global variables
+// in their symbols.
+static inline Value* variable_value(Interpreter* interpreter, Symbol* symbol)
 {
-    Symbol* symbol = scope_lookup(interpreter->local, expression->identifier->lexeme);
+    if (symbol->slot >= 0)
+        return &interpreter->frame[symbol->slot];
+
+    return &symbol->value;
+}
 
+
+Value evaluate_variable_expression(Interpreter* interpreter, AST_Expression* expression)
+{
     // NOTE(timo): We could check for null value, but resolver should 
     // have handled this. The famous last words.
     
-    return symbol->value;
+    return *variable_value(interpreter, expression->symbol);
 }
 
 
 Value evaluate_assignment_expression(Interpreter* interpreter, AST_Expression* expression)
 {
-    AST_Expression* variable = expression->assignment.variable;
-    Symbol* symbol = scope_lookup(interpreter->local, variable->identifier->lexeme);
+    Value* value = variable_value(interpreter, expression->assignment.variable->symbol);
     
     // TODO(timo): Some error handling here?
-    symbol->value = evaluate_expression(interpreter, expression->assignment.value);
+    *value = evaluate_expression(interpreter, expression->assignment.value);
+
+    return *value;
+}
+
+
+// Expression waiting on the explicit stack for its operands to be evaluated.
+typedef struct Pending_Operator
+{
+    AST_Expression* expression;
+    int operands;
+} Pending_Operator;
+
+
+TYPED_ARRAY(Pending_Operator_Stack, pending_operator_stack, Pending_Operator)
+TYPED_ARRAY(Value_Stack, value_stack, Value)
+
+
+// NOTE(timo): The trees of unary and binary expressions are evaluated in 
+// post-order with an explicit stack, so the long chains of operators don't
+// use up the native stack. The rest of the operands are evaluated with
+// evaluate_expression().
+static Value evaluate_operator_expression(Interpreter* interpreter, AST_Expression* expression)
+{
+    Pending_Operator_Stack stack;
+    Value_Stack values;
+
+    pending_operator_stack_init(&stack, 0);
+    value_stack_init(&values, 0);
+    pending_operator_stack_push(&stack, (Pending_Operator){ .expression = expression });
+
+    while (stack.length > 0)
+    {
+        Pending_Operator* top = &stack.items[stack.length - 1];
+        AST_Expression* current = top->expression;
+        int arity = current->kind == EXPRESSION_UNARY ? 1 : 2;
+
+        if (top->operands < arity)
+        {
+            AST_Expression* operand = current->kind == EXPRESSION_UNARY ? current->unary.operand :
+                                      top->operands == 0 ? current->binary.left : current->binary.right;
+            top->operands++;
+
+            if (operand->kind == EXPRESSION_UNARY || operand->kind == EXPRESSION_BINARY)
+                pending_operator_stack_push(&stack, (Pending_Operator){ .expression = operand });
+            else
+                value_stack_push(&values, evaluate_expression(interpreter, operand));
+
+            continue;
+        }
+
+        pending_operator_stack_pop(&stack);
+
+        if (current->kind == EXPRESSION_UNARY)
+        {
+            Value operand = value_stack_pop(&values);
+            value_stack_push(&values, evaluate_unary_expression(current, operand));
+        }
+        else
+        {
+            Value right = value_stack_pop(&values);
+            Value left = value_stack_pop(&values);
+            value_stack_push(&values, evaluate_binary_expression(current, left, right));
+        }
+    }
 
-    return symbol->value;
+    Value value = value_stack_pop(&values);
+
+    pending_operator_stack_free(&stack);
+    value_stack_free(&values);
+
+    return value;
 }
 
 
@@ -137,9 +213,8 @@ Value evaluate_expression(Interpreter* interpreter, AST_Expression* expression)
         case EXPRESSION_LITERAL:
             return evaluate_literal_expression(expression);
         case EXPRESSION_UNARY:
-            return evaluate_unary_expression(interpreter, expression);
         case EXPRESSION_BINARY:
-            return evaluate_binary_expression(interpreter, expression);
+            return evaluate_operator_expression(interpreter, expression);
         case EXPRESSION_VARIABLE:
             return evaluate_variable_expression(interpreter, expression);
         case EXPRESSION_ASSIGNMENT:
@@ -239,25 +314,13 @@ static void evaluate_variable_declaration(Interpreter* interpreter, AST_Declarat
 {
     assert(declaration->kind == DECLARATION_VARIABLE);
 
-    // Declare the identifier in the current scope
-    // Name collisions should've been handled by the resolver,
+    // NOTE(timo): The identifier is already declared by the resolver, 
     // now we are more interested of the value
-    // TODO(timo): Since we are interested in different things here in interpreter,
-    // we can't just create the symbols in the same way as in resolver
-    // Symbol* symbol = symbol_variable(declaration);
+    Value* value = variable_value(interpreter, declaration->symbol);
 
-    Symbol* symbol = scope_lookup(interpreter->local, declaration->identifier->lexeme);
-
-    if (symbol == NULL)
-    {
-        Symbol* symbol = symbol_variable(interpreter->local, declaration->identifier->lexeme, NULL);
-        // symbol->value = evaluate_expression(interpreter, declaration->initializer);
-        scope_declare(interpreter->local, symbol);
-    }
     // NOTE(timo): Resolver does not set values for the symbols as a default, so
     // we need to set them separately in the interpreter
-    symbol->value = evaluate_expression(interpreter, declaration->initializer);
-    // TODO(timo): Else declare the symbol? For now all the variables are resolved at compiletime
+    *value = evaluate_expression(interpreter, declaration->initializer);
 }
 
 
@@ -301,9 +364,8 @@ void evaluate_declaration(Interpreter* interpreter, AST_Declaration* declaration
 }
 
 
-// TODO(timo): Take arguments and options
-// void interpret(const char* source)
-const Value interpret(const char* source)
+// TODO(timo): Take arguments
+const Value interpret(const char* source, struct Options options)
 {
     // Setup
     Lexer lexer;
@@ -312,34 +374,57 @@ const Value interpret(const char* source)
     Resolver resolver;
     Interpreter interpreter;
     
-    // Lexing
+    // NOTE(timo): The cache saves the whole tree, so the bodies can't be skipped
+    bool lazy = options.lazy && options.cache_directory == NULL;
+    bool cached = false;
+
+    // Lexing and parsing
     lexer_init(&lexer, source);
-    lex(&lexer);
 
-    if (lexer.diagnostics->length > 0)
+    // NOTE(timo): Large sources are lexed at once, so they can be lexed and
+    // parsed in parallel. See compile().
+    if (! lazy && options.cache_directory == NULL && strlen(source) >= PARSER_PARALLEL_THRESHOLD)
     {
-        print_diagnostics(lexer.diagnostics);
-        goto teardown_lexer;
+        lex(&lexer);
+        parser_init(&parser, lexer.tokens);
     }
+    else
+        parser_init_streaming(&parser, &lexer);
+
+    // NOTE(timo): Only the body of main is evaluated and the lazy resolving 
+    // always parses and resolves it
+    parser.lazy = lazy;
+
+    // NOTE(timo): The cache restores the symbols of the program too, so the
+    // resolver is created before the tree is loaded
+    type_table = type_table_init();
+    resolver_init(&resolver, type_table);
+    resolver.lazy = options.lazy;
 
-    // Parsing
-    parser_init(&parser, lexer.tokens);
-    parse(&parser);
+    if (options.cache_directory == NULL || 
+        ! (cached = ast_cache_load(options.cache_directory, source, &parser.arena, parser.declarations, &resolver)))
+    {
+        parse(&parser);
+    }
 
-    if (parser.diagnostics->length > 0)
+    if (lexer.diagnostics->length > 0 || parser.diagnostics->length > 0)
     {
-        print_diagnostics(parser.diagnostics);
-        goto teardown_parser;
+        print_diagnostics(lexer.diagnostics->length > 0 ? lexer.diagnostics : parser.diagnostics, source);
+        goto teardown;
     }
 
     // Resolving
-    type_table = type_table_init();
-    resolver_init(&resolver, type_table);
-    resolve(&resolver, parser.declarations);
+    if (! cached)
+    {
+        resolve(&resolver, parser.declarations);
+
+        if (options.cache_directory && resolver.diagnostics->length == 0)
+            ast_cache_save(options.cache_directory, source, parser.declarations, &resolver);
+    }
 
     if (resolver.diagnostics->length > 0)
     {
-        print_diagnostics(resolver.diagnostics);
+        print_diagnostics(resolver.diagnostics, source);
         goto teardown;
     }
     
@@ -348,8 +433,9 @@ const Value interpret(const char* source)
     // TODO(timo): Create a program struct and evaluate it?
     // NOTE(timo): At this point we should handle the arguments and options
     // Then we should just evaluate the body of the program
-    Symbol* main = scope_lookup(resolver.global, "main");
-    interpreter.local = main->type->function.scope;
+    Symbol* main = scope_lookup(resolver.global, str_intern("main"));
+    interpreter.local = main->local;
+    interpreter.frame = xcalloc(interpreter.local->frame_size, sizeof (Value));
 
     AST_Declaration* program = parser.declarations->items[parser.declarations->length - 1];
     AST_Statement* body = program->initializer->function.body;
@@ -360,6 +446,8 @@ const Value interpret(const char* source)
     // TODO(timo): Get and print the return value of the program
     Value return_value = interpreter.return_value;
 
+    interpreter_free(&interpreter);
+
     /*
     if (return_value.type == VALUE_INTEGER)
         printf("Program exited with the value %d\n", return_value.integer);
@@ -371,23 +459,20 @@ const Value interpret(const char* source)
 teardown:
     resolver_free(&resolver);
     type_table_free(type_table);
-teardown_parser:
     parser_free(&parser);
-teardown_lexer:
     lexer_free(&lexer);
 
     return return_value;
 }
 
 
-// TODO(timo): Take arguments and options
-// void interpret_from_file(const char* path)
-const Value interpret_from_file(const char* path)
+// TODO(timo): Take arguments
+const Value interpret_from_file(const char* path, struct Options options)
 {
-    const char* source = read_file(path);
-    Value return_value = interpret(source);
+    Source_File source = load_file(path);
+    Value return_value = interpret(source.contents, options);
 
-    free((char*)source);
+    unload_file(&source);
 
     return return_value;
 }
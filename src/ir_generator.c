@@ -2,10 +2,11 @@
 // of the source code. Generator will generate array of three address code
 // instructions from the abstract syntax tree, annotated by the resolver.
 //
-// The instructions could save the operands of the instruction as straight
-// pointers to the symbol table instead of type char*. That way we can minimize
-// the lookups to the symbol table and make the code more straightforward
-// in the future stages.
+// The instructions save the operands of the instruction as the names and as
+// straight pointers to the symbol table. The names are for printing and the
+// symbols are for the later stages, so they don't have to look up the names
+// from the symbol table. The symbols of the variables are bound by the
+// resolver and the temporaries are declared here.
 //
 // The context handling stuff is a bit ugly and messy as it is. I probably
 // could get rid of alot of the code just by parsing the if-statements some
@@ -30,9 +31,15 @@ void ir_generator_init(IR_Generator* generator, Scope* global)
                                   .label = 0,
                                   .global = global,
                                   .diagnostics = array_init(sizeof (Diagnostic*)),
-                                  .instructions = array_init(sizeof (Instruction*)),
+                                  .instructions = xmalloc(sizeof (Instruction_Array)),
                                   .current_context = NULL,
-                                  .contexts = array_init(sizeof (IR_Context*)) };
+                                  .contexts = array_init(sizeof (IR_Context*)),
+                                  .shared = false,
+                                  .barrier = -1,
+                                  .scanned = 0 };
+
+    instruction_array_init(generator->instructions, 0);
+    shared_result_array_init(&generator->results, 0);
 
     generator->local = generator->global;
 }
@@ -54,15 +61,17 @@ void ir_generator_free(IR_Generator* generator)
 
     array_free(generator->diagnostics);
 
-    // Free instructions
-    for (int i = 0; i < generator->instructions->length; i++)
-        instruction_free(generator->instructions->items[i]);
-
-    array_free(generator->instructions);
+    // Free instructions. The instructions are saved inline into the array.
+    instruction_array_free(generator->instructions);
+    free(generator->instructions);
+    generator->instructions = NULL;
 
     // Free contexts. Length of the contexts should be 0 at this point.
     array_free(generator->contexts);
 
+    // Free the shared results
+    shared_result_array_free(&generator->results);
+
     // NOTE(timo): The global scope will be freed by the resolver
 
     // NOTE(timo): Generator itself is not being freed since it is
@@ -70,6 +79,14 @@ void ir_generator_free(IR_Generator* generator)
 }
 
 
+void ir_generator_clear_results(IR_Generator* generator)
+{
+    // NOTE(timo): The expressions keep the indices of their results, but an
+    // index past the length is never used
+    generator->results.length = 0;
+}
+
+
 static IR_Context* ir_context_if(char* exit_label)
 {
     IR_Context* context = xmalloc(sizeof (IR_Context));
@@ -149,291 +166,738 @@ static char* label(IR_Generator* generator)
 }
 
 
-char* ir_generate_expression(IR_Generator* generator, AST_Expression* expression)
+// Declares the temporary variable holding the result of an instruction into
+// the current scope.
+static Symbol* declare_temp(IR_Generator* generator, const char* identifier, Type* type)
 {
-    switch (expression->kind)
+    Symbol* symbol = symbol_temp(generator->local, identifier, type);
+    scope_declare(generator->local, symbol);
+
+    return symbol;
+}
+
+
+// Binds the symbols of the operands to the instruction and pushes the 
+// instruction into the instruction stream. The symbols are NULL for the 
+// constants and the unused operands.
+static void emit(IR_Generator* generator, Instruction instruction, Symbol* arg1, Symbol* arg2, Symbol* result)
+{
+    instruction.arg1_symbol = arg1;
+    instruction.arg2_symbol = arg2;
+    instruction.result_symbol = result;
+
+    instruction_array_push(generator->instructions, instruction);
+}
+
+
+static Symbol* ir_generate_operand(IR_Generator* generator, AST_Expression* expression);
+
+
+// Checks the instructions generated after the last check for the barriers
+// and the assignments of the variables.
+//
+// NOTE(timo): The results are reused only inside a straight piece of code,
+// since the temporaries are not known to hold the results after the jumps,
+// labels, calls and function boundaries. The assignment of a variable stops
+// the reuse only of the results reading the variable.
+static void scan_instructions(IR_Generator* generator)
+{
+    for (; generator->scanned < generator->instructions->length; generator->scanned++)
     {
-        case EXPRESSION_LITERAL:
+        Instruction* instruction = &generator->instructions->items[generator->scanned];
+
+        switch (instruction->operation)
         {
-            char* arg = (char*)expression->literal->lexeme;
-            char* temp = temp_label(generator);
+            case OP_GOTO:
+            case OP_GOTO_IF:
+            case OP_GOTO_IF_FALSE:
+            case OP_GOTO_IF_TRUE:
+            case OP_LABEL:
+            case OP_CALL:
+            case OP_RETURN:
+            case OP_FUNCTION_BEGIN:
+            case OP_FUNCTION_END:
+                generator->barrier = generator->scanned;
+                break;
+            default:
+                if (instruction->result_symbol && instruction->result_symbol->kind != SYMBOL_TEMP)
+                    instruction->result_symbol->last_write = generator->scanned + 1;
+                break;
+        }
+    }
+}
 
-            Instruction* instruction = instruction_copy(arg, temp);
 
-            array_push(generator->instructions, instruction);
-            scope_declare(generator->local, symbol_temp(generator->local, instruction->result, expression->type));
-            free(temp);
+// Returns the index + 1 of the last scanned instruction writing the variable
+// or 0 if the variable is not written.
+//
+// NOTE(timo): The position is saved on the symbol, so it can be left there by
+// another generator which generated the same symbols before. The position is
+// used only if the instruction at it writes the variable in this generator.
+static int last_write(const IR_Generator* generator, const Symbol* symbol)
+{
+    int position = symbol->last_write;
+
+    if (position == 0 || position > generator->scanned || 
+        generator->instructions->items[position - 1].result_symbol != symbol)
+        return 0;
+
+    return position;
+}
 
-            return instruction->result;
+
+TYPED_ARRAY(Expression_Stack, expression_stack, AST_Expression*)
+
+
+// Checks if any of the variables read by the expression is assigned after
+// the instruction at the position. The shared subexpressions are visited 
+// only once. The visited expressions are marked and the marks are cleared
+// after the walk, so every walk starts with unmarked expressions.
+static bool is_assigned_after(IR_Generator* generator, AST_Expression* expression, int position)
+{
+    Expression_Stack stack;
+    Expression_Stack visited;
+    bool assigned = false;
+
+    expression_stack_init(&stack, 0);
+    expression_stack_init(&visited, 0);
+    expression_stack_push(&stack, expression);
+
+    while (! assigned && stack.length > 0)
+    {
+        AST_Expression* current = expression_stack_pop(&stack);
+
+        if (current->visited)
+            continue;
+
+        current->visited = true;
+        expression_stack_push(&visited, current);
+
+        switch (current->kind)
+        {
+            case EXPRESSION_VARIABLE:
+                assigned = last_write(generator, current->symbol) > position;
+                break;
+            case EXPRESSION_UNARY:
+                expression_stack_push(&stack, current->unary.operand);
+                break;
+            case EXPRESSION_BINARY:
+                expression_stack_push(&stack, current->binary.right);
+                expression_stack_push(&stack, current->binary.left);
+                break;
+            default:
+                break;
         }
-        case EXPRESSION_UNARY:
+    }
+
+    for (int i = 0; i < visited.length; i++)
+        visited.items[i]->visited = false;
+
+    expression_stack_free(&visited);
+    expression_stack_free(&stack);
+
+    return assigned;
+}
+
+
+// Finds the temporary holding the result of an earlier occurrence of the 
+// shared expression.
+//
+// Arguments
+//      generator: Pointer to initialized IR generator.
+//      expression: Expression to be generated.
+// Returns
+//      Symbol of the temporary or NULL if the result can't be reused.
+static Symbol* find_shared_result(IR_Generator* generator, AST_Expression* expression)
+{
+    if (! generator->shared || expression->result == 0 || expression->result > generator->results.length)
+        return NULL;
+
+    Shared_Result* result = &generator->results.items[expression->result - 1];
+
+    // NOTE(timo): The index is saved on the expression, so it can be left 
+    // there by another generator which generated the same tree before. The 
+    // result is used only if it was saved for this very expression.
+    if (result->expression != expression)
+        return NULL;
+
+    scan_instructions(generator);
+
+    if (result->position <= generator->barrier || is_assigned_after(generator, expression, result->position))
+        return NULL;
+
+    return result->symbol;
+}
+
+
+// Saves the temporary holding the result of the expression, which was just
+// generated, for the later occurrences of the expression.
+static Symbol* save_shared_result(IR_Generator* generator, AST_Expression* expression, Symbol* symbol)
+{
+    if (generator->shared)
+    {
+        Shared_Result result = { .expression = expression, 
+                                 .symbol = symbol, 
+                                 .position = generator->instructions->length - 1 };
+
+        shared_result_array_push(&generator->results, result);
+        expression->result = generator->results.length;
+    }
+
+    return symbol;
+}
+
+
+// Checks if the expression is folded into a constant by the resolver and the
+// constant is generated instead of the operations.
+static inline bool is_folded_expression(const IR_Generator* generator, const AST_Expression* expression)
+{
+    return generator->fold && value_is_not_none(expression->value);
+}
+
+
+// Returns the value of the literal. The integers come straight from the
+// token computed by the lexer, so even the overflowing literals, which are
+// not constants for the resolver, keep their value.
+static Value literal_value(const AST_Expression* expression)
+{
+    if (expression->literal->kind == TOKEN_INTEGER_LITERAL)
+        return (Value){ .type = VALUE_INTEGER, .integer = expression->literal->integer };
+
+    return expression->value;
+}
+
+
+// Generates a single copy of the folded value of the expression.
+static Symbol* ir_generate_folded_expression(IR_Generator* generator, AST_Expression* expression)
+{
+    char* temp = temp_label(generator);
+
+    Instruction instruction = instruction_copy_constant(expression->value, temp);
+    Symbol* result = declare_temp(generator, instruction.result, expression->type);
+
+    emit(generator, instruction, NULL, NULL, result);
+    free(temp);
+
+    return result;
+}
+
+
+// Generates the instruction for a unary expression. The operand is already
+// generated.
+static Symbol* ir_generate_unary_expression(IR_Generator* generator, AST_Expression* expression, Symbol* operand)
+{
+    char* arg = (char*)operand->identifier;
+    char* temp = temp_label(generator);
+
+    Instruction instruction;
+
+    switch (expression->unary._operator->kind)
+    {
+        case TOKEN_MINUS:
+            instruction = instruction_minus(arg, temp);
+            break;
+        case TOKEN_NOT:
+            instruction = instruction_not(arg, temp);
+            break;
+    }
+
+    Symbol* result = declare_temp(generator, instruction.result, expression->type);
+
+    emit(generator, instruction, operand, NULL, result);
+    free(temp);
+
+    return result;
+}
+
+
+// Generates the instructions for a binary expression. The operands are already
+// generated.
+static Symbol* ir_generate_binary_expression(IR_Generator* generator, AST_Expression* expression, Symbol* left, Symbol* right)
+{
+    char* arg1 = (char*)left->identifier;
+    char* arg2 = (char*)right->identifier;
+    char* temp = temp_label(generator);
+
+    Instruction instruction;
+
+    switch (expression->binary._operator->kind)
+    {
+        case TOKEN_PLUS:
+            instruction = instruction_add(arg1, arg2, temp);
+            break;
+        case TOKEN_MINUS:
+            instruction = instruction_sub(arg1, arg2, temp);
+            break;
+        case TOKEN_MULTIPLY:
+            instruction = instruction_mul(arg1, arg2, temp);
+            break;
+        case TOKEN_DIVIDE:
+            instruction = instruction_div(arg1, arg2, temp);
+            break;
+        case TOKEN_IS_EQUAL:
+            instruction = instruction_eq(arg1, arg2, temp);
+            break;
+        case TOKEN_NOT_EQUAL:
+            instruction = instruction_neq(arg1, arg2, temp);
+            break;
+        case TOKEN_LESS_THAN:
+            instruction = instruction_lt(arg1, arg2, temp);
+            break;
+        case TOKEN_LESS_THAN_EQUAL:
+            instruction = instruction_lte(arg1, arg2, temp);
+            break;
+        case TOKEN_GREATER_THAN:
+            instruction = instruction_gt(arg1, arg2, temp);
+            break;
+        case TOKEN_GREATER_THAN_EQUAL:
+            instruction = instruction_gte(arg1, arg2, temp);
+            break;
+        case TOKEN_AND:
         {
-            char* operator = (char*)expression->unary._operator->lexeme;
-            char* operand = ir_generate_expression(generator, expression->unary.operand);
-            char* temp = temp_label(generator);
+            char* temp_1 = temp_label(generator);
+            char* temp_2 = temp_label(generator);
+            char* label_false = label(generator);
+            char* label_exit = label(generator);
 
-            Instruction* instruction;
+            //      if left false goto false
+            instruction = instruction_goto_if_false(arg1, label_false);
+            emit(generator, instruction, left, NULL, NULL);
 
-            switch (expression->unary._operator->kind)
-            {
-                case TOKEN_MINUS:
-                    instruction = instruction_minus(operand, temp);
-                    break;
-                case TOKEN_NOT:
-                    instruction = instruction_not(operand, temp);
-                    break;
-            }
+            //      if right false goto false
+            instruction = instruction_goto_if_false(arg2, label_false);
+            emit(generator, instruction, right, NULL, NULL);
 
-            array_push(generator->instructions, instruction);
-            scope_declare(generator->local, symbol_temp(generator->local, instruction->result, expression->type));
-            free(temp);
+            //      condition := true
+            instruction = instruction_copy_constant((Value){ .type = VALUE_BOOLEAN, .boolean = true }, temp_1); 
+            Symbol* condition = declare_temp(generator, instruction.result, expression->type);
+            emit(generator, instruction, NULL, NULL, condition);
+            
+            //      goto exit
+            instruction = instruction_goto(label_exit);
+            instruction_array_push(generator->instructions, instruction);
 
-            return instruction->result;
+            // false:
+            instruction = instruction_label(label_false);
+            instruction_array_push(generator->instructions, instruction);
+            
+            //      condition := false
+            instruction = instruction_copy_constant((Value){ .type = VALUE_BOOLEAN, .boolean = false }, temp_1); 
+            emit(generator, instruction, NULL, NULL, condition);
+
+            // exit:
+            instruction = instruction_label(label_exit);
+            instruction_array_push(generator->instructions, instruction);
+            
+            //      and 1
+            instruction = instruction_copy_constant((Value){ .type = VALUE_BOOLEAN, .boolean = true }, temp_2);
+            Symbol* mask = declare_temp(generator, instruction.result, expression->type);
+            emit(generator, instruction, NULL, NULL, mask);
+            
+            instruction = instruction_and(temp_1, temp_2, temp);
+            left = condition;
+            right = mask;
+
+            free(temp_1);
+            free(temp_2);
+            free(label_false);
+            free(label_exit);
+            break;
         }
-        case EXPRESSION_BINARY:
+        case TOKEN_OR:
         {
-            char* operator = (char*)expression->binary._operator->lexeme;
-            char* left = ir_generate_expression(generator, expression->binary.left); 
-            char* right = ir_generate_expression(generator, expression->binary.right);
-            char* temp = temp_label(generator);
+            char* temp_1 = temp_label(generator);
+            char* temp_2 = temp_label(generator);
+            char* label_next = label(generator);
+            char* label_true = label(generator);
+            char* label_false = label(generator);
+            char* label_exit = label(generator);
+
+            //      if left false goto next
+            instruction = instruction_goto_if_false(arg1, label_next);
+            emit(generator, instruction, left, NULL, NULL);
+
+            //      goto true
+            instruction = instruction_goto(label_true);
+            instruction_array_push(generator->instructions, instruction);
+
+            // next:
+            instruction = instruction_label(label_next);
+            instruction_array_push(generator->instructions, instruction);
+
+            //      if right false goto false
+            instruction = instruction_goto_if_false(arg2, label_false);
+            emit(generator, instruction, right, NULL, NULL);
+
+            // true:
+            instruction = instruction_label(label_true);
+            instruction_array_push(generator->instructions, instruction);
+
+            //      condition := true
+            instruction = instruction_copy_constant((Value){ .type = VALUE_BOOLEAN, .boolean = true }, temp_1); 
+            Symbol* condition = declare_temp(generator, instruction.result, expression->type);
+            emit(generator, instruction, NULL, NULL, condition);
+
+            //      goto exit
+            instruction = instruction_goto(label_exit);
+            instruction_array_push(generator->instructions, instruction);
+
+            // false:
+            instruction = instruction_label(label_false);
+            instruction_array_push(generator->instructions, instruction);
 
-            Instruction* instruction;
+            //      condition := false
+            instruction = instruction_copy_constant((Value){ .type = VALUE_BOOLEAN, .boolean = false }, temp_1); 
+            emit(generator, instruction, NULL, NULL, condition);
 
-            switch (expression->binary._operator->kind)
+            // exit:
+            instruction = instruction_label(label_exit);
+            instruction_array_push(generator->instructions, instruction);
+            
+            //      and 1
+            instruction = instruction_copy_constant((Value){ .type = VALUE_BOOLEAN, .boolean = true }, temp_2);
+            Symbol* mask = declare_temp(generator, instruction.result, expression->type);
+            emit(generator, instruction, NULL, NULL, mask);
+
+            instruction = instruction_and(temp_1, temp_2, temp);
+            left = condition;
+            right = mask;
+
+            free(temp_1);
+            free(temp_2);
+            free(label_next);
+            free(label_true);
+            free(label_false);
+            free(label_exit);
+            break;
+        }
+    }
+    
+    Symbol* result = declare_temp(generator, instruction.result, expression->type);
+
+    emit(generator, instruction, left, right, result);
+    free(temp);
+
+    return result;
+}
+
+
+// Generates the instructions for an index expression. The subscript is
+// already generated.
+static Symbol* ir_generate_index_expression(IR_Generator* generator, AST_Expression* expression, Symbol* subscript)
+{
+    // TODO(timo): This case is great example of why we probably should have
+    // functions to emit each of the operations, so we don't produce messy
+    // things like this right here.
+    Instruction instruction;
+    Type* element_type = expression->index.variable->type->array.element_type;
+    char* temp;
+
+    // Generate the total offset for the accessed element by multiplying the 
+    // width (=size) of the type with the value of the subscript
+    // NOTE(timo): All types are 8 bytes wide for now
+    char* element_size = temp_label(generator); 
+    instruction = instruction_copy_constant((Value){ .type = VALUE_INTEGER, .integer = 8 }, element_size);
+
+    Symbol* size = declare_temp(generator, instruction.result, element_type); // TODO(timo): remove
+    emit(generator, instruction, NULL, NULL, size);
+
+    temp = temp_label(generator);
+    instruction = instruction_mul((char*)subscript->identifier, element_size, temp);
+
+    Symbol* offset = declare_temp(generator, instruction.result, element_type);
+    emit(generator, instruction, subscript, size, offset);
+    free(element_size);
+    free(temp);
+    
+    // TODO(timo): Basically we should also copy the result of the multiplication to temp variable
+
+    // Add the offset to the base pointer
+    Symbol* variable = ir_generate_operand(generator, expression->index.variable);
+    temp = temp_label(generator);
+    instruction = instruction_add((char*)variable->identifier, (char*)offset->identifier, temp);
+
+    Symbol* address = declare_temp(generator, instruction.result, element_type);
+    emit(generator, instruction, variable, offset, address);
+    free(temp);
+
+    // Defererence the accessed element
+    temp = temp_label(generator);
+    instruction = instruction_dereference((char*)address->identifier, temp, -1);
+
+    Symbol* result = declare_temp(generator, instruction.result, element_type);
+    emit(generator, instruction, address, NULL, result);
+    free(temp);
+
+    return result;
+}
+
+
+// Generates the call instruction for a call expression. The arguments are
+// already generated and pushed from the last to the first, so the symbols of
+// the arguments are in the reverse order.
+static Symbol* ir_generate_call_expression(IR_Generator* generator, AST_Expression* expression, Symbol** pushed)
+{
+    Instruction instruction;
+    int count = expression->call.arguments->length;
+
+    // Call instruction itself
+    AST_Expression* function = expression->call.variable;
+    char* temp = temp_label(generator);
+
+    instruction = instruction_call((char*)function->identifier->lexeme, temp, count);
+
+    Symbol* result = declare_temp(generator, instruction.result, expression->type);
+    emit(generator, instruction, function->symbol, NULL, result);
+    free(temp);
+    
+    // Pop the params from the stack after the call has returned
+    for (int i = 0; i < count; i++)
+    {
+        Symbol* argument = pushed[count - 1 - i];
+
+        instruction = instruction_param_pop((char*)argument->identifier);
+        emit(generator, instruction, argument, NULL, NULL);
+    }
+
+    return result;
+}
+
+
+// Expression waiting on the explicit stack for its operands to be generated.
+//
+// Members
+//      expression: Unary, binary, call or index expression.
+//      operands: Number of the operands pushed to the stack so far.
+//      arity: Number of the operands.
+//      pushed: Number of the arguments of a call pushed as parameters.
+typedef struct Pending_Expression
+{
+    AST_Expression* expression;
+    int operands;
+    int arity;
+    int pushed;
+} Pending_Expression;
+
+
+TYPED_ARRAY(Pending_Expression_Stack, pending_expression_stack, Pending_Expression)
+TYPED_ARRAY(Operand_Stack, operand_stack, Symbol*)
+
+
+static void push_pending_expression(Pending_Expression_Stack* stack, AST_Expression* expression)
+{
+    int arity;
+
+    switch (expression->kind)
+    {
+        case EXPRESSION_UNARY:  arity = 1; break;
+        case EXPRESSION_BINARY: arity = 2; break;
+        case EXPRESSION_CALL:   arity = expression->call.arguments->length; break;
+        case EXPRESSION_INDEX:  arity = 1; break;
+        default:
+            assert(false && "Only nested expressions are pushed to the stack");
+            arity = 0;
+            break;
+    }
+
+    pending_expression_stack_push(stack, (Pending_Expression){ .expression = expression, .arity = arity });
+}
+
+
+// Returns the operand of the expression at the index. The arguments of the
+// calls are generated from the last to the first.
+static AST_Expression* nested_operand(const AST_Expression* expression, int index)
+{
+    switch (expression->kind)
+    {
+        case EXPRESSION_UNARY:  return expression->unary.operand;
+        case EXPRESSION_BINARY: return index == 0 ? expression->binary.left : expression->binary.right;
+        case EXPRESSION_CALL:   return expression->call.arguments->items[expression->call.arguments->length - 1 - index];
+        case EXPRESSION_INDEX:  return expression->index.value;
+        default:
+            assert(false && "Only nested expressions have operands");
+            return NULL;
+    }
+}
+
+
+// NOTE(timo): The trees of unary, binary, call and index expressions are 
+// generated in post-order with an explicit stack, so the long chains of 
+// operators and the deeply nested calls don't use up the native stack. Each 
+// argument is pushed as a parameter right after it is generated, so the 
+// instructions come out in the same order as with the recursion. The rest of
+// the operands are generated with ir_generate_operand().
+static Symbol* ir_generate_nested_expression(IR_Generator* generator, AST_Expression* expression)
+{
+    Pending_Expression_Stack stack;
+    Operand_Stack operands;
+
+    pending_expression_stack_init(&stack, 0);
+    operand_stack_init(&operands, 0);
+    push_pending_expression(&stack, expression);
+
+    while (stack.length > 0)
+    {
+        Pending_Expression* top = &stack.items[stack.length - 1];
+        AST_Expression* current = top->expression;
+
+        // Push the arguments to the stack/registers and leave them to the 
+        // operand stack to pop them later in correct order
+        if (current->kind == EXPRESSION_CALL && top->pushed < top->operands)
+        {
+            Symbol* argument = operands.items[operands.length - 1];
+            Instruction instruction = instruction_param_push((char*)argument->identifier);
+
+            emit(generator, instruction, argument, NULL, NULL);
+            top->pushed++;
+        }
+
+        if (top->operands < top->arity)
+        {
+            AST_Expression* operand = nested_operand(current, top->operands++);
+            Symbol* shared;
+
+            if ((operand->kind == EXPRESSION_UNARY || operand->kind == EXPRESSION_BINARY) &&
+                ! is_folded_expression(generator, operand))
             {
-                case TOKEN_PLUS:
-                    instruction = instruction_add(left, right, temp);
-                    break;
-                case TOKEN_MINUS:
-                    instruction = instruction_sub(left, right, temp);
-                    break;
-                case TOKEN_MULTIPLY:
-                    instruction = instruction_mul(left, right, temp);
-                    break;
-                case TOKEN_DIVIDE:
-                    instruction = instruction_div(left, right, temp);
-                    break;
-                case TOKEN_IS_EQUAL:
-                    instruction = instruction_eq(left, right, temp);
-                    break;
-                case TOKEN_NOT_EQUAL:
-                    instruction = instruction_neq(left, right, temp);
-                    break;
-                case TOKEN_LESS_THAN:
-                    instruction = instruction_lt(left, right, temp);
-                    break;
-                case TOKEN_LESS_THAN_EQUAL:
-                    instruction = instruction_lte(left, right, temp);
-                    break;
-                case TOKEN_GREATER_THAN:
-                    instruction = instruction_gt(left, right, temp);
-                    break;
-                case TOKEN_GREATER_THAN_EQUAL:
-                    instruction = instruction_gte(left, right, temp);
-                    break;
-                case TOKEN_AND:
-                {
-                    char* temp_1 = temp_label(generator);
-                    char* temp_2 = temp_label(generator);
-                    char* label_false = label(generator);
-                    char* label_exit = label(generator);
-
-                    //      if left false goto false
-                    instruction = instruction_goto_if_false(left, label_false);
-                    array_push(generator->instructions, instruction);
-
-                    //      if right false goto false
-                    instruction = instruction_goto_if_false(right, label_false);
-                    array_push(generator->instructions, instruction);
-
-                    //      condition := true
-                    instruction = instruction_copy("true", temp_1); 
-                    array_push(generator->instructions, instruction);
-                    scope_declare(generator->local, symbol_temp(generator->local, instruction->result, expression->type));
-                    
-                    //      goto exit
-                    instruction = instruction_goto(label_exit);
-                    array_push(generator->instructions, instruction);
-
-                    // false:
-                    instruction = instruction_label(label_false);
-                    array_push(generator->instructions, instruction);
-                    
-                    //      condition := false
-                    instruction = instruction_copy("false", temp_1); 
-                    array_push(generator->instructions, instruction);
-
-                    // exit:
-                    instruction = instruction_label(label_exit);
-                    array_push(generator->instructions, instruction);
-                    
-                    //      and 1
-                    instruction = instruction_copy("true", temp_2);
-                    array_push(generator->instructions, instruction);
-                    scope_declare(generator->local, symbol_temp(generator->local, instruction->result, expression->type));
-                    
-                    instruction = instruction_and(temp_1, temp_2, temp);
-
-                    free(temp_1);
-                    free(temp_2);
-                    free(label_false);
-                    free(label_exit);
-                    break;
-                }
-                case TOKEN_OR:
-                {
-                    char* temp_1 = temp_label(generator);
-                    char* temp_2 = temp_label(generator);
-                    char* label_next = label(generator);
-                    char* label_true = label(generator);
-                    char* label_false = label(generator);
-                    char* label_exit = label(generator);
-
-                    //      if left false goto next
-                    instruction = instruction_goto_if_false(left, label_next);
-                    array_push(generator->instructions, instruction);
-
-                    //      goto true
-                    instruction = instruction_goto(label_true);
-                    array_push(generator->instructions, instruction);
-
-                    // next:
-                    instruction = instruction_label(label_next);
-                    array_push(generator->instructions, instruction);
-
-                    //      if right false goto false
-                    instruction = instruction_goto_if_false(right, label_false);
-                    array_push(generator->instructions, instruction);
-
-                    // true:
-                    instruction = instruction_label(label_true);
-                    array_push(generator->instructions, instruction);
-
-                    //      condition := true
-                    instruction = instruction_copy("true", temp_1); 
-                    array_push(generator->instructions, instruction);
-                    scope_declare(generator->local, symbol_temp(generator->local, instruction->result, expression->type));
-
-                    //      goto exit
-                    instruction = instruction_goto(label_exit);
-                    array_push(generator->instructions, instruction);
-
-                    // false:
-                    instruction = instruction_label(label_false);
-                    array_push(generator->instructions, instruction);
-
-                    //      condition := false
-                    instruction = instruction_copy("false", temp_1); 
-                    array_push(generator->instructions, instruction);
-
-                    // exit:
-                    instruction = instruction_label(label_exit);
-                    array_push(generator->instructions, instruction);
-                    
-                    //      and 1
-                    instruction = instruction_copy("true", temp_2);
-                    array_push(generator->instructions, instruction);
-                    scope_declare(generator->local, symbol_temp(generator->local, instruction->result, expression->type));
-
-                    instruction = instruction_and(temp_1, temp_2, temp);
-
-                    free(temp_1);
-                    free(temp_2);
-                    free(label_next);
-                    free(label_true);
-                    free(label_false);
-                    free(label_exit);
-                    break;
-                }
+                if ((shared = find_shared_result(generator, operand)))
+                    operand_stack_push(&operands, shared);
+                else
+                    push_pending_expression(&stack, operand);
             }
-            
-            array_push(generator->instructions, instruction);
-            scope_declare(generator->local, symbol_temp(generator->local, instruction->result, expression->type));
-            free(temp);
+            else if (operand->kind == EXPRESSION_CALL || operand->kind == EXPRESSION_INDEX)
+                push_pending_expression(&stack, operand);
+            else
+                operand_stack_push(&operands, ir_generate_operand(generator, operand));
 
-            return instruction->result;
+            continue;
         }
-        case EXPRESSION_VARIABLE:
+
+        pending_expression_stack_pop(&stack);
+
+        switch (current->kind)
+        {
+            case EXPRESSION_UNARY:
+            {
+                Symbol* operand = operand_stack_pop(&operands);
+                Symbol* result = ir_generate_unary_expression(generator, current, operand);
+                operand_stack_push(&operands, save_shared_result(generator, current, result));
+                break;
+            }
+            case EXPRESSION_BINARY:
+            {
+                Symbol* right = operand_stack_pop(&operands);
+                Symbol* left = operand_stack_pop(&operands);
+                Symbol* result = ir_generate_binary_expression(generator, current, left, right);
+                operand_stack_push(&operands, save_shared_result(generator, current, result));
+                break;
+            }
+            case EXPRESSION_CALL:
+            {
+                int count = current->call.arguments->length;
+                Symbol* result = ir_generate_call_expression(generator, current, &operands.items[operands.length - count]);
+
+                operands.length -= count;
+                operand_stack_push(&operands, result);
+                break;
+            }
+            case EXPRESSION_INDEX:
+            {
+                Symbol* subscript = operand_stack_pop(&operands);
+                operand_stack_push(&operands, ir_generate_index_expression(generator, current, subscript));
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    Symbol* result = operand_stack_pop(&operands);
+
+    pending_expression_stack_free(&stack);
+    operand_stack_free(&operands);
+
+    return result;
+}
+
+
+// Generates the instructions for the expression.
+//
+// Arguments
+//      generator: Pointer to initialized IR generator.
+//      expression: Expression to be generated.
+// Returns
+//      Symbol of the temporary or the variable holding the result of the
+//      expression. NULL if the expression has no result.
+static Symbol* ir_generate_operand(IR_Generator* generator, AST_Expression* expression)
+{
+    Symbol* shared;
+
+    if ((shared = find_shared_result(generator, expression)))
+        return shared;
+
+    switch (expression->kind)
+    {
+        case EXPRESSION_LITERAL:
         {
-            char* arg = (char*)expression->literal->lexeme;
             char* temp = temp_label(generator);
-            
-            Instruction* instruction = instruction_copy(arg, temp);
 
-            array_push(generator->instructions, instruction);
-            scope_declare(generator->local, symbol_temp(generator->local, instruction->result, expression->type));
+            Instruction instruction = instruction_copy_constant(literal_value(expression), temp);
+            Symbol* result = declare_temp(generator, instruction.result, expression->type);
+
+            emit(generator, instruction, NULL, NULL, result);
             free(temp);
 
-            return instruction->result;
+            return save_shared_result(generator, expression, result);
         }
-        case EXPRESSION_ASSIGNMENT:
+        case EXPRESSION_UNARY:
+        case EXPRESSION_BINARY:
         {
-            char* arg = ir_generate_expression(generator, expression->assignment.value);
-            char* result = (char*)expression->assignment.variable->identifier->lexeme;
+            if (is_folded_expression(generator, expression))
+                return save_shared_result(generator, expression, ir_generate_folded_expression(generator, expression));
 
-            Instruction* instruction = instruction_copy(arg, result);
-            array_push(generator->instructions, instruction);
-
-            return result;
+            return ir_generate_nested_expression(generator, expression);
         }
         case EXPRESSION_INDEX:
+        case EXPRESSION_CALL:
+            return ir_generate_nested_expression(generator, expression);
+        case EXPRESSION_VARIABLE:
         {
-            // TODO(timo): This case is great example of why we probably should have
-            // functions to emit each of the operations, so we don't produce messy
-            // things like this right here.
-            Instruction* instruction;
-            char* temp;
-
-            // Generate the total offset for the accessed element by multiplying the 
-            // width (=size) of the type with the value of the subscript
-            // NOTE(timo): All types are 8 bytes wide for now
-            char* subscript = ir_generate_expression(generator, expression->index.value);
-            char* element_size = temp_label(generator); 
-            instruction = instruction_copy("8", element_size);
-
-            array_push(generator->instructions, instruction);
-            scope_declare(generator->local, symbol_temp(generator->local, instruction->result, expression->index.variable->type->array.element_type)); // TODO(timo): remove
-
-            temp = temp_label(generator);
-            instruction = instruction_mul(subscript, element_size, temp);
-
-            array_push(generator->instructions, instruction);
-            scope_declare(generator->local, symbol_temp(generator->local, instruction->result, expression->index.variable->type->array.element_type));
-            free(element_size);
-            free(temp);
+            char* arg = (char*)expression->identifier->lexeme;
+            char* temp = temp_label(generator);
             
-            // TODO(timo): Basically we should also copy the result of the multiplication to temp variable
+            Instruction instruction = instruction_copy(arg, temp);
+            Symbol* result = declare_temp(generator, instruction.result, expression->type);
 
-            // Add the offset to the base pointer
-            char* arg = ir_generate_expression(generator, expression->index.variable);
-            temp = temp_label(generator);
-            instruction = instruction_add(arg, instruction->result, temp);
-
-            array_push(generator->instructions, instruction);
-            scope_declare(generator->local, symbol_temp(generator->local, instruction->result, expression->index.variable->type->array.element_type));
+            emit(generator, instruction, expression->symbol, NULL, result);
             free(temp);
-        
-            // Defererence the accessed element
-            temp = temp_label(generator);
-            instruction = instruction_dereference(instruction->result, temp, -1);
 
-            array_push(generator->instructions, instruction);
-            scope_declare(generator->local, symbol_temp(generator->local, instruction->result, expression->index.variable->type->array.element_type));
-            free(temp);
+            return save_shared_result(generator, expression, result);
+        }
+        case EXPRESSION_ASSIGNMENT:
+        {
+            Symbol* value = ir_generate_operand(generator, expression->assignment.value);
+            Symbol* variable = expression->assignment.variable->symbol;
 
-            return instruction->result;
+            Instruction instruction = instruction_copy((char*)value->identifier, (char*)variable->identifier);
+            emit(generator, instruction, value, NULL, variable);
+
+            return variable;
         }
         case EXPRESSION_FUNCTION:
         {
-            Instruction* instruction;
+            Instruction instruction;
             
             // Function prologue
 
             // TODO(timo): Change the scope to function scope. For now it is handled
             // at the function declaration.
             
+            // NOTE(timo): The size of the function is known only after the body,
+            // so the index of the instruction is saved to update the size later
+            int function_begin = generator->instructions->length;
             instruction = instruction_function_begin((char*)generator->local->name);
-            array_push(generator->instructions, instruction);
+            instruction_array_push(generator->instructions, instruction);
 
             // Function body 
 
@@ -445,66 +909,36 @@ char* ir_generate_expression(IR_Generator* generator, AST_Expression* expression
             // NOTE(timo): At this point, the scope has been already set to the function scope
             // so therefore we already know the size of the function via the scope
             // We could also take this info at the code generation stage from the scope
-            instruction->size = generator->local->offset;
+            generator->instructions->items[function_begin].size = generator->local->offset;
             
             // Function epilogue
             
             instruction = instruction_function_end((char*)generator->local->name);
-            array_push(generator->instructions, instruction);
+            instruction_array_push(generator->instructions, instruction);
 
             // TODO(timo): This should probably return something, but what?
-            break;
-        }
-        case EXPRESSION_CALL:
-        {
-            Instruction* instruction;
-
-            // Push the arguments to the stack/registers and save the argument
-            // addresses to pop them later in correct order
-            array* arguments = expression->call.arguments;
-            char* args[arguments->length];
-
-            for (int i = arguments->length - 1; i >= 0; i--)
-            {
-                AST_Expression* argument = (AST_Expression*)arguments->items[i];
-                char* arg = ir_generate_expression(generator, argument);
-
-                instruction = instruction_param_push(arg);
-                array_push(generator->instructions, instruction);
-                args[i] = arg;
-            }
-
-            // Call instruction itself
-            char* arg = (char*)expression->call.variable->identifier->lexeme;
-            char* temp = temp_label(generator);
-
-            instruction = instruction_call(arg, temp, arguments->length);
-
-            scope_declare(generator->local, symbol_temp(generator->local, instruction->result, expression->type));
-            array_push(generator->instructions, instruction);
-            free(temp);
-            
-            // Pop the params from the stack after the call has returned
-            for (int i = 0; i < arguments->length; i++)
-            {
-                Instruction* instruction = instruction_param_pop(args[i]);
-                array_push(generator->instructions, instruction);
-            }
-
-            return instruction->result;
+            return NULL;
         }
         default:
         {
             Diagnostic* _diagnostic = diagnostic(DIAGNOSTIC_ERROR, (Position){0},
-                ":IR_GENERATOR - Unreachable: Unexpected expression in ir_generate_expression()");
+                ":IR_GENERATOR - Unreachable: Unexpected expression in ir_generate_operand()");
             array_push(generator->diagnostics, _diagnostic);
             // TODO(timo): What to return in error situation?
-            break;
+            return NULL;
         }
     }
 }
 
 
+char* ir_generate_expression(IR_Generator* generator, AST_Expression* expression)
+{
+    Symbol* result = ir_generate_operand(generator, expression);
+
+    return result ? (char*)result->identifier : NULL;
+}
+
+
 void ir_generate_statement(IR_Generator* generator, AST_Statement* statement)
 {
     switch (statement->kind)
@@ -516,7 +950,7 @@ void ir_generate_statement(IR_Generator* generator, AST_Statement* statement)
         }
         case STATEMENT_EXPRESSION:
         {
-            ir_generate_expression(generator, statement->expression);
+            ir_generate_operand(generator, statement->expression);
             break;
         }
         case STATEMENT_BLOCK:
@@ -527,7 +961,7 @@ void ir_generate_statement(IR_Generator* generator, AST_Statement* statement)
         }
         case STATEMENT_WHILE:
         {
-            Instruction* instruction;
+            Instruction instruction;
 
             // Local labels
             char* label_condition = label(generator); // condition
@@ -538,24 +972,24 @@ void ir_generate_statement(IR_Generator* generator, AST_Statement* statement)
             
             // Start of the loop
             instruction = instruction_label(label_condition);
-            array_push(generator->instructions, instruction);
+            instruction_array_push(generator->instructions, instruction);
 
             // Generate condition
-            char* condition = ir_generate_expression(generator, statement->_while.condition);
+            Symbol* condition = ir_generate_operand(generator, statement->_while.condition);
 
-            instruction = instruction_goto_if_false(condition, generator->current_context->_while.exit_label);
-            array_push(generator->instructions, instruction);
+            instruction = instruction_goto_if_false((char*)condition->identifier, generator->current_context->_while.exit_label);
+            emit(generator, instruction, condition, NULL, NULL);
             
             // Generate the body
             ir_generate_statement(generator, statement->_while.body);
             
             // Go back to the start of the loop to test the condition again
             instruction = instruction_goto(label_condition);
-            array_push(generator->instructions, instruction);
+            instruction_array_push(generator->instructions, instruction);
             
             // Exit Label
             instruction = instruction_label(generator->current_context->_while.exit_label);
-            array_push(generator->instructions, instruction);
+            instruction_array_push(generator->instructions, instruction);
 
             // Pop context
             ir_context_pop(generator);
@@ -566,11 +1000,11 @@ void ir_generate_statement(IR_Generator* generator, AST_Statement* statement)
         }
         case STATEMENT_IF:
         {
-            Instruction* instruction;
+            Instruction instruction;
 
             // Local labels
             char* label_exit = label(generator);
-            char* condition = ir_generate_expression(generator, statement->_if.condition);
+            Symbol* condition = ir_generate_operand(generator, statement->_if.condition);
 
             // Push context
             // NOTE(timo): We can start new if context IF
@@ -591,19 +1025,19 @@ void ir_generate_statement(IR_Generator* generator, AST_Statement* statement)
                 char* label_else = label(generator);
 
                 // Condition
-                instruction = instruction_goto_if_false(condition, label_else);
-                array_push(generator->instructions, instruction);
+                instruction = instruction_goto_if_false((char*)condition->identifier, label_else);
+                emit(generator, instruction, condition, NULL, NULL);
 
                 // Generate the body
                 ir_generate_statement(generator, statement->_if.then);
                 
                 // Goto exit
                 instruction = instruction_goto(generator->current_context->_if.exit_label);
-                array_push(generator->instructions, instruction);
+                instruction_array_push(generator->instructions, instruction);
 
                 // Else label
                 instruction = instruction_label(label_else);
-                array_push(generator->instructions, instruction);
+                instruction_array_push(generator->instructions, instruction);
 
                 // New contexts are not allowed since we are in else block of the current context
                 generator->current_context->_if.new_context = false;
@@ -615,8 +1049,8 @@ void ir_generate_statement(IR_Generator* generator, AST_Statement* statement)
             else // if-then
             {
                 // Condition
-                instruction = instruction_goto_if_false(condition, generator->current_context->_if.exit_label);
-                array_push(generator->instructions, instruction);
+                instruction = instruction_goto_if_false((char*)condition->identifier, generator->current_context->_if.exit_label);
+                emit(generator, instruction, condition, NULL, NULL);
 
                 // Generate the body
                 ir_generate_statement(generator, statement->_if.then);
@@ -630,8 +1064,8 @@ void ir_generate_statement(IR_Generator* generator, AST_Statement* statement)
                 generator->current_context->_if.exit_not_generated)
             {
                 // Exit label
-                Instruction* instruction = instruction_label(generator->current_context->_if.exit_label);
-                array_push(generator->instructions, instruction);
+                Instruction instruction = instruction_label(generator->current_context->_if.exit_label);
+                instruction_array_push(generator->instructions, instruction);
                 generator->current_context->_if.exit_not_generated = false;
 
                 // Pop context
@@ -643,10 +1077,10 @@ void ir_generate_statement(IR_Generator* generator, AST_Statement* statement)
         }
         case STATEMENT_RETURN:
         {
-            char* value = ir_generate_expression(generator, statement->_return.value);
+            Symbol* value = ir_generate_operand(generator, statement->_return.value);
 
-            Instruction* instruction = instruction_return(value);
-            array_push(generator->instructions, instruction);
+            Instruction instruction = instruction_return((char*)value->identifier);
+            emit(generator, instruction, value, NULL, NULL);
             break;
         }
         case STATEMENT_BREAK:
@@ -657,8 +1091,8 @@ void ir_generate_statement(IR_Generator* generator, AST_Statement* statement)
 
                 if (context->kind == IR_CONTEXT_WHILE)
                 {
-                    Instruction* instruction = instruction_goto(context->_while.exit_label);
-                    array_push(generator->instructions, instruction);
+                    Instruction instruction = instruction_goto(context->_while.exit_label);
+                    instruction_array_push(generator->instructions, instruction);
                     break;
                 }
             }
@@ -673,8 +1107,8 @@ void ir_generate_statement(IR_Generator* generator, AST_Statement* statement)
 
                 if (context->kind == IR_CONTEXT_WHILE)
                 {
-                    Instruction* instruction = instruction_goto(context->_while.start_label);
-                    array_push(generator->instructions, instruction);
+                    Instruction instruction = instruction_goto(context->_while.start_label);
+                    instruction_array_push(generator->instructions, instruction);
                     break;
                 }
             }
@@ -701,28 +1135,37 @@ void ir_generate_declaration(IR_Generator* generator, AST_Declaration* declarati
             // declarations. They are put to .data section in assembly.
             if (generator->local != generator->global)
             {
-                char* value = ir_generate_expression(generator, declaration->initializer);
+                Symbol* value = ir_generate_operand(generator, declaration->initializer);
 
-                Instruction* instruction = instruction_copy(value, (char*)declaration->identifier->lexeme);
-                array_push(generator->instructions, instruction);
+                Instruction instruction = instruction_copy((char*)value->identifier, (char*)declaration->identifier->lexeme);
+                emit(generator, instruction, value, NULL, declaration->symbol);
             }
             break;
         }
         case DECLARATION_FUNCTION:
         {
-            Instruction* instruction;
+            Instruction instruction;
 
             char* label = (char*)declaration->identifier->lexeme;
+            Symbol* function = declaration->symbol;
+
+            // NOTE(timo): Functions left unresolved by the lazy resolving 
+            // are never used, so there is nothing to generate
+            if (function->state == STATE_UNRESOLVED)
+                break;
 
             instruction = instruction_label(label);
-            array_push(generator->instructions, instruction);
+            instruction_array_push(generator->instructions, instruction);
             
             // Set the scope to the function scope
-            Symbol* function = scope_lookup(generator->local, declaration->identifier->lexeme);
-            generator->local = function->type->function.scope;
+            generator->local = function->local;
             
             // Generate the body of the function (=initializer)
-            ir_generate_expression(generator, declaration->initializer);
+            // NOTE(timo): The beginning of the function is bound to the 
+            // function, so the code generator can switch to its scope
+            int function_begin = generator->instructions->length;
+            ir_generate_operand(generator, declaration->initializer);
+            generator->instructions->items[function_begin].arg1_symbol = function;
             
             // Restore the scope to the enclosing scope
             generator->local = generator->local->enclosing;
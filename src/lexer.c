@@ -16,15 +16,45 @@
 // Date: 2021/05/12
 
 #include "t.h"
+#include <pthread.h>    // for threads of the parallel lexing
+#include <unistd.h>     // for sysconf
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define LEXER_SIMD
+#include <immintrin.h>  // for SSE2 and AVX2 intrinsics
+#endif
+
+// Initial capacity of the token stream. Even the small programs have a few
+// hundred tokens, so this skips the first few reallocations.
+#define LEXER_INITIAL_TOKENS 256
+
+// Maximum number of the chunks/threads in the parallel lexing.
+#define LEXER_MAX_THREADS 16
+
+
+static void select_scanners(void);
 
 
 void lexer_init(Lexer* lexer, const char* source)
 {
-    *lexer = (Lexer){ .stream = source, 
-                      .position.line_end = 1, 
-                      .position.column_end = 1,
+    lexer_init_range(lexer, source, source, source + strlen(source));
+}
+
+
+void lexer_init_range(Lexer* lexer, const char* source, const char* start, const char* end)
+{
+    select_scanners();
+
+    *lexer = (Lexer){ .source = source,
+                      .stream = start, 
+                      .end = end,
                       .diagnostics = array_init(sizeof (Diagnostic*)),
-                      .tokens = array_init(sizeof (Token*)) };
+                      .tokens = xmalloc(sizeof (Token_Array)) };
+
+    // NOTE(timo): The token stream is allocated only when the whole source is
+    // lexed at once with lex(). The parser can pull the tokens one at a time
+    // with next_token() and then the stream is not needed at all.
+    token_array_init(lexer->tokens, 0);
 }
 
 
@@ -44,45 +74,72 @@ void lexer_free(Lexer* lexer)
     // NOTE(timo): This function will set the array to NULL after freeing
     array_free(lexer->diagnostics);
 
-    // NOTE(timo): It is the callers responsibility to "unwind" the array
-    // to the beginning so this iteration can be done.
-    for (int i = 0; i < lexer->tokens->length; i++)
-    {
-        Token* token = lexer->tokens->items[i];
-        free((char*)token->lexeme);
-        token->lexeme = NULL;
-
-        free(token);
-        token = NULL;
-    }
-    
-    // NOTE(timo): This function will set the array to NULL after freeing
-    array_free(lexer->tokens);
+    // NOTE(timo): The tokens are saved inline into the array and their lexemes
+    // are interned, so freeing the array releases all of the tokens.
+    token_array_free(lexer->tokens);
+    free(lexer->tokens);
+    lexer->tokens = NULL;
 
     // NOTE(timo): The lexer itself is not freed, since it is being initialized 
     // in the stack at the top level function.
 }
 
 
-// Advances the current position in the source stream and updates the position
-// of the current lexeme.
+// Advances the current position in the source stream.
+//
+// NOTE(timo): The lines and columns are not tracked here anymore. The tokens
+// only save the offsets into the source and the lines and columns are computed
+// from the line table when they are actually needed.
 //
 // Arguments
 //      lexer: Pointer to initialized Lexer.
 //      n: How many characters/steps is being advanced.
 static inline void advance(Lexer* lexer, int n)
 {
-    if (*lexer->stream == '\n')
-    {
-        lexer->position.line_end++;
-        lexer->position.column_end = 1;
-        lexer->stream += n;
-    }
-    else
+    lexer->stream += n;
+}
+
+
+// Computes the value of the integer literal. The overflow is checked before
+// each digit is added and the value saturates to INT64_MAX, which is larger
+// than any integer value of the language, so the resolver can report the
+// overflow just by comparing the value to the maximum integer value.
+//
+// Arguments
+//      lexeme: Start of the scanned digits.
+//      length: Number of the scanned digits.
+// Returns
+//      Value of the integer literal or INT64_MAX if it overflows.
+static inline int64_t integer_value(const char* lexeme, const int length)
+{
+    int64_t value = 0;
+
+    for (int i = 0; i < length; i++)
     {
-        lexer->position.column_end += n;
-        lexer->stream += n;
+        // Converts ascii digit to corresponding number
+        const int digit = lexeme[i] - '0';
+
+        if (value > (INT64_MAX - digit) / 10)
+            return INT64_MAX;
+
+        value = value * 10 + digit;
     }
+
+    return value;
+}
+
+
+// Creates position for the lexeme starting from the offset. The end of the
+// position is the offset of the last character of the lexeme.
+//
+// Arguments
+//      offset: Offset of the first character of the lexeme.
+//      length: Length of the lexeme.
+// Returns
+//      Position of the lexeme.
+static inline Position lexeme_position(const int offset, const int length)
+{
+    return (Position){ .start = offset, .end = offset + length - 1 };
 }
 
 
@@ -94,13 +151,29 @@ static inline void advance(Lexer* lexer, int n)
 //      lexer: Pointer to initialized Lexer.
 //      n: Position in relation to the current position.
 // Returns
-//      The character in the position.
+//      The character in the position or 0 if the position is past the end.
 static inline const char peek(Lexer* lexer, int n)
 {
-    return *(lexer->stream + n);
+    return lexer->stream + n < lexer->end ? *(lexer->stream + n) : '\0';
 }
 
 
+// Classes of the characters. A character can belong to multiple classes.
+#define CHAR_WHITESPACE 0x1
+#define CHAR_DIGIT      0x2
+#define CHAR_ALPHA      0x4
+
+
+// Lookup table for the classes of all of the characters, so classifying a
+// character is a single load instead of a chain of comparisons.
+static const unsigned char char_classes[256] = 
+{
+    [' '] = CHAR_WHITESPACE, ['\t'] = CHAR_WHITESPACE, ['\n'] = CHAR_WHITESPACE,
+    ['0' ... '9'] = CHAR_DIGIT,
+    ['a' ... 'z'] = CHAR_ALPHA, ['A' ... 'Z'] = CHAR_ALPHA, ['_'] = CHAR_ALPHA,
+};
+
+
 // Checks if the character is whitespace.
 //
 // Arguments
@@ -109,7 +182,7 @@ static inline const char peek(Lexer* lexer, int n)
 //      Value true if character is whitespace, otherwise false.
 static inline const bool is_whitespace(const char ch)
 {
-    return ch == ' ' || ch == '\t' || ch == '\n';
+    return char_classes[(unsigned char)ch] & CHAR_WHITESPACE;
 }
 
 
@@ -121,7 +194,7 @@ static inline const bool is_whitespace(const char ch)
 //      Value true if character is digit, otherwise false.
 static inline const bool is_digit(const char ch)
 {
-    return '0' <= ch && ch <= '9';
+    return char_classes[(unsigned char)ch] & CHAR_DIGIT;
 }
 
 
@@ -133,28 +206,252 @@ static inline const bool is_digit(const char ch)
 //      Value true if character is in the allowed alphabet, otherwise false.
 static inline const bool is_alpha(const char ch)
 {
-    return ('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z') || ch == '_';
+    return char_classes[(unsigned char)ch] & CHAR_ALPHA;
 }
 
 
-void lex(Lexer* lexer)
+// Checks if the character is allowed in the names after the first character.
+//
+// Arguments
+//      ch: Character to be checked.
+// Returns
+//      Value true if character is in the alphabet or a digit, otherwise false.
+static inline const bool is_alphanumeric(const char ch)
+{
+    return char_classes[(unsigned char)ch] & (CHAR_ALPHA | CHAR_DIGIT);
+}
+
+
+// Keyword/reserved word and the kind of its token.
+typedef struct Keyword
+{
+    const char* lexeme;
+    int length;
+    Token_Kind kind;
+} Keyword;
+
+
+// Perfect hash of the keywords based on the length and the first and the last
+// character of the keyword. None of the keywords collide with each other, so
+// recognizing a keyword is a single probe into the table and a comparison. 
+// If new keywords are added, the multipliers have to be checked again.
+#define KEYWORD_HASH(length, first, last) (((length) + ((first) << 3) + (last) * 5) & 31)
+
+
+static const Keyword keywords[32] =
+{
+    [KEYWORD_HASH(3, 'a', 'd')] = { "and",      3, TOKEN_AND },
+    [KEYWORD_HASH(4, 'b', 'l')] = { "bool",     4, TOKEN_BOOL },
+    [KEYWORD_HASH(5, 'b', 'k')] = { "break",    5, TOKEN_BREAK },
+    [KEYWORD_HASH(8, 'c', 'e')] = { "continue", 8, TOKEN_CONTINUE },
+    [KEYWORD_HASH(2, 'd', 'o')] = { "do",       2, TOKEN_DO },
+    [KEYWORD_HASH(4, 'e', 'e')] = { "else",     4, TOKEN_ELSE },
+    [KEYWORD_HASH(5, 'f', 'e')] = { "false",    5, TOKEN_BOOLEAN_LITERAL },
+    [KEYWORD_HASH(2, 'i', 'f')] = { "if",       2, TOKEN_IF },
+    [KEYWORD_HASH(3, 'i', 't')] = { "int",      3, TOKEN_INT },
+    [KEYWORD_HASH(3, 'n', 't')] = { "not",      3, TOKEN_NOT },
+    [KEYWORD_HASH(2, 'o', 'r')] = { "or",       2, TOKEN_OR },
+    [KEYWORD_HASH(6, 'r', 'n')] = { "return",   6, TOKEN_RETURN },
+    [KEYWORD_HASH(4, 't', 'n')] = { "then",     4, TOKEN_THEN },
+    [KEYWORD_HASH(4, 't', 'e')] = { "true",     4, TOKEN_BOOLEAN_LITERAL },
+    [KEYWORD_HASH(5, 'w', 'e')] = { "while",    5, TOKEN_WHILE },
+};
+
+
+// Checks if the scanned name is one of the keywords/reserved words.
+//
+// Arguments
+//      lexeme: Start of the scanned name.
+//      length: Length of the scanned name.
+// Returns
+//      Pointer to the keyword or NULL if the name is not a keyword.
+static inline const Keyword* find_keyword(const char* lexeme, const int length)
+{
+    const Keyword* keyword = &keywords[KEYWORD_HASH(length, lexeme[0], lexeme[length - 1])];
+
+    if (keyword->length == length && memcmp(keyword->lexeme, lexeme, length) == 0)
+        return keyword;
+
+    return NULL;
+}
+
+
+// Skips the whitespace starting from the character. One character at a time.
+//
+// Arguments
+//      stream: Pointer to the current character.
+//      end: Pointer past the last character to be scanned.
+// Returns
+//      Pointer to the first character which is not whitespace or the end.
+static const char* skip_whitespace_scalar(const char* stream, const char* end)
+{
+    while (stream < end && is_whitespace(*stream)) 
+        stream++;
+
+    return stream;
+}
+
+
+// Skips the comment starting from the character. One character at a time.
+//
+// Arguments
+//      stream: Pointer to the current character.
+//      end: Pointer past the last character to be scanned.
+// Returns
+//      Pointer to the newline or the end of the source ending the comment.
+static const char* skip_comment_scalar(const char* stream, const char* end)
+{
+    while (stream < end && *stream != '\n' && *stream != '\0')
+        stream++;
+
+    return stream;
+}
+
+
+#ifdef LEXER_SIMD
+// NOTE(timo): The vectorized scanners read the source in unaligned blocks of
+// 16 or 32 bytes only while the whole block is before the end, so they never
+// read past the scanned range, which doesn't have to be terminated. The rest
+// of the range shorter than a block is finished with the scalar scanners.
+
+
+// Skips the whitespace 16 characters at a time with SSE2.
+static const char* skip_whitespace_sse2(const char* stream, const char* end)
+{
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    for (; end - stream >= 16; stream += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)stream);
+        __m128i whitespace = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space),
+                                                       _mm_cmpeq_epi8(chunk, tab)),
+                                          _mm_cmpeq_epi8(chunk, newline));
+        unsigned int mask = ~(unsigned int)_mm_movemask_epi8(whitespace) & 0xffff;
+
+        if (mask != 0)
+            return stream + __builtin_ctz(mask);
+    }
+
+    return skip_whitespace_scalar(stream, end);
+}
+
+
+// Skips the comment 16 characters at a time with SSE2.
+static const char* skip_comment_sse2(const char* stream, const char* end)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; end - stream >= 16; stream += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)stream);
+        __m128i stop = _mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, zero));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(stop);
+
+        if (mask != 0)
+            return stream + __builtin_ctz(mask);
+    }
+
+    return skip_comment_scalar(stream, end);
+}
+
+
+// Skips the whitespace 32 characters at a time with AVX2.
+__attribute__((target("avx2")))
+static const char* skip_whitespace_avx2(const char* stream, const char* end)
+{
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i newline = _mm256_set1_epi8('\n');
+
+    for (; end - stream >= 32; stream += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)stream);
+        __m256i whitespace = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, space),
+                                                             _mm256_cmpeq_epi8(chunk, tab)),
+                                             _mm256_cmpeq_epi8(chunk, newline));
+        uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(whitespace);
+
+        if (mask != 0)
+            return stream + __builtin_ctz(mask);
+    }
+
+    return skip_whitespace_scalar(stream, end);
+}
+
+
+// Skips the comment 32 characters at a time with AVX2.
+__attribute__((target("avx2")))
+static const char* skip_comment_avx2(const char* stream, const char* end)
 {
-    while (*lexer->stream != '\0')
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+
+    for (; end - stream >= 32; stream += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)stream);
+        __m256i stop = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, newline), _mm256_cmpeq_epi8(chunk, zero));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(stop);
+
+        if (mask != 0)
+            return stream + __builtin_ctz(mask);
+    }
+
+    return skip_comment_scalar(stream, end);
+}
+#endif
+
+
+// The scanners used by the lexer. These are selected at runtime based on the
+// features of the CPU.
+static const char* (*skip_whitespace)(const char* stream, const char* end) = skip_whitespace_scalar;
+static const char* (*skip_comment)(const char* stream, const char* end) = skip_comment_scalar;
+
+
+// Selects the fastest scanners supported by the CPU. The scalar scanners are
+// used if the vectorized ones are not supported at all.
+static void select_scanners(void)
+{
+#ifdef LEXER_SIMD
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        skip_whitespace = skip_whitespace_avx2;
+        skip_comment = skip_comment_avx2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
     {
-        lexer->position.line_start = lexer->position.line_end;
-        lexer->position.column_start = lexer->position.column_end;
+        skip_whitespace = skip_whitespace_sse2;
+        skip_comment = skip_comment_sse2;
+    }
+#endif
+}
+
+
+Token next_token(Lexer* lexer)
+{
+    while (lexer->stream < lexer->end)
+    {
+        const int offset = lexer->stream - lexer->source;
 
         switch (*lexer->stream)
         {
             case ' ':
             case '\t':
             case '\n':
-                while (is_whitespace(*lexer->stream) && *lexer->stream != '\0')
+                // NOTE(timo): Most of the time there is only a single space
+                // between the tokens, so the scanners are used only for the
+                // longer runs of whitespace e.g. the indentation
+                if (!is_whitespace(peek(lexer, 1)))
                     advance(lexer, 1);
+                else
+                    lexer->stream = skip_whitespace(lexer->stream, lexer->end);
                 continue;
             case '#':
-                while (*lexer->stream != '\n' && *lexer->stream != '\0')
-                    advance(lexer, 1);
+                lexer->stream = skip_comment(lexer->stream, lexer->end);
                 continue;
             case '0': case '1': case '2': case '3': case '4': 
             case '5': case '6': case '7': case '8': case '9':
@@ -163,17 +460,12 @@ void lex(Lexer* lexer)
 
                 while (is_digit(*lexer->stream)) advance(lexer, 1);
                 
-                int length = lexer->position.column_end - lexer->position.column_start;
+                const int length = lexer->stream - lexeme;
 
-                // TODO(timo): The position goes one step too far when it comes 
-                // to the lexeme of the number, so this is quick and dirty way 
-                // to fix it for now. 
-                lexer->position.column_end -= 1;
+                Token _token = token(TOKEN_INTEGER_LITERAL, str_intern_range(lexeme, length), length, lexeme_position(offset, length));
+                _token.integer = integer_value(lexeme, length);
 
-                array_push(lexer->tokens, token(TOKEN_INTEGER_LITERAL, lexeme, length, lexer->position));
-
-                lexer->position.column_end += 1;
-                continue;
+                return _token;
             }
             case '_':
             case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h': case 'i': case 'j': case 'k': case 'l': case 'm':
@@ -183,105 +475,18 @@ void lex(Lexer* lexer)
             {
                 const char* lexeme = lexer->stream;
 
-                while (is_alpha(*lexer->stream) || is_digit(*lexer->stream)) advance(lexer, 1);
+                while (is_alphanumeric(*lexer->stream)) advance(lexer, 1);
 
-                const int length = lexer->position.column_end - lexer->position.column_start;
-
-                Token_Kind kind = TOKEN_IDENTIFIER;
+                const int length = lexer->stream - lexeme;
 
                 // Check if the scanned lexeme is one of the keywords/reserved 
-                // words. If it is not, then it must be a identifier/name. The 
-                // implementation is a bit dirty trie structure, but it is clear 
-                // and simple to understand.
-                switch (*lexeme)
-                {
-                    case 'a':
-                        if (lexeme[1] == 'n' && lexeme[2] == 'd' && !is_alpha(lexeme[3]))
-                            kind = TOKEN_AND;
-                        break;
-                    case 'b':
-                        switch (lexeme[1])
-                        {
-                            case 'o':
-                                if (lexeme[2] == 'o' && lexeme[3] == 'l' && !is_alpha(lexeme[4]))
-                                    kind = TOKEN_BOOL;
-                                break;
-                            case 'r': 
-                                if (lexeme[2] == 'e' && lexeme[3] == 'a' && lexeme[4] == 'k' && !is_alpha(lexeme[5]))
-                                    kind = TOKEN_BREAK;
-                                break;
-                        }
-                        break;
-                    case 'c':
-                        if (lexeme[1] == 'o' && lexeme[2] == 'n' && lexeme[3] == 't' && lexeme[4] == 'i' && 
-                            lexeme[5] == 'n' && lexeme[6] == 'u' &&lexeme[7] == 'e' && !is_alpha(lexeme[8]))
-                                kind = TOKEN_CONTINUE;
-                        break;
-                    case 'd':
-                        if (lexeme[1] == 'o' && !is_alpha(lexeme[2]))
-                            kind = TOKEN_DO;
-                        break;
-                    case 'e': 
-                        if (lexeme[1] == 'l' && lexeme[2] == 's' && lexeme[3] == 'e' && !is_alpha(lexeme[4]))
-                            kind = TOKEN_ELSE;
-                        break;
-                    case 'f': 
-                        if (lexeme[1] == 'a' && lexeme[2] == 'l' && lexeme[3] == 's' && lexeme[4] == 'e' && !is_alpha(lexeme[5]))
-                            kind = TOKEN_BOOLEAN_LITERAL;
-                        break;
-                    case 'i':
-                        switch (lexeme[1])
-                        {
-                            case 'f':
-                                if (!is_alpha(lexeme[2]))
-                                    kind = TOKEN_IF;
-                                break;
-                            case 'n':
-                                if (lexeme[2] == 't' && !is_alpha(lexeme[3]))
-                                    kind = TOKEN_INT;
-                                break;
-                        }
-                        break;
-                    case 'n':
-                        if (lexeme[1] == 'o' && lexeme[2] == 't' && !is_alpha(lexeme[3]))
-                            kind = TOKEN_NOT;
-                        break;
-                    case 'o': 
-                        if (lexeme[1] == 'r' && !is_alpha(lexeme[2]))
-                            kind = TOKEN_OR;
-                        break;
-                    case 'r': 
-                        if (lexeme[1] == 'e' && lexeme[2] == 't' && lexeme[3] == 'u' && lexeme[4] == 'r' && lexeme[5] == 'n' && !is_alpha(lexeme[6]))
-                            kind = TOKEN_RETURN;
-                        break;
-                    case 't':
-                        switch (lexeme[1])
-                        {
-                            case 'h': 
-                                if (lexeme[2] == 'e' && lexeme[3] == 'n' && !is_alpha(lexeme[4]))
-                                    kind = TOKEN_THEN;
-                                break;
-                            case 'r': 
-                                if (lexeme[2] == 'u' && lexeme[3] == 'e' && !is_alpha(lexeme[4]))
-                                    kind = TOKEN_BOOLEAN_LITERAL;
-                                break;
-                        }
-                        break;
-                    case 'w': 
-                        if (lexeme[1] == 'h' && lexeme[2] == 'i' && lexeme[3] == 'l' && lexeme[4] == 'e' && !is_alpha(lexeme[5]))
-                            kind = TOKEN_WHILE;
-                        break;
-                }
-
-                // TODO(timo): The position goes one step too far when it comes 
-                // to the lexeme of the identifier, so this is quick and dirty 
-                // way to fix it for now. 
-                lexer->position.column_end -= 1;
+                // words. If it is not, then it must be a identifier/name.
+                const Keyword* keyword = find_keyword(lexeme, length);
 
-                array_push(lexer->tokens, token(kind, lexeme, length, lexer->position));
+                if (keyword)
+                    return token(keyword->kind, keyword->lexeme, length, lexeme_position(offset, length));
 
-                lexer->position.column_end += 1;
-                continue;
+                return token(TOKEN_IDENTIFIER, str_intern_range(lexeme, length), length, lexeme_position(offset, length));
             }
             // TODO(timo): There must be a better way to handle these operators, 
             // punctuation etc. lexemes which are only couple of characters long.
@@ -289,119 +494,92 @@ void lex(Lexer* lexer)
             // error messages in case of invalid operators etc. to give better
             // hints and possible solutions to the users.
             case '+':
-                array_push(lexer->tokens, token(TOKEN_PLUS, "+", 1, lexer->position));
                 advance(lexer, 1);
-                continue;
+                return token(TOKEN_PLUS, "+", 1, lexeme_position(offset, 1));
             case '-':
-                array_push(lexer->tokens, token(TOKEN_MINUS, "-", 1, lexer->position));
                 advance(lexer, 1);
-                continue;
+                return token(TOKEN_MINUS, "-", 1, lexeme_position(offset, 1));
             case '*':
-                array_push(lexer->tokens, token(TOKEN_MULTIPLY, "*", 1, lexer->position));
                 advance(lexer, 1);
-                continue;
+                return token(TOKEN_MULTIPLY, "*", 1, lexeme_position(offset, 1));
             case '/':
-                array_push(lexer->tokens, token(TOKEN_DIVIDE, "/", 1, lexer->position));
                 advance(lexer, 1);
-                continue;
+                return token(TOKEN_DIVIDE, "/", 1, lexeme_position(offset, 1));
             case '(':
-                array_push(lexer->tokens, token(TOKEN_LEFT_PARENTHESIS, "(", 1, lexer->position));
                 advance(lexer, 1);
-                continue;
+                return token(TOKEN_LEFT_PARENTHESIS, "(", 1, lexeme_position(offset, 1));
             case ')':
-                array_push(lexer->tokens, token(TOKEN_RIGHT_PARENTHESIS, ")", 1, lexer->position));
                 advance(lexer, 1);
-                continue;
+                return token(TOKEN_RIGHT_PARENTHESIS, ")", 1, lexeme_position(offset, 1));
             case '[':
-                array_push(lexer->tokens, token(TOKEN_LEFT_BRACKET, "[", 1, lexer->position));
                 advance(lexer, 1);
-                continue;
+                return token(TOKEN_LEFT_BRACKET, "[", 1, lexeme_position(offset, 1));
             case ']':
-                array_push(lexer->tokens, token(TOKEN_RIGHT_BRACKET, "]", 1, lexer->position));
                 advance(lexer, 1);
-                continue;
+                return token(TOKEN_RIGHT_BRACKET, "]", 1, lexeme_position(offset, 1));
             case '{':
-                array_push(lexer->tokens, token(TOKEN_LEFT_CURLYBRACE, "{", 1, lexer->position));
                 advance(lexer, 1);
-                continue;
+                return token(TOKEN_LEFT_CURLYBRACE, "{", 1, lexeme_position(offset, 1));
             case '}':
-                array_push(lexer->tokens, token(TOKEN_RIGHT_CURLYBRACE, "}", 1, lexer->position));
                 advance(lexer, 1);
-                continue;
+                return token(TOKEN_RIGHT_CURLYBRACE, "}", 1, lexeme_position(offset, 1));
             case ',':
-                array_push(lexer->tokens, token(TOKEN_COMMA, ",", 1, lexer->position));
                 advance(lexer, 1);
-                continue;
+                return token(TOKEN_COMMA, ",", 1, lexeme_position(offset, 1));
             case ';':
-                array_push(lexer->tokens, token(TOKEN_SEMICOLON, ";", 1, lexer->position));
                 advance(lexer, 1);
-                continue;
+                return token(TOKEN_SEMICOLON, ";", 1, lexeme_position(offset, 1));
             case ':':
                 if (peek(lexer, 1) == '=')
                 {
-                    advance(lexer, 1);
-                    array_push(lexer->tokens, token(TOKEN_COLON_ASSIGN, ":=", 2, lexer->position));
-                    advance(lexer, 1);
-                    continue;
+                    advance(lexer, 2);
+                    return token(TOKEN_COLON_ASSIGN, ":=", 2, lexeme_position(offset, 2));
                 }
-                array_push(lexer->tokens, token(TOKEN_COLON, ":", 1, lexer->position));
                 advance(lexer, 1);
-                continue;
+                return token(TOKEN_COLON, ":", 1, lexeme_position(offset, 1));
             case '=':
                 if (peek(lexer, 1) == '=')
                 {
-                    advance(lexer, 1);
-                    array_push(lexer->tokens, token(TOKEN_IS_EQUAL, "==", 2, lexer->position));
-                    advance(lexer, 1);
-                    continue;
+                    advance(lexer, 2);
+                    return token(TOKEN_IS_EQUAL, "==", 2, lexeme_position(offset, 2));
                 }
                 if (peek(lexer, 1) == '>')
                 {
-                    advance(lexer, 1);
-                    array_push(lexer->tokens, token(TOKEN_ARROW, "=>", 2, lexer->position));
-                    advance(lexer, 1);
-                    continue;
+                    advance(lexer, 2);
+                    return token(TOKEN_ARROW, "=>", 2, lexeme_position(offset, 2));
                 }
-                array_push(lexer->tokens, token(TOKEN_EQUAL, "=", 1, lexer->position));
                 advance(lexer, 1);
-                continue;
+                return token(TOKEN_EQUAL, "=", 1, lexeme_position(offset, 1));
             case '<':
                 if (peek(lexer, 1) == '=')
                 {
-                    advance(lexer, 1);
-                    array_push(lexer->tokens, token(TOKEN_LESS_THAN_EQUAL, "<=", 2, lexer->position));
-                    advance(lexer, 1);
-                    continue;
+                    advance(lexer, 2);
+                    return token(TOKEN_LESS_THAN_EQUAL, "<=", 2, lexeme_position(offset, 2));
                 }
-                array_push(lexer->tokens, token(TOKEN_LESS_THAN, "<", 1, lexer->position));
                 advance(lexer, 1);
-                continue;
+                return token(TOKEN_LESS_THAN, "<", 1, lexeme_position(offset, 1));
             case '>':
                 if (peek(lexer, 1) == '=')
                 {
-                    advance(lexer, 1);
-                    array_push(lexer->tokens, token(TOKEN_GREATER_THAN_EQUAL, ">=", 2, lexer->position));
-                    advance(lexer, 1);
-                    continue;
+                    advance(lexer, 2);
+                    return token(TOKEN_GREATER_THAN_EQUAL, ">=", 2, lexeme_position(offset, 2));
                 }
-                array_push(lexer->tokens, token(TOKEN_GREATER_THAN, ">", 1, lexer->position));
                 advance(lexer, 1);
-                continue;
+                return token(TOKEN_GREATER_THAN, ">", 1, lexeme_position(offset, 1));
             // NOTE(timo): This case has to be last, because there is only one
             // kind of operator allowed with the exclamation point and if it is
             // not the correct one, it will give a general error.
             case '!':
                 if (peek(lexer, 1) == '=')
                 {
-                    advance(lexer, 1);
-                    array_push(lexer->tokens, token(TOKEN_NOT_EQUAL, "!=", 2, lexer->position));
-                    advance(lexer, 1);
-                    continue;
+                    advance(lexer, 2);
+                    return token(TOKEN_NOT_EQUAL, "!=", 2, lexeme_position(offset, 2));
                 }
                 advance(lexer, 1);
             default:
             {
-                Diagnostic* _diagnostic = diagnostic(DIAGNOSTIC_ERROR, lexer->position, 
+                const Position position = { .start = offset, .end = lexer->stream - lexer->source };
+                Diagnostic* _diagnostic = diagnostic(DIAGNOSTIC_ERROR, position, 
                     ":LEXER - SyntaxError: Invalid character '%c'", *lexer->stream);
                 array_push(lexer->diagnostics, _diagnostic);
                 advance(lexer, 1);
@@ -410,10 +588,136 @@ void lex(Lexer* lexer)
         }
     }
     
-    // NOTE(timo): This have to be here to take into account the end of file situation
-    lexer->position.line_start = lexer->position.line_end;
-    lexer->position.column_start = lexer->position.column_end;
+    // NOTE(timo): The end of file token is returned every time after the
+    // source has been scanned through
+    const int offset = lexer->stream - lexer->source;
+    return token(TOKEN_EOF, "<EoF>", 5, (Position){ .start = offset, .end = offset });
+}
+
+
+void lex(Lexer* lexer)
+{
+    if (lexer->end - lexer->stream >= LEXER_PARALLEL_THRESHOLD)
+    {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+
+        if (processors > 1)
+        {
+            lex_parallel(lexer, processors);
+            return;
+        }
+    }
+
+    token_array_reserve(lexer->tokens, LEXER_INITIAL_TOKENS);
+
+    Token* last;
+
+    do
+        last = token_array_push(lexer->tokens, next_token(lexer));
+    while (last->kind != TOKEN_EOF);
+}
+
+
+// Lexes a single chunk of the source. This is the entry point of the threads
+// in the parallel lexing.
+//
+// Arguments
+//      argument: Pointer to the Lexer of the chunk.
+// Returns
+//      Always NULL.
+static void* lex_chunk(void* argument)
+{
+    Lexer* chunk = argument;
+    Token next;
+
+    // NOTE(timo): The end of file token is left out, since the chunk is not
+    // the end of the source
+    while ((next = next_token(chunk)).kind != TOKEN_EOF)
+        token_array_push(chunk->tokens, next);
+
+    return NULL;
+}
+
+
+void lex_parallel(Lexer* lexer, int chunks)
+{
+    Lexer lexers[LEXER_MAX_THREADS];
+    pthread_t threads[LEXER_MAX_THREADS];
+    
+    const char* start = lexer->stream;
+    const size_t size = lexer->end - start;
+    int count = 0;
+
+    if (chunks > LEXER_MAX_THREADS) chunks = LEXER_MAX_THREADS;
+    if (chunks < 1) chunks = 1;
+
+    // Split the source into chunks. The chunks end right after a newline, 
+    // which means that the next chunk can't start in the middle of a comment 
+    // or any other lexeme, since none of them continue over the newline.
+    for (const char* chunk_start = start; chunk_start < lexer->end; count++)
+    {
+        const char* chunk_end = start + size * (count + 1) / chunks;
+
+        if (chunk_end < chunk_start) 
+            chunk_end = chunk_start;
+
+        const char* newline = memchr(chunk_end, '\n', lexer->end - chunk_end);
+        chunk_end = newline && count < chunks - 1 ? newline + 1 : lexer->end;
+
+        // NOTE(timo): All the chunks share the same source, so the positions 
+        // of the tokens are offsets from the start of the whole source
+        lexer_init_range(&lexers[count], lexer->source, chunk_start, chunk_end);
+
+        // NOTE(timo): There is roughly one token for every six characters
+        token_array_reserve(lexers[count].tokens, (chunk_end - chunk_start) / 6);
+
+        chunk_start = chunk_end;
+    }
+
+    // NOTE(timo): The first chunk is lexed by the calling thread itself
+    for (int i = 1; i < count; i++)
+    {
+        if (pthread_create(&threads[i], NULL, lex_chunk, &lexers[i]) != 0)
+        {
+            printf("Could not create a thread for lexing\n");
+            exit(1);
+        }
+    }
+
+    if (count > 0)
+        lex_chunk(&lexers[0]);
+
+    for (int i = 1; i < count; i++)
+        pthread_join(threads[i], NULL);
+
+    // Concatenate the tokens and the diagnostics of the chunks in the order
+    // of the chunks, so the result is identical to the serial lexing
+    int length = lexer->tokens->length;
+
+    for (int i = 0; i < count; i++)
+        length += lexers[i].tokens->length;
+
+    token_array_reserve(lexer->tokens, length + 1);
+
+    for (int i = 0; i < count; i++)
+    {
+        Lexer* chunk = &lexers[i];
+
+        memcpy(lexer->tokens->items + lexer->tokens->length, chunk->tokens->items, 
+               chunk->tokens->length * sizeof (Token));
+        lexer->tokens->length += chunk->tokens->length;
+
+        for (int j = 0; j < chunk->diagnostics->length; j++)
+            array_push(lexer->diagnostics, chunk->diagnostics->items[j]);
+
+        // NOTE(timo): The diagnostics were moved to the lexer, so only the
+        // array holding them is freed
+        array_free(chunk->diagnostics);
+        token_array_free(chunk->tokens);
+        free(chunk->tokens);
+
+        lexer->stream = chunk->stream;
+    }
 
-    // Add the end of file token
-    array_push(lexer->tokens, token(TOKEN_EOF, "<EoF>", 5, lexer->position));    
+    token_array_push(lexer->tokens, next_token(lexer));
 }
@@ -25,16 +25,23 @@ int main(int argc, char** argv)
         .show_symbols = false,
         .show_ir = false,
         .show_asm = false,
+        .lazy = false,
+        .share = false,
+        .single_pass = false,
+        .fold = false,
+        .cache_directory = NULL,
     };
 
     parse_options(&options, &argc, &argv);
     
     if (options.interpret && options.interpret_ast)
-        interpret_from_file(options.source_file);
+        interpret_from_file(options.source_file, options);
     else
         // TODO(timo): This probably should return somekind of code indicating 
         // the success or the non-success of the compiling process
         compile_from_file(options.source_file, options);
 
+    interns_free();
+
     return 0;
 }
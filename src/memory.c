@@ -6,6 +6,8 @@
 #include "memory.h"
 #include <stdlib.h>     // for allocs, exit
 #include <stdio.h>      // for printing
+#include <string.h>     // for memset, memcpy
+#include <stdint.h>     // for uintptr_t
 
 
 void* xmalloc(size_t bytes)
@@ -48,3 +50,138 @@ void* xcalloc(size_t length, size_t size)
 
     return pointer;
 }
+
+
+void arena_init(arena* arena, size_t block_size)
+{
+    *arena = (struct arena){ .head = NULL,
+                             .block_size = block_size > 0 ? block_size : ARENA_BLOCK_SIZE,
+                             .allocated = 0 };
+}
+
+
+void arena_free(arena* arena)
+{
+    arena_block* block = arena->head;
+
+    while (block != NULL)
+    {
+        arena_block* next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arena->head = NULL;
+    arena->allocated = 0;
+}
+
+
+void arena_reset(arena* arena)
+{
+    if (arena->head == NULL)
+        return;
+
+    arena_block* block = arena->head->next;
+
+    while (block != NULL)
+    {
+        arena_block* next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arena->head->next = NULL;
+    arena->head->used = 0;
+    arena->allocated = 0;
+}
+
+
+// Allocates a new block to the head of the block list. The block header and
+// its data are allocated with a single allocation.
+static arena_block* arena_block_new(arena* arena, size_t capacity)
+{
+    arena_block* block = xmalloc(sizeof (arena_block) + capacity + ARENA_ALIGNMENT);
+    block->next = arena->head;
+    block->capacity = capacity + ARENA_ALIGNMENT;
+    block->used = 0;
+    block->data = (unsigned char*)(block + 1);
+
+    arena->head = block;
+
+    return block;
+}
+
+
+void* arena_alloc(arena* arena, size_t bytes)
+{
+    arena_block* block = arena->head;
+    uintptr_t address;
+    size_t padding = 0;
+
+    if (block != NULL)
+    {
+        address = (uintptr_t)(block->data + block->used);
+        padding = (ARENA_ALIGNMENT - (address % ARENA_ALIGNMENT)) % ARENA_ALIGNMENT;
+    }
+
+    if (block == NULL || block->used + padding + bytes > block->capacity)
+    {
+        // NOTE(timo): Allocations bigger than the default block size will get
+        // a block of their own
+        block = arena_block_new(arena, bytes > arena->block_size ? bytes : arena->block_size);
+        address = (uintptr_t)block->data;
+        padding = (ARENA_ALIGNMENT - (address % ARENA_ALIGNMENT)) % ARENA_ALIGNMENT;
+    }
+
+    void* pointer = block->data + block->used + padding;
+    block->used += padding + bytes;
+    arena->allocated += bytes;
+
+    return pointer;
+}
+
+
+void* arena_calloc(arena* arena, size_t length, size_t size)
+{
+    void* pointer = arena_alloc(arena, length * size);
+    memset(pointer, 0, length * size);
+
+    return pointer;
+}
+
+
+char* arena_str_copy(arena* arena, const char* str, size_t length)
+{
+    char* copy = arena_alloc(arena, length + 1);
+    memcpy(copy, str, length);
+    copy[length] = 0;
+
+    return copy;
+}
+
+
+void arena_merge(arena* arena, struct arena* other)
+{
+    if (other->head == NULL)
+        return;
+
+    arena_block* last = other->head;
+
+    while (last->next != NULL)
+        last = last->next;
+
+    // NOTE(timo): The blocks are linked after the head of the arena, so the
+    // allocations still continue from the current block of the arena
+    if (arena->head == NULL)
+        arena->head = other->head;
+    else
+    {
+        last->next = arena->head->next;
+        arena->head->next = other->head;
+    }
+
+    arena->allocated += other->allocated;
+
+    other->head = NULL;
+    other->allocated = 0;
+}
@@ -28,4 +28,49 @@ void* xcalloc(size_t length, size_t size);
 void* xrealloc(void* pointer, size_t bytes);
 
 
+//  Arena (region) allocator. Memory is handed out by bumping a pointer inside
+//  big blocks and everything allocated from the arena is released at once with
+//  arena_free(). Each compilation phase owns its own arena (tokens, AST, 
+//  symbols, instructions) so the objects don't have to be freed one by one.
+//
+//  The arena never moves the memory it has given out, so pointers to the
+//  allocated objects stay valid until the whole arena is released.
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 16
+
+typedef struct arena_block arena_block;
+typedef struct arena arena;
+
+struct arena_block
+{
+    arena_block* next;
+    size_t capacity;
+    size_t used;
+    unsigned char* data;
+};
+
+struct arena
+{
+    arena_block* head;
+    size_t block_size;
+    size_t allocated;
+};
+
+void arena_init(arena* arena, size_t block_size);
+void arena_free(arena* arena);
+void* arena_alloc(arena* arena, size_t bytes);
+void* arena_calloc(arena* arena, size_t length, size_t size);
+char* arena_str_copy(arena* arena, const char* str, size_t length);
+
+//  Releases everything allocated from the arena but keeps the newest block for
+//  the next allocations, so an arena reused again and again doesn't have to
+//  allocate a new block every time.
+void arena_reset(arena* arena);
+
+//  Moves all the memory of the other arena into the arena, e.g. when the parts
+//  of a tree are allocated from their own arenas in different threads. The 
+//  other arena is left empty.
+void arena_merge(arena* arena, struct arena* other);
+
+
 #endif
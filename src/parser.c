@@ -20,6 +20,17 @@
 // Date: 2021/05/12
 
 #include "t.h"
+#include <pthread.h>    // for threads of the parallel parsing
+#include <unistd.h>     // for sysconf
+
+
+// Maximum number of threads used for the parallel parsing.
+#define PARSER_MAX_THREADS 16
+
+
+// Temporary list of nodes collected while parsing. Most of the lists are short,
+// so they fit into the small buffer in the stack and don't allocate anything.
+TYPED_ARRAY(Node_List, node_list, void*)
 
 
 static AST_Statement* parse_block_statement(Parser* parser);
@@ -27,21 +38,65 @@ static AST_Statement* parse_return_statement(Parser* parser);
 static inline void advance(Parser* parser);
 
 
-void parser_init(Parser* parser, array* tokens)
+void parser_init(Parser* parser, Token_Array* tokens)
 {
     *parser = (Parser){ .tokens = tokens,
+                        .lexer = NULL,
                         .index = 0,
-                        .position.line_end = 1,
-                        .position.column_end = 1,
                         .diagnostics = array_init(sizeof (Diagnostic*)),
                         .declarations = array_init(sizeof (AST_Declaration*)) };
 
+    arena_init(&parser->arena, ARENA_BLOCK_SIZE);
+
     // NOTE(timo): This sets the initial first token as current token 
     // and advances the pointer for the peek function
     advance(parser);
 }
 
 
+void parser_init_streaming(Parser* parser, Lexer* lexer)
+{
+    *parser = (Parser){ .tokens = NULL,
+                        .lexer = lexer,
+                        .index = 0,
+                        .diagnostics = array_init(sizeof (Diagnostic*)),
+                        .declarations = array_init(sizeof (AST_Declaration*)) };
+
+    arena_init(&parser->arena, ARENA_BLOCK_SIZE);
+
+    // NOTE(timo): The first token is pulled here, so the advance can always
+    // assume that the token at the index is already pulled
+    parser->lookahead[0] = next_token(lexer);
+    advance(parser);
+}
+
+
+// Moves the items of a temporary list into the parsers arena, so the lists
+// inside the AST nodes are released together with the nodes themselves. The
+// temporary list is freed and the returned list should not be pushed to.
+//
+// Arguments
+//      parser: Pointer to initialized Parser.
+//      list: Temporary list of nodes collected while parsing.
+// Returns
+//      Pointer to the list allocated from the arena.
+static array* arena_list(Parser* parser, Node_List* list)
+{
+    array* result = arena_alloc(&parser->arena, sizeof (array));
+    result->items = arena_alloc(&parser->arena, sizeof (void*) * list->length);
+    result->length = list->length;
+    result->capacity = list->length;
+    result->item_size = sizeof (void*);
+
+    for (int i = 0; i < list->length; i++)
+        result->items[i] = list->items[i];
+
+    node_list_free(list);
+
+    return result;
+}
+
+
 void parser_free(Parser* parser)
 {
     for (int i = 0; i < parser->diagnostics->length; i++)
@@ -58,15 +113,13 @@ void parser_free(Parser* parser)
     // NOTE(timo): The array itself is set to NULL in the function
     array_free(parser->diagnostics);
 
-    for (int i = 0; i < parser->declarations->length; i++)
-    {
-        declaration_free(parser->declarations->items[i]);
-        parser->declarations->items[i] = NULL;
-    }
-    
     // NOTE(timo): The array itself is set to NULL in the function
     array_free(parser->declarations);
 
+    // NOTE(timo): The whole abstract syntax tree is released with the arena
+    arena_free(&parser->arena);
+    expression_table_free(&parser->expressions);
+
     // NOTE(timo): Tokens are being freed by the lexer and we dont 
     // free the parser since it is being initialized to the stack
     // at the top level function
@@ -143,7 +196,10 @@ static inline const Token* peek(const Parser* parser)
 {
     // NOTE(timo): Since the current token is always advanced after assigning it,
     // the peek needs to return the current pointer and not current + 1.
-    return (Token*)parser->tokens->items[parser->index];
+    if (parser->lexer)
+        return &parser->lookahead[parser->index & (PARSER_LOOKAHEAD - 1)];
+
+    return &parser->tokens->items[parser->index];
 }
 
 
@@ -154,10 +210,45 @@ static inline const Token* peek(const Parser* parser)
 //      parser: Pointer to a initialized Parser.
 static inline void advance(Parser* parser)
 {
+    if (parser->lexer)
+    {
+        // NOTE(timo): The end of file token stays as the current token
+        if (parser->current_token && parser->current_token->kind == TOKEN_EOF)
+            return;
+
+        // NOTE(timo): The next token is pulled right away for the peek. The
+        // ring buffer makes sure the current token stays valid meanwhile.
+        parser->current_token = &parser->lookahead[parser->index++ & (PARSER_LOOKAHEAD - 1)];
+        parser->lookahead[parser->index & (PARSER_LOOKAHEAD - 1)] = next_token(parser->lexer);
+        return;
+    }
+
     // NOTE(timo): This check is needed to make sure there actually is a 
     // current token all the time, at least the EoF token
     if (parser->index < parser->tokens->length)
-        parser->current_token = (Token*)parser->tokens->items[parser->index++];
+        parser->current_token = &parser->tokens->items[parser->index++];
+}
+
+
+// Keeps the token alive for the abstract syntax tree. When the tokens are 
+// pulled from the lexer, the token in the ring buffer will be overwritten 
+// soon, so it is copied into the arena with the rest of the tree. Tokens in
+// the token array live as long as the lexer, so they are used as is.
+//
+// Arguments
+//      parser: Pointer to a initialized Parser.
+//      token: Token to be kept.
+// Returns
+//      Pointer to the token which stays valid with the tree.
+static inline Token* keep_token(Parser* parser, Token* token)
+{
+    if (parser->lexer == NULL)
+        return token;
+
+    Token* kept = arena_alloc(&parser->arena, sizeof (Token));
+    *kept = *token;
+
+    return kept;
 }
 
 
@@ -224,7 +315,7 @@ static AST_Statement* parse_return_statement(Parser* parser)
     AST_Expression* value = parse_expression(parser);
     expect_token(parser, TOKEN_SEMICOLON, ";", false);
 
-    return return_statement(value);
+    return return_statement(&parser->arena, value);
 }
 
 
@@ -243,12 +334,16 @@ static AST_Statement* parse_block_statement(Parser* parser)
     // any statement to if and while statements and to function expressions
     expect_token(parser, TOKEN_LEFT_CURLYBRACE, "{", false);
 
-    array* statements = array_init(sizeof (AST_Statement*));
+    Node_List list;
+    node_list_init(&list, 0);
+    bool declared = false;
 
     while (parser->current_token->kind != TOKEN_RIGHT_CURLYBRACE && 
            parser->current_token->kind != TOKEN_EOF)
     {
-        array_push(statements, parse_statement(parser));
+        AST_Statement* statement = parse_statement(parser);
+        declared = declared || statement->kind == STATEMENT_DECLARATION;
+        node_list_push(&list, statement);
 
         if (parser->panic) 
             panic_mode(parser);
@@ -256,7 +351,14 @@ static AST_Statement* parse_block_statement(Parser* parser)
 
     expect_token(parser, TOKEN_RIGHT_CURLYBRACE, "}", true);
 
-    return block_statement(statements, statements->length);
+    // NOTE(timo): The variables after the block refer to the names declared
+    // outside of it again, so the shared expressions can't be used anymore
+    if (parser->share && declared)
+        expression_table_clear(&parser->expressions);
+
+    array* statements = arena_list(parser, &list);
+
+    return block_statement(&parser->arena, statements, statements->length);
 }
 
 
@@ -274,7 +376,7 @@ static AST_Statement* parse_expression_statement(Parser* parser)
     AST_Expression* expression = parse_expression(parser);
     expect_token(parser, TOKEN_SEMICOLON, ";", true);
 
-    return expression_statement(expression);
+    return expression_statement(&parser->arena, expression);
 }
 
 
@@ -291,8 +393,15 @@ static AST_Statement* parse_declaration_statement(Parser* parser)
 {
     AST_Declaration* declaration = parse_declaration(parser);
     // NOTE(timo): The closing semicolon is handled while parsing the declaration
+
+    // NOTE(timo): If the name was already used, the variables after the 
+    // declaration refer to the new local variable instead of the one with the
+    // same name before it, so the shared expressions can't be used anymore
+    if (parser->share && 
+        expression_table_get(&parser->expressions, EXPRESSION_VARIABLE, declaration->identifier, NULL, NULL))
+        expression_table_clear(&parser->expressions);
     
-    return declaration_statement(declaration);
+    return declaration_statement(&parser->arena, declaration);
 }
 
 
@@ -321,7 +430,7 @@ static AST_Statement* parse_if_statement(Parser* parser)
         _else = parse_statement(parser);
     }
 
-    return if_statement(condition, then, _else);
+    return if_statement(&parser->arena, condition, then, _else);
 }
 
 
@@ -341,7 +450,7 @@ static AST_Statement* parse_while_statement(Parser* parser)
     expect_token(parser, TOKEN_DO, "do", false);
     AST_Statement* body = parse_statement(parser);
 
-    return while_statement(condition, body);
+    return while_statement(&parser->arena, condition, body);
 }
 
 
@@ -359,7 +468,7 @@ static AST_Statement* parse_break_statement(Parser* parser)
     advance(parser); // skip the keyword
     expect_token(parser, TOKEN_SEMICOLON, ";", false);
 
-    return break_statement();
+    return break_statement(&parser->arena);
 }
 
 
@@ -377,7 +486,7 @@ static AST_Statement* parse_continue_statement(Parser* parser)
     advance(parser); // skip the keyword
     expect_token(parser, TOKEN_SEMICOLON, ";", false);
 
-    return continue_statement();
+    return continue_statement(&parser->arena);
 }
 
 
@@ -425,18 +534,19 @@ AST_Statement* parse_statement(Parser* parser)
 //      Pointer to array of parameters.
 static array* parse_parameter_list(Parser* parser)
 {
-    array* parameters = array_init(sizeof (Parameter*));
+    Node_List parameters;
+    node_list_init(&parameters, 0);
     
     while (parser->current_token->kind != TOKEN_RIGHT_PARENTHESIS &&
            parser->current_token->kind != TOKEN_EOF)
     {
-        Token* identifier = parser->current_token;
+        Token* identifier = keep_token(parser, parser->current_token);
         advance(parser);
 
         expect_token(parser, TOKEN_COLON, ":", false);
 
         Type_Specifier specifier = parse_type_specifier(parser);
-        array_push(parameters, function_parameter(identifier, specifier));
+        node_list_push(&parameters, function_parameter(&parser->arena, identifier, specifier));
 
         // Comma is kept at the end, so we don't have to care about trailing commas.
         // TODO(timo): But what if there is multiple of them? Then this doesn't
@@ -445,363 +555,839 @@ static array* parse_parameter_list(Parser* parser)
             advance(parser);
     }
 
-    return parameters;
+    return arena_list(parser, &parameters);
 }
 
 
-// Parses a primary expression based on the grammar.
-//
-// EBNF grammar:
-//      primary         = '(' expression ')'
-//                      | function
-//                      | literal ;
-//      function        = '(' parameter_list? ')' '=>' statement ';'
-//      parameter_list  = IDENTIFIER ':' type_specifier ( ',' IDENTIFIER ':' type_specifier )* ;
-//      type_specifier  = 'int' | 'bool' ;
-//      literal         = IDENTIFIER
-//                      | INTEGER
-//                      | BOOLEAN ;
+// Pre-scan of a skipped function body. The tokens of the body are checked 
+// against the grammar without building the tree, so the syntax errors of the
+// body are found without parsing it.
 //
-// Arguments
-//      parser: Pointer to initialized Parser.
-// Returns
-//      Pointer to the newly created expression.
-static AST_Expression* primary(Parser* parser)
+// Members
+//      parser: Parser pulling the tokens of the body from the lexer.
+//      lazy: Skipped body whose range is extended with each token.
+typedef struct Body_Scan
 {
-    AST_Expression* expression;
+    Parser* parser;
+    Lazy_Body* lazy;
+} Body_Scan;
 
-    switch (parser->current_token->kind)
-    {
-        case TOKEN_INTEGER_LITERAL:
-        case TOKEN_BOOLEAN_LITERAL:
-        {
-            expression = literal_expression(parser->current_token);
-            advance(parser);
-            break;
-        }
-        case TOKEN_IDENTIFIER:
-        {
-            expression = variable_expression(parser->current_token);
-            advance(parser);
-            break;
-        }
-        case TOKEN_LEFT_PARENTHESIS:
-        {
-            advance(parser);
-
-            // Function expression
-            if ((parser->current_token->kind == TOKEN_IDENTIFIER && peek(parser)->kind == TOKEN_COLON) ||
-                 parser->current_token->kind == TOKEN_RIGHT_PARENTHESIS)
-            {
-                array* parameters = parse_parameter_list(parser);
-                
-                expect_token(parser, TOKEN_RIGHT_PARENTHESIS, ")", true);
-                expect_token(parser, TOKEN_ARROW, "=>", false);
-
-                AST_Statement* body = parse_statement(parser);
-                expression = function_expression(parameters, parameters->length, body);
-            }
-            else // Ordinary parenthesized expression
-            {
-                expression = parse_expression(parser);
-                expect_token(parser, TOKEN_RIGHT_PARENTHESIS, ")", true);
-            }
-            
-            break;
-        }
-        default:
-        {
-            Diagnostic* _diagnostic = diagnostic(
-                DIAGNOSTIC_ERROR, parser->current_token->position, 
-                ":PARSER - SyntaxError: Invalid token '%s' in primary expression",
-                // ":PARSER - SyntaxError: Expected expression.",
-                parser->current_token->lexeme);
-            array_push(parser->diagnostics, _diagnostic); 
-            parser->panic = true;
-
-            expression = error_expression();
-            advance(parser);
-        }
-    }
 
-    return expression;
-}
+static bool scan_statement(Body_Scan* scan);
 
 
-// Parses a call and subscript expressions based on the grammar.
+// Skips the block of a function body. The body is pre-scanned for syntax 
+// errors and only the range of the body in the source is saved, so the body
+// can be parsed later with parse_function_body() if it is ever needed.
 //
-// EBNF grammar:
-//      call            = primary '(' arguments? ')' ;
-//      index           = primary '[' expression ']' ;
-//      arguments       = expression ( ',' expression )* ;
+// If the pre-scan finds an error, the lexer and the parser are moved back to
+// the start of the body. The body is then parsed right away like without the
+// skipping, so its errors are reported the same way whether it is used or not.
 //
 // Arguments
-//      parser: Pointer to initialized Parser.
+//      parser: Initialized parser pulling the tokens from the lexer.
 // Returns
-//      Pointer to the newly created expression.
-static AST_Expression* call(Parser* parser)
+//      Pointer to the saved range of the body or NULL if the body has to be
+//      parsed.
+static Lazy_Body* skip_function_body(Parser* parser)
 {
-    AST_Expression* expression = primary(parser);
+    assert(parser->lexer && parser->current_token->kind == TOKEN_LEFT_CURLYBRACE);
+
+    Lexer* lexer = parser->lexer;
+    const char* stream = lexer->stream;
+    int diagnostics = lexer->diagnostics->length;
+    int index = parser->index;
+    Token* current_token = parser->current_token;
+    Token lookahead[PARSER_LOOKAHEAD];
+
+    memcpy(lookahead, parser->lookahead, sizeof (lookahead));
+
+    Lazy_Body* lazy = arena_alloc(&parser->arena, sizeof (Lazy_Body));
+    lazy->source = lexer->source;
+    lazy->arena = &parser->arena;
+    lazy->position = parser->current_token->position;
+    lazy->share = parser->share;
 
-    if (parser->current_token->kind == TOKEN_LEFT_BRACKET)
+    Body_Scan scan = { .parser = parser, .lazy = lazy };
+
+    if (scan_statement(&scan))
+        return lazy;
+
+    // NOTE(timo): The errors of the lexer are reported again when the body 
+    // is lexed again
+    for (int i = diagnostics; i < lexer->diagnostics->length; i++)
     {
-        advance(parser);
-        AST_Expression* index = parse_expression(parser);
-        expect_token(parser, TOKEN_RIGHT_BRACKET, "]", true);
-        expression = index_expression(expression, index);
+        Diagnostic* diagnostic = lexer->diagnostics->items[i];
+        free((char*)diagnostic->message);
+        free(diagnostic);
     }
-    else if (parser->current_token->kind == TOKEN_LEFT_PARENTHESIS)
-    {
-        advance(parser);
-        array* arguments = array_init(sizeof (AST_Expression*));
-        // TODO(timo): Should probably check for end of file too
-        if (parser->current_token->kind != TOKEN_RIGHT_PARENTHESIS)
-        {
-            array_push(arguments, parse_expression(parser));
 
-            while (parser->current_token->kind == TOKEN_COMMA)
-            {
-                advance(parser);
-                array_push(arguments, parse_expression(parser));
-            }
-        }
-        
-        expect_token(parser, TOKEN_RIGHT_PARENTHESIS, ")", true);
-        expression = call_expression(expression, arguments);
-    }
+    lexer->diagnostics->length = diagnostics;
+    lexer->stream = stream;
+    parser->index = index;
+    parser->current_token = current_token;
+    memcpy(parser->lookahead, lookahead, sizeof (lookahead));
 
-    return expression;
+    return NULL;
 }
 
 
-// Parses a unary expression based on the grammar.
-//
-// EBNF grammar:
-//      unary           = ( 'not' | '-' | '+' ) unary
-//                      | call ;
-//
-// Arguments
-//      parser: Pointer to initialized Parser.
-// Returns
-//      Pointer to the newly created expression.
-static AST_Expression* unary(Parser* parser)
+AST_Statement* parse_function_body(AST_Expression* expression, array* diagnostics)
 {
-    if (parser->current_token->kind == TOKEN_MINUS || 
-        parser->current_token->kind == TOKEN_PLUS ||
-        parser->current_token->kind == TOKEN_NOT)
-    {
-        Token* _operator = parser->current_token;
-        advance(parser);
-        AST_Expression* operand = unary(parser);
+    assert(expression->kind == EXPRESSION_FUNCTION);
 
-        return unary_expression(_operator, operand);
-    }
+    Lazy_Body* lazy = expression->function.lazy;
+
+    if (lazy == NULL)
+        return expression->function.body;
+
+    Lexer lexer;
+    Parser parser;
+
+    lexer_init_range(&lexer, lazy->source, lazy->source + lazy->position.start, lazy->source + lazy->position.end + 1);
+    parser_init_streaming(&parser, &lexer);
+    parser.share = lazy->share;
+
+    AST_Statement* body = parse_block_statement(&parser);
 
-    return call(parser);
+    // NOTE(timo): The errors of the lexer were already reported when the 
+    // body was skipped, so only the errors of the parser are passed on
+    for (int i = 0; i < parser.diagnostics->length; i++)
+        array_push(diagnostics, parser.diagnostics->items[i]);
+
+    parser.diagnostics->length = 0;
+
+    // The body is owned by the arena of the original tree
+    arena_merge(lazy->arena, &parser.arena);
+    parser_free(&parser);
+    lexer_free(&lexer);
+
+    expression->function.body = body;
+    expression->function.lazy = NULL;
+
+    return body;
 }
 
 
-// Parses a binary expression based on the grammar.
-//
-// EBNF grammar:
-//      factor          = unary ( ( '/' | '*' ) unary )* ;
+// Creates a literal, variable, unary or binary expression. If the sharing of
+// the expressions is on and an identical expression is already created, the
+// existing expression is returned instead and the position is saved as its
+// occurrence.
 //
 // Arguments
-//      parser: Pointer to initialized Parser.
+//      parser: Initialized parser.
+//      kind: Kind of the expression.
+//      token: Literal or identifier of the leaves and operator of the rest.
+//      left: Operand of the unary and left operand of the binary expression.
+//      right: Right operand of the binary expression.
+//      position: Position of the expression in the source.
 // Returns
-//      Pointer to the newly created expression.
-static AST_Expression* factor(Parser* parser)
+//      Pointer to the expression.
+static AST_Expression* pure_expression(Parser* parser, Expression_Kind kind, Token* token, AST_Expression* left, AST_Expression* right, const Position position)
 {
-    AST_Expression* expression = unary(parser);
+    AST_Expression* expression = NULL;
 
-    while (parser->current_token->kind == TOKEN_MULTIPLY || 
-           parser->current_token->kind == TOKEN_DIVIDE)
+    if (parser->share && (expression = expression_table_get(&parser->expressions, kind, token, left, right)))
     {
-        Token* _operator = parser->current_token;
-        advance(parser);
-        AST_Expression* right = unary(parser);
-        expression = binary_expression(expression, _operator, right);
+        // NOTE(timo): The first occurrence is saved only when the expression
+        // is met again, so the expressions used once have no occurrences
+        if (expression->occurrences == NULL)
+            expression_add_occurrence(&parser->arena, expression, expression->position);
+
+        expression_add_occurrence(&parser->arena, expression, position);
+
+        return expression;
     }
 
+    switch (kind)
+    {
+        case EXPRESSION_LITERAL:
+            expression = literal_expression(&parser->arena, keep_token(parser, token));
+            break;
+        case EXPRESSION_VARIABLE:
+            expression = variable_expression(&parser->arena, keep_token(parser, token));
+            break;
+        case EXPRESSION_UNARY:
+            expression = unary_expression(&parser->arena, token, left);
+            break;
+        case EXPRESSION_BINARY:
+            expression = binary_expression(&parser->arena, left, token, right);
+            break;
+        default:
+            assert(false && "Only pure expressions can be shared");
+    }
+
+    // NOTE(timo): The operands may be shared, so the position is given
+    expression->position = position;
+
+    if (parser->share)
+        expression_table_put(&parser->expressions, expression);
+
     return expression;
 }
 
 
-// Parses a binary expression based on the grammar.
-//
-// EBNF grammar:
-//      term            = factor ( ( '+' | '-' ) factor )* ;
+// Binding powers of the infix operators from the loosest to the tightest.
+// The tokens which are not infix operators have the precedence of none, so
+// they end the expression.
+typedef enum Precedence
+{
+    PRECEDENCE_NONE,
+    PRECEDENCE_ASSIGNMENT,  // :=
+    PRECEDENCE_OR,          // or
+    PRECEDENCE_AND,         // and
+    PRECEDENCE_EQUALITY,    // == !=
+    PRECEDENCE_RELATION,    // < <= > >=
+    PRECEDENCE_TERM,        // + -
+    PRECEDENCE_FACTOR,      // * /
+} Precedence;
+
+
+static const Precedence precedences[TOKEN_KIND_COUNT] =
+{
+    [TOKEN_COLON_ASSIGN]        = PRECEDENCE_ASSIGNMENT,
+    [TOKEN_OR]                  = PRECEDENCE_OR,
+    [TOKEN_AND]                 = PRECEDENCE_AND,
+    [TOKEN_IS_EQUAL]            = PRECEDENCE_EQUALITY,
+    [TOKEN_NOT_EQUAL]           = PRECEDENCE_EQUALITY,
+    [TOKEN_LESS_THAN]           = PRECEDENCE_RELATION,
+    [TOKEN_LESS_THAN_EQUAL]     = PRECEDENCE_RELATION,
+    [TOKEN_GREATER_THAN]        = PRECEDENCE_RELATION,
+    [TOKEN_GREATER_THAN_EQUAL]  = PRECEDENCE_RELATION,
+    [TOKEN_PLUS]                = PRECEDENCE_TERM,
+    [TOKEN_MINUS]               = PRECEDENCE_TERM,
+    [TOKEN_MULTIPLY]            = PRECEDENCE_FACTOR,
+    [TOKEN_DIVIDE]              = PRECEDENCE_FACTOR,
+};
+
+
+// Expressions waiting on the explicit stack of the expression parser for the
+// expression being parsed to finish.
+typedef enum Pending_Kind
+{
+    PENDING_BINARY,         // Operators of a precedence and their operands
+    PENDING_ASSIGNMENT,     // Value of an assignment
+    PENDING_UNARY,          // Operand of a unary operator
+    PENDING_GROUPING,       // Parenthesized expression
+    PENDING_INDEX,          // Subscript of an index expression
+    PENDING_CALL,           // Argument of a call expression
+} Pending_Kind;
+
+
+// Pending expression on the explicit stack of the expression parser.
 //
-// Arguments
-//      parser: Pointer to initialized Parser.
-// Returns
-//      Pointer to the newly created expression.
-static AST_Expression* term(Parser* parser)
+// Members
+//      kind: Classification of the pending expression.
+//      precedence: Loosest precedence of the binary operators being parsed.
+//      expression: Left operand of the binary operator, target of the 
+//                  assignment, subscripted variable or the callee. For the
+//                  binary operators it is NULL until the first operand is
+//                  parsed.
+//      position: Position of the expression.
+//      _operator: Operator of the binary or unary expression. For the binary
+//                 operators it is NULL unless the right operand is pending.
+//      arguments: Index of the first argument of the call in the stack of
+//                 the parsed arguments.
+typedef struct Pending
 {
-    AST_Expression* expression = factor(parser);
+    Pending_Kind kind;
+    Precedence precedence;
+    AST_Expression* expression;
+    Position position;
+    Token* _operator;
+    int arguments;
+} Pending;
 
-    while (parser->current_token->kind == TOKEN_PLUS || 
-           parser->current_token->kind == TOKEN_MINUS)
-    {
-        Token* _operator = parser->current_token;
-        advance(parser);
-        AST_Expression* right = factor(parser);
-        expression = binary_expression(expression, _operator, right);
-    }
 
-    return expression;
-}
+TYPED_ARRAY(Pending_Stack, pending_stack, Pending)
 
 
-// Parses a binary expression based on the grammar.
-//
-// EBNF grammar:
-//      relation        = term ( ( '<' | '<=' | '>' | '>=' ) term )* ;
-//
-// Arguments
-//      parser: Pointer to initialized Parser.
-// Returns
-//      Pointer to the newly created expression.
-static AST_Expression* relation(Parser* parser)
+// States of the expression parser. Each state tells what was just parsed.
+typedef enum Parse_State
 {
-    AST_Expression* expression = term(parser);
+    STATE_OPERAND,          // Nothing, an operand is expected next
+    STATE_PRIMARY,          // Primary expression
+    STATE_UNARY,            // Unary expression, see the grammar below
+    STATE_BINARY,           // Operand of the binary operators on the top
+    STATE_EXPRESSION,       // Binary expression of the precedence on the top
+} Parse_State;
 
-    while (parser->current_token->kind == TOKEN_LESS_THAN || 
-           parser->current_token->kind == TOKEN_LESS_THAN_EQUAL ||
-           parser->current_token->kind == TOKEN_GREATER_THAN || 
-           parser->current_token->kind == TOKEN_GREATER_THAN_EQUAL)
-    {
-        Token* _operator = parser->current_token;
-        advance(parser);
-        AST_Expression* right = term(parser);
-        expression = binary_expression(expression, _operator, right);
-    }
 
-    return expression;
+static inline void push_binary(Pending_Stack* stack, const Precedence precedence)
+{
+    pending_stack_push(stack, (Pending){ .kind = PENDING_BINARY, .precedence = precedence });
 }
 
 
-// Parses a binary expression based on the grammar.
+// Moves the pre-scan to the next token of the body.
 //
-// EBNF grammar:
-//      equality        = relation ( ( '==' | '!=' ) relation )* ;
+// Arguments
+//      scan: Pre-scan of the body.
+static inline void scan_advance(Body_Scan* scan)
+{
+    scan->lazy->position.end = scan->parser->current_token->position.end;
+    advance(scan->parser);
+}
+
+
+// Checks that the current token is of the given kind and moves past it.
 //
 // Arguments
-//      parser: Pointer to initialized Parser.
+//      scan: Pre-scan of the body.
+//      kind: Expected token kind.
 // Returns
-//      Pointer to the newly created expression.
-static AST_Expression* equality(Parser* parser)
+//      Value true if the token was of the given kind, otherwise false.
+static inline bool scan_token(Body_Scan* scan, const Token_Kind kind)
 {
-    AST_Expression* expression = relation(parser);
+    if (scan->parser->current_token->kind != kind)
+        return false;
 
-    while (parser->current_token->kind == TOKEN_IS_EQUAL || 
-           parser->current_token->kind == TOKEN_NOT_EQUAL)
-    {
-        Token* _operator = parser->current_token;
-        advance(parser);
-        AST_Expression* right = relation(parser);
-        expression = binary_expression(expression, _operator, right);
-    }
+    scan_advance(scan);
 
-    return expression;
+    return true;
 }
 
 
-// Parses a binary expression based on the grammar.
+// Pre-scans an expression with the same states as parse_expression(), but
+// only the open parentheses and brackets are kept in the stack. 
 //
-// EBNF grammar:
-//      and             = equality ( 'and' equality )* ;
+// NOTE(timo): The pre-scan gives up on the expressions it doesn't check as
+// precisely as the parser, so the body is parsed to find out. These are the
+// function expressions and the assignments to anything else than a plain
+// variable, which are rare inside a function body.
 //
 // Arguments
-//      parser: Pointer to initialized Parser.
+//      scan: Pre-scan of the body.
 // Returns
-//      Pointer to the newly created expression.
-static AST_Expression* and(Parser* parser)
+//      Value true if no syntax errors were found, otherwise false.
+static bool scan_expression(Body_Scan* scan)
 {
-    AST_Expression* expression = equality(parser);
+    Parser* parser = scan->parser;
+    Pending_Stack stack;
+    Parse_State state = STATE_OPERAND;
+    bool clean = true;
+    bool start = true;
+    bool variable = false;
+
+    pending_stack_init(&stack, 0);
 
-    while (parser->current_token->kind == TOKEN_AND)
+    while (clean)
     {
-        Token* _operator = parser->current_token;
-        advance(parser);
-        AST_Expression* right = equality(parser);
-        expression = binary_expression(expression, _operator, right);
+        Token_Kind kind = parser->current_token->kind;
+
+        if (state == STATE_OPERAND)
+        {
+            bool unary = false;
+
+            while (parser->current_token->kind == TOKEN_MINUS || 
+                   parser->current_token->kind == TOKEN_PLUS ||
+                   parser->current_token->kind == TOKEN_NOT)
+            {
+                scan_advance(scan);
+                unary = true;
+            }
+
+            kind = parser->current_token->kind;
+            variable = kind == TOKEN_IDENTIFIER && start && ! unary;
+            start = false;
+            state = STATE_PRIMARY;
+
+            if (kind == TOKEN_INTEGER_LITERAL || kind == TOKEN_BOOLEAN_LITERAL || kind == TOKEN_IDENTIFIER)
+                scan_advance(scan);
+            else if (kind == TOKEN_LEFT_PARENTHESIS)
+            {
+                scan_advance(scan);
+
+                if ((parser->current_token->kind == TOKEN_IDENTIFIER && peek(parser)->kind == TOKEN_COLON) ||
+                     parser->current_token->kind == TOKEN_RIGHT_PARENTHESIS)
+                    clean = false;
+
+                pending_stack_push(&stack, (Pending){ .kind = PENDING_GROUPING });
+                state = STATE_OPERAND;
+                start = true;
+            }
+            else
+                clean = false;
+        }
+        else if (state == STATE_PRIMARY)
+        {
+            state = STATE_BINARY;
+
+            if (kind == TOKEN_LEFT_BRACKET || kind == TOKEN_LEFT_PARENTHESIS)
+            {
+                scan_advance(scan);
+                variable = false;
+
+                if (kind == TOKEN_LEFT_PARENTHESIS && scan_token(scan, TOKEN_RIGHT_PARENTHESIS))
+                    continue;
+
+                pending_stack_push(&stack, (Pending){ .kind = kind == TOKEN_LEFT_BRACKET ? PENDING_INDEX : PENDING_CALL });
+                state = STATE_OPERAND;
+                start = true;
+            }
+        }
+        else if (precedences[kind] == PRECEDENCE_ASSIGNMENT)
+        {
+            clean = variable;
+            scan_advance(scan);
+            state = STATE_OPERAND;
+            start = true;
+        }
+        else if (precedences[kind] != PRECEDENCE_NONE)
+        {
+            scan_advance(scan);
+            state = STATE_OPERAND;
+        }
+        else if (stack.length == 0)
+            break;
+        else
+        {
+            Pending_Kind pending = stack.items[--stack.length].kind;
+            variable = false;
+
+            if (pending == PENDING_CALL && kind == TOKEN_COMMA)
+            {
+                scan_advance(scan);
+                stack.length++;
+                state = STATE_OPERAND;
+                start = true;
+            }
+            else if (pending == PENDING_INDEX)
+                clean = scan_token(scan, TOKEN_RIGHT_BRACKET);
+            else
+            {
+                clean = scan_token(scan, TOKEN_RIGHT_PARENTHESIS);
+
+                // NOTE(timo): The parenthesized expression is a primary 
+                // expression, so it can be called or subscripted
+                if (pending == PENDING_GROUPING)
+                    state = STATE_PRIMARY;
+            }
+        }
     }
 
-    return expression;
+    pending_stack_free(&stack);
+
+    return clean;
 }
 
 
-// Parses a binary expression based on the grammar.
-//
-// EBNF grammar:
-//      or              = and ( 'or' and )* ;
+// Pre-scans a type specifier.
 //
 // Arguments
-//      parser: Pointer to initialized Parser.
+//      scan: Pre-scan of the body.
 // Returns
-//      Pointer to the newly created expression.
-static AST_Expression* or(Parser* parser)
+//      Value true if no syntax errors were found, otherwise false.
+static bool scan_type_specifier(Body_Scan* scan)
 {
-    AST_Expression* expression = and(parser);
-
-    while (parser->current_token->kind == TOKEN_OR)
-    {
-        Token* _operator = parser->current_token;
-        advance(parser);
-        AST_Expression* right = and(parser);
-        expression = binary_expression(expression, _operator, right);
-    }
+    if (scan_token(scan, TOKEN_INT) || scan_token(scan, TOKEN_BOOL))
+        return true;
 
-    return expression;
+    return scan_token(scan, TOKEN_LEFT_BRACKET) && scan_token(scan, TOKEN_INT) && 
+           scan_token(scan, TOKEN_RIGHT_BRACKET);
 }
 
 
-// Parses an assignment expression based on the grammar.
-//
-// EBNF grammar:
-//      assignment      = IDENTIFIER ':=' assignment
-//                      | or ;
+// Pre-scans a statement with the same grammar as parse_statement().
 //
 // Arguments
-//      parser: Pointer to initialized Parser.
+//      scan: Pre-scan of the body.
 // Returns
-//      Pointer to the newly created expression.
-static AST_Expression* assignment(Parser* parser)
+//      Value true if no syntax errors were found, otherwise false.
+static bool scan_statement(Body_Scan* scan)
 {
-    AST_Expression* expression = or(parser);
+    Parser* parser = scan->parser;
 
-    if (parser->current_token->kind == TOKEN_COLON_ASSIGN)
+    switch (parser->current_token->kind)
     {
-        advance(parser);
-        AST_Expression* value = assignment(parser);
+        case TOKEN_LEFT_CURLYBRACE:
+        {
+            scan_advance(scan);
 
-        if (expression->kind != EXPRESSION_VARIABLE)
+            while (parser->current_token->kind != TOKEN_RIGHT_CURLYBRACE && 
+                   parser->current_token->kind != TOKEN_EOF)
+            {
+                if (! scan_statement(scan))
+                    return false;
+            }
+
+            return scan_token(scan, TOKEN_RIGHT_CURLYBRACE);
+        }
+        case TOKEN_IF:
         {
-            Diagnostic* _diagnostic = diagnostic(
-                DIAGNOSTIC_ERROR, expression->position, 
-                ":PARSER - SyntaxError: Invalid assignment target, expected a variable.");
-            array_push(parser->diagnostics, _diagnostic); 
-            // NOTE(timo): In case of invalid assignment target there is really no need
-            // for error recovery since we are already at the end of the expression.
+            scan_advance(scan);
+
+            if (! scan_expression(scan) || ! scan_token(scan, TOKEN_THEN) || ! scan_statement(scan))
+                return false;
+
+            return ! scan_token(scan, TOKEN_ELSE) || scan_statement(scan);
         }
+        case TOKEN_WHILE:
+            scan_advance(scan);
+            return scan_expression(scan) && scan_token(scan, TOKEN_DO) && scan_statement(scan);
+        case TOKEN_BREAK:
+        case TOKEN_CONTINUE:
+            scan_advance(scan);
+            return scan_token(scan, TOKEN_SEMICOLON);
+        case TOKEN_RETURN:
+            scan_advance(scan);
+            return scan_expression(scan) && scan_token(scan, TOKEN_SEMICOLON);
+        case TOKEN_IDENTIFIER:
+            if (peek(parser)->kind == TOKEN_COLON)
+            {
+                scan_advance(scan);
+                scan_advance(scan);
 
-        return assignment_expression(expression, value);
+                return scan_type_specifier(scan) && scan_token(scan, TOKEN_EQUAL) &&
+                       scan_expression(scan) && scan_token(scan, TOKEN_SEMICOLON);
+            }
+        default:
+            return scan_expression(scan) && scan_token(scan, TOKEN_SEMICOLON);
     }
-
-    return expression;
 }
 
 
+// Parses an expression based on the grammar.
+//
+// The expressions are parsed with precedence climbing, but instead of calling
+// the parsing functions recursively, the expressions waiting for their
+// operands are kept in an explicit stack. That way the long chains of
+// operators and the deeply nested parentheses don't use up the native stack.
+// Only the bodies of the function expressions are parsed recursively. The
+// trees and the diagnostics are the same as with the recursive descent.
+//
+// EBNF grammar:
+//      expression      = assignment ;
+//      assignment      = IDENTIFIER ':=' assignment
+//                      | or ;
+//      or              = and ( 'or' and )* ;
+//      and             = equality ( 'and' equality )* ;
+//      equality        = relation ( ( '==' | '!=' ) relation )* ;
+//      relation        = term ( ( '<' | '<=' | '>' | '>=' ) term )* ;
+//      term            = factor ( ( '+' | '-' ) factor )* ;
+//      factor          = unary ( ( '/' | '*' ) unary )* ;
+//      unary           = ( 'not' | '-' | '+' ) unary
+//                      | call ;
+//      call            = primary '(' arguments? ')' ;
+//      index           = primary '[' expression ']' ;
+//      arguments       = expression ( ',' expression )* ;
+//      primary         = '(' expression ')'
+//                      | function
+//                      | literal ;
+//      function        = '(' parameter_list? ')' '=>' statement ';'
+//      parameter_list  = IDENTIFIER ':' type_specifier ( ',' IDENTIFIER ':' type_specifier )* ;
+//      type_specifier  = 'int' | 'bool' ;
+//      literal         = IDENTIFIER
+//                      | INTEGER
+//                      | BOOLEAN ;
 AST_Expression* parse_expression(Parser* parser)
 {
-    return assignment(parser);
+    Pending_Stack stack;
+    Node_List arguments;
+    AST_Expression* expression = NULL;
+    Position position = { 0 };
+    Parse_State state = STATE_OPERAND;
+
+    pending_stack_init(&stack, 0);
+    node_list_init(&arguments, 0);
+    push_binary(&stack, PRECEDENCE_ASSIGNMENT);
+
+    while (true)
+    {
+        switch (state)
+        {
+            case STATE_OPERAND:
+            {
+                while (parser->current_token->kind == TOKEN_MINUS || 
+                       parser->current_token->kind == TOKEN_PLUS ||
+                       parser->current_token->kind == TOKEN_NOT)
+                {
+                    Token* _operator = keep_token(parser, parser->current_token);
+                    advance(parser);
+                    pending_stack_push(&stack, (Pending){ .kind = PENDING_UNARY, ._operator = _operator });
+                }
+
+                state = STATE_PRIMARY;
+
+                switch (parser->current_token->kind)
+                {
+                    case TOKEN_INTEGER_LITERAL:
+                    case TOKEN_BOOLEAN_LITERAL:
+                    {
+                        position = parser->current_token->position;
+                        expression = pure_expression(parser, EXPRESSION_LITERAL, parser->current_token, NULL, NULL, position);
+                        advance(parser);
+                        break;
+                    }
+                    case TOKEN_IDENTIFIER:
+                    {
+                        position = parser->current_token->position;
+                        expression = pure_expression(parser, EXPRESSION_VARIABLE, parser->current_token, NULL, NULL, position);
+                        advance(parser);
+                        break;
+                    }
+                    case TOKEN_LEFT_PARENTHESIS:
+                    {
+                        advance(parser);
+
+                        // Function expression
+                        if ((parser->current_token->kind == TOKEN_IDENTIFIER && peek(parser)->kind == TOKEN_COLON) ||
+                             parser->current_token->kind == TOKEN_RIGHT_PARENTHESIS)
+                        {
+                            array* parameters = parse_parameter_list(parser);
+                            
+                            expect_token(parser, TOKEN_RIGHT_PARENTHESIS, ")", true);
+                            expect_token(parser, TOKEN_ARROW, "=>", false);
+
+                            Lazy_Body* lazy = NULL;
+
+                            // NOTE(timo): The error recovery in progress may continue
+                            // into the body, so the body is parsed then
+                            if (parser->lazy && parser->lexer && ! parser->panic &&
+                                parser->current_token->kind == TOKEN_LEFT_CURLYBRACE)
+                                lazy = skip_function_body(parser);
+
+                            if (lazy)
+                            {
+                                expression = function_expression(&parser->arena, parameters, parameters->length, NULL);
+                                expression->function.lazy = lazy;
+                            }
+                            else
+                            {
+                                // NOTE(timo): The parameters hide the names outside of the
+                                // function only inside of its body
+                                if (parser->share)
+                                    expression_table_clear(&parser->expressions);
+
+                                AST_Statement* body = parse_statement(parser);
+                                expression = function_expression(&parser->arena, parameters, parameters->length, body);
+
+                                if (parser->share)
+                                    expression_table_clear(&parser->expressions);
+                            }
+
+                            position = expression->position;
+                        }
+                        else // Ordinary parenthesized expression
+                        {
+                            pending_stack_push(&stack, (Pending){ .kind = PENDING_GROUPING });
+                            push_binary(&stack, PRECEDENCE_ASSIGNMENT);
+                            state = STATE_OPERAND;
+                        }
+                        
+                        break;
+                    }
+                    default:
+                    {
+                        Diagnostic* _diagnostic = diagnostic(
+                            DIAGNOSTIC_ERROR, parser->current_token->position, 
+                            ":PARSER - SyntaxError: Invalid token '%s' in primary expression",
+                            // ":PARSER - SyntaxError: Expected expression.",
+                            parser->current_token->lexeme);
+                        array_push(parser->diagnostics, _diagnostic); 
+                        parser->panic = true;
+
+                        expression = error_expression(&parser->arena);
+                        position = expression->position;
+                        advance(parser);
+                    }
+                }
+
+                break;
+            }
+            case STATE_PRIMARY:
+            {
+                // NOTE(timo): Only one call or subscript is parsed after the
+                // primary expression
+                if (parser->current_token->kind == TOKEN_LEFT_BRACKET)
+                {
+                    advance(parser);
+                    pending_stack_push(&stack, (Pending){ .kind = PENDING_INDEX, .expression = expression, .position = position });
+                    push_binary(&stack, PRECEDENCE_ASSIGNMENT);
+                    state = STATE_OPERAND;
+                }
+                else if (parser->current_token->kind == TOKEN_LEFT_PARENTHESIS)
+                {
+                    advance(parser);
+                    // TODO(timo): Should probably check for end of file too
+                    if (parser->current_token->kind != TOKEN_RIGHT_PARENTHESIS)
+                    {
+                        pending_stack_push(&stack, (Pending){ .kind = PENDING_CALL, .expression = expression, .position = position, .arguments = arguments.length });
+                        push_binary(&stack, PRECEDENCE_ASSIGNMENT);
+                        state = STATE_OPERAND;
+                    }
+                    else
+                    {
+                        expect_token(parser, TOKEN_RIGHT_PARENTHESIS, ")", true);
+                        Node_List list;
+                        node_list_init(&list, 0);
+                        expression = call_expression(&parser->arena, expression, arena_list(parser, &list));
+                        expression->position = position;
+                        state = STATE_UNARY;
+                    }
+                }
+                else
+                    state = STATE_UNARY;
+
+                break;
+            }
+            case STATE_UNARY:
+            {
+                Pending* top = &stack.items[stack.length - 1];
+
+                if (top->kind == PENDING_UNARY)
+                {
+                    position = (Position){ .start = top->_operator->position.start, .end = position.end };
+                    expression = pure_expression(parser, EXPRESSION_UNARY, top->_operator, expression, NULL, position);
+                    pending_stack_pop(&stack);
+                }
+                else
+                {
+                    assert(top->kind == PENDING_BINARY && top->expression == NULL);
+                    top->expression = expression;
+                    top->position = position;
+                    state = STATE_BINARY;
+                }
+
+                break;
+            }
+            case STATE_BINARY:
+            {
+                Pending* top = &stack.items[stack.length - 1];
+                const Precedence current = precedences[parser->current_token->kind];
+
+                if (current < top->precedence)
+                {
+                    expression = top->expression;
+                    position = top->position;
+                    pending_stack_pop(&stack);
+                    state = STATE_EXPRESSION;
+                }
+                else if (current == PRECEDENCE_ASSIGNMENT)
+                {
+                    // NOTE(timo): The assignment is right associative, so the
+                    // value is parsed with the same precedence
+                    advance(parser);
+                    top->kind = PENDING_ASSIGNMENT;
+                    push_binary(&stack, PRECEDENCE_ASSIGNMENT);
+                    state = STATE_OPERAND;
+                }
+                else
+                {
+                    // NOTE(timo): The binary operators are left associative, so 
+                    // the right operand is parsed with one level tighter precedence
+                    top->_operator = keep_token(parser, parser->current_token);
+                    advance(parser);
+                    push_binary(&stack, current + 1);
+                    state = STATE_OPERAND;
+                }
+
+                break;
+            }
+            case STATE_EXPRESSION:
+            {
+                if (stack.length == 0)
+                {
+                    pending_stack_free(&stack);
+                    node_list_free(&arguments);
+                    parser->position = position;
+
+                    return expression;
+                }
+
+                Pending* top = &stack.items[stack.length - 1];
+
+                switch (top->kind)
+                {
+                    case PENDING_BINARY:
+                    {
+                        top->position.end = position.end;
+                        top->expression = pure_expression(parser, EXPRESSION_BINARY, top->_operator, top->expression, expression, top->position);
+                        top->_operator = NULL;
+                        state = STATE_BINARY;
+                        break;
+                    }
+                    case PENDING_ASSIGNMENT:
+                    {
+                        AST_Expression* target = top->expression;
+                        Position target_position = top->position;
+                        pending_stack_pop(&stack);
+
+                        if (target->kind != EXPRESSION_VARIABLE)
+                        {
+                            Diagnostic* _diagnostic = diagnostic(
+                                DIAGNOSTIC_ERROR, target_position, 
+                                ":PARSER - SyntaxError: Invalid assignment target, expected a variable.");
+                            array_push(parser->diagnostics, _diagnostic); 
+                            // NOTE(timo): In case of invalid assignment target there is really no need
+                            // for error recovery since we are already at the end of the expression.
+                        }
+
+                        expression = assignment_expression(&parser->arena, target, expression);
+                        expression->position = position = (Position){ .start = target_position.start, .end = position.end };
+                        break;
+                    }
+                    case PENDING_GROUPING:
+                    {
+                        pending_stack_pop(&stack);
+                        expect_token(parser, TOKEN_RIGHT_PARENTHESIS, ")", true);
+                        state = STATE_PRIMARY;
+                        break;
+                    }
+                    case PENDING_INDEX:
+                    {
+                        AST_Expression* variable = top->expression;
+                        Position variable_position = top->position;
+                        pending_stack_pop(&stack);
+                        expect_token(parser, TOKEN_RIGHT_BRACKET, "]", true);
+                        expression = index_expression(&parser->arena, variable, expression);
+                        expression->position = position = (Position){ .start = variable_position.start, .end = position.end };
+                        state = STATE_UNARY;
+                        break;
+                    }
+                    case PENDING_CALL:
+                    {
+                        node_list_push(&arguments, expression);
+
+                        if (parser->current_token->kind == TOKEN_COMMA)
+                        {
+                            advance(parser);
+                            push_binary(&stack, PRECEDENCE_ASSIGNMENT);
+                            state = STATE_OPERAND;
+                            break;
+                        }
+
+                        AST_Expression* variable = top->expression;
+                        position = top->position;
+                        Node_List list;
+                        node_list_init(&list, arguments.length - top->arguments);
+
+                        for (int i = top->arguments; i < arguments.length; i++)
+                            node_list_push(&list, arguments.items[i]);
+
+                        arguments.length = top->arguments;
+                        pending_stack_pop(&stack);
+
+                        expect_token(parser, TOKEN_RIGHT_PARENTHESIS, ")", true);
+                        expression = call_expression(&parser->arena, variable, arena_list(parser, &list));
+                        expression->position = position;
+                        state = STATE_UNARY;
+                        break;
+                    }
+                    default:
+                        assert(false);
+                }
+
+                break;
+            }
+        }
+    }
 }
 
 
 AST_Declaration* parse_declaration(Parser* parser)
 {
-    Token* identifier = parser->current_token;
+    Token* identifier = keep_token(parser, parser->current_token);
 
     expect_token(parser, TOKEN_IDENTIFIER, "identifier", true);
     expect_token(parser, TOKEN_COLON, ":", true);
@@ -811,25 +1397,207 @@ AST_Declaration* parse_declaration(Parser* parser)
     expect_token(parser, TOKEN_EQUAL, "=", true);
     
     AST_Expression* initializer = parse_expression(parser);
+    Position position = { .start = identifier->position.start, .end = parser->position.end };
+    AST_Declaration* declaration;
 
     expect_token(parser, TOKEN_SEMICOLON, ";", true);
 
     if (initializer->kind == EXPRESSION_FUNCTION)
-        return function_declaration(identifier, specifier, initializer);
+        declaration = function_declaration(&parser->arena, identifier, specifier, initializer);
     else
-        return variable_declaration(identifier, specifier, initializer);
+        declaration = variable_declaration(&parser->arena, identifier, specifier, initializer);
+
+    // NOTE(timo): The initializer may be shared, so the position is given
+    declaration->position = position;
+
+    return declaration;
+}
+
+
+AST_Declaration* parse_top_level_declaration(Parser* parser)
+{
+    // NOTE(timo): The expressions are shared only inside a declaration, since
+    // the same names mean different things in different functions
+    if (parser->share)
+        expression_table_clear(&parser->expressions);
+
+    AST_Declaration* declaration = parse_declaration(parser);
+        
+    if (parser->panic) 
+        panic_mode(parser);
+
+    return declaration;
 }
 
 
 void parse(Parser* parser)
 {
+    if (parser->tokens && parser->tokens->length - parser->index >= PARSER_PARALLEL_THRESHOLD)
+    {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+
+        if (processors > 1)
+        {
+            parse_parallel(parser, processors);
+            return;
+        }
+    }
+
     while (parser->current_token->kind != TOKEN_EOF)
+        array_push(parser->declarations, parse_top_level_declaration(parser));
+
+    assert(parser->current_token->kind == TOKEN_EOF);
+}
+
+
+// Parser of a single chunk of the token stream in the parallel parsing.
+//
+// Members
+//      parser: Parser of the chunk with its own arena and diagnostics.
+//      end: Index of the first token of the next chunk.
+//      stop: Index of the token the parser stopped at.
+typedef struct Parser_Chunk
+{
+    Parser parser;
+    int end;
+    int stop;
+} Parser_Chunk;
+
+
+// Parses the top level declarations of a single chunk. This is the entry
+// point of the threads in the parallel parsing.
+//
+// Arguments
+//      argument: Pointer to the Parser_Chunk.
+// Returns
+//      Always NULL.
+static void* parse_chunk(void* argument)
+{
+    Parser_Chunk* chunk = argument;
+    Parser* parser = &chunk->parser;
+
+    while (parser->current_token->kind != TOKEN_EOF && parser->index - 1 < chunk->end)
+        array_push(parser->declarations, parse_top_level_declaration(parser));
+
+    chunk->stop = parser->index - 1;
+
+    return NULL;
+}
+
+
+void parse_parallel(Parser* parser, int chunks)
+{
+    assert(parser->tokens != NULL);
+
+    Parser_Chunk parsers[PARSER_MAX_THREADS];
+    pthread_t threads[PARSER_MAX_THREADS];
+
+    const Token* tokens = parser->tokens->items;
+    const int start = parser->index - 1;
+    const int length = parser->tokens->length - start;
+    int count = 0;
+
+    if (chunks > PARSER_MAX_THREADS) chunks = PARSER_MAX_THREADS;
+    if (chunks < 1) chunks = 1;
+
+    // Split the token stream into chunks at the semicolons which are not
+    // inside any parentheses, brackets or curly braces. Those end the top 
+    // level declarations, so each chunk starts with a new declaration.
+    int chunk_start = start;
+    int depth = 0;
+
+    for (int i = start; i < start + length; i++)
     {
-        array_push(parser->declarations, parse_declaration(parser));
-        
-        if (parser->panic) 
-            panic_mode(parser);
+        switch (tokens[i].kind)
+        {
+            case TOKEN_LEFT_PARENTHESIS:
+            case TOKEN_LEFT_BRACKET:
+            case TOKEN_LEFT_CURLYBRACE:
+                depth++;
+                break;
+            case TOKEN_RIGHT_PARENTHESIS:
+            case TOKEN_RIGHT_BRACKET:
+            case TOKEN_RIGHT_CURLYBRACE:
+                if (depth > 0) depth--;
+                break;
+            default:
+                break;
+        }
+
+        bool boundary = tokens[i].kind == TOKEN_SEMICOLON && depth == 0 && 
+                        i + 1 - start >= (long)length * (count + 1) / chunks;
+
+        if ((boundary && count < chunks - 1) || tokens[i].kind == TOKEN_EOF)
+        {
+            Parser_Chunk* chunk = &parsers[count++];
+            
+            // NOTE(timo): All the chunks read the same token stream, so they
+            // can look ahead past the end of their chunk
+            parser_init(&chunk->parser, parser->tokens);
+            chunk->parser.share = parser->share;
+            chunk->parser.index = chunk_start;
+            advance(&chunk->parser);
+            chunk->end = i + 1;
+            chunk->stop = chunk_start;
+
+            chunk_start = i + 1;
+        }
+    }
+
+    // NOTE(timo): The first chunk is parsed by the calling thread itself
+    for (int i = 1; i < count; i++)
+    {
+        if (pthread_create(&threads[i], NULL, parse_chunk, &parsers[i]) != 0)
+        {
+            printf("Could not create a thread for parsing\n");
+            exit(1);
+        }
+    }
+
+    if (count > 0)
+        parse_chunk(&parsers[0]);
+
+    for (int i = 1; i < count; i++)
+        pthread_join(threads[i], NULL);
+
+    // Concatenate the declarations and the diagnostics of the chunks in the
+    // order of the chunks. If the error recovery took a chunk past its end,
+    // the next chunks started from a wrong place and they are thrown away.
+    int stop = start;
+    bool synchronized = true;
+
+    for (int i = 0; i < count; i++)
+    {
+        Parser* chunk = &parsers[i].parser;
+
+        if (synchronized)
+        {
+            for (int j = 0; j < chunk->declarations->length; j++)
+                array_push(parser->declarations, chunk->declarations->items[j]);
+
+            for (int j = 0; j < chunk->diagnostics->length; j++)
+                array_push(parser->diagnostics, chunk->diagnostics->items[j]);
+
+            // NOTE(timo): The declarations and the diagnostics were moved to
+            // the parser, so only the arrays holding them are released
+            chunk->declarations->length = 0;
+            chunk->diagnostics->length = 0;
+            arena_merge(&parser->arena, &chunk->arena);
+
+            stop = parsers[i].stop;
+            synchronized = stop == parsers[i].end;
+        }
+
+        parser_free(chunk);
     }
 
+    // NOTE(timo): The rest of the declarations are parsed serially from the
+    // place the last synchronized chunk stopped at
+    parser->index = stop;
+    advance(parser);
+
+    while (parser->current_token->kind != TOKEN_EOF)
+        array_push(parser->declarations, parse_top_level_declaration(parser));
+
     assert(parser->current_token->kind == TOKEN_EOF);
 }
@@ -1,26 +1,37 @@
 // Implementation for the resolver which does type checking and semantic
 // checking for the abstract syntax tree.
 //
-// At the moment, there is incomplete implementation for constant folding.
-// Resolver does the folding with number literals, but the folded values
-// are not actually used for anything. This decision has to be made in the
-// end, because some of the IR generator code and tests would've needed
-// big rewrite. So no constant folding for the time being.
+// The resolver also does the constant folding. The unary and binary expressions
+// with constant operands get their folded value, and the overflows and the
+// divisions by zero found while folding are reported. The IR generator emits
+// the folded values instead of the operations when the folding is enabled.
 //
 // Author: Timo Mehto
 // Date: 2021/05/12
 
 #include "t.h"
+#include <pthread.h>    // for threads of the parallel resolving
+#include <unistd.h>     // for sysconf
 
 #define INTEGER_MAX 2147483647
 #define INTEGER_MIN 2147483648 // absolute value
 
+// Minimum number of top level declarations for the parallel resolving. The
+// declarations of smaller programs are resolved faster than the threads are
+// started.
+#define RESOLVER_PARALLEL_THRESHOLD 64
+
+// Maximum number of threads used for the parallel resolving.
+#define RESOLVER_MAX_THREADS 16
+
 
 void resolver_init(Resolver* resolver, hashtable* type_table)
 {
     *resolver = (Resolver){ .global = scope_init(NULL, "global"),
                             .diagnostics = array_init(sizeof (Diagnostic*)),
                             .type_table = type_table,
+                            .deferred = hashtable_init_interned(0),
+                            .visible = -1,
                             .context.current_function = NULL,
                             .context.not_in_loop = true,
                             .context.not_in_function = true, 
@@ -46,6 +57,10 @@ void resolver_free(Resolver* resolver)
 
     array_free(resolver->diagnostics);
 
+    // NOTE(timo): The deferred declarations are owned by the parser
+    hashtable_free(resolver->deferred);
+    resolver->deferred = NULL;
+
     // NOTE(timo): Scopes are being freed at the later stage since they
     // are needed for code generation
     
@@ -93,6 +108,64 @@ static inline void leave_scope(Resolver* resolver)
 }
 
 
+// Declares the parameter or the variable into the current scope. The 
+// parameters and the local variables of a function get the next free slot in
+// the frame of the function. The global variables live outside of the frames.
+//
+// Arguments
+//      resolver: Pointer to initialized Resolver.
+//      symbol: Symbol of the parameter or the variable.
+static inline void declare_variable(Resolver* resolver, Symbol* symbol)
+{
+    if (resolver->local != resolver->global)
+        symbol->slot = resolver->local->frame_size++;
+
+    scope_declare(resolver->local, symbol);
+}
+
+
+static void resolve_deferred_function(Resolver* resolver, Symbol* symbol);
+static void resolve_used_function(Resolver* resolver, Symbol* symbol);
+
+
+// Finds the symbol from the current scope or from its enclosing scopes. The
+// identifier is recorded as a dependency of the declaration being resolved
+// whether the symbol is found or not, since declaring it later would change
+// the result too.
+//
+// Arguments
+//      resolver: Pointer to initialized Resolver.
+//      identifier: Interned identifier of the symbol.
+// Returns
+//      Pointer to the symbol if it is found, otherwise NULL.
+static inline Symbol* lookup_symbol(Resolver* resolver, const char* identifier)
+{
+    if (resolver->dependencies)
+        array_push(resolver->dependencies, (void*)identifier);
+
+    Symbol* symbol = scope_lookup(resolver->local, identifier);
+
+    // NOTE(timo): In the parallel resolving the globals declared after the
+    // function are already in the global scope, but they are not visible yet
+    if (symbol && resolver->visible >= 0 && symbol->scope == resolver->global && 
+        symbol->index >= resolver->visible)
+        return NULL;
+
+    // NOTE(timo): The body of a deferred function is resolved when the 
+    // function is used for the first time
+    if (symbol && symbol->state == STATE_UNRESOLVED)
+        resolve_deferred_function(resolver, symbol);
+
+    // NOTE(timo): In the parallel resolving the body of a used function is
+    // resolved first, so the type returned by it is known like in the serial
+    // resolving
+    if (symbol && resolver->pool && symbol->kind == SYMBOL_FUNCTION && symbol->scope == resolver->global)
+        resolve_used_function(resolver, symbol);
+
+    return symbol;
+}
+
+
 // Resolves type of a literal expression. Integer overflow of integer literal
 // will also be checked.
 //
@@ -112,34 +185,26 @@ static Type* resolve_literal_expression(Resolver* resolver, AST_Expression* expr
     {
         case TOKEN_INTEGER_LITERAL:
         {
-            const char* lexeme = literal->lexeme;
-            uint64_t integer_value = 0;
-
-            while (*lexeme != '\0') 
-            { 
-                // Converts ascii digit to corresponding number
-                int digit = *lexeme - '0';
-                integer_value *= 10; 
-                
-                // NOTE(timo): We can only check for the overflow of the literal in compile time, 
-                // rest of the expressions are being evaluated and therefore we cannot know the value.
-                // We just decieded that our maximum integer value is abs(2147483647)
-                if (integer_value > INT_MAX - digit)
-                {
-                    Diagnostic* _diagnostic = diagnostic(
-                        DIAGNOSTIC_ERROR, expression->position,
-                        ":RESOLVER - OverflowError: Integer overflow in integer literal. Maximum integer value is abs(2147483647)");
-                    array_push(resolver->diagnostics, _diagnostic);
-                    break;
-                }
+            // NOTE(timo): We can only check for the overflow of the literal in compile time, 
+            // rest of the expressions are being evaluated and therefore we cannot know the value.
+            // We just decieded that our maximum integer value is abs(2147483647). The lexer
+            // has already computed the value of the literal, so it is just compared here.
+            // NOTE(timo): The literal which overflows is not a constant at all,
+            // so it is never folded into the expressions using it
+            if (literal->integer > INT_MAX)
+            {
+                Diagnostic* _diagnostic = diagnostic(
+                    DIAGNOSTIC_ERROR, expression->position,
+                    ":RESOLVER - OverflowError: Integer overflow in integer literal. Maximum integer value is abs(2147483647)");
+                array_push(resolver->diagnostics, _diagnostic);
 
-                integer_value += digit;
-                lexeme++;
+                expression->value = (Value){ .type = VALUE_NONE };
             }
+            else
+                expression->value = (Value){ .type = VALUE_INTEGER, 
+                                             .integer = literal->integer };
             
             type = hashtable_get(resolver->type_table, "int");
-            expression->value = (Value){ .type = VALUE_INTEGER, 
-                                         .integer = integer_value };
             break;
         }
         case TOKEN_BOOLEAN_LITERAL:
@@ -175,110 +240,113 @@ static Type* resolve_literal_expression(Resolver* resolver, AST_Expression* expr
 }
 
 
-// Resolves type of a unary expression. If the unary expression is a literal,
-// also integer overflows will be checked.
+// Creates the operand of a folded integer constant. The integers of the
+// language are 32-bit, so the constant which doesn't fit into the range is 
+// reported as an overflow and the expression is left unfolded.
+//
+// Arguments
+//      resolver: Pointer to initialized Resolver.
+//      expression: Expression being folded.
+//      type: Resolved type of the expression.
+//      integer: Folded value of the expression.
+// Returns
+//      Operand with the folded value, or without a value if the value overflows.
+static Operand fold_integer(Resolver* resolver, AST_Expression* expression, Type* type, int64_t integer)
+{
+    if (integer > INTEGER_MAX || integer < -INTEGER_MIN)
+    {
+        Diagnostic* _diagnostic = diagnostic(
+            DIAGNOSTIC_ERROR, expression->position,
+            ":RESOLVER - OverflowError: Integer overflow in constant expression. Integer values are between -2147483648 and 2147483647");
+        array_push(resolver->diagnostics, _diagnostic);
+
+        return (Operand){ .type = type, .value = { .type = VALUE_NONE } };
+    }
+
+    return (Operand){ .type = type, .value = { .type = VALUE_INTEGER, .integer = integer } };
+}
+
+
+// Resolves type of a unary expression. If the operand is a constant, the
+// expression is folded and integer overflows will be checked. The operand is
+// already resolved.
 //
 // Arguments
 //      resolver: Pointer to initialized Resolver.
 //      expression: Expression to be resolved.
+//      operand: Resolved operand.
 // Returns
-//      Pointer to resolved type of the expression.
-static Type* resolve_unary_expression(Resolver* resolver, AST_Expression* expression)
+//      Resolved operand of the expression.
+static Operand resolve_unary_expression(Resolver* resolver, AST_Expression* expression, Operand operand)
 {
     assert(expression->kind == EXPRESSION_UNARY);
 
-    Type* type;
-    AST_Expression* operand = expression->unary.operand;
+    Operand result = { .value = { .type = VALUE_NONE } };
     Token* _operator = expression->unary._operator;
-    Type* operand_type = resolve_expression(resolver, operand);
 
     switch (_operator->kind)
     {
         case TOKEN_PLUS:
         {
-            if (type_is_integer(operand_type))
+            if (type_is_integer(operand.type))
             {
-                if (value_is_integer(operand->value))
-                {
-                    if (operand->value.integer > INTEGER_MAX)
-                    {
-                        Diagnostic* _diagnostic = diagnostic(
-                            DIAGNOSTIC_ERROR, expression->position,
-                            ":RESOLVER - OverflowError: Integer overflow in integer literal. Maximum integer value is 2147483647");
-                        array_push(resolver->diagnostics, _diagnostic);
-                        break;
-                    }
-                    
-                    expression->value = (Value){ .type = VALUE_INTEGER,
-                                                 .integer = +operand->value.integer };
-                }
+                result.type = operand.type;
 
-                type = operand_type;
+                if (value_is_integer(operand.value))
+                    result = fold_integer(resolver, expression, operand.type, +operand.value.integer);
             }
             else
             {
                 Diagnostic* _diagnostic = diagnostic(
                     DIAGNOSTIC_ERROR, expression->position,
                     ":RESOLVER - TypeError: Unsupported operand type '%s' for unary '+'",
-                    type_as_string(operand_type->kind));
+                    type_as_string(operand.type->kind));
                 array_push(resolver->diagnostics, _diagnostic);
 
-                type = hashtable_get(resolver->type_table, "none");
+                result.type = hashtable_get(resolver->type_table, "none");
             }
             break;
         }
         case TOKEN_MINUS:
         {
-            if (type_is_integer(operand_type))
+            if (type_is_integer(operand.type))
             {
-                if (value_is_integer(operand->value))
-                {
-                    if (operand->value.integer > INTEGER_MIN)
-                    {
-                        Diagnostic* _diagnostic = diagnostic(
-                            DIAGNOSTIC_ERROR, expression->position,
-                            ":RESOLVER - OverflowError: Integer overflow in integer literal. Minimum integer value is -2147483648");
-                        array_push(resolver->diagnostics, _diagnostic);
-                        break;
-                    }
+                result.type = operand.type;
 
-                    expression->value = (Value){ .type = VALUE_INTEGER,
-                                                 .integer = -operand->value.integer };
-                }
-
-                type = operand_type;
+                if (value_is_integer(operand.value))
+                    result = fold_integer(resolver, expression, operand.type, -operand.value.integer);
             }
             else
             {
                 Diagnostic* _diagnostic = diagnostic(
                     DIAGNOSTIC_ERROR, expression->position,
                     ":RESOLVER - TypeError: Unsupported operand type '%s' for unary '-'",
-                    type_as_string(operand_type->kind));
+                    type_as_string(operand.type->kind));
                 array_push(resolver->diagnostics, _diagnostic);
 
-                type = hashtable_get(resolver->type_table, "none");
+                result.type = hashtable_get(resolver->type_table, "none");
             }
             break;
         }
         case TOKEN_NOT:
         {
-            if (type_is_boolean(operand_type))
+            if (type_is_boolean(operand.type))
             {
-                if (value_is_boolean(operand->value))
-                    expression->value = (Value){ .type = VALUE_BOOLEAN,
-                                                 .boolean = ! operand->value.boolean };
+                result.type = operand.type;
 
-                type = operand_type;
+                if (value_is_boolean(operand.value))
+                    result.value = (Value){ .type = VALUE_BOOLEAN,
+                                            .boolean = ! operand.value.boolean };
             }
             else
             {
                 Diagnostic* _diagnostic = diagnostic(
                     DIAGNOSTIC_ERROR, expression->position,
                     ":RESOLVER - TypeError: Unsupported operand type '%s' for unary 'not'",
-                    type_as_string(operand_type->kind));
+                    type_as_string(operand.type->kind));
                 array_push(resolver->diagnostics, _diagnostic);
 
-                type = hashtable_get(resolver->type_table, "none");
+                result.type = hashtable_get(resolver->type_table, "none");
             }
             break;
         }
@@ -290,33 +358,36 @@ static Type* resolve_unary_expression(Resolver* resolver, AST_Expression* expres
                 _operator->lexeme);
             array_push(resolver->diagnostics, _diagnostic);
 
-            type = hashtable_get(resolver->type_table, "none");
+            result.type = hashtable_get(resolver->type_table, "none");
             break;
         }
     }
 
-    expression->type = type;
+    expression->type = result.type;
+    expression->value = result.value;
 
-    return type;
+    return result;
 }
 
 
-// Resolves type of a binary expression.
+// Resolves type of a binary expression. If both of the operands are constants,
+// the expression is folded and integer overflows and divisions by zero will
+// be checked. The operands are already resolved.
 //
 // Arguments
 //      resolver: Pointer to initialized Resolver.
 //      expression: Expression to be resolved.
+//      left: Resolved left operand.
+//      right: Resolved right operand.
 // Returns
-//      Pointer to resolved type of the expression.
-static Type* resolve_binary_expression(Resolver* resolver, AST_Expression* expression)
+//      Resolved operand of the expression.
+static Operand resolve_binary_expression(Resolver* resolver, AST_Expression* expression, Operand left, Operand right)
 {
     assert(expression->kind == EXPRESSION_BINARY);
 
-    Type* type_left = resolve_expression(resolver, expression->binary.left);
-    Type* type_right = resolve_expression(resolver, expression->binary.right);
     Token* _operator = expression->binary._operator;
     
-    Type* type;
+    Operand result = { .value = { .type = VALUE_NONE } };
 
     switch (_operator->kind)
     {
@@ -325,55 +396,63 @@ static Type* resolve_binary_expression(Resolver* resolver, AST_Expression* expre
         case TOKEN_MULTIPLY:
         case TOKEN_DIVIDE:
         {
-            if (type_is_not_integer(type_left) || type_is_not_integer(type_right))
+            if (type_is_not_integer(left.type) || type_is_not_integer(right.type))
             {
                 Diagnostic* _diagnostic = diagnostic(
                     DIAGNOSTIC_ERROR, expression->position,
                     ":RESOLVER - TypeError: Unsupported operand types '%s' and '%s' for binary '%s'",
-                    type_as_string(type_left->kind), type_as_string(type_right->kind), _operator->lexeme);
+                    type_as_string(left.type->kind), type_as_string(right.type->kind), _operator->lexeme);
                 array_push(resolver->diagnostics, _diagnostic);
 
-                type = hashtable_get(resolver->type_table, "none");
+                result.type = hashtable_get(resolver->type_table, "none");
             }
             else
             {
-                Value value_left = expression->binary.left->value;
-                Value value_right = expression->binary.right->value;
+                result.type = left.type;
 
                 // If both values are integers => they are integer constants and
-                // we can do some constant folding.
-                if (value_is_integer(value_left) && value_is_integer(value_right))
+                // we can do some constant folding. The constants are always 
+                // 32-bit, since the literals and the folded values which 
+                // overflow are not constants, so the 64-bit arithmetic can't
+                // overflow before the check.
+                if (value_is_integer(left.value) && value_is_integer(right.value))
                 {
+                    int64_t value_left = left.value.integer;
+                    int64_t value_right = right.value.integer;
+
                     switch (_operator->kind)
                     {
                         case TOKEN_PLUS:
                         {
-                            expression->value = (Value){ .type = VALUE_INTEGER,
-                                                         .integer = value_left.integer + value_right.integer };
+                            result = fold_integer(resolver, expression, result.type, value_left + value_right);
                             break;
                         }
                         case TOKEN_MINUS:
                         {
-                            expression->value = (Value){ .type = VALUE_INTEGER,
-                                                         .integer = value_left.integer - value_right.integer };
+                            result = fold_integer(resolver, expression, result.type, value_left - value_right);
                             break;
                         }
                         case TOKEN_MULTIPLY:
                         {
-                            expression->value = (Value){ .type = VALUE_INTEGER,
-                                                         .integer = value_left.integer * value_right.integer };
+                            result = fold_integer(resolver, expression, result.type, value_left * value_right);
                             break;
                         }
                         case TOKEN_DIVIDE:
                         {
-                            expression->value = (Value){ .type = VALUE_INTEGER,
-                                                         .integer = value_left.integer / value_right.integer };
+                            if (value_right == 0)
+                            {
+                                Diagnostic* _diagnostic = diagnostic(
+                                    DIAGNOSTIC_ERROR, expression->position,
+                                    ":RESOLVER - ZeroDivisionError: Integer division by zero");
+                                array_push(resolver->diagnostics, _diagnostic);
+                                break;
+                            }
+
+                            result = fold_integer(resolver, expression, result.type, value_left / value_right);
                             break;
                         }
                     }
                 }
-
-                type = type_left;
             }
 
             break;
@@ -381,23 +460,23 @@ static Type* resolve_binary_expression(Resolver* resolver, AST_Expression* expre
         case TOKEN_IS_EQUAL:
         case TOKEN_NOT_EQUAL:
         {
-            if ((type_is_integer(type_left) && type_is_not_integer(type_right)) ||
-                (type_is_boolean(type_left) && type_is_not_boolean(type_right)))
+            if ((type_is_integer(left.type) && type_is_not_integer(right.type)) ||
+                (type_is_boolean(left.type) && type_is_not_boolean(right.type)))
             {
                 Diagnostic* _diagnostic = diagnostic(
                     DIAGNOSTIC_ERROR, expression->position,
                     ":RESOLVER - TypeError: Unsupported operand types '%s' and '%s' for binary '%s'",
-                    type_as_string(type_left->kind), type_as_string(type_right->kind), _operator->lexeme);
+                    type_as_string(left.type->kind), type_as_string(right.type->kind), _operator->lexeme);
                 array_push(resolver->diagnostics, _diagnostic);
 
                 // TODO(timo): These none types create a lot of useless error messages in error situations
                 // so consider just removing them
-                type = hashtable_get(resolver->type_table, "none");
+                result.type = hashtable_get(resolver->type_table, "none");
             }
             else
             {
-                Value value_left = expression->binary.left->value;
-                Value value_right = expression->binary.right->value;
+                Value value_left = left.value;
+                Value value_right = right.value;
 
                 // If both values are booleans or both values are integers  => they 
                 // are constants and we can do some constant folding.
@@ -407,14 +486,14 @@ static Type* resolve_binary_expression(Resolver* resolver, AST_Expression* expre
                     {
                         case TOKEN_IS_EQUAL:
                         {
-                            expression->value = (Value){ .type = VALUE_BOOLEAN,
-                                                         .boolean = value_left.integer == value_right.integer};
+                            result.value = (Value){ .type = VALUE_BOOLEAN,
+                                                    .boolean = value_left.integer == value_right.integer};
                             break;
                         }
                         case TOKEN_NOT_EQUAL:
                         {
-                            expression->value = (Value){ .type = VALUE_BOOLEAN,
-                                                         .boolean = value_left.integer != value_right.integer};
+                            result.value = (Value){ .type = VALUE_BOOLEAN,
+                                                    .boolean = value_left.integer != value_right.integer};
                             break;
                         }
                     }
@@ -425,20 +504,20 @@ static Type* resolve_binary_expression(Resolver* resolver, AST_Expression* expre
                     {
                         case TOKEN_IS_EQUAL:
                         {
-                            expression->value = (Value){ .type = VALUE_BOOLEAN,
-                                                         .boolean = value_left.boolean == value_right.boolean };
+                            result.value = (Value){ .type = VALUE_BOOLEAN,
+                                                    .boolean = value_left.boolean == value_right.boolean };
                             break;
                         }
                         case TOKEN_NOT_EQUAL:
                         {
-                            expression->value = (Value){ .type = VALUE_BOOLEAN,
-                                                         .boolean = value_left.boolean != value_right.boolean };
+                            result.value = (Value){ .type = VALUE_BOOLEAN,
+                                                    .boolean = value_left.boolean != value_right.boolean };
                             break;
                         }
                     }
                 }
 
-                type = hashtable_get(resolver->type_table, "bool");
+                result.type = hashtable_get(resolver->type_table, "bool");
             }
 
             break;
@@ -450,22 +529,22 @@ static Type* resolve_binary_expression(Resolver* resolver, AST_Expression* expre
         {
             // Operand/values has to be scalar types e.g. integers in this 
             // case for the relational expression
-            if (type_is_not_integer(type_left) || type_is_not_integer(type_right))
+            if (type_is_not_integer(left.type) || type_is_not_integer(right.type))
             {
                 Diagnostic* _diagnostic = diagnostic(
                     DIAGNOSTIC_ERROR, expression->position,
                     ":RESOLVER - TypeError: Unsupported operand types '%s' and '%s' for binary '%s'",
-                    type_as_string(type_left->kind), type_as_string(type_right->kind), _operator->lexeme);
+                    type_as_string(left.type->kind), type_as_string(right.type->kind), _operator->lexeme);
                 array_push(resolver->diagnostics, _diagnostic);
 
                 // TODO(timo): These none types create a lot of useless error messages in error situations
                 // so consider just removing them
-                type = hashtable_get(resolver->type_table, "none");
+                result.type = hashtable_get(resolver->type_table, "none");
             }
             else
             {
-                Value value_left = expression->binary.left->value;
-                Value value_right = expression->binary.right->value;
+                Value value_left = left.value;
+                Value value_right = right.value;
 
                 // If both values are integers => they are integer constants and
                 // we can do some constant folding.
@@ -475,32 +554,32 @@ static Type* resolve_binary_expression(Resolver* resolver, AST_Expression* expre
                     {
                         case TOKEN_LESS_THAN:
                         {
-                            expression->value = (Value){ .type = VALUE_BOOLEAN,
-                                                         .boolean = value_left.integer < value_right.integer };
+                            result.value = (Value){ .type = VALUE_BOOLEAN,
+                                                    .boolean = value_left.integer < value_right.integer };
                             break;
                         }
                         case TOKEN_LESS_THAN_EQUAL:
                         {
-                            expression->value = (Value){ .type = VALUE_BOOLEAN,
-                                                         .boolean = value_left.integer <= value_right.integer };
+                            result.value = (Value){ .type = VALUE_BOOLEAN,
+                                                    .boolean = value_left.integer <= value_right.integer };
                             break;
                         }
                         case TOKEN_GREATER_THAN:
                         {
-                            expression->value = (Value){ .type = VALUE_BOOLEAN,
-                                                         .boolean = value_left.integer > value_right.integer };
+                            result.value = (Value){ .type = VALUE_BOOLEAN,
+                                                    .boolean = value_left.integer > value_right.integer };
                             break;
                         }
                         case TOKEN_GREATER_THAN_EQUAL:
                         {
-                            expression->value = (Value){ .type = VALUE_BOOLEAN,
-                                                         .boolean = value_left.integer >= value_right.integer };
+                            result.value = (Value){ .type = VALUE_BOOLEAN,
+                                                    .boolean = value_left.integer >= value_right.integer };
                             break;
                         }
                     }
                 }
 
-                type = hashtable_get(resolver->type_table, "bool");
+                result.type = hashtable_get(resolver->type_table, "bool");
             }
 
             break;
@@ -508,22 +587,22 @@ static Type* resolve_binary_expression(Resolver* resolver, AST_Expression* expre
         case TOKEN_AND:
         case TOKEN_OR:
         {
-            if (type_is_not_boolean(type_left) || type_is_not_boolean(type_right))
+            if (type_is_not_boolean(left.type) || type_is_not_boolean(right.type))
             {
                 Diagnostic* _diagnostic = diagnostic(
                     DIAGNOSTIC_ERROR, expression->position,
                     ":RESOLVER - TypeError: Unsupported operand types '%s' and '%s' for binary '%s'",
-                    type_as_string(type_left->kind), type_as_string(type_right->kind), _operator->lexeme);
+                    type_as_string(left.type->kind), type_as_string(right.type->kind), _operator->lexeme);
                 array_push(resolver->diagnostics, _diagnostic);
 
                 // TODO(timo): These none types create a lot of useless error messages in error situations
                 // so consider just removing them
-                type = hashtable_get(resolver->type_table, "none");
+                result.type = hashtable_get(resolver->type_table, "none");
             }
             else
             {
-                Value value_left = expression->binary.left->value;
-                Value value_right = expression->binary.right->value;
+                Value value_left = left.value;
+                Value value_right = right.value;
 
                 // If both values are booleans => they are constants and we can do 
                 // some constant folding.
@@ -533,20 +612,20 @@ static Type* resolve_binary_expression(Resolver* resolver, AST_Expression* expre
                     {
                         case TOKEN_AND:
                         {
-                            expression->value = (Value){ .type = VALUE_BOOLEAN,
-                                                         .boolean = value_left.boolean && value_right.boolean };
+                            result.value = (Value){ .type = VALUE_BOOLEAN,
+                                                    .boolean = value_left.boolean && value_right.boolean };
                             break;
                         }
                         case TOKEN_OR:
                         {
-                            expression->value = (Value){ .type = VALUE_BOOLEAN,
-                                                         .boolean = value_left.boolean || value_right.boolean };
+                            result.value = (Value){ .type = VALUE_BOOLEAN,
+                                                    .boolean = value_left.boolean || value_right.boolean };
                             break;
                         }
                     }
                 }
 
-                type = type_left;
+                result.type = left.type;
             }
 
             break;
@@ -561,14 +640,15 @@ static Type* resolve_binary_expression(Resolver* resolver, AST_Expression* expre
 
             // TODO(timo): These none types create a lot of useless error messages in error situations
             // so consider just removing them
-            type = hashtable_get(resolver->type_table, "none");
+            result.type = hashtable_get(resolver->type_table, "none");
             break;
         }
     }
 
-    expression->type = type;
+    expression->type = result.type;
+    expression->value = result.value;
 
-    return type;
+    return result;
 }
 
 
@@ -584,7 +664,7 @@ static Type* resolve_variable_expression(Resolver* resolver, AST_Expression* exp
     assert(expression->kind == EXPRESSION_VARIABLE);
 
     Type* type;
-    Symbol* symbol = scope_lookup(resolver->local, expression->identifier->lexeme);
+    Symbol* symbol = lookup_symbol(resolver, expression->identifier->lexeme);
      
     if (symbol == NULL)
     {
@@ -602,6 +682,7 @@ static Type* resolve_variable_expression(Resolver* resolver, AST_Expression* exp
         type = symbol->type;
 
     expression->type = type;
+    expression->symbol = symbol;
 
     return type;
 }
@@ -642,22 +723,24 @@ static Type* resolve_assignment_expression(Resolver* resolver, AST_Expression* e
 }
 
 
-// Resolves type of a index/subscript expression. The resolved type will be
-// the type of the elements stored in the subscript target.
+// Resolves the subscript target of an index/subscript expression and checks
+// that it can be indexed. The subscript itself is resolved after this and 
+// checked with resolve_index_subscript().
 //
 // Arguments
 //      resolver: Pointer to initialized Resolver.
 //      expression: Expression to be resolved.
 // Returns
-//      Pointer to resolved type of the expression.
-static Type* resolve_index_expression(Resolver* resolver, AST_Expression* expression)
+//      Value true if the subscript is resolved next. Otherwise the expression
+//      is resolved to the type none.
+static bool resolve_index_target(Resolver* resolver, AST_Expression* expression)
 {
     assert(expression->kind == EXPRESSION_INDEX);
 
-    Type* type;
     AST_Expression* variable = expression->index.variable;
     Type* variable_type = resolve_expression(resolver, variable);
-    Symbol* symbol = scope_lookup(resolver->local, variable->identifier->lexeme);
+    // NOTE(timo): Resolving the variable bound it to its symbol already
+    Symbol* symbol = variable->symbol;
 
     // TODO(timo): Seriously refactor this mess
 
@@ -675,8 +758,8 @@ static Type* resolve_index_expression(Resolver* resolver, AST_Expression* expres
 
         // TODO(timo): These none types create a lot of useless error messages in error situations
         // so consider just removing them
-        type = hashtable_get(resolver->type_table, "none");
-        goto end;
+        expression->type = hashtable_get(resolver->type_table, "none");
+        return false;
     }
 
     // TODO(timo): These checks for the argv and main are only for this stage of the 
@@ -692,13 +775,32 @@ static Type* resolve_index_expression(Resolver* resolver, AST_Expression* expres
 
         // TODO(timo): These none types create a lot of useless error messages in error situations
         // so consider just removing them
-        type = hashtable_get(resolver->type_table, "none");
-        goto end;
+        expression->type = hashtable_get(resolver->type_table, "none");
+        return false;
     }
 
+    return true;
+}
+
+
+// Checks the resolved subscript of an index/subscript expression. The 
+// resolved type will be the type of the elements stored in the subscript 
+// target.
+//
+// Arguments
+//      resolver: Pointer to initialized Resolver.
+//      expression: Expression to be resolved.
+//      index_type: Resolved type of the subscript.
+// Returns
+//      Pointer to resolved type of the expression.
+static Type* resolve_index_subscript(Resolver* resolver, AST_Expression* expression, Type* index_type)
+{
+    assert(expression->kind == EXPRESSION_INDEX);
+
+    Type* type;
+    AST_Expression* variable = expression->index.variable;
+
     // Make sure that the type of the expression is integer
-    Type* index_type = resolve_expression(resolver, expression->index.value);
-    
     if (type_is_not_integer(index_type))
     {
         Diagnostic* _diagnostic = diagnostic(
@@ -737,7 +839,7 @@ static Type* resolve_index_expression(Resolver* resolver, AST_Expression* expres
     // which is handled at runtime only.
 
     // Return the type of the element in the array which the subscript accesses
-    type = variable_type->array.element_type;
+    type = variable->type->array.element_type;
 end:
     expression->type = type;
 
@@ -745,27 +847,16 @@ end:
 }
 
 
-// Resolves type of a function expression. The type will be the type of the
-// value returned by the function.
-// 
-// NOTE(timo): We don't check the return type here, it is the callers responsibility.
-// Expression just returns the value, or in this case, the type.
+// Resolves the parameters of a function expression into the local scope of
+// the function. The local scope of the function is entered and it is left 
+// for the caller to leave. The type of the function is created with 
+// function_type after the return type is known.
 //
 // Arguments
 //      resolver: Pointer to initialized Resolver.
-//      expression: Expression to be resolved.
-// Returns
-//      Pointer to resolved type of the expression.
-static Type* resolve_function_expression(Resolver* resolver, AST_Expression* expression)
+//      expression: Function expression to be resolved.
+static void resolve_function_signature(Resolver* resolver, AST_Expression* expression)
 {
-    assert(expression->kind == EXPRESSION_FUNCTION);
-
-    // TODO(timo): If we are in function at this point, error out.
-    // if not in function -> resolve function -> return function type
-    // else -> error -> return none type
-
-    resolver->context.not_in_function = false;
-
     // Begin a new scope
     // TODO(timo): If anonymous functions are being supported, we
     // should check here whether the current function is NULL or not
@@ -773,8 +864,6 @@ static Type* resolve_function_expression(Resolver* resolver, AST_Expression* exp
     // before entering this expression itself.
     enter_scope(resolver, resolver->context.current_function);
 
-    Type* type = type_function();
-
     // Resolve parameters if there is some
     if (expression->function.arity > 0)
     {
@@ -802,15 +891,70 @@ static Type* resolve_function_expression(Resolver* resolver, AST_Expression* exp
             Type* parameter_type = resolve_type_specifier(resolver, parameter->specifier);
             Symbol* symbol = symbol_parameter(resolver->local, parameter->identifier->lexeme, parameter_type);
 
-            scope_declare(resolver->local, symbol);
-            array_push(type->function.parameters, symbol);
+            declare_variable(resolver, symbol);
         }
+    }
+
+    // Set the functions scope to the created local scope
+    expression->function.scope = resolver->local;
+}
+
+
+TYPED_ARRAY(Type_List, type_list, Type*)
+
+
+// Gets the canonical type of the function from the type table. The parameters
+// are declared first into the local scope of the function, so their types are
+// taken from the first symbols of the scope.
+//
+// Arguments
+//      resolver: Pointer to initialized Resolver.
+//      expression: Function expression with the resolved signature.
+//      return_type: Type of the value returned by the function.
+// Returns
+//      Pointer to the type of the function.
+static Type* function_type(Resolver* resolver, AST_Expression* expression, Type* return_type)
+{
+    const hashtable* symbols = expression->function.scope->symbols;
+    Type_List parameters;
+    type_list_init(&parameters, 0);
+
+    for (int i = 0; i < symbols->count; i++)
+    {
+        Symbol* symbol = symbols->entries[i].value;
+
+        if (symbol->kind != SYMBOL_PARAMETER)
+            break;
 
-        type->function.arity = type->function.parameters->length;
+        type_list_push(&parameters, symbol->type);
     }
 
+    Type* type = type_function(resolver->type_table, return_type, parameters.items, parameters.length);
+    type_list_free(&parameters);
+
+    return type;
+}
+
+
+// Resolves the body of a function expression in the local scope of the 
+// function. The body is parsed first if the parsing of it was postponed. The
+// resolved return type is left to the context.
+//
+// Arguments
+//      resolver: Pointer to initialized Resolver.
+//      expression: Function expression to be resolved.
+static void resolve_function_body(Resolver* resolver, AST_Expression* expression)
+{
+    int diagnostics = resolver->diagnostics->length;
+    AST_Statement* body = parse_function_body(expression, resolver->diagnostics);
+
+    // NOTE(timo): Body with syntax errors is not resolved at all, since the
+    // resolver doesn't expect to see incomplete trees
+    if (resolver->diagnostics->length > diagnostics)
+        return;
+
     // Resolve body and return type
-    resolve_statement(resolver, expression->function.body);
+    resolve_statement(resolver, body);
 
     // Function has to return value
     if (resolver->context.not_returned)
@@ -820,15 +964,39 @@ static Type* resolve_function_expression(Resolver* resolver, AST_Expression* exp
             ":RESOLVER - SyntaxError: Function has to return a value.");
         array_push(resolver->diagnostics, _diagnostic);
     }
+}
+
+
+// Resolves type of a function expression. The type will be the type of the
+// value returned by the function.
+// 
+// NOTE(timo): We don't check the return type here, it is the callers responsibility.
+// Expression just returns the value, or in this case, the type.
+//
+// Arguments
+//      resolver: Pointer to initialized Resolver.
+//      expression: Expression to be resolved.
+// Returns
+//      Pointer to resolved type of the expression.
+static Type* resolve_function_expression(Resolver* resolver, AST_Expression* expression)
+{
+    assert(expression->kind == EXPRESSION_FUNCTION);
+
+    // TODO(timo): If we are in function at this point, error out.
+    // if not in function -> resolve function -> return function type
+    // else -> error -> return none type
+
+    resolver->context.not_in_function = false;
+
+    resolve_function_signature(resolver, expression);
+    resolve_function_body(resolver, expression);
     
-    // Set the functions scope to the created local scope
-    type->function.scope = resolver->local;
     // NOTE(timo): Decided to force only single return statement per function, so 
     // this can actually return something. Even though this information could 
     // carry inside the context structure.
     // NOTE(timo): We should check that the function actually returned something,
     // but that check is made in resolve_function_declaration()
-    type->function.return_type = resolver->context.return_type;
+    Type* type = function_type(resolver, expression, resolver->context.return_type);
 
     // End scope
     leave_scope(resolver);
@@ -844,73 +1012,390 @@ static Type* resolve_function_expression(Resolver* resolver, AST_Expression* exp
 }
 
 
-// Resolves type of a call expression. The resolved type will be the type of
-// the value returned by the called function/callable.
+// Returns the name of the parameter of the function for the diagnostics. The
+// parameters are the first symbols declared into the local scope of the 
+// function, since the type of the function has only their types.
+//
+// Arguments
+//      function: Symbol of the called function.
+//      index: Index of the parameter.
+// Returns
+//      Name of the parameter.
+static const char* parameter_name(const Symbol* function, int index)
+{
+    // NOTE(timo): Variable with a function type has no local scope
+    if (function->local == NULL)
+        return function->identifier;
+
+    const Symbol* parameter = function->local->symbols->entries[index].value;
+
+    return parameter->identifier;
+}
+
+
+// Resolves the called variable of a call expression and checks that it can 
+// be called with the number of arguments given. The arguments are resolved 
+// after this and each of them is checked with resolve_call_argument().
 //
 // Arguments
 //      resolver: Pointer to initialized Resolver.
 //      expression: Expression to be resolved.
 // Returns
-//      Pointer to resolved type of the expression.
-static Type* resolve_call_expression(Resolver* resolver, AST_Expression* expression)
+//      Symbol of the called function or NULL if the variable is not callable.
+//      Without the symbol the expression is resolved to the type none and
+//      the arguments are not resolved.
+static Symbol* resolve_callee(Resolver* resolver, AST_Expression* expression)
 {
     assert(expression->kind == EXPRESSION_CALL);
 
     Type* type = resolve_expression(resolver, expression->call.variable);
     
-    // TODO(timo): Refactor this to be in line with other functions and 
-    // have only one return statement at the end.
     // Make sure the called variable is actually callable - a function in our case
-    if (type_is_function(type))
+    if (type_is_not_function(type))
+    {
+        Diagnostic* _diagnostic = diagnostic(
+            DIAGNOSTIC_ERROR, expression->position,
+            ":RESOLVER - TypeError: '%s' is not callable.",
+            expression->call.variable->identifier->lexeme);
+        array_push(resolver->diagnostics, _diagnostic);
+
+        expression->type = hashtable_get(resolver->type_table, "none");
+
+        return NULL;
+    }
+
+    array* arguments = expression->call.arguments;
+    // NOTE(timo): Resolving the callee bound it to its symbol already
+    Symbol* symbol = expression->call.variable->symbol;
+
+    // Number of arguments == arity of the called function
+    if (symbol->type->function.arity != arguments->length)
     {
-        array* arguments = expression->call.arguments;
-        Symbol* symbol = scope_lookup(resolver->local, expression->call.variable->identifier->lexeme);
+        Diagnostic* _diagnostic = diagnostic(
+            DIAGNOSTIC_ERROR, expression->position,
+            ":RESOLVER - TypeError: Function '%s' expected %d arguments, but %d was given\n", 
+            symbol->identifier, symbol->type->function.arity, arguments->length);
+        array_push(resolver->diagnostics, _diagnostic);
+    }
+
+    // TODO(timo): Is this the correct type?
+    // NOTE(timo): The type is the return type of the called function
+    expression->type = type->function.return_type;
+
+    return symbol;
+}
+
+
+// Checks the type of a resolved argument of a call expression against the
+// type of its parameter.
+//
+// NOTE(timo): The types are canonical, so each of the checks is just a 
+// comparison of the pointers
+//
+// Arguments
+//      resolver: Pointer to initialized Resolver.
+//      expression: Call expression.
+//      function: Symbol of the called function.
+//      index: Index of the argument.
+//      argument_type: Resolved type of the argument.
+static void resolve_call_argument(Resolver* resolver, AST_Expression* expression, Symbol* function, int index, Type* argument_type)
+{
+    Type* parameter_type = function->type->function.parameters->items[index];
+
+    if (types_not_equal(argument_type, parameter_type))
+    {
+        Diagnostic* _diagnostic = diagnostic(
+            DIAGNOSTIC_ERROR, expression->position,
+            ":RESOLVER - TypeError: Parameter '%s' is of type '%s', but argument of type '%s' was given.", 
+            parameter_name(function, index), type_as_string(parameter_type->kind), type_as_string(argument_type->kind));
+        array_push(resolver->diagnostics, _diagnostic);
+    }
+}
+
+
+// Expression waiting on the explicit stack for its operands to be resolved.
+//
+// Members
+//      expression: Unary, binary, call or index expression.
+//      operands: Number of the operands pushed to the stack so far.
+//      arity: Number of the operands to be resolved.
+//      checked: Number of the arguments of a call checked so far.
+//      function: Symbol of the called function.
+//      diagnostics: Number of the diagnostics before the expression.
+typedef struct Pending_Expression
+{
+    AST_Expression* expression;
+    int operands;
+    int arity;
+    int checked;
+    Symbol* function;
+    int diagnostics;
+} Pending_Expression;
+
+
+TYPED_ARRAY(Pending_Expression_Stack, pending_expression_stack, Pending_Expression)
+TYPED_ARRAY(Operand_Stack, operand_stack, Operand)
+TYPED_ARRAY(Expression_Stack, expression_stack, AST_Expression*)
 
-        // Number of arguments == arity of the called function
-        if (symbol->type->function.arity != arguments->length)
+
+static inline bool is_operator_expression(const AST_Expression* expression)
+{
+    return expression->kind == EXPRESSION_UNARY || expression->kind == EXPRESSION_BINARY;
+}
+
+
+static inline bool is_pure_expression(const AST_Expression* expression)
+{
+    return expression->kind == EXPRESSION_LITERAL || expression->kind == EXPRESSION_VARIABLE || 
+           is_operator_expression(expression);
+}
+
+
+// Moves the shared expressions of the tree to their next occurrences without
+// resolving them. The tree which is not resolved at all, e.g. the arguments
+// of a function which can't be called, and the shared expression which is 
+// already resolved are passed this way, so the occurrences of each shared 
+// expression are taken in the order of the source. The bodies of the 
+// function expressions share nothing with the rest of the tree.
+//
+// Arguments
+//      resolver: Pointer to initialized Resolver.
+//      expression: Root of the tree to be passed.
+static void pass_occurrences(Resolver* resolver, AST_Expression* expression)
+{
+    if (! resolver->shared)
+        return;
+
+    Expression_Stack stack;
+    expression_stack_init(&stack, 0);
+    expression_stack_push(&stack, expression);
+
+    while (stack.length > 0)
+    {
+        AST_Expression* current = expression_stack_pop(&stack);
+        expression_next_occurrence(current);
+
+        switch (current->kind)
         {
-            Diagnostic* _diagnostic = diagnostic(
-                DIAGNOSTIC_ERROR, expression->position,
-                ":RESOLVER - TypeError: Function '%s' expected %d arguments, but %d was given\n", 
-                symbol->identifier, symbol->type->function.arity, arguments->length);
-            array_push(resolver->diagnostics, _diagnostic);
+            case EXPRESSION_UNARY:
+                expression_stack_push(&stack, current->unary.operand);
+                break;
+            case EXPRESSION_BINARY:
+                expression_stack_push(&stack, current->binary.right);
+                expression_stack_push(&stack, current->binary.left);
+                break;
+            case EXPRESSION_ASSIGNMENT:
+                expression_stack_push(&stack, current->assignment.value);
+                expression_stack_push(&stack, current->assignment.variable);
+                break;
+            case EXPRESSION_INDEX:
+                expression_stack_push(&stack, current->index.value);
+                expression_stack_push(&stack, current->index.variable);
+                break;
+            case EXPRESSION_CALL:
+                for (int i = current->call.arguments->length - 1; i >= 0; i--)
+                    expression_stack_push(&stack, current->call.arguments->items[i]);
+
+                expression_stack_push(&stack, current->call.variable);
+                break;
+            default:
+                break;
         }
-        
-        // Types of the arguments == types of the parameters
-        for (int i = 0; i < arguments->length; i++)
+    }
+
+    expression_stack_free(&stack);
+}
+
+
+// Moves the shared expression met by the resolver to its next occurrence. 
+// The shared expression resolved without errors is not resolved again. The
+// expression with errors is left unresolved, so it is resolved again at each
+// of its occurrences and the errors are reported at each of them.
+//
+// Arguments
+//      resolver: Pointer to initialized Resolver.
+//      expression: Expression met by the resolver.
+// Returns
+//      Value true if the expression is already resolved, otherwise false.
+static bool is_resolved_shared_expression(Resolver* resolver, AST_Expression* expression)
+{
+    if (! resolver->shared || ! is_pure_expression(expression))
+        return false;
+
+    if (expression->type == NULL)
+    {
+        expression_next_occurrence(expression);
+        return false;
+    }
+
+    pass_occurrences(resolver, expression);
+
+    return true;
+}
+
+
+static inline bool is_nested_expression(const AST_Expression* expression)
+{
+    return is_operator_expression(expression) || 
+           expression->kind == EXPRESSION_CALL || expression->kind == EXPRESSION_INDEX;
+}
+
+
+// Returns the operand of the expression at the index.
+static AST_Expression* nested_operand(const AST_Expression* expression, int index)
+{
+    switch (expression->kind)
+    {
+        case EXPRESSION_UNARY:  return expression->unary.operand;
+        case EXPRESSION_BINARY: return index == 0 ? expression->binary.left : expression->binary.right;
+        case EXPRESSION_CALL:   return expression->call.arguments->items[index];
+        case EXPRESSION_INDEX:  return expression->index.value;
+        default:
+            assert(false && "Only nested expressions have operands");
+            return NULL;
+    }
+}
+
+
+// Pushes the expression to the explicit stack. The parts of the calls and
+// the index expressions resolved before their operands are resolved here.
+static void push_pending_expression(Resolver* resolver, Pending_Expression_Stack* stack, AST_Expression* expression)
+{
+    Pending_Expression pending = { .expression = expression, .diagnostics = resolver->diagnostics->length };
+
+    switch (expression->kind)
+    {
+        case EXPRESSION_UNARY:
+            pending.arity = 1;
+            break;
+        case EXPRESSION_BINARY:
+            pending.arity = 2;
+            break;
+        case EXPRESSION_CALL:
+            // NOTE(timo): Only the arguments with a parameter are resolved
+            if ((pending.function = resolve_callee(resolver, expression)))
+                pending.arity = expression->call.arguments->length < pending.function->type->function.arity ? 
+                                expression->call.arguments->length : pending.function->type->function.arity;
+
+            for (int i = pending.arity; i < expression->call.arguments->length; i++)
+                pass_occurrences(resolver, expression->call.arguments->items[i]);
+            break;
+        case EXPRESSION_INDEX:
+            pending.arity = resolve_index_target(resolver, expression) ? 1 : 0;
+
+            if (pending.arity == 0)
+                pass_occurrences(resolver, expression->index.value);
+            break;
+        default:
+            assert(false && "Only nested expressions are pushed to the stack");
+            break;
+    }
+
+    pending_expression_stack_push(stack, pending);
+}
+
+
+// Resolves the tree of unary, binary, call and index expressions in post-order
+// with an explicit stack, so the long chains of operators and the deeply 
+// nested calls don't use up the native stack. The operands are resolved from
+// left to right before the operator and each argument is checked right after
+// it is resolved, so the diagnostics come out in the same order as with the
+// recursion. The operands are carried on the stack with their constant 
+// values, so the constant subexpressions are folded on the way up. The rest 
+// of the operands are resolved with resolve_expression().
+//
+// Arguments
+//      resolver: Pointer to initialized Resolver.
+//      expression: Unary, binary, call or index expression to be resolved.
+// Returns
+//      Pointer to resolved type of the expression.
+static Type* resolve_nested_expression(Resolver* resolver, AST_Expression* expression)
+{
+    Pending_Expression_Stack stack;
+    Operand_Stack operands;
+    
+    pending_expression_stack_init(&stack, 0);
+    operand_stack_init(&operands, 0);
+    push_pending_expression(resolver, &stack, expression);
+
+    while (stack.length > 0)
+    {
+        Pending_Expression* top = &stack.items[stack.length - 1];
+        AST_Expression* current = top->expression;
+
+        if (current->kind == EXPRESSION_CALL && top->checked < top->operands)
         {
-            AST_Expression* argument = (AST_Expression*)arguments->items[i];
-            Symbol* parameter = symbol->type->function.parameters->items[i];
+            Operand argument = operand_stack_pop(&operands);
+            resolve_call_argument(resolver, current, top->function, top->checked++, argument.type);
+        }
 
-            Type* argument_type = resolve_expression(resolver, argument);
-            Type* parameter_type = parameter->type;
+        if (top->operands < top->arity)
+        {
+            AST_Expression* operand = nested_operand(current, top->operands++);
 
-            if (types_not_equal(argument_type, parameter_type))
+            if (! is_nested_expression(operand))
             {
-                Diagnostic* _diagnostic = diagnostic(
-                    DIAGNOSTIC_ERROR, expression->position,
-                    ":RESOLVER - TypeError: Parameter '%s' is of type '%s', but argument of type '%s' was given.", 
-                    parameter->identifier, type_as_string(parameter_type->kind), type_as_string(argument_type->kind));
-                array_push(resolver->diagnostics, _diagnostic);
+                Type* type = resolve_expression(resolver, operand);
+                operand_stack_push(&operands, (Operand){ .type = type, .value = operand->value });
             }
+            else if (is_resolved_shared_expression(resolver, operand))
+                operand_stack_push(&operands, (Operand){ .type = operand->type, .value = operand->value });
+            else
+                push_pending_expression(resolver, &stack, operand);
+
+            continue;
         }
-        
-        // TODO(timo): Is this the correct type?
-        expression->type = type->function.return_type;
 
-        // return the return type of the called function
-        return type->function.return_type;
-    }
-    else
-    {
-        Diagnostic* _diagnostic = diagnostic(
-            DIAGNOSTIC_ERROR, expression->position,
-            ":RESOLVER - TypeError: '%s' is not callable.",
-            expression->call.variable->identifier->lexeme);
-        array_push(resolver->diagnostics, _diagnostic);
+        Pending_Expression finished = pending_expression_stack_pop(&stack);
 
-        return hashtable_get(resolver->type_table, "none");
+        switch (current->kind)
+        {
+            case EXPRESSION_UNARY:
+            {
+                Operand operand = operand_stack_pop(&operands);
+                operand_stack_push(&operands, resolve_unary_expression(resolver, current, operand));
+                break;
+            }
+            case EXPRESSION_BINARY:
+            {
+                Operand right = operand_stack_pop(&operands);
+                Operand left = operand_stack_pop(&operands);
+                operand_stack_push(&operands, resolve_binary_expression(resolver, current, left, right));
+                break;
+            }
+            case EXPRESSION_CALL:
+            {
+                operand_stack_push(&operands, (Operand){ .type = current->type, .value = current->value });
+                break;
+            }
+            case EXPRESSION_INDEX:
+            {
+                if (finished.arity > 0)
+                {
+                    Operand subscript = operand_stack_pop(&operands);
+                    resolve_index_subscript(resolver, current, subscript.type);
+                }
+
+                operand_stack_push(&operands, (Operand){ .type = current->type, .value = current->value });
+                break;
+            }
+            default:
+                break;
+        }
+
+        // NOTE(timo): The shared expression with errors is resolved again
+        // at its next occurrence
+        if (resolver->shared && is_operator_expression(current) && 
+            resolver->diagnostics->length > finished.diagnostics)
+            current->type = NULL;
     }
+
+    Operand result = operand_stack_pop(&operands);
+
+    pending_expression_stack_free(&stack);
+    operand_stack_free(&operands);
+
+    return result.type;
 }
 
 
@@ -922,6 +1407,13 @@ Type* resolve_expression(Resolver* resolver, AST_Expression* expression)
     // declared in global scope. If it is => error. Only declarations
     // allowed in the global scope.
 
+    // NOTE(timo): Shared expression without errors is resolved only the first
+    // time it is met
+    if (is_resolved_shared_expression(resolver, expression))
+        return expression->type;
+
+    int diagnostics = resolver->diagnostics->length;
+
     switch (expression->kind)
     {
         case EXPRESSION_LITERAL:
@@ -934,16 +1426,10 @@ Type* resolve_expression(Resolver* resolver, AST_Expression* expression)
             type = resolve_assignment_expression(resolver, expression);
             break;
         case EXPRESSION_UNARY:
-            type = resolve_unary_expression(resolver, expression);
-            break;
         case EXPRESSION_BINARY:
-            type = resolve_binary_expression(resolver, expression);
-            break;
         case EXPRESSION_INDEX:
-            type = resolve_index_expression(resolver, expression);
-            break;
         case EXPRESSION_CALL:
-            type = resolve_call_expression(resolver, expression);
+            type = resolve_nested_expression(resolver, expression);
             break;
         case EXPRESSION_FUNCTION:
             type = resolve_function_expression(resolver, expression);
@@ -969,6 +1455,10 @@ Type* resolve_expression(Resolver* resolver, AST_Expression* expression)
     // void, since we are just decorating the expressions, we don't actually
     // have to return anything.
 
+    if (resolver->shared && is_pure_expression(expression) && 
+        resolver->diagnostics->length > diagnostics)
+        expression->type = NULL;
+
     return type;
 }
 
@@ -1190,7 +1680,7 @@ Type* resolve_type_specifier(Resolver* resolver, Type_Specifier specifier)
         }
         case TYPE_SPECIFIER_ARRAY_INT:
         {
-            type = type_array(hashtable_get(resolver->type_table, "int"));
+            type = type_array(resolver->type_table, hashtable_get(resolver->type_table, "int"));
             break;
         }
         default:
@@ -1233,17 +1723,22 @@ static void resolve_variable_declaration(Resolver* resolver, AST_Declaration* de
 
         // We can just return since the identifier is already declared so in
         // future uses of the identifier won't mess things up.
+        pass_occurrences(resolver, declaration->initializer);
         return;
     }
 
     Type* expected_type = resolve_type_specifier(resolver, declaration->specifier);
+    int diagnostics = resolver->diagnostics->length;
     Type* actual_type = resolve_expression(resolver, declaration->initializer);
 
     // The variables initializer has to be a constant literal. At this point we 
     // can check that by checking if the value is none or not after resolving it.
+    // NOTE(timo): The initializer with errors, e.g. an overflowing literal,
+    // has no value either, but that is already reported
     Value initializer_value = declaration->initializer->value;
 
-    if (resolver->local == resolver->global && value_is_none(initializer_value))
+    if (resolver->local == resolver->global && value_is_none(initializer_value) &&
+        resolver->diagnostics->length == diagnostics)
     {
         Diagnostic* _diagnostic = diagnostic(
             DIAGNOSTIC_ERROR, declaration->position,
@@ -1263,7 +1758,35 @@ static void resolve_variable_declaration(Resolver* resolver, AST_Declaration* de
     Symbol* symbol = symbol_variable(resolver->local, declaration->identifier->lexeme, actual_type);
     // We have at least a none value in every expression.
     symbol->value = declaration->initializer->value;
+    declare_variable(resolver, symbol);
+    declaration->symbol = symbol;
+}
+
+
+// Declares the function with only its signature resolved. The declared type 
+// is trusted to be the return type until the body is resolved.
+//
+// Arguments
+//      resolver: Pointer to initialized Resolver.
+//      declaration: Declaration of the function.
+//      expected_type: Declared return type of the function.
+// Returns
+//      Pointer to the declared symbol of the function.
+static Symbol* declare_function_signature(Resolver* resolver, AST_Declaration* declaration, Type* expected_type)
+{
+    resolve_function_signature(resolver, declaration->initializer);
+
+    Type* type = function_type(resolver, declaration->initializer, expected_type);
+    declaration->initializer->type = type;
+
+    leave_scope(resolver);
+
+    Symbol* symbol = symbol_function(resolver->local, declaration->identifier->lexeme, type);
+    symbol->local = declaration->initializer->function.scope;
     scope_declare(resolver->local, symbol);
+    declaration->symbol = symbol;
+
+    return symbol;
 }
 
 
@@ -1294,6 +1817,20 @@ static void resolve_function_declaration(Resolver* resolver, AST_Declaration* de
     resolver->context.current_function = (char*)declaration->identifier->lexeme;
 
     Type* expected_type = resolve_type_specifier(resolver, declaration->specifier);
+
+    // The body is resolved when the function is used for the first time, so 
+    // the declared type is trusted to be the return type until then
+    if (resolver->lazy && declaration->initializer->kind == EXPRESSION_FUNCTION &&
+        declaration->identifier->lexeme != str_intern("main"))
+    {
+        Symbol* symbol = declare_function_signature(resolver, declaration, expected_type);
+        symbol->state = STATE_UNRESOLVED;
+        hashtable_put(resolver->deferred, symbol->identifier, declaration);
+
+        resolver->context.current_function = NULL;
+        return;
+    }
+
     Type* actual_type = resolve_expression(resolver, declaration->initializer);
 
     // The initializer has to be a function type
@@ -1327,16 +1864,87 @@ static void resolve_function_declaration(Resolver* resolver, AST_Declaration* de
     // Declare the symbol into the current scope
     Symbol* symbol = symbol_function(resolver->local, declaration->identifier->lexeme, actual_type);
 
+    if (declaration->initializer->kind == EXPRESSION_FUNCTION)
+        symbol->local = declaration->initializer->function.scope;
+
     // TODO(timo): Should we take the responsibility of declaring errors of
     // already declared variables instead of doing it in the scope
     // TODO(timo): Check for redeclaration of the variable
     scope_declare(resolver->local, symbol);
+    declaration->symbol = symbol;
 
     // Reset the context
     resolver->context.current_function = NULL;
 }
 
 
+// Resolves the body of a function declared by declare_function_signature. The
+// body is resolved in the local scope of the function, so the resolver is 
+// moved there and back to the scope where it was.
+//
+// Arguments
+//      resolver: Pointer to initialized Resolver.
+//      declaration: Declaration of the function.
+// Returns
+//      Type of the value returned by the body or NULL if nothing is returned.
+static Type* resolve_declared_function(Resolver* resolver, AST_Declaration* declaration)
+{
+    Symbol* symbol = declaration->symbol;
+    Scope* local = resolver->local;
+    struct Resolver_Context context = resolver->context;
+
+    resolver->local = symbol->local;
+    resolver->context = (struct Resolver_Context){ .current_function = (char*)symbol->identifier,
+                                                   .not_in_loop = true,
+                                                   .not_in_function = false,
+                                                   .not_returned = true,
+                                                   .return_type = NULL };
+
+    resolve_function_body(resolver, declaration->initializer);
+
+    Type* return_type = resolver->context.return_type;
+    Type* expected_type = symbol->type->function.return_type;
+
+    if (return_type && types_not_equal(return_type, expected_type) && type_is_not_none(return_type))
+    {
+        Diagnostic* _diagnostic = diagnostic(
+            DIAGNOSTIC_ERROR, declaration->position,
+            ":RESOLVER - TypeError: Conflicting types in function declaration. Declaring type '%s' to '%s'",
+            type_as_string(return_type->kind), type_as_string(expected_type->kind));
+        array_push(resolver->diagnostics, _diagnostic);
+    }
+
+    resolver->local = local;
+    resolver->context = context;
+
+    return return_type;
+}
+
+
+// Resolves the body of a deferred function declaration when the function is
+// used for the first time.
+//
+// Arguments
+//      resolver: Pointer to initialized Resolver.
+//      symbol: Symbol of the deferred function.
+static void resolve_deferred_function(Resolver* resolver, Symbol* symbol)
+{
+    // NOTE(timo): The body is resolved only after the whole program is 
+    // declared, so the globals declared after the function are hidden like in
+    // the parallel resolving. The function itself is hidden too, so a call to
+    // itself is reported as a reference before the declaration, like in the
+    // serial resolving.
+    int visible = resolver->visible;
+    resolver->visible = symbol->index;
+    symbol->state = STATE_RESOLVING;
+
+    resolve_declared_function(resolver, hashtable_get(resolver->deferred, symbol->identifier));
+
+    symbol->state = STATE_RESOLVED;
+    resolver->visible = visible;
+}
+
+
 void resolve_declaration(Resolver* resolver, AST_Declaration* declaration)
 {
     switch (declaration->kind)
@@ -1361,6 +1969,281 @@ void resolve_declaration(Resolver* resolver, AST_Declaration* declaration)
 
 void resolve(Resolver* resolver, array* declarations)
 {
+    // NOTE(timo): The lazy resolving and the incremental checking depend on
+    // the order in which the bodies are resolved
+    if (declarations->length >= RESOLVER_PARALLEL_THRESHOLD && ! resolver->lazy && ! resolver->dependencies)
+    {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+
+        if (processors > 1)
+        {
+            resolve_parallel(resolver, declarations, processors);
+            return;
+        }
+    }
+
     for (int i = 0; i < declarations->length; i++)
         resolve_declaration(resolver, declarations->items[i]);
 }
+
+
+// Function body to be resolved in the parallel resolving.
+//
+// Members
+//      declaration: Declaration of the function.
+//      position: Number of the diagnostics reported before the body, so the
+//                diagnostics of the body are merged to the right place.
+//      diagnostics: Diagnostics of the body.
+//      taken: If a thread has taken the body to be resolved.
+typedef struct Resolver_Job
+{
+    AST_Declaration* declaration;
+    int position;
+    array* diagnostics;
+    bool taken;
+} Resolver_Job;
+
+
+TYPED_ARRAY(Resolver_Job_List, resolver_job_list, Resolver_Job)
+
+
+// Pool of the threads resolving the bodies. The threads take the next job from
+// the pool until all the jobs are taken, so the threads are kept busy even if
+// the bodies are of very different sizes.
+//
+// Members
+//      resolver: Resolver with the declared global scope.
+//      jobs: Bodies to be resolved. The list is never grown after the jobs
+//            are found, so the pointers to the jobs stay valid.
+//      functions: Table of the jobs by the names of their functions.
+//      next: Index of the next job to be taken.
+//      lock: Lock for taking the jobs and for the types of the functions.
+//      resolved: Signaled when the body of a function has been resolved.
+typedef struct Resolver_Pool
+{
+    const Resolver* resolver;
+    Resolver_Job_List* jobs;
+    hashtable* functions;
+    int next;
+    pthread_mutex_t lock;
+    pthread_cond_t resolved;
+} Resolver_Pool;
+
+
+// Resolves the body of the job taken by the thread. The function is declared
+// with the type returned by its body like in the serial resolving, and the
+// threads waiting for it are woken up.
+//
+// Arguments
+//      resolver: Resolver of the thread.
+//      job: Job taken by the thread.
+static void resolve_job(Resolver* resolver, Resolver_Job* job)
+{
+    AST_Declaration* declaration = job->declaration;
+    array* diagnostics = resolver->diagnostics;
+    int visible = resolver->visible;
+    Symbol* symbol = declaration->symbol;
+
+    resolver->diagnostics = job->diagnostics;
+    resolver->visible = symbol->index;
+
+    // NOTE(timo): Body with syntax errors is not resolved at all, and the 
+    // declared type is kept
+    bool resolvable = job->diagnostics->length == 0;
+    Type* return_type = resolvable ? resolve_declared_function(resolver, declaration) : NULL;
+
+    resolver->diagnostics = diagnostics;
+    resolver->visible = visible;
+
+    pthread_mutex_lock(&resolver->pool->lock);
+
+    // NOTE(timo): The type table is shared by the threads
+    if (resolvable)
+    {
+        symbol->type = function_type(resolver, declaration->initializer, return_type);
+        declaration->initializer->type = symbol->type;
+    }
+
+    symbol->state = STATE_RESOLVED;
+    pthread_cond_broadcast(&resolver->pool->resolved);
+    pthread_mutex_unlock(&resolver->pool->lock);
+}
+
+
+// Makes sure the body of the used function is resolved before its type is
+// used. The body is resolved by the calling thread if no other thread has 
+// taken it yet, otherwise the calling thread waits for it. The function has
+// to be declared before the user, so the waiting threads always wait for an
+// earlier function and never for each other.
+//
+// Arguments
+//      resolver: Resolver of the thread.
+//      symbol: Symbol of the used function.
+static void resolve_used_function(Resolver* resolver, Symbol* symbol)
+{
+    Resolver_Pool* pool = resolver->pool;
+    Resolver_Job* job = hashtable_get(pool->functions, symbol->identifier);
+
+    // NOTE(timo): The function declared without a body of its own was 
+    // resolved with the globals
+    if (job == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+
+    bool taken = job->taken;
+    job->taken = true;
+
+    while (taken && symbol->state != STATE_RESOLVED)
+        pthread_cond_wait(&pool->resolved, &pool->lock);
+
+    pthread_mutex_unlock(&pool->lock);
+
+    if (! taken)
+        resolve_job(resolver, job);
+}
+
+
+// Resolves the bodies taken from the pool. This is the entry point of the 
+// threads in the parallel resolving.
+//
+// Arguments
+//      argument: Pointer to the Resolver_Pool.
+// Returns
+//      Always NULL.
+static void* resolve_jobs(void* argument)
+{
+    Resolver_Pool* pool = argument;
+
+    // NOTE(timo): Each thread has its own copy of the resolver, so the local
+    // scope, the context and the diagnostics are never shared
+    Resolver resolver = *pool->resolver;
+
+    while (true)
+    {
+        pthread_mutex_lock(&pool->lock);
+
+        while (pool->next < pool->jobs->length && pool->jobs->items[pool->next].taken)
+            pool->next++;
+
+        Resolver_Job* job = NULL;
+
+        if (pool->next < pool->jobs->length)
+        {
+            job = &pool->jobs->items[pool->next++];
+            job->taken = true;
+        }
+
+        pthread_mutex_unlock(&pool->lock);
+
+        if (job == NULL)
+            break;
+
+        resolve_job(&resolver, job);
+    }
+
+    return NULL;
+}
+
+
+void resolve_parallel(Resolver* resolver, array* declarations, int threads)
+{
+    assert(resolver->local == resolver->global);
+
+    Resolver_Job_List jobs;
+    resolver_job_list_init(&jobs, declarations->length);
+
+    Resolver_Pool pool = { .resolver = resolver, 
+                           .jobs = &jobs, 
+                           .functions = hashtable_init_interned(0),
+                           .next = 0 };
+
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.resolved, NULL);
+
+    resolver->pool = &pool;
+
+    // Declare the globals and the signatures of the functions in the order of
+    // the declarations. Everything else than the bodies is resolved here.
+    for (int i = 0; i < declarations->length; i++)
+    {
+        AST_Declaration* declaration = declarations->items[i];
+
+        if (declaration->kind != DECLARATION_FUNCTION || 
+            declaration->initializer->kind != EXPRESSION_FUNCTION ||
+            scope_get(resolver->global, declaration->identifier->lexeme) != NULL)
+        {
+            resolve_declaration(resolver, declaration);
+            continue;
+        }
+
+        resolver->context.current_function = (char*)declaration->identifier->lexeme;
+
+        Type* expected_type = resolve_type_specifier(resolver, declaration->specifier);
+        Symbol* symbol = declare_function_signature(resolver, declaration, expected_type);
+        symbol->state = STATE_RESOLVING;
+
+        resolver->context.current_function = NULL;
+
+        Resolver_Job job = { .declaration = declaration,
+                             .position = resolver->diagnostics->length,
+                             .diagnostics = array_init(sizeof (Diagnostic*)) };
+
+        // NOTE(timo): The postponed bodies are parsed here, since the parsed
+        // bodies are merged into the arena of the tree shared by all of them
+        parse_function_body(declaration->initializer, job.diagnostics);
+
+        hashtable_put(pool.functions, declaration->identifier->lexeme, resolver_job_list_push(&jobs, job));
+    }
+
+    pthread_t workers[RESOLVER_MAX_THREADS];
+
+    if (threads > RESOLVER_MAX_THREADS) threads = RESOLVER_MAX_THREADS;
+    if (threads > jobs.length) threads = jobs.length;
+
+    // NOTE(timo): The calling thread resolves the bodies too
+    for (int i = 1; i < threads; i++)
+    {
+        if (pthread_create(&workers[i], NULL, resolve_jobs, &pool) != 0)
+        {
+            printf("Could not create a thread for resolving\n");
+            exit(1);
+        }
+    }
+
+    resolve_jobs(&pool);
+
+    for (int i = 1; i < threads; i++)
+        pthread_join(workers[i], NULL);
+
+    pthread_mutex_destroy(&pool.lock);
+    pthread_cond_destroy(&pool.resolved);
+    hashtable_free(pool.functions);
+    resolver->pool = NULL;
+
+    // Merge the diagnostics of the bodies after the diagnostics reported 
+    // before them, so they are in the same order as in the serial resolving
+    array* diagnostics = array_init(sizeof (Diagnostic*));
+    int merged = 0;
+
+    for (int i = 0; i < jobs.length; i++)
+    {
+        Resolver_Job* job = &jobs.items[i];
+
+        for (; merged < job->position; merged++)
+            array_push(diagnostics, resolver->diagnostics->items[merged]);
+
+        for (int j = 0; j < job->diagnostics->length; j++)
+            array_push(diagnostics, job->diagnostics->items[j]);
+
+        array_free(job->diagnostics);
+    }
+
+    for (; merged < resolver->diagnostics->length; merged++)
+        array_push(diagnostics, resolver->diagnostics->items[merged]);
+
+    array_free(resolver->diagnostics);
+    resolver->diagnostics = diagnostics;
+
+    resolver_job_list_free(&jobs);
+}
@@ -6,14 +6,21 @@
 #include "t.h"
 
 
+// NOTE(timo): Scopes are small compared to the token stream or the syntax
+// tree, so they get smaller blocks
+#define SCOPE_ARENA_BLOCK_SIZE 4096
+
+
 Scope* scope_init(Scope* enclosing, const char* name)
 {
     Scope* scope = xmalloc(sizeof (Scope));
     scope->name = name;
     scope->offset = 0;
     scope->offset_parameter = 16;
+    scope->frame_size = 0;
     scope->enclosing = enclosing;
-    scope->symbols = hashtable_init(10);
+    scope->symbols = hashtable_init_interned(10);
+    arena_init(&scope->arena, SCOPE_ARENA_BLOCK_SIZE);
 
     return scope;
 }
@@ -21,7 +28,7 @@ Scope* scope_init(Scope* enclosing, const char* name)
 
 void scope_free(Scope* scope)
 {
-    for (int i = 0; i < scope->symbols->capacity; i++)
+    for (int i = 0; i < scope->symbols->count; i++)
     {
         Symbol* symbol = scope->symbols->entries[i].value;
 
@@ -30,6 +37,7 @@ void scope_free(Scope* scope)
     }
 
     hashtable_free(scope->symbols);
+    arena_free(&scope->arena);
 
     free(scope);
     scope = NULL;
@@ -44,6 +52,11 @@ Symbol* scope_get(const Scope* scope, const char* identifier)
 
 static void scope_put(Scope* scope, Symbol* symbol)
 {
+    // NOTE(timo): Symbol replacing an existing one takes its place in the
+    // declaration order, since the entry of the table is reused
+    Symbol* existing = scope_get(scope, symbol->identifier);
+    symbol->index = existing ? existing->index : scope->symbols->count;
+
     hashtable_put(scope->symbols, symbol->identifier, symbol);
 }
 
@@ -115,7 +128,7 @@ const array* scope_symbols(const Scope* scope)
 {
     array* symbols = array_init(sizeof (Symbol*));
 
-    for (int i = 0; i < scope->symbols->capacity; i++)
+    for (int i = 0; i < scope->symbols->count; i++)
     {
         Symbol* symbol = scope->symbols->entries[i].value;
 
@@ -138,11 +151,11 @@ void dump_scope(const Scope* scope, int indentation)
 
     printf("---\n");
 
-    for (int i = 0; i < scope->symbols->capacity; i++)
+    for (int i = 0; i < scope->symbols->count; i++)
     {
         hashtable_entry entry = scope->symbols->entries[i];
 
-        if (entry.key)
+        if (entry.key && entry.value)
         {
             Symbol* symbol = entry.value;
 
@@ -153,7 +166,7 @@ void dump_scope(const Scope* scope, int indentation)
             {
                 case SYMBOL_FUNCTION:
                     printf("function\t%s\t\t%s\t%d\t%d\n", symbol->identifier, type_as_string(symbol->type->kind), symbol->type->size, symbol->offset);
-                    dump_scope(symbol->type->function.scope, indentation + 1);
+                    dump_scope(symbol->local, indentation + 1);
                     break;
                 case SYMBOL_VARIABLE:
                     printf("variable\t%s\t\t%s\t%d\t%d\n", symbol->identifier, type_as_string(symbol->type->kind), symbol->type->size, symbol->offset);
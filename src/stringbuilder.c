@@ -34,7 +34,9 @@ void sb_append(stringbuilder* sb, const char* string)
     // memory will be allocated for the new bigger string.
     if (sb->capacity < sb->length + length + 1)
     {
-        sb->capacity *= 2;
+        while (sb->capacity < sb->length + length + 1)
+            sb->capacity *= 2;
+
         sb->string = xrealloc(sb->string, sb->capacity);
     }
 
@@ -43,6 +45,10 @@ void sb_append(stringbuilder* sb, const char* string)
     // comes from taking into account overlapping memory.
     memmove(sb->string + sb->length, string, length);
     sb->length += length;
+
+    // NOTE(timo): The reallocated memory is not zeroed, so the string has to
+    // be terminated after every append
+    sb->string[sb->length] = 0;
 }
 
 
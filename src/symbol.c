@@ -9,11 +9,14 @@
 
 Symbol* symbol_variable(Scope* scope, const char* identifier, Type* type)
 {
-    Symbol* symbol = xcalloc(1, sizeof (Symbol));
+    Symbol* symbol = arena_calloc(&scope->arena, 1, sizeof (Symbol));
     symbol->kind = SYMBOL_VARIABLE;
     symbol->scope = scope;
-    symbol->identifier = str_copy(identifier);
+    symbol->identifier = str_intern(identifier);
     symbol->type = type;
+    symbol->state = STATE_RESOLVED;
+    symbol->slot = -1;
+    symbol->index = -1;
     symbol->_register = -1;
         
     return symbol;
@@ -22,11 +25,14 @@ Symbol* symbol_variable(Scope* scope, const char* identifier, Type* type)
 
 Symbol* symbol_function(Scope* scope, const char* identifier, Type* type)
 {
-    Symbol* symbol = xcalloc(1, sizeof (Symbol));
+    Symbol* symbol = arena_calloc(&scope->arena, 1, sizeof (Symbol));
     symbol->kind = SYMBOL_FUNCTION;
     symbol->scope = scope;
-    symbol->identifier = str_copy(identifier);
+    symbol->identifier = str_intern(identifier);
     symbol->type = type;
+    symbol->state = STATE_RESOLVED;
+    symbol->slot = -1;
+    symbol->index = -1;
     symbol->_register = -1;
 
     return symbol;
@@ -35,11 +41,14 @@ Symbol* symbol_function(Scope* scope, const char* identifier, Type* type)
 
 Symbol* symbol_parameter(Scope* scope, const char* identifier, Type* type)
 {
-    Symbol* symbol = xcalloc(1, sizeof (Symbol));
+    Symbol* symbol = arena_calloc(&scope->arena, 1, sizeof (Symbol));
     symbol->kind = SYMBOL_PARAMETER;
     symbol->scope = scope;
-    symbol->identifier = str_copy(identifier);
+    symbol->identifier = str_intern(identifier);
     symbol->type = type;
+    symbol->state = STATE_RESOLVED;
+    symbol->slot = -1;
+    symbol->index = -1;
     symbol->_register = -1;
 
     return symbol;
@@ -48,11 +57,14 @@ Symbol* symbol_parameter(Scope* scope, const char* identifier, Type* type)
 
 Symbol* symbol_temp(Scope* scope, const char* identifier, Type* type)
 {
-    Symbol* symbol = xcalloc(1, sizeof (Symbol));
+    Symbol* symbol = arena_calloc(&scope->arena, 1, sizeof (Symbol));
     symbol->kind = SYMBOL_TEMP;
     symbol->scope = scope;
-    symbol->identifier = str_copy(identifier);
+    symbol->identifier = str_intern(identifier);
     symbol->type = type;
+    symbol->state = STATE_RESOLVED;
+    symbol->slot = -1;
+    symbol->index = -1;
     symbol->_register = -1;
         
     return symbol;
@@ -61,30 +73,14 @@ Symbol* symbol_temp(Scope* scope, const char* identifier, Type* type)
 
 void symbol_free(Symbol* symbol)
 {
-    // NOTE(timo): There might not be type if program stops before types are added
-    if (symbol->type != NULL && symbol->kind != SYMBOL_TEMP)
+    // NOTE(timo): The types are owned by the type table, so only the local
+    // scope of a function is freed with the symbol
+    if (symbol->kind == SYMBOL_FUNCTION && symbol->local != NULL)
     {
-        switch (symbol->type->kind)
-        {
-            case TYPE_NONE:
-            case TYPE_INTEGER:
-            case TYPE_BOOLEAN:
-                break;
-            case TYPE_ARRAY:
-            case TYPE_FUNCTION:
-                type_free(symbol->type);
-                symbol->type = NULL;
-                break;
-            default:
-                // TODO(timo): Error
-                break;
-        }
+        scope_free(symbol->local);
+        symbol->local = NULL;
     }
 
-    // NOTE(timo): The scope is being freed by the resolver
-    free((char*)symbol->identifier);
-    symbol->identifier = NULL;
-
-    free(symbol);
-    symbol = NULL;
+    // NOTE(timo): The symbol lives in the arena of the scope and it is released
+    // when the scope is freed. The identifier is interned.
 }
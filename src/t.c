@@ -18,11 +18,17 @@ static const char* usage =
     "                     Valid arguments:\n"
     "                           ast: Interpret with abstract syntax tree walker NOT_IMPLEMENTED\n"
     "                           ir: IR interpreter NOT IMPLEMENTED\n"
+    "    -c, --cache: Directory of the cache of the resolved programs, used by\n"
+    "                 both the compiler and the interpreter\n"
     "Flags:\n"
     "    --show-summary: Prints a summary of the compilation at the end\n"
     "    --show-symbols: Prints the contents of the symbol table after resolving stage\n"
     "    --show-ir: Prints the instructions of the intermediate representation\n"
-    "    --show-asm: Prints the assembly file\n";
+    "    --show-asm: Prints the assembly file\n"
+    "    --lazy: Parses and resolves only the bodies of the functions used by the program\n"
+    "    --share: Shares the identical expressions inside the declarations\n"
+    "    --single-pass: Parses, resolves and generates the IR one declaration at a time\n"
+    "    --fold: Generates the constant expressions as their folded values\n";
 
 
 void parse_options(struct Options* options, int* argc, char*** argv)
@@ -58,6 +64,19 @@ void parse_options(struct Options* options, int* argc, char*** argv)
                 exit(1);
             }
         }
+        else if (str_equals(arg, "-c") || str_equals(arg, "--cache"))
+        {
+            shift(argc, argv);
+            arg = (char*)**argv;
+
+            if (arg)
+                options->cache_directory = arg;
+            else
+            {
+                printf("Error: Missing argument for '-c' or '--cache'\n");
+                exit(1);
+            }
+        }
         else if (str_equals(arg, "-i") || str_equals(arg, "--interpret"))
         {
             options->interpret = true;
@@ -86,6 +105,14 @@ void parse_options(struct Options* options, int* argc, char*** argv)
             options->show_ir = true;
         else if (str_equals(arg, "--show-asm"))
             options->show_asm = true;
+        else if (str_equals(arg, "--lazy"))
+            options->lazy = true;
+        else if (str_equals(arg, "--share"))
+            options->share = true;
+        else if (str_equals(arg, "--single-pass"))
+            options->single_pass = true;
+        else if (str_equals(arg, "--fold"))
+            options->fold = true;
         // NOTE(timo): This has to be last option so if there are no flags or
         // other arguments, we just assume it is a source file then
         else if (options->source_file == NULL)
@@ -96,73 +123,143 @@ void parse_options(struct Options* options, int* argc, char*** argv)
 }
 
 
+void compile_single_pass(Lexer* lexer, Parser* parser, Resolver* resolver, IR_Generator* generator)
+{
+    while (parser->current_token->kind != TOKEN_EOF)
+    {
+        AST_Declaration* declaration = parse_top_level_declaration(parser);
+
+        if (lexer->diagnostics->length == 0 && parser->diagnostics->length == 0)
+        {
+            resolve_declaration(resolver, declaration);
+
+            if (resolver->diagnostics->length == 0)
+                ir_generate_declaration(generator, declaration);
+        }
+
+        // NOTE(timo): Only the table of the shared expressions and the shared
+        // results of the generator refer to the tree, so they are cleared 
+        // before the tree is released. The symbols and the instructions refer
+        // only to the interned names and to the symbols, which live in the 
+        // arenas of the scopes: the local scopes of the functions are owned by
+        // their symbols and the last writes are indices of the instructions.
+        if (parser->share)
+            expression_table_clear(&parser->expressions);
+
+        ir_generator_clear_results(generator);
+        arena_reset(&parser->arena);
+    }
+}
+
+
 void compile(const char* source, struct Options options)
 {
     if (options.show_summary)
         printf("-----===== COMPILING =====-----\n");
 
-    // Lexing
+    // Lexing and parsing
+    //
+    // NOTE(timo): The parser pulls the tokens from the lexer on demand, so the
+    // lexing and the parsing are done at the same time, unless the source is
+    // large enough to be lexed and parsed in parallel
     Lexer lexer;
-    clock_t lexing_start;
-    clock_t lexing_end;
-    double lexing_time = 0.0;
+    Parser parser;
+    hashtable* type_table;
+    Resolver resolver;
+    IR_Generator ir_generator;
+
+    // NOTE(timo): The timers of all the phases are declared here, since the
+    // failing phases jump straight to the teardown, which prints them all
+    clock_t parsing_start = 0;
+    clock_t parsing_end = 0;
+    double parsing_time = 0.0;
+    clock_t resolving_start = 0;
+    clock_t resolving_end = 0;
+    double resolving_time = 0.0;
+    clock_t ir_generating_start = 0;
+    clock_t ir_generating_end = 0;
+    double ir_generating_time = 0.0;
+    clock_t code_generating_start = 0;
+    clock_t code_generating_end = 0;
+    double code_generating_time = 0.0;
+    clock_t assembly_start = 0;
+    clock_t assembly_end = 0;
+    double assembly_time = 0.0;
+    clock_t linker_start = 0;
+    clock_t linker_end = 0;
+    double linker_time = 0.0;
 
     if (options.show_summary)
     {
-        printf("Lexing...");
-        lexing_start = clock();
+        printf("Lexing and parsing...");
+        parsing_start = clock();
     }
 
+    // NOTE(timo): The cache saves the whole tree, so the bodies can't be skipped
+    bool lazy = options.lazy && options.cache_directory == NULL && ! options.single_pass;
+
     lexer_init(&lexer, source);
-    lex(&lexer);
 
-    if (options.show_summary)
+    // NOTE(timo): Every token takes at least one character, so the smaller 
+    // sources can't have enough tokens for the parallel parsing and they are
+    // parsed while lexing. The larger sources are lexed at once, so they can
+    // be lexed and parsed in parallel. The bodies are skipped only while 
+    // streaming the tokens and the cached programs are not lexed at all.
+    if (! lazy && ! options.single_pass && options.cache_directory == NULL && 
+        strlen(source) >= PARSER_PARALLEL_THRESHOLD)
     {
-        lexing_end = clock();
-        lexing_time = (double)(lexing_end - lexing_start) * 1000 / (double)CLOCKS_PER_SEC;
+        lex(&lexer);
+        parser_init(&parser, lexer.tokens);
     }
+    else
+        parser_init_streaming(&parser, &lexer);
 
-    if (lexer.diagnostics->length > 0)
-    {
-        if (options.show_summary)
-            printf("FAILED\n");
-
-        print_diagnostics(lexer.diagnostics);
-        goto teardown_lexer;
-    } 
-
-    if (options.show_summary)
-        printf("OK\n");
+    parser.lazy = lazy;
+    parser.share = options.share;
 
+    // NOTE(timo): The cache restores the symbols of the program too, so the
+    // resolver is created before the tree is loaded
+    type_table = type_table_init();
+    resolver_init(&resolver, type_table);
+    resolver.lazy = options.lazy && ! options.single_pass;
+    resolver.shared = options.share;
+    bool cached = false;
 
-    // Parsing
-    Parser parser;
-    clock_t parsing_start;
-    clock_t parsing_end;
-    double parsing_time = 0.0;
+    // NOTE(timo): In the single pass mode the whole front end is run while 
+    // parsing and there is never a whole tree to be cached
+    if (options.single_pass)
+    {
+        ir_generator_init(&ir_generator, resolver.global);
+        ir_generator.fold = options.fold;
+        ir_generator.shared = options.share;
 
-    if (options.show_summary)
+        compile_single_pass(&lexer, &parser, &resolver, &ir_generator);
+    }
+    else if (options.cache_directory == NULL || 
+        ! (cached = ast_cache_load(options.cache_directory, source, &parser.arena, parser.declarations, &resolver)))
     {
-        printf("Parsing...");
-        parsing_start = clock();
+        parse(&parser);
     }
 
-    parser_init(&parser, lexer.tokens);
-    parse(&parser);
-
     if (options.show_summary)
     {
         parsing_end = clock();
         parsing_time = (double)(parsing_end - parsing_start) * 1000 / (double)CLOCKS_PER_SEC;
     }
 
-    if (parser.diagnostics->length > 0)
+    // NOTE(timo): The errors of the lexer are reported first, since they most
+    // likely cause the errors of the parser
+    if (lexer.diagnostics->length > 0 || parser.diagnostics->length > 0)
     {
         if (options.show_summary)
             printf("FAILED\n");
 
-        print_diagnostics(parser.diagnostics);
-        goto teardown_parser;
+        print_diagnostics(lexer.diagnostics->length > 0 ? lexer.diagnostics : parser.diagnostics, source);
+
+        if (options.single_pass)
+            goto teardown_ir_generator;
+
+        goto teardown_resolver;
     }
 
     if (options.show_summary)
@@ -170,21 +267,21 @@ void compile(const char* source, struct Options options)
 
 
     // Resolving
-    hashtable* type_table;
-    Resolver resolver;
-    clock_t resolving_start;
-    clock_t resolving_end;
-    double resolving_time = 0.0;
-
     if (options.show_summary)
     {
         printf("Resolving...");
         resolving_start = clock();
     }
 
-    type_table = type_table_init();
-    resolver_init(&resolver, type_table);
-    resolve(&resolver, parser.declarations);
+    // NOTE(timo): In the single pass mode the declarations are already resolved
+    // and the cached trees are saved resolved
+    if (! options.single_pass && ! cached)
+    {
+        resolve(&resolver, parser.declarations);
+
+        if (options.cache_directory && resolver.diagnostics->length == 0)
+            ast_cache_save(options.cache_directory, source, parser.declarations, &resolver);
+    }
 
     if (options.show_summary)
     {
@@ -197,7 +294,11 @@ void compile(const char* source, struct Options options)
         if (options.show_summary)
             printf("FAILED\n");
 
-        print_diagnostics(resolver.diagnostics);
+        print_diagnostics(resolver.diagnostics, source);
+
+        if (options.single_pass)
+            goto teardown_ir_generator;
+
         goto teardown_resolver;
     }
 
@@ -213,19 +314,20 @@ void compile(const char* source, struct Options options)
 
 
     // IR generation
-    IR_Generator ir_generator;
-    clock_t ir_generating_start;
-    clock_t ir_generating_end;
-    double ir_generating_time = 0.0;
-
     if (options.show_summary)
     {
         printf("IR Generating...");
         ir_generating_start = clock();
     }
 
-    ir_generator_init(&ir_generator, resolver.global);
-    ir_generate(&ir_generator, parser.declarations);
+    // NOTE(timo): In the single pass mode the IR is already generated
+    if (! options.single_pass)
+    {
+        ir_generator_init(&ir_generator, resolver.global);
+        ir_generator.fold = options.fold;
+        ir_generator.shared = options.share;
+        ir_generate(&ir_generator, parser.declarations);
+    }
 
     if (options.show_summary)
     {
@@ -238,7 +340,7 @@ void compile(const char* source, struct Options options)
         if (options.show_summary)
             printf("FAILED\n");
 
-        print_diagnostics(ir_generator.diagnostics);
+        print_diagnostics(ir_generator.diagnostics, source);
         goto teardown_ir_generator;
     }
 
@@ -250,10 +352,6 @@ void compile(const char* source, struct Options options)
 
 
     // Code generation
-    clock_t code_generating_start;
-    clock_t code_generating_end;
-    double code_generating_time = 0.0;
-
     if (options.show_summary)
     {
         printf("Code generating...");
@@ -279,7 +377,7 @@ void compile(const char* source, struct Options options)
         if (options.show_summary)
             printf("FAILED\n");
 
-        print_diagnostics(code_generator.diagnostics);
+        print_diagnostics(code_generator.diagnostics, source);
         goto teardown_code_generator;
     }
 
@@ -306,10 +404,6 @@ void compile(const char* source, struct Options options)
 
 
     // Assembling
-    clock_t assembly_start;
-    clock_t assembly_end;
-    double assembly_time = 0.0;
-
     char assemble[128];
     snprintf(assemble, 128, "nasm -f elf64 -o %s.o %s.asm", options.program, options.program);
     int assemble_error;
@@ -338,10 +432,6 @@ void compile(const char* source, struct Options options)
 
 
     // Linking
-    clock_t linker_start;
-    clock_t linker_end;
-    double linker_time = 0.0;
-
     char link[128];
     snprintf(link, 128, "gcc -no-pie -o %s %s.o", options.program, options.program);
     int link_error;
@@ -386,21 +476,18 @@ teardown_ir_generator:
 teardown_resolver:
     resolver_free(&resolver);
     type_table_free(type_table);
-teardown_parser:
     parser_free(&parser);
-teardown_lexer:
     lexer_free(&lexer);
 
     if (options.show_summary)
     {
         // Compilation summary
-        double compilation_time = (lexing_time + parsing_time + resolving_time + ir_generating_time +
+        double compilation_time = (parsing_time + resolving_time + ir_generating_time +
                                    code_generating_time + assembly_time + linker_time);
 
         printf("-----===== COMPILATION SUMMARY =====-----\n");
         printf("Total compilation time: %f ms\n", compilation_time);
-        printf("    Lexing time:             %f ms\n", lexing_time);
-        printf("    Parsing time:            %f ms\n", parsing_time);
+        printf("    Lexing and parsing time: %f ms\n", parsing_time);
         printf("    Resolving time:          %f ms\n", resolving_time);
         printf("    IR generation time:      %f ms\n", ir_generating_time);
         printf("    Code generation time:    %f ms\n", code_generating_time);
@@ -413,9 +500,9 @@ teardown_lexer:
 
 void compile_from_file(const char* path, struct Options options)
 {
-    const char* source = read_file(path);
+    Source_File source = load_file(path);
 
-    compile(source, options);
+    compile(source.contents, options);
 
-    free((char*)source);
+    unload_file(&source);
 }
@@ -28,6 +28,7 @@
 #include "stringbuilder.h"  // for my stringbuilder
 #include "hashtable.h"      // for hashtable implementation
 #include "memory.h"         // for custom x-allocators
+#include "intern.h"         // for string interning
 #include "common.h"         // for general utility functions
 
 #include <stdio.h>          // for printing and stuff
@@ -44,6 +45,7 @@
 // List of type definitions forward declared just so they can be used everywhere.
 typedef struct Type Type;
 typedef struct Scope Scope;
+typedef struct Symbol Symbol;
 typedef struct AST_Declaration AST_Declaration;
 typedef struct AST_Statement AST_Statement;
 typedef struct AST_Expression AST_Expression;
@@ -54,20 +56,80 @@ typedef struct AST_Expression AST_Expression;
 // Since for now we will only support compiling of single file, there is no 
 // need to add the file attribute for the position at this stage. Maybe later.
 //
+// The position is saved as byte offsets into the source, so it is cheap to
+// create and to save into every token and AST node. The lines and columns are
+// computed from the offsets with the Line_Table only when they are needed,
+// e.g. when the diagnostics are printed.
+//
 // Members
-//      line_start: Starting line of the thing.
-//      column_start: Starting column of the thing.
-//      line_end: Ending line of the thing.
-//      column_end: Ending column of the thing.
+//      start: Offset of the first character of the thing.
+//      end: Offset of the last character of the thing.
 typedef struct Position
 {
-    int line_start;
-    int column_start;
-    int line_end;
-    int column_end;
+    int start;
+    int end;
 } Position;
 
 
+// Line and column of a single offset in the source. Both start from 1.
+//
+// Members
+//      line: Line of the offset.
+//      column: Column of the offset.
+typedef struct Location
+{
+    int line;
+    int column;
+} Location;
+
+
+// Table of the offsets where each of the lines start in the source. The table
+// is built with a single pass over the source and after that the line and the
+// column of any offset can be found with binary search.
+//
+// Members
+//      starts: Offsets of the first characters of the lines.
+//      length: Number of the lines.
+//      capacity: Number of the offsets the table can hold.
+typedef struct Line_Table
+{
+    int* starts;
+    int length;
+    int capacity;
+} Line_Table;
+
+
+// Builds the line table for the source.
+//
+// File(s): diagnostics.c
+//
+// Arguments
+//      table: Line table to be initialized.
+//      source: Source to build the table from.
+void line_table_init(Line_Table* table, const char* source);
+
+
+// Frees the memory allocated for the line table.
+//
+// File(s): diagnostics.c
+//
+// Arguments
+//      table: Line table to be freed.
+void line_table_free(Line_Table* table);
+
+
+// Finds the line and the column of the offset.
+//
+// File(s): diagnostics.c
+//
+// Arguments
+//      table: Initialized line table of the source.
+//      offset: Offset in the source.
+// Returns
+//      Line and column of the offset.
+Location line_table_location(const Line_Table* table, const int offset);
+
+
 // Enumeration of different diagnostic kinds.
 typedef enum Diagnostic_Kind
 {
@@ -104,13 +166,15 @@ typedef struct Diagnostic
 Diagnostic* diagnostic(const Diagnostic_Kind kind, const Position position, const char* message, ...);
 
 
-// Prints all diagnostic messages in array of diagnostics.
+// Prints all diagnostic messages in array of diagnostics. The line table of
+// the source is built only if there is something to print.
 //
 // File(s): diagnostics.c
 //
 // Arguments
 //      diagnostics: Array of diagnostics.
-void print_diagnostics(const array* diagnostics);
+//      source: Source where the diagnostics were spotted.
+void print_diagnostics(const array* diagnostics, const char* source);
 
 
 // Prints diagnostic message.
@@ -119,7 +183,8 @@ void print_diagnostics(const array* diagnostics);
 //
 // Arguments
 //      diagnostic: Diagnostic to be printed.
-void print_diagnostic(const Diagnostic* diagnostic);
+//      lines: Line table of the source where the diagnostic was spotted.
+void print_diagnostic(const Diagnostic* diagnostic, const Line_Table* lines);
 
 
 // Struture for compiler options which are parsed at the beginning of the
@@ -137,6 +202,16 @@ void print_diagnostic(const Diagnostic* diagnostic);
 //                    resolving stage.
 //      show_ir: If the IR instructions are printed after generating them.
 //      show_asm: If the generated assembly file is printed.
+//      lazy: If only the functions used by the program are parsed and 
+//            resolved. The syntax of the unused functions is still checked,
+//            but their types are not.
+//      share: If the identical pure expressions are shared in the tree.
+//      single_pass: If the declarations are resolved and their IR generated
+//                   right after each of them is parsed. Meant for the fast
+//                   edit-compile-run loop, the separate passes are the default.
+//      fold: If the constant expressions are generated as their folded values.
+//      cache_directory: Directory of the cache of the resolved programs. NULL
+//                       if the cache is not used.
 struct Options
 {
     const char* program;
@@ -150,6 +225,12 @@ struct Options
     bool show_symbols;
     bool show_ir;
     bool show_asm;
+
+    bool lazy;
+    bool share;
+    bool single_pass;
+    bool fold;
+    const char* cache_directory;
 };
 
 
@@ -220,6 +301,10 @@ typedef enum Token_Kind
 
     // Type specifiers
     TOKEN_INT, TOKEN_BOOL,
+
+    // NOTE(timo): Number of the token kinds, used to size the tables indexed
+    // by the token kind. Keep this as the last one.
+    TOKEN_KIND_COUNT,
 } Token_Kind;
 
 
@@ -228,17 +313,27 @@ typedef enum Token_Kind
 // Members
 //      kind: Classification of the lexeme.
 //      position: Position of the lexeme in the source file.
-//      lexeme: The lexeme itself.
 //      lexeme_length: Length of the lexeme.
+//      lexeme: The lexeme itself, interned.
+//      integer: Value of the integer literal computed by the lexer, so the
+//               later stages don't have to parse the lexeme again. If the
+//               literal doesn't fit into 64 bits, the value is INT64_MAX.
 typedef struct Token 
 {
     Token_Kind kind;
     Position position;
-    const char* lexeme;
     int lexeme_length;
+    const char* lexeme;
+    int64_t integer;
 } Token;
 
 
+// Contiguous array of tokens, the token stream.
+//
+// File(s): array.h
+TYPED_ARRAY(Token_Array, token_array, Token)
+
+
 // Factory function for initializing a token.
 //
 // File(s): token.c
@@ -249,24 +344,28 @@ typedef struct Token
 //      lexeme_length: Length of the lexeme.
 //      position: Position of the lexeme in the source file.
 // Returns
-//      Pointer to the newly created Token.
-Token* token(Token_Kind kind, const char* lexeme, const int lexeme_length, Position position);
+//      The newly created Token.
+Token token(Token_Kind kind, const char* lexeme, const int lexeme_length, Position position);
 
 
 // Lexer scans through the source (file or string), analyzes the scanned
 // lexemes and creates a stream of tokens from the lexemes.
 //
 // Members
+//      source: Start of the source. The source is not copied, so it has to
+//              outlive the tokens, e.g. the memory mapped file.
 //      stream: Source stream of characters.
+//      end: End of the source stream, which is the terminating 0 of the 
+//           source or the end of the chunk in parallel lexing.
 //      diagnostics: Array of collected diagnostics.
-//      tokens: Array of collected tokens.
-//      position: Position of the current lexeme.
+//      tokens: Contiguous array of collected tokens.
 typedef struct Lexer
 {
+    const char* source;
     const char* stream;
+    const char* end;
     array* diagnostics;
-    array* tokens;
-    Position position;
+    Token_Array* tokens;
 } Lexer;
 
 
@@ -280,6 +379,20 @@ typedef struct Lexer
 void lexer_init(Lexer* lexer, const char* source);
 
 
+// Factory function to initialize new Lexer which lexes only a part of the 
+// source. The positions of the tokens are still offsets from the start of the
+// whole source.
+//
+// File(s): lexer.c
+//
+// Arguments:
+//      lexer: Pointer to the Lexer structure.
+//      source: Start of the whole source.
+//      start: Start of the part to be lexed.
+//      end: End of the part to be lexed.
+void lexer_init_range(Lexer* lexer, const char* source, const char* start, const char* end);
+
+
 // Frees the memory allocated for Lexer.
 //
 // File(s): lexer.c
@@ -289,9 +402,15 @@ void lexer_init(Lexer* lexer, const char* source);
 void lexer_free(Lexer* lexer);
 
 
+// Sources bigger than this are lexed in parallel if there is more than one
+// processor available. Smaller sources are not worth of starting the threads.
+#define LEXER_PARALLEL_THRESHOLD (1024 * 1024)
+
+
 // Main function of the lexer which scans through the source and produces a
 // stream of tokens. Generated tokens can be accessed from the Lexers 'tokens'
-// which is an array.
+// which is an array. Large sources are lexed in parallel with lex_parallel
+// if there are multiple processors available.
 //
 // File(s): lexer.c
 //
@@ -300,6 +419,33 @@ void lexer_free(Lexer* lexer);
 void lex(Lexer* lexer);
 
 
+// Splits the source into chunks at the newlines and lexes each chunk in its
+// own thread. The tokens and the diagnostics of the chunks are concatenated
+// in the order of the chunks, so the result is identical to lexing the whole
+// source at once.
+//
+// File(s): lexer.c
+//
+// Arguments:
+//      lexer: Pointer to already initialized Lexer.
+//      chunks: Number of the chunks/threads.
+void lex_parallel(Lexer* lexer, int chunks);
+
+
+// Scans the next token from the source. This lets the parser pull the tokens
+// one at a time, so the whole token stream is never held in the memory. The
+// diagnostics are collected to the Lexer in the same way as with lex().
+//
+// File(s): lexer.c
+//
+// Arguments:
+//      lexer: Pointer to already initialized Lexer.
+// Returns
+//      The next token. After the source has been scanned through, the end of
+//      file token is returned every time.
+Token next_token(Lexer* lexer);
+
+
 // Enumeration of different value types to separate different kind of Value
 // structures from each other.
 //
@@ -413,6 +559,7 @@ const char* declaration_str(const Declaration_Kind kind);
 //      specifier: Type of the declaration.
 //      identifier: Name of the declaration.
 //      initializer: Value of the declaration.
+//      symbol: Symbol declared by the declaration. Bound by the resolver.
 struct AST_Declaration
 {
     Declaration_Kind kind;
@@ -420,6 +567,7 @@ struct AST_Declaration
     Type_Specifier specifier;
     Token* identifier;
     AST_Expression* initializer;
+    Symbol* symbol;
 };
 
 
@@ -428,16 +576,18 @@ struct AST_Declaration
 // File(s): ast.c
 //
 // Arguments
+//      arena: Arena the declaration is allocated from.
 //      identifier: Name of the declaration.
 //      specifier: Intended type of the declaration.
 //      initializer: Value of the declaration.
 // Returns
 //      Pointer to newly created declaration.
-AST_Declaration* function_declaration(Token* identifier, Type_Specifier specifier, AST_Expression* initializer);
-AST_Declaration* variable_declaration(Token* identifier, Type_Specifier specifier, AST_Expression* initializer);
+AST_Declaration* function_declaration(arena* arena, Token* identifier, Type_Specifier specifier, AST_Expression* initializer);
+AST_Declaration* variable_declaration(arena* arena, Token* identifier, Type_Specifier specifier, AST_Expression* initializer);
 
 
-// Frees the memory allocated for a declaration.
+// Frees the memory allocated for a declaration. The memory of the nodes is owned
+// by the parsers arena, so this doesn't release anything by itself.
 //
 // File(s): ast.c
 //
@@ -528,19 +678,22 @@ struct AST_Statement
 //      will set the kind and position based on given arguments so the needed
 //      arguments are the ones in the union where arguments are given based
 //      on the statement.
+//
+//      The first argument is always the arena the statement is allocated from.
 // Returns
 //      Pointer to the newly created statement.
-AST_Statement* expression_statement(AST_Expression* expression);
-AST_Statement* block_statement(array* statements, int statements_length);
-AST_Statement* if_statement(AST_Expression* condition, AST_Statement* then, AST_Statement* _else);
-AST_Statement* while_statement(AST_Expression* condition, AST_Statement* body);
-AST_Statement* break_statement();
-AST_Statement* continue_statement();
-AST_Statement* return_statement(AST_Expression* value);
-AST_Statement* declaration_statement(AST_Declaration* declaration);
+AST_Statement* expression_statement(arena* arena, AST_Expression* expression);
+AST_Statement* block_statement(arena* arena, array* statements, int statements_length);
+AST_Statement* if_statement(arena* arena, AST_Expression* condition, AST_Statement* then, AST_Statement* _else);
+AST_Statement* while_statement(arena* arena, AST_Expression* condition, AST_Statement* body);
+AST_Statement* break_statement(arena* arena);
+AST_Statement* continue_statement(arena* arena);
+AST_Statement* return_statement(arena* arena, AST_Expression* value);
+AST_Statement* declaration_statement(arena* arena, AST_Declaration* declaration);
 
 
-// Frees the memory allocated for a statement.
+// Frees the memory allocated for a statement. The memory of the nodes is owned
+// by the parsers arena, so this doesn't release anything by itself.
 //
 // File(s): ast.c
 //
@@ -569,11 +722,12 @@ typedef struct Parameter
 // File(s): ast.c
 //
 // Arguments
+//      arena: Arena the parameter is allocated from.
 //      identifier: Name of the parameter.
 //      specifier: Type of the parameter.
 // Returns
 //      Pointer to the newly created parameter.
-Parameter* function_parameter(Token* identifier, Type_Specifier specifier);
+Parameter* function_parameter(arena* arena, Token* identifier, Type_Specifier specifier);
 
 
 // Enumeration of different expression classifications.
@@ -600,13 +754,59 @@ typedef enum Expression_Kind
 const char* expression_str(const Expression_Kind kind);
 
 
+// Unparsed body of a function expression. The body is skipped after its 
+// tokens are pre-scanned for syntax errors, and parsed only when it is needed
+// for the first time. The bodies with syntax errors are never skipped.
+//
+// Members
+//      source: Start of the whole source the body is in.
+//      position: Range of the body in the source including the braces.
+//      arena: Arena of the tree where the parsed body is moved into.
+//      share: If the identical expressions of the body are shared.
+typedef struct Lazy_Body
+{
+    const char* source;
+    Position position;
+    arena* arena;
+    bool share;
+} Lazy_Body;
+
+
+// Position of a later occurrence of a shared expression in the source. The
+// occurrences of an expression form a circular list in the order of the 
+// source and the expression refers to the last of them, so the parser adds 
+// to the end of the list and the resolver takes from the start of it.
+//
+// Members
+//      position: Position of the occurrence.
+//      next: Next occurrence, or the first one after the last occurrence.
+typedef struct Occurrence Occurrence;
+
+struct Occurrence
+{
+    Position position;
+    Occurrence* next;
+};
+
+
 // General structure for expressions.
 //
 // Members
 //      kind: Classification of the expression.
-//      position: Position of the expression. 
+//      position: Position of the expression. The shared expression has the
+//                position of the occurrence being resolved.
 //      type: Type of the expression.
 //      value: Value of the expression.
+//      symbol: Symbol referenced by a variable expression. Bound by the 
+//              resolver, so the later stages don't have to look up the name
+//              again. The variables being assigned and the functions being 
+//              called are variable expressions too.
+//      occurrences: Later occurrences of a shared expression still to be 
+//                   resolved, or NULL. See Occurrence.
+//      result: Index + 1 of the result of the shared expression saved by the
+//              IR generator, or 0 if there is none. See Shared_Result.
+//      visited: Mark of the expressions visited by the IR generator while
+//               checking a shared result. Cleared after each check.
 //
 //      identifier: Identifier token if the expression is a variable expression.
 //      literal: Literal value if the expression is a literal expression.
@@ -626,7 +826,12 @@ const char* expression_str(const Expression_Kind kind);
 //      function:
 //          parameters: Array of function parameters.
 //          arity: How many arguments the function can take.
-//          body: Body of the function containing array of statements.
+//          body: Body of the function containing array of statements. NULL
+//                if the parsing of the body is postponed.
+//          lazy: Unparsed body of the function or NULL if the body is parsed.
+//          scope: Local scope of the function created by the resolver. The 
+//                 scope is passed on to the symbol of the function declared
+//                 with the expression.
 //      call:
 //          variable: Name of the function or callable being called.
 //          arguments: Array of arguments passed to the function or callable.
@@ -636,6 +841,10 @@ struct AST_Expression
     Position position;
     Type* type;
     Value value;
+    Symbol* symbol;
+    Occurrence* occurrences;
+    int result;
+    bool visited;
 
     union {
         Token* identifier;
@@ -661,6 +870,8 @@ struct AST_Expression
             array* parameters;
             int arity;
             AST_Statement* body;
+            Lazy_Body* lazy;
+            Scope* scope;
         } function;
         struct {
             AST_Expression* variable;
@@ -680,22 +891,106 @@ struct AST_Expression
 //      arguments are the ones in the union where arguments are given based
 //      on the statement.
 //
-//      Type and Value of the expression will be set on later stages of the
-//      compilation.
+//      The first argument is always the arena the expression is allocated
+//      from. Type and Value of the expression will be set on later stages of
+//      the compilation.
 // Returns
 //      Pointer to the newly created expression.
-AST_Expression* literal_expression(Token* literal);
-AST_Expression* unary_expression(Token* _operator, AST_Expression* operand);
-AST_Expression* binary_expression(AST_Expression* left, Token* _operator, AST_Expression* right);
-AST_Expression* variable_expression(Token* identifier);
-AST_Expression* assignment_expression(AST_Expression* variable, AST_Expression* value);
-AST_Expression* index_expression(AST_Expression* variable, AST_Expression* value);
-AST_Expression* function_expression(array* parameters, int arity, AST_Statement* body);
-AST_Expression* call_expression(AST_Expression* variable, array* arguments);
-AST_Expression* error_expression();
+AST_Expression* literal_expression(arena* arena, Token* literal);
+AST_Expression* unary_expression(arena* arena, Token* _operator, AST_Expression* operand);
+AST_Expression* binary_expression(arena* arena, AST_Expression* left, Token* _operator, AST_Expression* right);
+AST_Expression* variable_expression(arena* arena, Token* identifier);
+AST_Expression* assignment_expression(arena* arena, AST_Expression* variable, AST_Expression* value);
+AST_Expression* index_expression(arena* arena, AST_Expression* variable, AST_Expression* value);
+AST_Expression* function_expression(arena* arena, array* parameters, int arity, AST_Statement* body);
+AST_Expression* call_expression(arena* arena, AST_Expression* variable, array* arguments);
+AST_Expression* error_expression(arena* arena);
+
+
+// Table of the shared expressions for the hash-consing of the pure 
+// expressions: literals, variables and unary and binary operators. Each 
+// distinct expression is created only once and the identical expressions 
+// refer to the same node, so the tree becomes a directed acyclic graph. 
+// Since the children are shared before their parents, the expressions are 
+// compared by the pointers of their children without walking the subtrees.
+//
+// File(s): ast.c
+//
+// Members
+//      capacity: Number of the slots. Always zero or a power of two.
+//      count: Number of the expressions in the table.
+//      slots: Open addressing table of the expressions.
+typedef struct Expression_Table
+{
+    int capacity;
+    int count;
+    AST_Expression** slots;
+} Expression_Table;
+
+
+// Initializes, frees and clears the table of the shared expressions.
+//
+// File(s): ast.c
+//
+// Arguments
+//      table: Pointer to the Expression_Table structure.
+void expression_table_init(Expression_Table* table);
+void expression_table_free(Expression_Table* table);
+void expression_table_clear(Expression_Table* table);
+
+
+// Finds the shared expression identical to the expression which would be
+// created from the arguments.
+//
+// File(s): ast.c
+//
+// Arguments
+//      table: Table of the shared expressions.
+//      kind: Kind of the expression.
+//      token: Literal or identifier of the leaves and operator of the rest.
+//      left: Operand of the unary and left operand of the binary expression.
+//      right: Right operand of the binary expression.
+// Returns
+//      Pointer to the shared expression or NULL if there is none.
+AST_Expression* expression_table_get(const Expression_Table* table, const Expression_Kind kind, const Token* token, const AST_Expression* left, const AST_Expression* right);
+
+
+// Adds a new pure expression into the table of the shared expressions.
+//
+// File(s): ast.c
+//
+// Arguments
+//      table: Table of the shared expressions.
+//      expression: Expression to be shared.
+void expression_table_put(Expression_Table* table, AST_Expression* expression);
+
+
+// Adds a later occurrence to the end of the occurrences of a shared
+// expression.
+//
+// File(s): ast.c
+//
+// Arguments
+//      arena: Arena owning the tree of the expression.
+//      expression: Shared expression.
+//      position: Position of the occurrence.
+void expression_add_occurrence(arena* arena, AST_Expression* expression, const Position position);
+
+
+// Moves a shared expression to its next occurrence, i.e. takes the first of
+// its occurrences as its position.
+//
+// File(s): ast.c
+//
+// Arguments
+//      expression: Shared expression.
+// Returns
+//      Value true if the expression had an occurrence left, otherwise false.
+bool expression_next_occurrence(AST_Expression* expression);
 
 
-// Frees the memory allocated for an expression.
+// Frees the memory allocated for an expression. The memory of the nodes is
+// owned by the parsers arena, so this doesn't release anything by itself.
 //
 // File(s): ast.c
 //
@@ -715,25 +1010,52 @@ void expression_free(AST_Expression* expression);
 const char* expression_to_string(const AST_Expression* expression);
 
 
+// Size of the lookahead ring buffer of the parser. Has to be a power of two.
+// The parser itself looks only one token ahead, but the current token has to
+// stay valid while the next one is pulled.
+#define PARSER_LOOKAHEAD 4
+
+
 // Structure for keeping track of the parser data.
+//
+// The tokens are either read from the array produced by lex() or pulled one
+// at a time from the lexer with next_token() into the lookahead ring buffer.
 // 
 // Members
 //      diagnostics: Array of collected diagnostics.
-//      position: TODO(timo): Is this needed to anything?
+//      position: Position of the last parsed expression. The shared 
+//                expressions keep the position of their first occurrence,
+//                so the position of the occurrence is passed on here.
 //      index: Index of the current token.
-//      tokens: Stream of tokens in an array.
+//      tokens: Stream of tokens in an array. NULL if the tokens are pulled.
+//      lexer: Lexer the tokens are pulled from. NULL if the tokens are read
+//             from the array.
+//      lookahead: Ring buffer of the pulled tokens.
 //      current_token: Current token from the token stream.
 //      declarations: Array of declarations.
 //      panic: If error recovery is needed to execute.
+//      lazy: If the function bodies are skipped and parsed only when they
+//            are needed. Only parsers pulling the tokens from the lexer can
+//            skip the bodies, since the skipped tokens are lexed again.
+//      share: If the identical pure expressions inside a declaration are 
+//             shared. See Expression_Table.
+//      expressions: Table of the shared expressions.
+//      arena: Arena which owns the memory of the abstract syntax tree.
 typedef struct Parser
 {
     array* diagnostics;
     Position position;
-    array* tokens;
+    Token_Array* tokens;
+    Lexer* lexer;
+    Token lookahead[PARSER_LOOKAHEAD];
     int index;
     Token* current_token;
     array* declarations;
     bool panic;
+    bool lazy;
+    bool share;
+    Expression_Table expressions;
+    arena arena;
 } Parser;
 
 
@@ -744,7 +1066,18 @@ typedef struct Parser
 // Arguments
 //      parser: Pointer to Parser structure.
 //      tokens: Stream of tokens to be parsed into abstract syntax tree.
-void parser_init(Parser* parser, array* tokens);
+void parser_init(Parser* parser, Token_Array* tokens);
+
+
+// Factory function to initialize new parser which pulls the tokens from the
+// lexer while parsing. The lexer doesn't have to lex the source beforehand.
+//
+// File(s): parser.c
+//
+// Arguments
+//      parser: Pointer to Parser structure.
+//      lexer: Initialized lexer the tokens are pulled from.
+void parser_init_streaming(Parser* parser, Lexer* lexer);
 
 
 // Frees the memory allocated for a parser.
@@ -756,9 +1089,16 @@ void parser_init(Parser* parser, array* tokens);
 void parser_free(Parser* parser);
 
 
+// Minimum number of tokens for the parallel parsing. Smaller token streams
+// are parsed faster than the threads are started.
+#define PARSER_PARALLEL_THRESHOLD (128 * 1024)
+
+
 // Main function that turns a stream of tokens into a abstract syntax tree.
 // The stream of tokens will be parsed into an array of declarations which
-// can be accessed through the field 'declarations' after parsing.
+// can be accessed through the field 'declarations' after parsing. Large 
+// token streams are parsed in parallel with parse_parallel if there are 
+// multiple processors available.
 //
 // File(s): parser.c
 //
@@ -767,6 +1107,35 @@ void parser_free(Parser* parser);
 void parse(Parser* parser);
 
 
+// Splits the token stream into chunks at the ends of the top level 
+// declarations and parses each chunk in its own thread and arena. The 
+// declarations and the diagnostics of the chunks are concatenated in the 
+// order of the chunks, so the result is identical to parsing the whole 
+// stream at once. Only parsers reading the tokens from an array can parse
+// in parallel.
+//
+// File(s): parser.c
+//
+// Arguments
+//      parser: Pointer to a already initialized Parser.
+//      chunks: Number of the chunks/threads.
+void parse_parallel(Parser* parser, int chunks);
+
+
+// Parses the postponed body of a function expression. The body is parsed from
+// the source into the arena of the original tree and the function expression
+// is updated to point to it, so the body is parsed only once.
+//
+// File(s): parser.c
+//
+// Arguments
+//      expression: Function expression.
+//      diagnostics: Array where the diagnostics of the parsing are pushed to.
+// Returns
+//      Pointer to the body of the function.
+AST_Statement* parse_function_body(AST_Expression* expression, array* diagnostics);
+
+
 // Main interface for parsing type specifiers. 
 //
 // File(s): parser.c
@@ -811,6 +1180,19 @@ AST_Statement* parse_statement(Parser* parser);
 AST_Declaration* parse_declaration(Parser* parser);
 
 
+// Parses the next top level declaration and recovers from the errors found
+// in it, so the parsing can continue from the next declaration. The parsed
+// declaration is not saved to the 'declarations' of the parser.
+//
+// File(s): parser.c
+//
+// Arguments
+//      parser: Pointer to a already initialized Parser.
+// Returns
+//      Pointer to parsed declaration.
+AST_Declaration* parse_top_level_declaration(Parser* parser);
+
+
 // Enumeration of different type classicifations.
 typedef enum Type_Kind
 {
@@ -835,6 +1217,11 @@ const char* type_as_string(const Type_Kind kind);
 // info used later for type checking and for allocating and aligning the 
 // memory correctly.
 //
+// The types are canonical. Every distinct type is created only once and the
+// identical types are the same object, so the types are compared just by
+// comparing the pointers. All the types are owned by the type table and they
+// are freed with it.
+//
 // Members
 //      kind: Kind of the type
 //      size: Size of the type. At this point every type is 8 bytes to make
@@ -844,8 +1231,7 @@ const char* type_as_string(const Type_Kind kind);
 //      function:
 //          return_type: Type of the value returned by the function.
 //          arity: How many arguments the function takes.
-//          parameters: Parameters of the function if there is any.
-//          scope: Functions local scope.
+//          parameters: Types of the parameters of the function.
 //      array:
 //          element_type: Type of the elements in the array.
 //          length: Length/size of the array. Not in any use at this point
@@ -861,8 +1247,7 @@ struct Type
         struct {
             Type* return_type;
             int arity;
-            array* parameters; // array of pointers to parameter symbols
-            Scope* scope;
+            array* parameters; // array of pointers to parameter types
         } function;
         struct {
             Type* element_type;
@@ -872,19 +1257,37 @@ struct Type
 };
 
 
-// Factory functions for initializing types.
+// Factory functions for initializing the primitive types. These are used
+// only to fill the type table, everyone else gets the primitive types from 
+// the table.
 //
 // File(s): type.c
 //
-// Arguments
-//      element_type: Type of the element in the array. Only used with arrays.
 // Returns
 //      Pointer to the newly created type.
 Type* type_none();
 Type* type_integer();
 Type* type_boolean();
-Type* type_function();
-Type* type_array(Type* element_type);
+
+
+// Factory functions for the composite types. The type is created only if 
+// there is no identical type built on the same component types yet. The 
+// types are kept in the type table by the pointers to their component types,
+// so an existing type is found with one lookup.
+//
+// File(s): type.c
+//
+// Arguments
+//      type_table: Type table owning the types.
+//      return_type: Type of the value returned by the function. NULL if the
+//                   function doesn't return anything.
+//      parameters: Types of the parameters of the function.
+//      arity: Number of the parameters.
+//      element_type: Type of the element in the array.
+// Returns
+//      Pointer to the canonical type.
+Type* type_function(hashtable* type_table, Type* return_type, Type** parameters, int arity);
+Type* type_array(hashtable* type_table, Type* element_type);
 
 
 // Functions to check and compare types.
@@ -910,7 +1313,8 @@ const bool types_equal(const Type* type1, const Type* type2);
 const bool types_not_equal(const Type* type1, const Type* type2);
 
 
-// Frees the memory allocated for the Type structure.
+// Frees the memory allocated for the Type structure. Only the type table 
+// frees the types, since everyone else shares them.
 //
 // File(s): type.c
 //
@@ -919,7 +1323,8 @@ const bool types_not_equal(const Type* type1, const Type* type2);
 void type_free(Type* type);
 
 
-// Initializes a new type table containing all the primitive types.
+// Initializes a new type table containing all the primitive types and the
+// types of all the type specifiers.
 //
 // File(s): type.c
 //
@@ -938,9 +1343,8 @@ void type_table_free(hashtable* table);
 
 
 // Used to tie the type and the value together when resolving expressions
-// and having most use when doing constant folding.
-//  
-// HOX! NOT IN USE AT THE MOMENT.
+// and having most use when doing constant folding. Operand without a constant
+// value has the value of type VALUE_NONE.
 //
 // Members
 //      type: Type of the operand.
@@ -966,9 +1370,9 @@ typedef enum Symbol_Kind
 
 // Symbols state of resolving. This is used if symbols are being resolved
 // out of declaration order or if the symbols are being resolved in multiple
-// passes.
-//
-// NOT IN USE AT THE MOMENT
+// passes. At the moment only the functions deferred by the lazy resolving are
+// unresolved and only the functions whose bodies are resolved in parallel are
+// resolving, all the other symbols are resolved when they are created.
 typedef enum Symbol_State
 {
     STATE_UNRESOLVED,
@@ -981,16 +1385,25 @@ typedef enum Symbol_State
 //
 // Members
 //      kind: Symbol kind.
-//      state: Resolving state of the symbol. NOT USED AT THE MOMENT.
+//      state: Resolving state of the symbol.
 //      scope: Scope which the symbols belongs to.
 //      identifier: Identifier/name for the symbol.
 //      type: Type of the symbol.
 //      value: Value of the symbol.
+//      slot: Index of the parameter or the local variable in the frame of
+//            its function. Assigned by the resolver. The value will be -1 
+//            for the globals, the functions and the temporaries.
+//      index: Index of the symbol in the declaration order of its scope. 
+//             Assigned when the symbol is declared into the scope.
+//      local: Local scope of the function. The scope is owned by the symbol
+//             of the function. NULL for the other symbols.
+//      last_write: Index + 1 of the last instruction writing the variable,
+//                  found by the IR generator, or 0 if there is none.
 //
 //      offset: Stack offset from the stack frame base.
 //      _register: Register where the symbol is allocated. If no register
 //                 is allocated, value will be -1.
-typedef struct Symbol
+struct Symbol
 {
     Symbol_Kind kind;
     Symbol_State state;
@@ -998,11 +1411,15 @@ typedef struct Symbol
     const char* identifier;
     Type* type;
     Value value;
+    int slot;
+    int index;
+    Scope* local;
+    int last_write;
 
     // Register stuff
     int offset;
     int _register;
-} Symbol;
+};
 
 
 // Constructor functions for all the used symbols.
@@ -1023,9 +1440,9 @@ Symbol* symbol_function(Scope* scope, const char* identifier, Type* type);
 
 // Frees the memory allocated for the symbol.
 //
-// The identifier comes from the AST nodes and is also freed when they are freed.
-// The type is free'd by type table if it is primitive type, else symbol has the
-// responsibility of freeing the type of the symbol.
+// The symbol itself and its identifier are allocated from the arena of the
+// scope and they are released with the scope. The types are freed by the type
+// table. The symbol of a function frees the local scope of the function.
 //
 // File(s): symbol.c
 //
@@ -1046,15 +1463,21 @@ void symbol_free(Symbol* symbol);
 //      offset_parameter: Total offset for parameters in the scope. Separate
 //                        offset is used because parameters live in the other
 //                        side of the stack frame than local variables.
+//      frame_size: Number of the slots in the frame of the function, one for
+//                  each of the parameters and the local variables. The slots
+//                  are assigned by the resolver in the order of declaration.
 //      enclosing: Enclosing scope.
 //      symbols: Symbol table containing the symbols in the scope.
+//      arena: Arena which owns the memory of the symbols in the scope.
 struct Scope
 {
     const char* name;
     int offset; // alignment
     int offset_parameter;
+    int frame_size;
     Scope* enclosing;
     hashtable* symbols;
+    arena arena;
 };
 
 
@@ -1079,13 +1502,14 @@ Scope* scope_init(Scope* enclosing, const char* name);
 void scope_free(Scope* scope);
 
 
-// Finds symbol from the passed scope.
+// Finds symbol from the passed scope. The symbol tables are keyed by interned
+// identifiers so the lookup compares only pointers.
 //
 // File(s): scope.c
 //
 // Arguments
 //      scope: Pointer to scope where the symbol will be looked from.
-//      identifier: Name of the symbol to be looked from the scope.
+//      identifier: Interned name of the symbol to be looked from the scope.
 // Returns
 //      Pointer to symbol if it is found, otherwise NULL.
 Symbol* scope_get(const Scope* scope, const char* identifier);
@@ -1098,7 +1522,7 @@ Symbol* scope_get(const Scope* scope, const char* identifier);
 //
 // Arguments
 //      scope: The first scope where the symbol will be looked from.
-//      identifier: Identifier of the symbol to be looked from the scope.
+//      identifier: Interned identifier of the symbol to be looked from the scope.
 // Returns
 //      Pointer to the symbol if it is found, otherwise NULL.
 Symbol* scope_lookup(const Scope* scope, const char* identifier);
@@ -1124,7 +1548,7 @@ void scope_declare(Scope* scope, Symbol* symbol);
 //
 // Arguments
 //      scope: Scope where the key will be looked up from.
-//      identifier: Identifier of the symbol to be looked from the scope.
+//      identifier: Interned identifier of the symbol to be looked from the scope.
 // Returns
 //      Value true if the symbol is found from the scope, otherwise false.
 const bool scope_contains(const Scope* scope, const char* identifier);
@@ -1157,6 +1581,24 @@ void dump_scope(const Scope* scope, int indentation);
 //      type_table: Type table with languages primitive data types.
 //      global: Global scope of the program.
 //      local: Current scope.
+//      dependencies: Array of the interned identifiers looked up while 
+//                    resolving. The identifiers are recorded only if the 
+//                    array is set, which is done by the incremental checking
+//                    to find out what the declarations depend on.
+//      lazy: If the bodies of the functions are resolved only when the 
+//            functions are used. The body of main is always resolved and the
+//            functions which are never used are left unresolved.
+//      deferred: Table of the deferred function declarations by their names.
+//      shared: If the pure expressions of the tree are shared by the parser,
+//              so each of them is resolved only once.
+//      visible: Number of the global symbols visible to the function body
+//               being resolved by resolve_parallel. The globals declared 
+//               after the function are hidden, so the body sees the same 
+//               symbols as in the declaration order. Value -1 means that all
+//               the global symbols are visible.
+//      pool: Pool of the function bodies resolved by resolve_parallel. The
+//            bodies of the used functions are resolved before the users. 
+//            NULL outside of the parallel resolving.
 //      context:
 //          current_function: The name of the current context/scope.
 //          not_int_loop: If loop structure is currently being resolved.
@@ -1170,8 +1612,14 @@ typedef struct Resolver
     // TODO(timo): Separate the global scope as it's own variable in the top level
     Scope* global;
     Scope* local;
-
-    struct {
+    array* dependencies;
+    bool lazy;
+    hashtable* deferred;
+    bool shared;
+    int visible;
+    struct Resolver_Pool* pool;
+
+    struct Resolver_Context {
         // TODO(timo): Check if we can remove this current_function somehow
         char* current_function; // TODO(timo): This could also be pointer to symbol
         bool not_in_loop;
@@ -1250,7 +1698,9 @@ void resolve_declaration(Resolver* resolver, AST_Declaration* declaration);
 Type* resolve_type_specifier(Resolver* resolver, Type_Specifier specifier);
 
 
-// The main interface for resolving generated abstract syntax tree.
+// The main interface for resolving generated abstract syntax tree. Programs
+// with many declarations are resolved with resolve_parallel if there are
+// multiple processors available and the bodies are not resolved lazily.
 //
 // File(s): resolver.c
 //
@@ -1260,6 +1710,366 @@ Type* resolve_type_specifier(Resolver* resolver, Type_Specifier specifier);
 void resolve(Resolver* resolver, array* declarations);
 
 
+// Resolves the declarations in two passes. First the global variables and the
+// signatures of the functions are declared in the declaration order. Then the
+// bodies of the functions are resolved concurrently, since a body only reads 
+// the global scope and writes its own local scope. The diagnostics of the 
+// bodies are merged in the order of the declarations.
+//
+// A body using a function declared before it waits until the body of the
+// function is resolved, or resolves it first if no thread has taken it yet.
+// The function is then declared with the type returned by its body, so the
+// callers are checked against the same type as in the serial resolving.
+//
+// File(s): resolver.c
+//
+// Arguments
+//      resolver: Pointer to initialized Resolver.
+//      declarations: Array of AST_Declarations to be resolved.
+//      threads: Number of the threads.
+void resolve_parallel(Resolver* resolver, array* declarations, int threads);
+
+
+// Index of a node in the AST_Pool. The index 0 is reserved for the missing
+// nodes, e.g. the else branch of an if statement without one.
+typedef uint32_t AST_Index;
+
+
+TYPED_ARRAY(AST_Index_Array, ast_index_array, AST_Index)
+
+
+// Classes of the nodes in the AST_Pool. The kind of a node is saved as one
+// byte, the class in the upper four bits and the kind of the declaration, 
+// statement or expression in the lower four bits.
+typedef enum AST_Node_Class
+{
+    NODE_NONE,
+    NODE_DECLARATION,
+    NODE_PARAMETER,
+    NODE_STATEMENT,
+    NODE_EXPRESSION,
+} AST_Node_Class;
+
+
+#define AST_NODE_KIND(class, kind) ((uint8_t)((class) << 4 | (kind)))
+#define AST_NODE_CLASS(node_kind) ((node_kind) >> 4)
+#define AST_NODE_SUBKIND(node_kind) ((node_kind) & 0xf)
+
+
+// Operands of a node in the AST_Pool. What the operands mean depends on the
+// kind of the node. They are either indices of the child nodes or indices
+// into the extra data of the pool, where the lists of children and the rest
+// of the operands are saved.
+//
+//      declaration:    lhs = specifier, rhs = initializer
+//      parameter:      lhs = specifier
+//      expression statement:   lhs = expression
+//      block:          lhs = extra (count, statements...)
+//      if:             lhs = condition, rhs = extra (then, else)
+//      while:          lhs = condition, rhs = body
+//      return:         lhs = value
+//      declaration statement:  lhs = declaration
+//      unary:          lhs = operand
+//      binary:         lhs = left, rhs = right
+//      assignment:     lhs = variable, rhs = value
+//      index:          lhs = variable, rhs = value
+//      function:       lhs = extra (count, parameters...), rhs = body
+//      call:           lhs = variable, rhs = extra (count, arguments...)
+//
+// Members
+//      lhs: First operand of the node.
+//      rhs: Second operand of the node.
+typedef struct AST_Node_Data
+{
+    AST_Index lhs;
+    AST_Index rhs;
+} AST_Node_Data;
+
+
+// Format of the abstract syntax tree in the cache files. The nodes are saved
+// into contiguous arrays as a structure of arrays and they refer to each other
+// with 32-bit indices instead of pointers, so the arrays can be written into a
+// file and mapped back from it as they are.
+//
+// The pool is only the file format of the cache, the phases of the compiler
+// work on the tree of pointers. The tree is flattened into the pool when it is
+// saved and expanded back into the tree right after it is loaded. The 
+// expressions shared by the parser are flattened only once and their later
+// parents refer to the same node, so the expanded tree shares them too.
+//
+// The tokens referred by the nodes are copied into the pool, every node has
+// one main token e.g. the identifier of a declaration or the operator of a
+// binary expression. Nodes without a main token refer to the token 0.
+//
+// File(s): cache.c
+//
+// Members
+//      length: Number of the nodes in the pool.
+//      capacity: Number of the nodes the arrays have room for.
+//      kinds: Kinds of the nodes. See AST_NODE_KIND.
+//      main_tokens: Indices of the main tokens of the nodes.
+//      positions: Positions of the nodes.
+//      data: Operands of the nodes.
+//      extra: Lists of children and the extra operands of the nodes.
+//      tokens: Tokens referred by the nodes.
+//      declarations: Index of the list of the top level declarations in the
+//                    extra data.
+//      shared: If the expressions can have more than one parent.
+typedef struct AST_Pool
+{
+    int length;
+    int capacity;
+    uint8_t* kinds;
+    AST_Index* main_tokens;
+    Position* positions;
+    AST_Node_Data* data;
+
+    AST_Index_Array extra;
+    Token_Array tokens;
+    AST_Index declarations;
+    bool shared;
+} AST_Pool;
+
+
+// Initializes new empty node pool.
+//
+// File(s): cache.c
+//
+// Arguments
+//      pool: Pointer to the AST_Pool structure.
+void ast_pool_init(AST_Pool* pool);
+
+
+// Frees the memory allocated for the node pool.
+//
+// File(s): cache.c
+//
+// Arguments
+//      pool: Pool to be freed.
+void ast_pool_free(AST_Pool* pool);
+
+
+// Flattens the abstract syntax tree into the node pool. The nodes are saved 
+// in the pre-order, so the parent comes always before its children.
+//
+// File(s): cache.c
+//
+// Arguments
+//      pool: Pointer to initialized AST_Pool.
+//      declarations: Array of top level declarations to be flattened.
+void ast_pool_flatten(AST_Pool* pool, const array* declarations);
+
+
+// Expands the node pool back into an abstract syntax tree. The nodes are 
+// created with the same factory functions the parser uses and the tokens are
+// copied from the pool, so the tree doesn't refer to the pool afterwards.
+//
+// File(s): cache.c
+//
+// Arguments
+//      pool: Pool to be expanded.
+//      arena: Arena the tree is allocated from.
+//      declarations: Array the top level declarations are pushed into.
+void ast_pool_expand(const AST_Pool* pool, arena* arena, array* declarations);
+
+
+// Checks that the pool is a well formed tree before it is expanded. Every
+// index has to be in the bounds of its array, the nodes have to be of the 
+// kinds their parents expect and every node can have only one parent, which
+// comes before the node. Only the expressions of a shared pool can have more
+// parents and then the pool can't have cycles. Used for the pools read from
+// the outside.
+//
+// File(s): cache.c
+//
+// Arguments
+//      pool: Pool to be checked.
+// Returns
+//      Value true if the pool can be expanded safely, otherwise false.
+bool ast_pool_valid(const AST_Pool* pool);
+
+
+// Loads the resolved abstract syntax tree of the source from the cache. The
+// cache file is found by the hash of the source and it is used only if it was
+// written from the same source by the same build of the compiler. Besides the
+// tree, the symbols and the types of the program are restored into the 
+// resolver, so the tree doesn't have to be resolved again.
+//
+// Everything read from the file is checked before it is used, and a file 
+// which is broken in any way is just ignored.
+//
+// File(s): cache.c
+//
+// Arguments
+//      directory: Directory of the cache files.
+//      source: Source of the program.
+//      arena: Arena the tree is allocated from.
+//      declarations: Array the top level declarations are pushed into.
+//      resolver: Initialized resolver which hasn't resolved anything yet.
+// Returns
+//      Value true if the tree was loaded, otherwise false.
+bool ast_cache_load(const char* directory, const char* source, arena* arena, array* declarations, Resolver* resolver);
+
+
+// Saves the resolved abstract syntax tree of the source into the cache. Only
+// the trees resolved without errors are saved. The directory is created if it
+// doesn't exist. Failing to save the tree is not an error, the tree is just
+// parsed and resolved again the next time.
+//
+// File(s): cache.c
+//
+// Arguments
+//      directory: Directory of the cache files.
+//      source: Source of the program.
+//      declarations: Top level declarations of the program.
+//      resolver: Resolver which resolved the declarations.
+void ast_cache_save(const char* directory, const char* source, const array* declarations, const Resolver* resolver);
+
+
+// Arena shared by the declarations which were parsed at the same time. The
+// arena is released when the last of the declarations is dropped.
+//
+// File(s): document.c
+//
+// Members
+//      arena: Arena which owns the memory of the declarations.
+//      references: Number of the units referencing the arena.
+typedef struct Document_Tree
+{
+    arena arena;
+    int references;
+} Document_Tree;
+
+
+// Top level declaration of the document and everything produced for it. The
+// units cover the whole source, so each unit starts from its declaration and
+// continues until the start of the next one.
+//
+// File(s): document.c
+//
+// Members
+//      start: Offset of the start of the unit in the current source.
+//      end: Offset of the end of the unit in the current source. Exclusive.
+//      shift: How much the unit has moved since it was parsed. The positions
+//             in the tokens, nodes and diagnostics of the unit are offsets at
+//             the time of the parsing.
+//      tree: Arena of the declaration.
+//      declaration: Parsed declaration. NULL if the unit contains only
+//                   whitespace and comments.
+//      symbol: Symbol declared by the declaration. NULL if the declaration
+//              has not been resolved or it declares nothing.
+//      dirty: If the declaration has not been resolved after it was parsed.
+//      lexer_diagnostics: Diagnostics from the lexer.
+//      parser_diagnostics: Diagnostics from the parser.
+//      resolver_diagnostics: Diagnostics from the resolver.
+//      dependencies: Interned identifiers looked up while resolving.
+//      reported: Number of the reported diagnostics of the document up to and
+//                including the diagnostics of the unit.
+typedef struct Document_Unit
+{
+    int start;
+    int end;
+    int shift;
+    Document_Tree* tree;
+    AST_Declaration* declaration;
+    Symbol* symbol;
+    bool dirty;
+    array* lexer_diagnostics;
+    array* parser_diagnostics;
+    array* resolver_diagnostics;
+    array* dependencies;
+    int reported;
+} Document_Unit;
+
+
+TYPED_ARRAY(Document_Unit_Array, document_unit_array, Document_Unit)
+
+
+// Source being edited and checked incrementally e.g. in an editor. After an
+// edit only the units touched by the edit are lexed and parsed again. Only
+// the changed declarations and the declarations depending on the identifiers
+// they declare are resolved again, and the rest of the units keep their
+// declarations and symbols as they were.
+//
+// The diagnostics are reported the same way as in the compiler. If there are
+// diagnostics from the lexer, only those are reported, then the ones from the
+// parser and the ones from the resolver. The document is resolved only if
+// there are no diagnostics from the lexer or the parser.
+//
+// The global scope is kept between the checks and only the symbols of the
+// units resolved again or released are replaced in it. The symbols of the
+// global scope are indexed with their units, so each declaration sees only
+// the symbols of the units before it. The diagnostics of the units before
+// the edit are kept as they were reported, and only the rest are reported
+// again.
+//
+// File(s): document.c
+//
+// Members
+//      source: Current source of the document.
+//      length: Length of the source.
+//      capacity: Capacity of the source.
+//      units: Units of the document in the order of the source.
+//      type_table: Type table with languages primitive data types.
+//      resolver: Resolver which owns the global scope of the document.
+//      changed: Identifiers which were declared or undeclared since the last
+//               resolving.
+//      released: Symbols which are freed after the next resolving, since the
+//                declarations depending on them still refer to their types.
+//      diagnostics: Array of reported diagnostics with positions of the 
+//                   current source.
+//      lexer_errors: Number of the units with diagnostics from the lexer.
+//      parser_errors: Number of the units with diagnostics from the parser.
+//      unresolved: Index of the first unit which might need resolving again,
+//                  since the document was not resolved after it was edited.
+typedef struct Document
+{
+    char* source;
+    int length;
+    int capacity;
+    Document_Unit_Array units;
+    hashtable* type_table;
+    Resolver resolver;
+    hashtable* changed;
+    array* released;
+    array* diagnostics;
+    int lexer_errors;
+    int parser_errors;
+    int unresolved;
+} Document;
+
+
+// Initializes new document and checks the source.
+//
+// File(s): document.c
+//
+// Arguments
+//      document: Pointer to the Document structure.
+//      source: Source of the document. The source is copied.
+void document_init(Document* document, const char* source);
+
+
+// Frees the memory allocated for a document.
+//
+// File(s): document.c
+//
+// Arguments
+//      document: Document to be freed.
+void document_free(Document* document);
+
+
+// Replaces a range of the source with the text and checks the document again.
+//
+// File(s): document.c
+//
+// Arguments
+//      document: Pointer to initialized Document.
+//      start: Offset of the start of the replaced range.
+//      end: Offset of the end of the replaced range. Exclusive.
+//      text: Text replacing the range.
+void document_edit(Document* document, int start, int end, const char* text);
+
+
 //  Interpreter
 typedef struct Interpreter
 {
@@ -1267,7 +2077,9 @@ typedef struct Interpreter
     // params for the program?
     Scope* global;
     Scope* local;
-    // activation records / stack frames?
+    // NOTE(timo): Values of the parameters and the local variables of the
+    // function being evaluated, indexed by the slots of the symbols
+    Value* frame;
     // NOTE(timo): This is used for now just to be able to return something
     Value return_value;
 } Interpreter;
@@ -1330,9 +2142,11 @@ void evaluate_declaration(Interpreter* interpreter, AST_Declaration* declaration
 //
 // Arguments
 //      source:
+//      options: Options structure as interpreter options. Only the lazy
+//               parsing and resolving is used by the interpreter.
 // Returns
 //      Value returned by the main program.
-const Value interpret(const char* source);
+const Value interpret(const char* source, struct Options options);
 
 
 //
@@ -1341,9 +2155,10 @@ const Value interpret(const char* source);
 //
 // Arguments
 //      path:
+//      options: Options structure as interpreter options.
 // Returns
 //      Value returned by the main program.
-const Value interpret_from_file(const char* path);
+const Value interpret_from_file(const char* path, struct Options options);
 
 
 // Enumeration of different kind of operations.
@@ -1424,21 +2239,41 @@ typedef struct Address
 //      arg2: Address of the second operand of the instruction.
 //      result: Address of the result of the instruction.
 //      size: Used to compute sizes, aligments etc. numerical info.
+//      value: Value of the constant operand of a copy. The arg1 holds the
+//             same value as text for printing.
 //      label: Used to save labels e.g. for jump instructions.
+//      arg1_symbol: Symbol of the first operand. For the beginning of a 
+//                   function, the symbol of the function.
+//      arg2_symbol: Symbol of the second operand.
+//      result_symbol: Symbol of the result.
+//
+// The symbols are bound by the IR generator, so the code generator doesn't
+// have to look up the names of the operands. The symbol is NULL if the 
+// operand is a constant or it is not used.
 typedef struct Instruction 
 {
     Operation operation;
 
-    // TODO(timo): All of these could or should be pointers to the symbol table
     char* arg1;
     char* arg2;
     char* result;
 
     int size;
+    Value value;
     const char* label;
+
+    Symbol* arg1_symbol;
+    Symbol* arg2_symbol;
+    Symbol* result_symbol;
 } Instruction;
 
 
+// Contiguous array of instructions, the instruction stream.
+//
+// File(s): array.h
+TYPED_ARRAY(Instruction_Array, instruction_array, Instruction)
+
+
 // Factory functions for different kind of instructions.
 //
 // TODO(timo): I can do more informative docstrings by grouping some of these
@@ -1448,43 +2283,35 @@ typedef struct Instruction
 //
 // Arguments
 //      Arguments are based on the instruction used. Some instructions have
-//      more operands than others.
+//      more operands than others. The operands are interned.
 // Returns
-//      Pointer to the newly created Instruction.
-Instruction* instruction_copy(char* arg, char* result);
-Instruction* instruction_add(char* arg1, char* arg2, char* result);
-Instruction* instruction_sub(char* arg1, char* arg2, char* result);
-Instruction* instruction_mul(char* arg1, char* arg2, char* result);
-Instruction* instruction_div(char* arg1, char* arg2, char* result);
-Instruction* instruction_eq(char* arg1, char* arg2, char* result);
-Instruction* instruction_neq(char* arg1, char* arg2, char* result);
-Instruction* instruction_lt(char* arg1, char* arg2, char* result);
-Instruction* instruction_lte(char* arg1, char* arg2, char* result);
-Instruction* instruction_gt(char* arg1, char* arg2, char* result);
-Instruction* instruction_gte(char* arg1, char* arg2, char* result);
-Instruction* instruction_and(char* arg1, char* arg2, char* result);
-Instruction* instruction_or(char* arg1, char* arg2, char* result);
-Instruction* instruction_minus(char* arg, char* result);
-Instruction* instruction_not(char* arg, char* result);
-Instruction* instruction_function_begin(char* label);
-Instruction* instruction_function_end(char* label);
-Instruction* instruction_param_push(char* arg);
-Instruction* instruction_param_pop(char* arg);
-Instruction* instruction_call(char* arg, char* result, int n);
-Instruction* instruction_return(char* arg);
-Instruction* instruction_label(char* label);
-Instruction* instruction_goto(char* label);
-Instruction* instruction_goto_if_false(char* arg, char* label);
-Instruction* instruction_dereference(char* arg, char* result, int offset);
-
-
-// Frees the memory allocated for instruction
-//
-// File(s): instruction.c
-//
-// Arguments
-//      instruction: Instruction to be freed
-void instruction_free(Instruction* instruction);
+//      The newly created Instruction.
+Instruction instruction_copy(char* arg, char* result);
+Instruction instruction_copy_constant(Value value, char* result);
+Instruction instruction_add(char* arg1, char* arg2, char* result);
+Instruction instruction_sub(char* arg1, char* arg2, char* result);
+Instruction instruction_mul(char* arg1, char* arg2, char* result);
+Instruction instruction_div(char* arg1, char* arg2, char* result);
+Instruction instruction_eq(char* arg1, char* arg2, char* result);
+Instruction instruction_neq(char* arg1, char* arg2, char* result);
+Instruction instruction_lt(char* arg1, char* arg2, char* result);
+Instruction instruction_lte(char* arg1, char* arg2, char* result);
+Instruction instruction_gt(char* arg1, char* arg2, char* result);
+Instruction instruction_gte(char* arg1, char* arg2, char* result);
+Instruction instruction_and(char* arg1, char* arg2, char* result);
+Instruction instruction_or(char* arg1, char* arg2, char* result);
+Instruction instruction_minus(char* arg, char* result);
+Instruction instruction_not(char* arg, char* result);
+Instruction instruction_function_begin(char* label);
+Instruction instruction_function_end(char* label);
+Instruction instruction_param_push(char* arg);
+Instruction instruction_param_pop(char* arg);
+Instruction instruction_call(char* arg, char* result, int n);
+Instruction instruction_return(char* arg);
+Instruction instruction_label(char* label);
+Instruction instruction_goto(char* label);
+Instruction instruction_goto_if_false(char* arg, char* label);
+Instruction instruction_dereference(char* arg, char* result, int offset);
 
 
 // Prints the instruction to terminal/console
@@ -1502,7 +2329,7 @@ void dump_instruction(Instruction* instruction);
 //
 // Arguments
 //      instructions: Array of instructions to be printed
-void dump_instructions(array* instructions);
+void dump_instructions(Instruction_Array* instructions);
 
 
 //  Code in basic block has only one entry point and one exit point, meaning
@@ -1557,6 +2384,24 @@ typedef struct IR_Context
 } IR_Context;
 
 
+// Temporary holding the result of a shared expression, which can be reused
+// by the later occurrences of the expression.
+//
+// Members
+//      expression: Expression the result was generated from.
+//      symbol: Symbol of the temporary holding the result.
+//      position: Index of the instruction producing the result.
+typedef struct Shared_Result
+{
+    AST_Expression* expression;
+    Symbol* symbol;
+    int position;
+} Shared_Result;
+
+
+TYPED_ARRAY(Shared_Result_Array, shared_result_array, Shared_Result)
+
+
 // IR Generator is responsible for generating intermediate representation from
 // the resolved and annotated abstract syntax tree. The generated instructions
 // are quads.
@@ -1570,10 +2415,20 @@ typedef struct IR_Context
 //      local: Current local scope.
 //      contexts: Stack of IR Contexts.
 //      current_context: Current context in the IR generation.
+//      fold: If the expressions folded by the resolver are generated as a
+//            single copy of the folded constant.
+//      shared: If the results of the expressions shared by the parser are 
+//              reused. See Expression_Table.
+//      results: Results of the generated shared expressions. The expressions
+//               refer to their results by the indices.
+//      barrier: Index of the last jump, label, call or function boundary,
+//               which no result can be reused over.
+//      scanned: Number of the instructions checked for the assignments and
+//               the barriers.
 typedef struct IR_Generator
 {
     // array* blocks;
-    array* instructions;
+    Instruction_Array* instructions;
     array* diagnostics;
     int label;
     int temp;
@@ -1582,6 +2437,13 @@ typedef struct IR_Generator
 
     array* contexts;
     IR_Context* current_context;
+
+    bool fold;
+
+    bool shared;
+    Shared_Result_Array results;
+    int barrier;
+    int scanned;
 } IR_Generator;
 
 
@@ -1604,6 +2466,17 @@ void ir_generator_init(IR_Generator* generator, Scope* global);
 void ir_generator_free(IR_Generator* generator);
 
 
+// Forgets the results of the shared expressions generated so far, e.g. before
+// the tree they were generated from is freed. The results are never reused 
+// over the function boundaries anyway.
+//
+// File(s): ir_generator.c
+//
+// Arguments
+//      generator: Pointer to initialized IR generator.
+void ir_generator_clear_results(IR_Generator* generator);
+
+
 // Generates intermediate representation of the resolved and annotated abstract
 // syntax tree. The main interface used with IR generator.
 //
@@ -1653,7 +2526,24 @@ void ir_generate_declaration(IR_Generator* generator, AST_Declaration* declarati
 //
 // Arguments
 //      instructions: Array of instructions.
-void dump_instructions(array* instructions);
+void dump_instructions(Instruction_Array* instructions);
+
+
+// Parses, resolves and generates the IR for one top level declaration at a
+// time, so the tree of a declaration can be released right after its IR is
+// generated. After the first errors of the lexer or the parser the rest of the
+// declarations are only parsed, and after the first errors of the resolver 
+// they are only parsed and resolved. That way the same errors are found as 
+// with the separate passes.
+//
+// File(s): t.c
+//
+// Arguments
+//      lexer: Lexer the tokens are pulled from.
+//      parser: Parser pulling the tokens from the lexer.
+//      resolver: Initialized resolver.
+//      generator: Initialized IR generator.
+void compile_single_pass(Lexer* lexer, Parser* parser, Resolver* resolver, IR_Generator* generator);
 
 
 // Code generator is responsible of generating target machine instructions
@@ -1672,7 +2562,7 @@ void dump_instructions(array* instructions);
 typedef struct Code_Generator
 {
     FILE* output;
-    array* instructions;
+    Instruction_Array* instructions;
     array* diagnostics;
     Scope* global;
     Scope* local;
@@ -1696,7 +2586,7 @@ typedef struct Code_Generator
 //      generator: Address of the code generator to be initialized.
 //      global: Global scope with resolved symbols.
 //      instructions: Array of instructions from the IR generator.
-void code_generator_init(Code_Generator* generator, Scope* global, array* instructions);
+void code_generator_init(Code_Generator* generator, Scope* global, Instruction_Array* instructions);
 
 
 // Generates the target machine instructions from the intermediate 
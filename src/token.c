@@ -6,20 +6,15 @@
 #include "t.h"
 
 
-// NOTE(timo): This memory allocation for each lexeme is pretty
-// wasteful of resources and speed, but for now it makes things
-// easier to understand and do in the later stages so it stays
-// like this at least for now.
-// TODO(timo): Therefore later we should just use pointer
-// arithmetics with the pointer to the starting character
-Token* token(Token_Kind kind, const char* lexeme, const int lexeme_length, Position position)
+// NOTE(timo): The lexeme is not copied. The lexer interns the lexemes of the
+// names and the literals, so there is only one copy of each of them in the 
+// whole program and the later stages can compare them just by their pointers.
+// The lexemes of the operators and the keywords are static strings. The token
+// itself is returned by value and saved into the token stream of the lexer.
+Token token(Token_Kind kind, const char* lexeme, const int lexeme_length, Position position)
 {
-    Token* token = xcalloc(1, sizeof (Token));
-    token->kind = kind;
-    token->lexeme = xcalloc(lexeme_length + 1, sizeof (char));
-    memcpy((char*)token->lexeme, lexeme, lexeme_length);
-    token->lexeme_length = lexeme_length;
-    token->position = position;
-
-    return token;
+    return (Token){ .kind = kind,
+                    .lexeme = lexeme,
+                    .lexeme_length = lexeme_length,
+                    .position = position };
 }
@@ -1,70 +1,134 @@
 // Implementations for the factory functions for creating types and freeing
 // the memory allocated for them.
 //
+// The composite types are hash-consed in the type table. The key of the type
+// is made of the pointers to its component types, which are canonical 
+// themselves, so the identical types are found with one lookup.
+//
 // Author: Timo Mehto
 // Date: 2021/05/12
 
 #include "t.h"
 
 
-Type* type_none()
+// Length of the keys of the composite types kept in the stack. The keys of
+// the functions with more parameters are allocated.
+#define TYPE_KEY_LENGTH 256
+
+// Maximum length of one component type in the key of a composite type.
+#define TYPE_KEY_COMPONENT_LENGTH 24
+
+
+// Allocates a new type of the given kind with the common size and alignment.
+//
+// Arguments
+//      kind: Kind of the type.
+//      size: Size of the type.
+// Returns
+//      Pointer to the newly created type.
+static Type* type_create(Type_Kind kind, size_t size)
 {
-    Type* type = xmalloc(sizeof (Type));
-    type->kind = TYPE_NONE;
-    // TODO(timo): This should be something sensible
-    type->size = 0;
+    Type* type = xcalloc(1, sizeof (Type));
+    type->kind = kind;
+    type->size = size;
     type->alignment = 8;
 
     return type;
 }
 
 
+Type* type_none()
+{
+    // TODO(timo): This should be something sensible
+    return type_create(TYPE_NONE, 0);
+}
+
+
 Type* type_integer()
 {
-    Type* type = xmalloc(sizeof (Type));
-    type->kind = TYPE_INTEGER;
     // TODO(timo): This should be 4 bytes, but for simplicity everything is 8 bytes
-    type->size = 8;
-    type->alignment = 8;
-
-    return type;
+    return type_create(TYPE_INTEGER, 8);
 }
 
 
 Type* type_boolean()
 {
-    Type* type = xmalloc(sizeof (Type));
-    type->kind = TYPE_BOOLEAN;
     // TODO(timo): This should be like 1 byte, but for simplicity everything is 8 bytes
-    type->size = 8;
-    type->alignment = 8;
+    return type_create(TYPE_BOOLEAN, 8);
+}
 
-    return type;
+
+// Writes the key of a composite type into the buffer. The key has the kind of
+// the type and the pointers to the component types, so the keys never clash
+// with the names of the primitive types.
+//
+// Arguments
+//      buffer: Buffer with space for the kind and the components.
+//      kind: Character marking the kind of the composite type.
+//      first: Pointer to the first component type. NULL for a function 
+//             without a return type.
+//      rest: Pointers to the rest of the component types.
+//      count: Number of the rest of the component types.
+// Returns
+//      Pointer to the key in the buffer.
+static char* type_key(char* buffer, char kind, Type* first, Type** rest, int count)
+{
+    int length = sprintf(buffer, "%c %p", kind, (void*)first);
+
+    for (int i = 0; i < count; i++)
+        length += sprintf(buffer + length, " %p", (void*)rest[i]);
+
+    return buffer;
 }
 
 
-Type* type_function()
+Type* type_function(hashtable* type_table, Type* return_type, Type** parameters, int arity)
 {
-    Type* type = xmalloc(sizeof (Type));
-    type->kind = TYPE_FUNCTION;
-    type->function.return_type = NULL;
-    type->function.parameters = array_init(sizeof (Symbol*));
-    type->function.arity = 0;
-    type->size = 8; // The size if basically the size of the pointer to the function
-    type->alignment = 8;
+    // NOTE(timo): The return type is the first component, so the functions 
+    // without a return type are kept apart from the functions returning none,
+    // and the arity is given by the number of the components
+    int length = (arity + 1) * TYPE_KEY_COMPONENT_LENGTH + 2;
+    char small[TYPE_KEY_LENGTH];
+    char* buffer = length > TYPE_KEY_LENGTH ? xmalloc(length) : small;
+    char* key = type_key(buffer, 'f', return_type, parameters, arity);
+    Type* type = hashtable_get(type_table, key);
+
+    if (type == NULL)
+    {
+        // The size if basically the size of the pointer to the function
+        type = type_create(TYPE_FUNCTION, 8);
+        type->function.return_type = return_type;
+        type->function.parameters = array_init(sizeof (Type*));
+        type->function.arity = arity;
+
+        for (int i = 0; i < arity; i++)
+            array_push(type->function.parameters, parameters[i]);
+
+        hashtable_put(type_table, key, type);
+    }
+
+    if (buffer != small)
+        free(buffer);
 
     return type;
 }
 
 
-Type* type_array(Type* element_type)
+Type* type_array(hashtable* type_table, Type* element_type)
 {
-    Type* type = xmalloc(sizeof (Type));
-    type->kind = TYPE_ARRAY;
-    type->array.element_type = element_type;
-    type->array.length = 0;
-    type->size = 8; // The size is the size of the base pointer
-    type->alignment = 8;
+    char buffer[TYPE_KEY_LENGTH];
+    char* key = type_key(buffer, 'a', element_type, NULL, 0);
+    Type* type = hashtable_get(type_table, key);
+
+    if (type == NULL)
+    {
+        // The size is the size of the base pointer
+        type = type_create(TYPE_ARRAY, 8);
+        type->array.element_type = element_type;
+        type->array.length = 0;
+
+        hashtable_put(type_table, key, type);
+    }
 
     return type;
 }
@@ -132,13 +196,13 @@ const bool type_is_not_function(const Type* type)
 
 const bool types_equal(const Type* type1, const Type* type2)
 {
-    return type1->kind == type2->kind;
+    return type1 == type2;
 }
 
 
 const bool types_not_equal(const Type* type1, const Type* type2)
 {
-    return type1->kind != type2->kind;
+    return type1 != type2;
 }
 
 
@@ -155,16 +219,12 @@ void type_free(Type* type)
         case TYPE_BOOLEAN:
             break;
         case TYPE_FUNCTION:
-            if (type->function.scope) scope_free(type->function.scope);
-            // NOTE(timo): Return types are primitive types at this point so there 
-            // is no need to explicitly remove them as they point to type table
-            // NOTE(timo): The parameter list is a list of pointers to symbols
-            // which are being freed with the scope.
+            // NOTE(timo): The return type and the types of the parameters are
+            // owned by the type table, so only the list itself is freed
             array_free(type->function.parameters);
             break;
         case TYPE_ARRAY:
-            // NOTE(timo): Element types are primitive types at this point so there 
-            // is no need to explicitly remove them as they point to type table
+            // NOTE(timo): The element type is owned by the type table
             break;
         default:
             // TODO(timo): Error
@@ -198,18 +258,23 @@ const char* type_as_string(const Type_Kind kind)
 
 hashtable* type_table_init()
 {
-    hashtable* type_table = hashtable_init(3);
+    hashtable* type_table = hashtable_init(4);
     hashtable_put(type_table, "none", type_none());
     hashtable_put(type_table, "int", type_integer());
     hashtable_put(type_table, "bool", type_boolean());
 
+    // NOTE(timo): The types of the type specifiers are created here, so the
+    // resolving of the type specifiers only reads the table. The bodies of 
+    // the functions resolved in parallel never modify the table that way.
+    type_array(type_table, hashtable_get(type_table, "int"));
+
     return type_table;
 }
 
 
 void type_table_free(hashtable* table)
 {
-    for (int i = 0; i < table->capacity; i++)
+    for (int i = 0; i < table->count; i++)
     {
         Type* type = table->entries[i].value;
 
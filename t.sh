@@ -34,7 +34,7 @@ build () {
     [ -d "$1" ] || mkdir "$1"
 
     # Compile the source code to executable if there is entry point created
-    [ -f "$2" ] && gcc -O3 -o $3 $4
+    [ -f "$2" ] && gcc -O3 -pthread -o $3 $4
 }
 
 
@@ -54,6 +54,7 @@ case $COMMAND in
                                                                                    src/array.c 
                                                                                    src/parser.c 
                                                                                    src/resolver.c 
+                                                                                   src/document.c 
                                                                                    src/interpreter.c 
                                                                                    src/instruction.c 
                                                                                    src/ir_generator.c 
@@ -61,11 +62,13 @@ case $COMMAND in
                                                                                    src/code_generator.c 
                                                                                    src/stringbuilder.c 
                                                                                    src/ast.c 
+                                                                                   src/cache.c 
                                                                                    src/symbol.c 
                                                                                    src/type.c 
                                                                                    src/value.c 
                                                                                    src/token.c 
                                                                                    src/memory.c 
+                                                                                   src/intern.c 
                                                                                    src/common.c 
                                                                                    src/diagnostics.c"
         exit 0;;
@@ -81,6 +84,7 @@ case $COMMAND in
                                                                                    src/array.c 
                                                                                    src/parser.c 
                                                                                    src/resolver.c 
+                                                                                   src/document.c 
                                                                                    src/interpreter.c 
                                                                                    src/instruction.c 
                                                                                    src/ir_generator.c 
@@ -88,11 +92,13 @@ case $COMMAND in
                                                                                    src/code_generator.c 
                                                                                    src/stringbuilder.c 
                                                                                    src/ast.c 
+                                                                                   src/cache.c 
                                                                                    src/symbol.c 
                                                                                    src/type.c 
                                                                                    src/value.c 
                                                                                    src/token.c 
                                                                                    src/memory.c 
+                                                                                   src/intern.c 
                                                                                    src/common.c 
                                                                                    src/diagnostics.c"
         $TEST_BUILD_DIR/$TEST_EXECUTABLE "${@:2}"
@@ -109,6 +115,7 @@ case $COMMAND in
                                                                                    src/array.c 
                                                                                    src/parser.c 
                                                                                    src/resolver.c 
+                                                                                   src/document.c 
                                                                                    src/interpreter.c 
                                                                                    src/instruction.c 
                                                                                    src/ir_generator.c 
@@ -116,11 +123,13 @@ case $COMMAND in
                                                                                    src/code_generator.c 
                                                                                    src/stringbuilder.c 
                                                                                    src/ast.c 
+                                                                                   src/cache.c 
                                                                                    src/symbol.c 
                                                                                    src/type.c 
                                                                                    src/value.c 
                                                                                    src/token.c 
                                                                                    src/memory.c 
+                                                                                   src/intern.c 
                                                                                    src/common.c
                                                                                    src/diagnostics.c"
         valgrind --leak-check=full --show-leak-kinds=all --track-origins=yes --log-file="vglog" --verbose $TEST_BUILD_DIR/$TEST_EXECUTABLE "${@:2}"
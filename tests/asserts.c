@@ -29,16 +29,24 @@ void assert_base(Test_Runner* runner, const bool assertion, const char* message,
 }
 
 
-void assert_position(Test_Runner* runner, const Position position, const int line_start, const int column_start, const int line_end, const int column_end)
+void assert_position(Test_Runner* runner, const char* source, const Position position, const int line_start, const int column_start, const int line_end, const int column_end)
 {
-    assert_base(runner, (line_start != 0 && position.line_start == line_start),
-        "Invalid starting line '%d', expected '%d'", position.line_start, line_start);
-    assert_base(runner, (column_start != 0 && position.column_start == column_start),
-        "Invalid starting column '%d', expected '%d'", position.column_start, column_start);
-    assert_base(runner, (line_end != 0 && position.line_end == line_end), 
-        "Invalid ending line '%d', expected '%d'", position.line_end, line_end);
-    assert_base(runner, (column_end != 0 && position.column_end == column_end), 
-        "Invalid ending column '%d', expected '%d'", position.column_end, column_end);
+    Line_Table lines;
+    line_table_init(&lines, source);
+
+    Location start = line_table_location(&lines, position.start);
+    Location end = line_table_location(&lines, position.end);
+
+    line_table_free(&lines);
+
+    assert_base(runner, (line_start != 0 && start.line == line_start),
+        "Invalid starting line '%d', expected '%d'", start.line, line_start);
+    assert_base(runner, (column_start != 0 && start.column == column_start),
+        "Invalid starting column '%d', expected '%d'", start.column, column_start);
+    assert_base(runner, (line_end != 0 && end.line == line_end), 
+        "Invalid ending line '%d', expected '%d'", end.line, line_end);
+    assert_base(runner, (column_end != 0 && end.column == column_end), 
+        "Invalid ending column '%d', expected '%d'", end.column, column_end);
 }
 
 
@@ -114,3 +122,25 @@ void assert_instruction(Test_Runner* runner, const Instruction* instruction, con
     assert_base(runner, instruction->operation == expected_operation,
         "Invalid instruction '%s', expected '%s'", operation_str(instruction->operation), operation_str(expected_operation));
 }
+
+
+void assert_same_instructions(Test_Runner* runner, const Instruction_Array* instructions, const Instruction_Array* expected)
+{
+    assert_base(runner, instructions->length == expected->length,
+        "Invalid number of instructions %d, expected %d", instructions->length, expected->length);
+
+    for (int i = 0; i < instructions->length && i < expected->length; i++)
+    {
+        const Instruction* instruction = &instructions->items[i];
+        const Instruction* expected_instruction = &expected->items[i];
+
+        assert_base(runner, instruction->operation == expected_instruction->operation &&
+                            instruction->arg1 == expected_instruction->arg1 &&
+                            instruction->arg2 == expected_instruction->arg2 &&
+                            instruction->result == expected_instruction->result &&
+                            instruction->label == expected_instruction->label &&
+                            instruction->size == expected_instruction->size,
+            "Invalid instruction %d '%s', expected '%s'", i, operation_str(instruction->operation), 
+            operation_str(expected_instruction->operation));
+    }
+}
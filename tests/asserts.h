@@ -32,12 +32,13 @@ void assert_base(Test_Runner* runner, const bool assertion, const char* message,
 //
 // Arguments
 //      runner: Initialized test runner.
+//      source: Source where the position is from.
 //      position: Actual position.
 //      line_start: Expected starting line of the position.
 //      column_start: Expected starting column of the position.
 //      line_end: Expected ending line of the position.
 //      column_end: Expected ending column of the position.
-void assert_position(Test_Runner* runner, const Position position, const int line_start, const int column_start, const int line_end, const int column_end);
+void assert_position(Test_Runner* runner, const char* source, const Position position, const int line_start, const int column_start, const int line_end, const int column_end);
 
 
 // Assertion for Token structs.
@@ -134,4 +135,14 @@ void assert_value(Test_Runner* runner, const Value actual, const Value_Type expe
 void assert_instruction(Test_Runner* runner, const Instruction* instruction, const Operation expected_operation);
 
 
+// Assertion for comparing two arrays of instructions. The operands and the
+// labels are interned, so they are compared as pointers.
+//
+// Arguments
+//      runner: Initialized test runner.
+//      instructions: Actual instructions.
+//      expected: Expected instructions.
+void assert_same_instructions(Test_Runner* runner, const Instruction_Array* instructions, const Instruction_Array* expected);
+
+
 #endif
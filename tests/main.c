@@ -137,6 +137,7 @@ int main(int argc, char** argv)
         printf("No tests selected to run\n");
 
     test_runner_free(&runner);
+    interns_free();
 
     return 0;
 }
@@ -6,6 +6,7 @@
 #include "tests.h"
 #include "../src/t.h"
 #include "../src/common.h"
+#include <dirent.h>
 
 
 static void test_evaluate_literal_expression(Test_Runner* runner)
@@ -259,6 +260,7 @@ static void test_evaluate_assignment_expression(Test_Runner* runner)
     assert_value(runner, value, VALUE_INTEGER, 6);
 
     statement_free(statement_block);
+    interpreter_free(&interpreter);
     resolver_free(&resolver);
     type_table_free(type_table);
     parser_free(&parser);
@@ -298,7 +300,7 @@ static void test_evaluate_variable_declaration(Test_Runner* runner)
         interpreter_init(&interpreter, resolver.global);
         evaluate_declaration(&interpreter, declaration);
         
-        Symbol* symbol = scope_lookup(interpreter.global, identifiers[i]);
+        Symbol* symbol = scope_lookup(interpreter.global, str_intern(identifiers[i]));
 
         assert_base(runner, strcmp(symbol->identifier, identifiers[i]) == 0,
             "Invalid symbol identifier '%s', expected '%s'", symbol->identifier, identifiers[i]);
@@ -308,6 +310,7 @@ static void test_evaluate_variable_declaration(Test_Runner* runner)
         assert_value(runner, value, results[i][0], results[i][1]);
         
         declaration_free(declaration);
+        interpreter_free(&interpreter);
         resolver_free(&resolver);
         type_table_free(type_table);
         parser_free(&parser);
@@ -318,74 +321,117 @@ static void test_evaluate_variable_declaration(Test_Runner* runner)
 
 static void test_example_first(Test_Runner* runner)
 {
-    Value return_value = interpret_from_file("./tests/cases/first.t");
+    Value return_value = interpret_from_file("./tests/cases/first.t", (struct Options){ 0 });
     assert_value(runner, return_value, VALUE_INTEGER, 0);
 }
 
 
 static void test_example_trivial_add(Test_Runner* runner)
 {
-    Value return_value = interpret_from_file("./tests/cases/trivial_add.t");
+    Value return_value = interpret_from_file("./tests/cases/trivial_add.t", (struct Options){ 0 });
     assert_value(runner, return_value, VALUE_INTEGER, 2);
 }
 
 
 static void test_example_trivial_subtract(Test_Runner* runner)
 {
-    Value return_value = interpret_from_file("./tests/cases/trivial_subtract.t");
+    Value return_value = interpret_from_file("./tests/cases/trivial_subtract.t", (struct Options){ 0 });
     assert_value(runner, return_value, VALUE_INTEGER, 0);
 }
 
 
 static void test_example_trivial_multiply(Test_Runner* runner)
 {
-    Value return_value = interpret_from_file("./tests/cases/trivial_multiply.t");
+    Value return_value = interpret_from_file("./tests/cases/trivial_multiply.t", (struct Options){ 0 });
     assert_value(runner, return_value, VALUE_INTEGER, 6);
 }
 
 
 static void test_example_trivial_divide(Test_Runner* runner)
 {
-    Value return_value = interpret_from_file("./tests/cases/trivial_divide.t");
+    Value return_value = interpret_from_file("./tests/cases/trivial_divide.t", (struct Options){ 0 });
     assert_value(runner, return_value, VALUE_INTEGER, 5);
 }
 
 
 static void test_example_trivial_arithmetics(Test_Runner* runner)
 {
-    Value return_value = interpret_from_file("./tests/cases/trivial_arithmetics.t");
+    Value return_value = interpret_from_file("./tests/cases/trivial_arithmetics.t", (struct Options){ 0 });
     assert_value(runner, return_value, VALUE_INTEGER, 7);
 }
 
 
 static void test_example_if_1(Test_Runner* runner)
 {
-    Value return_value = interpret_from_file("./tests/cases/if_1.t");
+    Value return_value = interpret_from_file("./tests/cases/if_1.t", (struct Options){ 0 });
     assert_value(runner, return_value, VALUE_INTEGER, 0);
 }
 
 
 static void test_example_if_7(Test_Runner* runner)
 {
-    Value return_value = interpret_from_file("./tests/cases/if_7.t");
+    Value return_value = interpret_from_file("./tests/cases/if_7.t", (struct Options){ 0 });
     assert_value(runner, return_value, VALUE_INTEGER, 1);
 }
 
 
 static void test_example_while_1(Test_Runner* runner)
 {
-    Value return_value = interpret_from_file("./tests/cases/while_loop_1.t");
+    Value return_value = interpret_from_file("./tests/cases/while_loop_1.t", (struct Options){ 0 });
     assert_value(runner, return_value, VALUE_INTEGER, 4950);
 }
 
 
 static void test_example_while_2(Test_Runner* runner)
 {
-    Value return_value = interpret_from_file("./tests/cases/while_loop_2.t");
+    Value return_value = interpret_from_file("./tests/cases/while_loop_2.t", (struct Options){ 0 });
     assert_value(runner, return_value, VALUE_INTEGER, 105);
 }
 
 
+static void test_interpret_lazy(Test_Runner* runner)
+{
+    // NOTE(timo): The unused function has a type error, but it is never resolved
+    const char* source = "unused: int = (a: int) => { return a + true; };\n"
+                         "main: int = () => { result: int = 40; result := result + 2; return result; };\n";
+
+    Value return_value = interpret(source, (struct Options){ .lazy = true });
+    assert_value(runner, return_value, VALUE_INTEGER, 42);
+}
+
+
+
+static void test_interpret_cached(Test_Runner* runner)
+{
+    char directory[] = "/tmp/t_cache_XXXXXX";
+    const char* source = "main: int = () => { result: int = 20 * 2; result := result + 2; return result; };\n";
+
+    assert_base(runner, mkdtemp(directory) != NULL, "Failed to create the cache directory");
+
+    // NOTE(timo): The first run saves the tree and the second one loads it
+    for (int i = 0; i < 2; i++)
+    {
+        Value return_value = interpret(source, (struct Options){ .cache_directory = directory });
+        assert_value(runner, return_value, VALUE_INTEGER, 42);
+    }
+
+    DIR* cache = opendir(directory);
+    struct dirent* entry;
+    int files = 0;
+
+    while ((entry = readdir(cache)) != NULL)
+        files += entry->d_name[0] != '.';
+
+    closedir(cache);
+
+    assert_base(runner, files == 1, "Invalid number of cache files %d, expected 1", files);
+
+    // Clean up the cache directory
+    char command[64];
+    snprintf(command, sizeof (command), "rm -rf %s", directory);
+    system(command);
+}
+
 Test_Set* interpreter_test_set()
 {
     Test_Set* set = test_set("Interpreter");
@@ -414,6 +460,9 @@ Test_Set* interpreter_test_set()
     array_push(set->tests, test_case("Example file: while_loop_1.t", test_example_while_1));
     array_push(set->tests, test_case("Example file: while_loop_2.t", test_example_while_2));
 
+    array_push(set->tests, test_case("Lazy interpreting", test_interpret_lazy));
+    array_push(set->tests, test_case("Cached interpreting", test_interpret_cached));
+
     set->length = set->tests->length;
 
     return set;
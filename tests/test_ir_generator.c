@@ -34,9 +34,13 @@ static void test_generate_literal_expression(Test_Runner* runner)
     assert_base(runner, strcmp(result, "_t0") == 0,
         "Invalid result '%s', expected '_t0'", result);
 
-    Instruction* instruction = generator.instructions->items[0];
+    Instruction* instruction = &generator.instructions->items[0];
 
     assert_instruction(runner, instruction, OP_COPY);
+    assert_base(runner, value_is_integer(instruction->value) && instruction->value.integer == 42,
+        "Invalid value of the constant %lld, expected 42", (long long)instruction->value.integer);
+    assert_base(runner, strcmp(instruction->arg1, "42") == 0,
+        "Invalid constant '%s', expected '42'", instruction->arg1);
 
     // dump_instructions(generator.instructions);
 
@@ -75,8 +79,8 @@ static void test_generate_unary_expression_minus(Test_Runner* runner)
 
     assert_base(runner, generator.instructions->length == 2,
         "Invalid number of instructions: %d, expected 2", generator.instructions->length);
-    assert_instruction(runner, generator.instructions->items[0], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[1], OP_MINUS);
+    assert_instruction(runner, &generator.instructions->items[0], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[1], OP_MINUS);
 
     // dump_instructions(generator.instructions);
 
@@ -133,7 +137,7 @@ static void test_generate_binary_expression_arithmetic(Test_Runner* runner)
             "Invalid number of instructions: %d, expected 3", generator.instructions->length);
 
         for (int j = 0; j < generator.instructions->length; j++)
-            assert_instruction(runner, generator.instructions->items[j], results[i][j]);
+            assert_instruction(runner, &generator.instructions->items[j], results[i][j]);
 
         // dump_instructions(generator.instructions);
         
@@ -195,7 +199,7 @@ static void test_generate_binary_expression_relational(Test_Runner* runner)
             "Invalid number of instructions: %d, expected 3", generator.instructions->length);
 
         for (int j = 0; j < generator.instructions->length; j++)
-            assert_instruction(runner, generator.instructions->items[j], results[i][j]);
+            assert_instruction(runner, &generator.instructions->items[j], results[i][j]);
 
         // dump_instructions(generator.instructions);
         
@@ -244,7 +248,7 @@ static void test_generate_logical_expression_not(Test_Runner* runner)
             "Invalid number of instructions: %d, expected 2", generator.instructions->length);
 
         for (int j = 0; j < generator.instructions->length; j++)
-            assert_instruction(runner, generator.instructions->items[j], expected[j]);
+            assert_instruction(runner, &generator.instructions->items[j], expected[j]);
 
         // dump_instructions(generator.instructions);
         
@@ -308,7 +312,64 @@ static void test_generate_logical_expression_and(Test_Runner* runner)
             "Invalid number of instructions: %d, expected 11", generator.instructions->length);
 
         for (int j = 0; j < generator.instructions->length; j++)
-            assert_instruction(runner, generator.instructions->items[j], expected[j]);
+            assert_instruction(runner, &generator.instructions->items[j], expected[j]);
+
+        // dump_instructions(generator.instructions);
+        
+        expression_free(expression);
+        ir_generator_free(&generator);
+        resolver_free(&resolver);
+        type_table_free(type_table);
+        parser_free(&parser);
+        lexer_free(&lexer);
+    }
+}
+
+
+static void test_generate_folded_expression(Test_Runner* runner)
+{
+    const char* tests[] =
+    {
+        "-(2 + 3) * 4",
+        "(1 + 2) * 3 == 9",
+        "not (1 < 2 and true)",
+    };
+
+    const char* results[] =
+    {
+        "-20",
+        "true",
+        "false",
+    };
+
+    Lexer lexer;
+    Parser parser;
+    hashtable* type_table;
+    Resolver resolver;
+    IR_Generator generator;
+    AST_Expression* expression;
+
+    for (int i = 0; i < sizeof (tests) / sizeof (*tests); i++)
+    {
+        lexer_init(&lexer, tests[i]);
+        lex(&lexer);
+
+        parser_init(&parser, lexer.tokens);
+        expression = parse_expression(&parser);
+        
+        type_table = type_table_init();
+        resolver_init(&resolver, type_table);
+        resolve_expression(&resolver, expression);
+        
+        ir_generator_init(&generator, resolver.global);
+        generator.fold = true;
+        ir_generate_expression(&generator, expression);
+
+        assert_base(runner, generator.instructions->length == 1,
+            "Invalid number of instructions: %d, expected 1", generator.instructions->length);
+        assert_instruction(runner, &generator.instructions->items[0], OP_COPY);
+        assert_base(runner, strcmp(generator.instructions->items[0].arg1, results[i]) == 0,
+            "Invalid folded constant '%s', expected '%s'", generator.instructions->items[0].arg1, results[i]);
 
         // dump_instructions(generator.instructions);
         
@@ -376,7 +437,7 @@ static void test_generate_logical_expression_or(Test_Runner* runner)
             "Invalid number of instructions: %d, expected 14", generator.instructions->length);
 
         for (int j = 0; j < generator.instructions->length; j++)
-            assert_instruction(runner, generator.instructions->items[j], expected[j]);
+            assert_instruction(runner, &generator.instructions->items[j], expected[j]);
 
         // dump_instructions(generator.instructions);
         
@@ -426,7 +487,7 @@ static void test_generate_variable_expression(Test_Runner* runner)
 
     assert_base(runner, generator.instructions->length == 1,
         "Invalid number of instructions: %d, expected 1", generator.instructions->length);
-    assert_instruction(runner, generator.instructions->items[0], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[0], OP_COPY);
 
     // dump_instructions(generator.instructions);
     
@@ -474,8 +535,8 @@ static void test_generate_assignment_expression(Test_Runner* runner)
 
     assert_base(runner, generator.instructions->length == 2,
         "Invalid number of instructions: %d, expected 2", generator.instructions->length);
-    assert_instruction(runner, generator.instructions->items[0], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[1], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[0], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[1], OP_COPY);
 
     // dump_instructions(generator.instructions);
     
@@ -523,16 +584,16 @@ static void test_generate_assignment_expression_complex(Test_Runner* runner)
 
     assert_base(runner, generator.instructions->length == 10,
         "Invalid number of instructions: %d, expected 10", generator.instructions->length);
-    assert_instruction(runner, generator.instructions->items[0], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[1], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[2], OP_MINUS);
-    assert_instruction(runner, generator.instructions->items[3], OP_MUL);
-    assert_instruction(runner, generator.instructions->items[4], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[5], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[6], OP_MINUS);
-    assert_instruction(runner, generator.instructions->items[7], OP_MUL);
-    assert_instruction(runner, generator.instructions->items[8], OP_ADD);
-    assert_instruction(runner, generator.instructions->items[9], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[0], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[1], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[2], OP_MINUS);
+    assert_instruction(runner, &generator.instructions->items[3], OP_MUL);
+    assert_instruction(runner, &generator.instructions->items[4], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[5], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[6], OP_MINUS);
+    assert_instruction(runner, &generator.instructions->items[7], OP_MUL);
+    assert_instruction(runner, &generator.instructions->items[8], OP_ADD);
+    assert_instruction(runner, &generator.instructions->items[9], OP_COPY);
 
     // dump_instructions(generator.instructions);
     
@@ -570,16 +631,16 @@ static void test_generate_assignment_expression_complex(Test_Runner* runner)
 
     assert_base(runner, generator.instructions->length == 10,
         "Invalid number of instructions: %d, expected 10", generator.instructions->length);
-    assert_instruction(runner, generator.instructions->items[0], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[1], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[2], OP_MINUS);
-    assert_instruction(runner, generator.instructions->items[3], OP_MUL);
-    assert_instruction(runner, generator.instructions->items[4], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[5], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[6], OP_MINUS);
-    assert_instruction(runner, generator.instructions->items[7], OP_MUL);
-    assert_instruction(runner, generator.instructions->items[8], OP_ADD);
-    assert_instruction(runner, generator.instructions->items[9], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[0], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[1], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[2], OP_MINUS);
+    assert_instruction(runner, &generator.instructions->items[3], OP_MUL);
+    assert_instruction(runner, &generator.instructions->items[4], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[5], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[6], OP_MINUS);
+    assert_instruction(runner, &generator.instructions->items[7], OP_MUL);
+    assert_instruction(runner, &generator.instructions->items[8], OP_ADD);
+    assert_instruction(runner, &generator.instructions->items[9], OP_COPY);
 
     // dump_instructions(generator.instructions);
 
@@ -625,18 +686,85 @@ static void test_generate_index_expression(Test_Runner* runner)
 
     assert_base(runner, generator.instructions->length == 6,
         "Invalid number of instructions: %d, expected 6", generator.instructions->length);
-    assert_instruction(runner, generator.instructions->items[0], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[1], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[2], OP_MUL);
-    assert_instruction(runner, generator.instructions->items[3], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[4], OP_ADD);
-    assert_instruction(runner, generator.instructions->items[5], OP_DEREFERENCE);
+    assert_instruction(runner, &generator.instructions->items[0], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[1], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[2], OP_MUL);
+    assert_instruction(runner, &generator.instructions->items[3], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[4], OP_ADD);
+    assert_instruction(runner, &generator.instructions->items[5], OP_DEREFERENCE);
+    
+    ir_generator_free(&generator);
+    resolver_free(&resolver);
+    type_table_free(type_table);
+    parser_free(&parser);
+    lexer_free(&lexer);
+}
+
+
+static void test_generate_deeply_nested_calls(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parser;
+    hashtable* type_table;
+    Resolver resolver;
+    IR_Generator generator;
+    stringbuilder* sb = sb_init();
+    const int depth = 20000;
+
+    // f(f(... argv[f(f(... argc ...))] ...))
+    sb_append(sb, "f: int = (x: int) => { return x; };\n");
+    sb_append(sb, "main: int = (argc: int, argv: [int]) => { return ");
+    for (int i = 0; i < depth; i++)
+        sb_append(sb, "f(");
+    sb_append(sb, "argv[");
+    for (int i = 0; i < depth; i++)
+        sb_append(sb, "f(");
+    sb_append(sb, "argc");
+    for (int i = 0; i < depth; i++)
+        sb_append(sb, ")");
+    sb_append(sb, "]");
+    for (int i = 0; i < depth; i++)
+        sb_append(sb, ")");
+    sb_append(sb, "; };");
+
+    lexer_init(&lexer, sb->string);
+    lex(&lexer);
+
+    parser_init(&parser, lexer.tokens);
+    parse(&parser);
+
+    type_table = type_table_init();
+    resolver_init(&resolver, type_table);
+    resolve(&resolver, parser.declarations);
+    
+    assert(resolver.diagnostics->length == 0);
+    AST_Declaration* declaration = parser.declarations->items[1];
+    AST_Statement* body = declaration->initializer->function.body;
+    AST_Statement* _return = body->block.statements->items[0];
+
+    ir_generator_init(&generator, resolver.global);
+    ir_generate_expression(&generator, _return->_return.value);
+
+    // The innermost call is generated first and the outermost call last
+    int calls = 0;
+    for (int i = 0; i < generator.instructions->length; i++)
+        if (generator.instructions->items[i].operation == OP_CALL)
+            calls++;
+
+    assert_base(runner, calls == 2 * depth,
+        "Invalid number of calls: %d, expected %d", calls, 2 * depth);
+    assert_instruction(runner, &generator.instructions->items[1], OP_PARAM_PUSH);
+    assert_instruction(runner, &generator.instructions->items[2], OP_CALL);
+    assert_instruction(runner, &generator.instructions->items[3], OP_PARAM_POP);
+    assert_instruction(runner, &generator.instructions->items[generator.instructions->length - 2], OP_CALL);
+    assert_instruction(runner, &generator.instructions->items[generator.instructions->length - 1], OP_PARAM_POP);
     
     ir_generator_free(&generator);
     resolver_free(&resolver);
     type_table_free(type_table);
     parser_free(&parser);
     lexer_free(&lexer);
+    sb_free(sb);
 }
 
 
@@ -662,30 +790,31 @@ static void test_generate_function_expression(Test_Runner* runner)
     // Resolver will enter a scope, and since we don't have a name for the
     // function expression, we will have to set it here manually.
     resolver.context.current_function = "some_func";
-    // We need to take this type and free it, since it won't be freed otherwise
-    Type* type = resolve_expression(&resolver, expression);
+    // NOTE(timo): The local scope of the function has to be freed here, since
+    // there is no symbol of the function to free it
+    resolve_expression(&resolver, expression);
     
     ir_generator_init(&generator, resolver.global);
 
     // We will also have to set the scope to the function scope manually
-    generator.local = type->function.scope;
+    generator.local = expression->function.scope;
 
     ir_generate_expression(&generator, expression);
 
     assert_base(runner, generator.instructions->length == 8,
         "Invalid number of instructions: %d, expected 8", generator.instructions->length);
-    assert_instruction(runner, generator.instructions->items[0], OP_FUNCTION_BEGIN);
-    assert_instruction(runner, generator.instructions->items[1], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[2], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[3], OP_ADD);
-    assert_instruction(runner, generator.instructions->items[4], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[5], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[6], OP_RETURN);
-    assert_instruction(runner, generator.instructions->items[7], OP_FUNCTION_END);
+    assert_instruction(runner, &generator.instructions->items[0], OP_FUNCTION_BEGIN);
+    assert_instruction(runner, &generator.instructions->items[1], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[2], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[3], OP_ADD);
+    assert_instruction(runner, &generator.instructions->items[4], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[5], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[6], OP_RETURN);
+    assert_instruction(runner, &generator.instructions->items[7], OP_FUNCTION_END);
 
     // dump_instructions(generator.instructions);
     
-    type_free(type);
+    scope_free(expression->function.scope);
     expression_free(expression);
     ir_generator_free(&generator);
     resolver_free(&resolver);
@@ -735,10 +864,10 @@ static void test_generate_call_expression(Test_Runner* runner)
 
     assert_base(runner, generator.instructions->length == 4,
         "Invalid number of instructions: %d, expected 4", generator.instructions->length);
-    assert_instruction(runner, generator.instructions->items[0], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[1], OP_PARAM_PUSH);
-    assert_instruction(runner, generator.instructions->items[2], OP_CALL);
-    assert_instruction(runner, generator.instructions->items[3], OP_PARAM_POP);
+    assert_instruction(runner, &generator.instructions->items[0], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[1], OP_PARAM_PUSH);
+    assert_instruction(runner, &generator.instructions->items[2], OP_CALL);
+    assert_instruction(runner, &generator.instructions->items[3], OP_PARAM_POP);
 
     // dump_instructions(generator.instructions);
     
@@ -773,13 +902,13 @@ static void test_generate_call_expression(Test_Runner* runner)
 
     assert_base(runner, generator.instructions->length == 7,
         "Invalid number of instructions: %d, expected 7", generator.instructions->length);
-    assert_instruction(runner, generator.instructions->items[0], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[1], OP_PARAM_PUSH);
-    assert_instruction(runner, generator.instructions->items[2], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[3], OP_PARAM_PUSH);
-    assert_instruction(runner, generator.instructions->items[4], OP_CALL);
-    assert_instruction(runner, generator.instructions->items[5], OP_PARAM_POP);
-    assert_instruction(runner, generator.instructions->items[6], OP_PARAM_POP);
+    assert_instruction(runner, &generator.instructions->items[0], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[1], OP_PARAM_PUSH);
+    assert_instruction(runner, &generator.instructions->items[2], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[3], OP_PARAM_PUSH);
+    assert_instruction(runner, &generator.instructions->items[4], OP_CALL);
+    assert_instruction(runner, &generator.instructions->items[5], OP_PARAM_POP);
+    assert_instruction(runner, &generator.instructions->items[6], OP_PARAM_POP);
 
     // dump_instructions(generator.instructions);
     
@@ -834,7 +963,7 @@ static void test_generate_if_statement_1(Test_Runner* runner)
         "Invalid number of instructions: %d, expected %d", actual_length, expected_length);
 
     for (int i = 0; actual_length == expected_length && i < expected_length; i++)
-        assert_instruction(runner, generator.instructions->items[i], expected[i]);
+        assert_instruction(runner, &generator.instructions->items[i], expected[i]);
 
     // dump_instructions(generator.instructions);
 
@@ -895,7 +1024,7 @@ static void test_generate_if_statement_2(Test_Runner* runner)
         "Invalid number of instructions: %d, expected %d", actual_length, expected_length);
 
     for (int i = 0; actual_length == expected_length && i < expected_length; i++)
-        assert_instruction(runner, generator.instructions->items[i], expected[i]);
+        assert_instruction(runner, &generator.instructions->items[i], expected[i]);
 
     // dump_instructions(generator.instructions);
 
@@ -971,7 +1100,7 @@ static void test_generate_if_statement_3(Test_Runner* runner)
         "Invalid number of instructions: %d, expected %d", actual_length, expected_length);
 
     for (int i = 0; actual_length == expected_length && i < expected_length; i++)
-        assert_instruction(runner, generator.instructions->items[i], expected[i]);
+        assert_instruction(runner, &generator.instructions->items[i], expected[i]);
 
     // dump_instructions(generator.instructions);
 
@@ -1058,7 +1187,7 @@ static void test_generate_if_statement_4(Test_Runner* runner)
         "Invalid number of instructions: %d, expected %d", actual_length, expected_length);
 
     for (int i = 0; actual_length == expected_length && i < expected_length; i++)
-        assert_instruction(runner, generator.instructions->items[i], expected[i]);
+        assert_instruction(runner, &generator.instructions->items[i], expected[i]);
 
     // dump_instructions(generator.instructions);
 
@@ -1125,7 +1254,7 @@ static void test_generate_while_statement(Test_Runner* runner)
         "Invalid number of instructions: %d, expected %d", actual_length, expected_length);
 
     for (int i = 0; actual_length == expected_length && i < expected_length; i++)
-        assert_instruction(runner, generator.instructions->items[i], expected[i]);
+        assert_instruction(runner, &generator.instructions->items[i], expected[i]);
 
     // dump_instructions(generator.instructions);
 
@@ -1204,7 +1333,7 @@ static void test_generate_while_statement_with_break(Test_Runner* runner)
         "Invalid number of instructions: %d, expected %d", actual_length, expected_length);
 
     for (int i = 0; actual_length == expected_length && i < expected_length; i++)
-        assert_instruction(runner, generator.instructions->items[i], expected[i]);
+        assert_instruction(runner, &generator.instructions->items[i], expected[i]);
 
     // dump_instructions(generator.instructions);
 
@@ -1273,7 +1402,7 @@ static void test_generate_while_statement_with_continue(Test_Runner* runner)
         "Invalid number of instructions: %d, expected %d", actual_length, expected_length);
 
     for (int i = 0; actual_length == expected_length && i < expected_length; i++)
-        assert_instruction(runner, generator.instructions->items[i], expected[i]);
+        assert_instruction(runner, &generator.instructions->items[i], expected[i]);
 
     // dump_instructions(generator.instructions);
 
@@ -1354,7 +1483,7 @@ static void test_generate_while_statement_with_continue_and_break(Test_Runner* r
         "Invalid number of instructions: %d, expected %d", actual_length, expected_length);
 
     for (int i = 0; actual_length == expected_length && i < expected_length; i++)
-        assert_instruction(runner, generator.instructions->items[i], expected[i]);
+        assert_instruction(runner, &generator.instructions->items[i], expected[i]);
 
     // dump_instructions(generator.instructions);
 
@@ -1432,7 +1561,7 @@ static void test_generate_while_statement_nested(Test_Runner* runner)
         "Invalid number of instructions: %d, expected %d", actual_length, expected_length);
 
     for (int i = 0; actual_length == expected_length && i < expected_length; i++)
-        assert_instruction(runner, generator.instructions->items[i], expected[i]);
+        assert_instruction(runner, &generator.instructions->items[i], expected[i]);
 
     // dump_instructions(generator.instructions);
 
@@ -1534,7 +1663,7 @@ static void test_generate_while_statement_nested_with_break(Test_Runner* runner)
         "Invalid number of instructions: %d, expected %d", actual_length, expected_length);
 
     for (int i = 0; actual_length == expected_length && i < expected_length; i++)
-        assert_instruction(runner, generator.instructions->items[i], expected[i]);
+        assert_instruction(runner, &generator.instructions->items[i], expected[i]);
 
     // dump_instructions(generator.instructions);
 
@@ -1650,7 +1779,7 @@ static void test_generate_while_statement_nested_with_breaks(Test_Runner* runner
         "Invalid number of instructions: %d, expected %d", actual_length, expected_length);
 
     for (int i = 0; actual_length == expected_length && i < expected_length; i++)
-        assert_instruction(runner, generator.instructions->items[i], expected[i]);
+        assert_instruction(runner, &generator.instructions->items[i], expected[i]);
 
     // dump_instructions(generator.instructions);
 
@@ -1695,8 +1824,8 @@ static void test_generate_return_statement(Test_Runner* runner)
 
     assert_base(runner, generator.instructions->length == 2,
         "Invalid number of instructions: %d, expected 2", generator.instructions->length);
-    assert_instruction(runner, generator.instructions->items[0], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[1], OP_RETURN);
+    assert_instruction(runner, &generator.instructions->items[0], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[1], OP_RETURN);
 
     // dump_instructions(generator.instructions);
 
@@ -1746,24 +1875,24 @@ static void test_generate_variable_declaration_global(Test_Runner* runner)
 
     assert_base(runner, generator.instructions->length == 18,
         "Invalid number of instructions: %d, expected 18", generator.instructions->length);
-    assert_instruction(runner, generator.instructions->items[0], OP_LABEL);
-    assert_instruction(runner, generator.instructions->items[1], OP_FUNCTION_BEGIN);
-    assert_instruction(runner, generator.instructions->items[2], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[3], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[4], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[5], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[6], OP_GT);
-    assert_instruction(runner, generator.instructions->items[7], OP_GOTO_IF_FALSE);
-    assert_instruction(runner, generator.instructions->items[8], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[9], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[10], OP_GOTO);
-    assert_instruction(runner, generator.instructions->items[11], OP_LABEL);
-    assert_instruction(runner, generator.instructions->items[12], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[13], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[14], OP_LABEL);
-    assert_instruction(runner, generator.instructions->items[15], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[16], OP_RETURN);
-    assert_instruction(runner, generator.instructions->items[17], OP_FUNCTION_END);
+    assert_instruction(runner, &generator.instructions->items[0], OP_LABEL);
+    assert_instruction(runner, &generator.instructions->items[1], OP_FUNCTION_BEGIN);
+    assert_instruction(runner, &generator.instructions->items[2], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[3], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[4], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[5], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[6], OP_GT);
+    assert_instruction(runner, &generator.instructions->items[7], OP_GOTO_IF_FALSE);
+    assert_instruction(runner, &generator.instructions->items[8], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[9], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[10], OP_GOTO);
+    assert_instruction(runner, &generator.instructions->items[11], OP_LABEL);
+    assert_instruction(runner, &generator.instructions->items[12], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[13], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[14], OP_LABEL);
+    assert_instruction(runner, &generator.instructions->items[15], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[16], OP_RETURN);
+    assert_instruction(runner, &generator.instructions->items[17], OP_FUNCTION_END);
     
     // dump_instructions(generator.instructions);
 
@@ -1810,24 +1939,24 @@ static void test_generate_function_declaration(Test_Runner* runner)
 
     assert_base(runner, generator.instructions->length == 18,
         "Invalid number of instructions: %d, expected 18", generator.instructions->length);
-    assert_instruction(runner, generator.instructions->items[0], OP_LABEL);
-    assert_instruction(runner, generator.instructions->items[1], OP_FUNCTION_BEGIN);
-    assert_instruction(runner, generator.instructions->items[2], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[3], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[4], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[5], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[6], OP_GT);
-    assert_instruction(runner, generator.instructions->items[7], OP_GOTO_IF_FALSE);
-    assert_instruction(runner, generator.instructions->items[8], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[9], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[10], OP_GOTO);
-    assert_instruction(runner, generator.instructions->items[11], OP_LABEL);
-    assert_instruction(runner, generator.instructions->items[12], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[13], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[14], OP_LABEL);
-    assert_instruction(runner, generator.instructions->items[15], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[16], OP_RETURN);
-    assert_instruction(runner, generator.instructions->items[17], OP_FUNCTION_END);
+    assert_instruction(runner, &generator.instructions->items[0], OP_LABEL);
+    assert_instruction(runner, &generator.instructions->items[1], OP_FUNCTION_BEGIN);
+    assert_instruction(runner, &generator.instructions->items[2], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[3], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[4], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[5], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[6], OP_GT);
+    assert_instruction(runner, &generator.instructions->items[7], OP_GOTO_IF_FALSE);
+    assert_instruction(runner, &generator.instructions->items[8], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[9], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[10], OP_GOTO);
+    assert_instruction(runner, &generator.instructions->items[11], OP_LABEL);
+    assert_instruction(runner, &generator.instructions->items[12], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[13], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[14], OP_LABEL);
+    assert_instruction(runner, &generator.instructions->items[15], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[16], OP_RETURN);
+    assert_instruction(runner, &generator.instructions->items[17], OP_FUNCTION_END);
     
     // dump_instructions(generator.instructions);
 
@@ -1840,6 +1969,79 @@ static void test_generate_function_declaration(Test_Runner* runner)
 }
 
 
+static void test_generate_shared_expressions(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parser;
+    hashtable* type_table;
+    Resolver resolver;
+    IR_Generator generator;
+    AST_Declaration* declaration;
+    char* source;
+    
+    source = "foo: int = (a: int, b: int) => {\n"
+             "    x: int = a * b + a * b;\n"
+             "    a := 1;\n"
+             "    return a * b;\n"
+             "};";
+
+    lexer_init(&lexer, source);
+    lex(&lexer);
+
+    parser_init(&parser, lexer.tokens);
+    parser.share = true;
+    declaration = parse_top_level_declaration(&parser);
+
+    type_table = type_table_init();
+    resolver_init(&resolver, type_table);
+    resolver.shared = true;
+    resolve_declaration(&resolver, declaration);
+
+    ir_generator_init(&generator, resolver.global);
+    generator.shared = true;
+    ir_generate_declaration(&generator, declaration);
+
+    assert_base(runner, generator.instructions->length == 13,
+        "Invalid number of instructions: %d, expected 13", generator.instructions->length);
+    assert_instruction(runner, &generator.instructions->items[4], OP_MUL);
+    assert_instruction(runner, &generator.instructions->items[5], OP_ADD);
+    assert_instruction(runner, &generator.instructions->items[10], OP_MUL);
+
+    Instruction* sum = &generator.instructions->items[5];
+    Instruction* product = &generator.instructions->items[10];
+
+    assert_base(runner, sum->arg1_symbol == sum->arg2_symbol && sum->arg1_symbol == generator.instructions->items[4].result_symbol,
+        "The result of 'a * b' is not reused in the same statement");
+    assert_base(runner, product->arg1_symbol != generator.instructions->items[2].result_symbol,
+        "The value of 'a' is reused after the assignment of 'a'");
+    assert_base(runner, product->arg2_symbol == generator.instructions->items[3].result_symbol,
+        "The value of 'b' is not reused after the assignment of 'a'");
+
+    // dump_instructions(generator.instructions);
+
+    // NOTE(timo): The generators save the results on the tree and the writes
+    // on the symbols, so the same tree generated again gives the same result
+    IR_Generator again;
+    ir_generator_init(&again, resolver.global);
+    again.shared = true;
+    ir_generate_declaration(&again, declaration);
+
+    assert_base(runner, again.instructions->length == generator.instructions->length,
+        "Invalid number of instructions generated again: %d, expected %d", 
+        again.instructions->length, generator.instructions->length);
+
+    for (int i = 0; i < again.instructions->length && i < generator.instructions->length; i++)
+        assert_instruction(runner, &again.instructions->items[i], generator.instructions->items[i].operation);
+
+    ir_generator_free(&again);
+    ir_generator_free(&generator);
+    resolver_free(&resolver);
+    type_table_free(type_table);
+    parser_free(&parser);
+    lexer_free(&lexer);
+}
+
+
 static void test_generate_arithmetics(Test_Runner* runner)
 {
     Lexer lexer;
@@ -1864,11 +2066,11 @@ static void test_generate_arithmetics(Test_Runner* runner)
 
     assert_base(runner, generator.instructions->length == 5,
         "Invalid number of instructions: %d, expected 5", generator.instructions->length);
-    assert_instruction(runner, generator.instructions->items[0], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[1], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[2], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[3], OP_MUL);
-    assert_instruction(runner, generator.instructions->items[4], OP_ADD);
+    assert_instruction(runner, &generator.instructions->items[0], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[1], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[2], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[3], OP_MUL);
+    assert_instruction(runner, &generator.instructions->items[4], OP_ADD);
 
     // dump_instructions(generator.instructions);
 
@@ -1895,13 +2097,13 @@ static void test_generate_arithmetics(Test_Runner* runner)
 
     assert_base(runner, generator.instructions->length == 7,
         "Invalid number of instructions: %d, expected 7", generator.instructions->length);
-    assert_instruction(runner, generator.instructions->items[0], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[1], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[2], OP_MUL);
-    assert_instruction(runner, generator.instructions->items[3], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[4], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[5], OP_MUL);
-    assert_instruction(runner, generator.instructions->items[6], OP_ADD);
+    assert_instruction(runner, &generator.instructions->items[0], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[1], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[2], OP_MUL);
+    assert_instruction(runner, &generator.instructions->items[3], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[4], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[5], OP_MUL);
+    assert_instruction(runner, &generator.instructions->items[6], OP_ADD);
 
     // dump_instructions(generator.instructions);
 
@@ -1928,15 +2130,15 @@ static void test_generate_arithmetics(Test_Runner* runner)
 
     assert_base(runner, generator.instructions->length == 9,
         "Invalid number of instructions: %d, expected 9", generator.instructions->length);
-    assert_instruction(runner, generator.instructions->items[0], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[1], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[2], OP_MINUS);
-    assert_instruction(runner, generator.instructions->items[3], OP_MUL);
-    assert_instruction(runner, generator.instructions->items[4], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[5], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[6], OP_MINUS);
-    assert_instruction(runner, generator.instructions->items[7], OP_MUL);
-    assert_instruction(runner, generator.instructions->items[8], OP_ADD);
+    assert_instruction(runner, &generator.instructions->items[0], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[1], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[2], OP_MINUS);
+    assert_instruction(runner, &generator.instructions->items[3], OP_MUL);
+    assert_instruction(runner, &generator.instructions->items[4], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[5], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[6], OP_MINUS);
+    assert_instruction(runner, &generator.instructions->items[7], OP_MUL);
+    assert_instruction(runner, &generator.instructions->items[8], OP_ADD);
 
     // dump_instructions(generator.instructions);
 
@@ -1986,35 +2188,35 @@ static void test_generate_small_program(Test_Runner* runner)
 
     assert_base(runner, generator.instructions->length == 29,
         "Invalid number of instructions: %d, expected 29", generator.instructions->length);
-    assert_instruction(runner, generator.instructions->items[0], OP_LABEL);
-    assert_instruction(runner, generator.instructions->items[1], OP_FUNCTION_BEGIN);
-    assert_instruction(runner, generator.instructions->items[2], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[3], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[4], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[5], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[6], OP_GT);
-    assert_instruction(runner, generator.instructions->items[7], OP_GOTO_IF_FALSE);
-    assert_instruction(runner, generator.instructions->items[8], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[9], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[10], OP_GOTO);
-    assert_instruction(runner, generator.instructions->items[11], OP_LABEL);
-    assert_instruction(runner, generator.instructions->items[12], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[13], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[14], OP_LABEL);
-    assert_instruction(runner, generator.instructions->items[15], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[16], OP_RETURN);
-    assert_instruction(runner, generator.instructions->items[17], OP_FUNCTION_END);
-    assert_instruction(runner, generator.instructions->items[18], OP_LABEL);
-    assert_instruction(runner, generator.instructions->items[19], OP_FUNCTION_BEGIN);
-    assert_instruction(runner, generator.instructions->items[20], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[21], OP_PARAM_PUSH);
-    assert_instruction(runner, generator.instructions->items[22], OP_COPY);
-    assert_instruction(runner, generator.instructions->items[23], OP_PARAM_PUSH);
-    assert_instruction(runner, generator.instructions->items[24], OP_CALL);
-    assert_instruction(runner, generator.instructions->items[25], OP_PARAM_POP);
-    assert_instruction(runner, generator.instructions->items[26], OP_PARAM_POP);
-    assert_instruction(runner, generator.instructions->items[27], OP_RETURN);
-    assert_instruction(runner, generator.instructions->items[28], OP_FUNCTION_END);
+    assert_instruction(runner, &generator.instructions->items[0], OP_LABEL);
+    assert_instruction(runner, &generator.instructions->items[1], OP_FUNCTION_BEGIN);
+    assert_instruction(runner, &generator.instructions->items[2], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[3], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[4], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[5], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[6], OP_GT);
+    assert_instruction(runner, &generator.instructions->items[7], OP_GOTO_IF_FALSE);
+    assert_instruction(runner, &generator.instructions->items[8], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[9], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[10], OP_GOTO);
+    assert_instruction(runner, &generator.instructions->items[11], OP_LABEL);
+    assert_instruction(runner, &generator.instructions->items[12], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[13], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[14], OP_LABEL);
+    assert_instruction(runner, &generator.instructions->items[15], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[16], OP_RETURN);
+    assert_instruction(runner, &generator.instructions->items[17], OP_FUNCTION_END);
+    assert_instruction(runner, &generator.instructions->items[18], OP_LABEL);
+    assert_instruction(runner, &generator.instructions->items[19], OP_FUNCTION_BEGIN);
+    assert_instruction(runner, &generator.instructions->items[20], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[21], OP_PARAM_PUSH);
+    assert_instruction(runner, &generator.instructions->items[22], OP_COPY);
+    assert_instruction(runner, &generator.instructions->items[23], OP_PARAM_PUSH);
+    assert_instruction(runner, &generator.instructions->items[24], OP_CALL);
+    assert_instruction(runner, &generator.instructions->items[25], OP_PARAM_POP);
+    assert_instruction(runner, &generator.instructions->items[26], OP_PARAM_POP);
+    assert_instruction(runner, &generator.instructions->items[27], OP_RETURN);
+    assert_instruction(runner, &generator.instructions->items[28], OP_FUNCTION_END);
     
     // dump_instructions(generator.instructions);
 
@@ -2026,6 +2228,183 @@ static void test_generate_small_program(Test_Runner* runner)
 }
 
 
+// Compiles the source with the separate passes and in the single pass mode
+// and checks that both of them find the same errors and generate the same
+// instructions. The identical expressions are shared by both if requested.
+static void assert_same_passes(Test_Runner* runner, const char* source, bool share)
+{
+    Lexer lexer, single_lexer;
+    Parser parser, single_parser;
+    hashtable* type_table;
+    hashtable* single_type_table;
+    Resolver resolver, single_resolver;
+    IR_Generator generator, single_generator;
+
+    lexer_init(&lexer, source);
+    parser_init_streaming(&parser, &lexer);
+    parser.share = share;
+    parse(&parser);
+
+    type_table = type_table_init();
+    resolver_init(&resolver, type_table);
+    resolver.shared = share;
+    resolve(&resolver, parser.declarations);
+
+    ir_generator_init(&generator, resolver.global);
+    generator.shared = share;
+
+    if (resolver.diagnostics->length == 0)
+        ir_generate(&generator, parser.declarations);
+
+    lexer_init(&single_lexer, source);
+    parser_init_streaming(&single_parser, &single_lexer);
+    single_parser.share = share;
+    single_type_table = type_table_init();
+    resolver_init(&single_resolver, single_type_table);
+    single_resolver.shared = share;
+    ir_generator_init(&single_generator, single_resolver.global);
+    single_generator.shared = share;
+    compile_single_pass(&single_lexer, &single_parser, &single_resolver, &single_generator);
+
+    assert_base(runner, single_generator.results.length == 0,
+        "The shared results are kept after the single pass, %d of them", single_generator.results.length);
+
+    assert_base(runner, single_resolver.diagnostics->length == resolver.diagnostics->length,
+        "Invalid number of resolver diagnostics %d, expected %d", 
+        single_resolver.diagnostics->length, resolver.diagnostics->length);
+
+    for (int i = 0; i < single_resolver.diagnostics->length && i < resolver.diagnostics->length; i++)
+    {
+        Diagnostic* diagnostic = single_resolver.diagnostics->items[i];
+        Diagnostic* expected = resolver.diagnostics->items[i];
+
+        assert_base(runner, strcmp(diagnostic->message, expected->message) == 0 &&
+                            diagnostic->position.start == expected->position.start,
+            "Invalid diagnostic '%s', expected '%s'", diagnostic->message, expected->message);
+    }
+
+    assert_same_instructions(runner, single_generator.instructions, generator.instructions);
+
+    ir_generator_free(&single_generator);
+    resolver_free(&single_resolver);
+    type_table_free(single_type_table);
+    parser_free(&single_parser);
+    lexer_free(&single_lexer);
+
+    ir_generator_free(&generator);
+    resolver_free(&resolver);
+    type_table_free(type_table);
+    parser_free(&parser);
+    lexer_free(&lexer);
+}
+
+
+static void test_generate_single_pass(Test_Runner* runner)
+{
+    const char* source = "limit: int = 10;\n"
+                         "max: int = (x: int, y: int) => {\n"
+                         "    result: int = y;\n"
+                         "    if x > y and x != limit then {\n"
+                         "        result := x;\n"
+                         "    }\n"
+                         "    return result;\n"
+                         "};\n"
+                         "main: int = (argc: int, argv: [int]) => {\n"
+                         "    i: int = 0;\n"
+                         "    while i < limit do {\n"
+                         "        i := max(i + 1, argc);\n"
+                         "    }\n"
+                         "    return i;\n"
+                         "};";
+
+    assert_same_passes(runner, source, false);
+
+    // NOTE(timo): The errors are in the different declarations, so the 
+    // declarations after the first error are still resolved
+    source = "foo: int = (a: int) => { b: bool = a; return a + true; };\n"
+             "bar: int = foo(1);\n"
+             "main: int = (argc: int, argv: [int]) => { x: int = foo(argc, 1); return y; };";
+
+    assert_same_passes(runner, source, false);
+}
+
+
+static void test_generate_single_pass_shared(Test_Runner* runner)
+{
+    // NOTE(timo): The declarations are alike, so the trees of the later ones
+    // are allocated at the same addresses as the released trees before them
+    const char* source = "f: int = (a: int, b: int) => { c: int = a * b + a * b; a := a * b; return a * b + c; };\n"
+                         "g: int = (a: int, b: int) => { c: int = a * b + a * b; b := a * b; return a * b + c; };\n"
+                         "h: int = (a: int, b: int) => { c: int = a * b + a * b; if c > 0 then c := a * b; return c; };\n"
+                         "main: int = (argc: int, argv: [int]) => { x: int = f(argc, 2) + g(argc, 2); return x + h(x, x); };";
+
+    assert_same_passes(runner, source, true);
+}
+
+
+static void test_generate_single_pass_memory(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parser;
+    hashtable* type_table;
+    Resolver resolver;
+    IR_Generator generator;
+    stringbuilder* sb = sb_init();
+    char function[256];
+
+    for (int i = 0; i < 400; i++)
+    {
+        snprintf(function, sizeof (function), 
+            "f%d: int = (a: int, b: bool) => { c: int = a * %d; if b then { c := c - 1; } while c < 100 do { c := c + 3; } return c; };\n", i, i);
+        sb_append(sb, function);
+    }
+
+    sb_append(sb, "main: int = (argc: int, argv: [int]) => { return f0(argc, true); };");
+    char* source = sb_to_string(sb);
+
+    // NOTE(timo): The tree of the whole program doesn't fit into one block
+    lexer_init(&lexer, source);
+    parser_init_streaming(&parser, &lexer);
+    parse(&parser);
+
+    assert_base(runner, parser.arena.head != NULL && parser.arena.head->next != NULL,
+        "The tree of the whole program fits into one block of the arena");
+
+    parser_free(&parser);
+    lexer_free(&lexer);
+
+    // NOTE(timo): Only the newest block is kept after the arena is reset 
+    // after every declaration
+    lexer_init(&lexer, source);
+    parser_init_streaming(&parser, &lexer);
+    type_table = type_table_init();
+    resolver_init(&resolver, type_table);
+    ir_generator_init(&generator, resolver.global);
+    compile_single_pass(&lexer, &parser, &resolver, &generator);
+
+    assert_base(runner, resolver.diagnostics->length == 0,
+        "Invalid number of resolver diagnostics %d, expected 0", resolver.diagnostics->length);
+    assert_base(runner, parser.arena.head != NULL && parser.arena.head->next == NULL,
+        "The arena holds more than one block after the single pass");
+    assert_base(runner, parser.arena.head->used == 0 && parser.arena.allocated == 0,
+        "The arena is not empty after the single pass");
+
+    // NOTE(timo): The kept block is reused by the next allocations
+    arena_block* block = parser.arena.head;
+    arena_alloc(&parser.arena, 64);
+
+    assert_base(runner, parser.arena.head == block,
+        "The block kept by the reset is not reused");
+
+    ir_generator_free(&generator);
+    resolver_free(&resolver);
+    type_table_free(type_table);
+    parser_free(&parser);
+    lexer_free(&lexer);
+    sb_free(sb);
+}
+
+
 Test_Set* ir_generator_test_set()
 {
     Test_Set* set = test_set("IR Generator");
@@ -2035,6 +2414,7 @@ Test_Set* ir_generator_test_set()
     array_push(set->tests, test_case("Unary expression (minus)", test_generate_unary_expression_minus));
     array_push(set->tests, test_case("Binary expression (arithmetic)", test_generate_binary_expression_arithmetic));
     array_push(set->tests, test_case("Binary expression (relational)", test_generate_binary_expression_relational));
+    array_push(set->tests, test_case("Folded expression", test_generate_folded_expression));
     array_push(set->tests, test_case("Logical expression (not)", test_generate_logical_expression_not));
     array_push(set->tests, test_case("Logical expression (and)", test_generate_logical_expression_and));
     array_push(set->tests, test_case("Logical expression (or)", test_generate_logical_expression_or));
@@ -2044,6 +2424,7 @@ Test_Set* ir_generator_test_set()
     array_push(set->tests, test_case("Function expression", test_generate_function_expression));
     array_push(set->tests, test_case("Call expression", test_generate_call_expression));
     array_push(set->tests, test_case("Index expression", test_generate_index_expression));
+    array_push(set->tests, test_case("Deeply nested calls", test_generate_deeply_nested_calls));
 
     // Statements
     array_push(set->tests, test_case("If statement (if then)", test_generate_if_statement_1));
@@ -2063,10 +2444,14 @@ Test_Set* ir_generator_test_set()
     // Declarations
     array_push(set->tests, test_case("Variable declaration (global)", test_generate_variable_declaration_global));
     array_push(set->tests, test_case("Function declaration", test_generate_function_declaration));
+    array_push(set->tests, test_case("Shared expressions", test_generate_shared_expressions));
 
     // MISC
     array_push(set->tests, test_case("Generate MISC arithmetics", test_generate_arithmetics));
     array_push(set->tests, test_case("Small program", test_generate_small_program));
+    array_push(set->tests, test_case("Single pass", test_generate_single_pass));
+    array_push(set->tests, test_case("Single pass (memory)", test_generate_single_pass_memory));
+    array_push(set->tests, test_case("Single pass (shared)", test_generate_single_pass_shared));
 
     set->length = set->tests->length;
 
@@ -19,8 +19,8 @@ static void test_skip_whitespace(Test_Runner* runner)
 
     assert_base(runner, lexer.tokens->length == 1, 
                 "Invalid number of tokens '%d' expected 1", lexer.tokens->length);
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 3, 5, 3, 5);
-    assert_token(runner, (Token*)*lexer.tokens->items, TOKEN_EOF, "<EoF>");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 3, 5, 3, 5);
+    assert_token(runner, lexer.tokens->items, TOKEN_EOF, "<EoF>");
 
     lexer_free(&lexer);
 }
@@ -35,8 +35,8 @@ static void test_skip_comments_1(Test_Runner* runner)
 
     assert_base(runner, lexer.tokens->length == 1, 
                 "Invalid number of tokens '%d' expected 1", lexer.tokens->length);
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 18, 1, 18);
-    assert_token(runner, (Token*)*lexer.tokens->items, TOKEN_EOF, "<EoF>");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 18, 1, 18);
+    assert_token(runner, lexer.tokens->items, TOKEN_EOF, "<EoF>");
 
     lexer_free(&lexer);
 }
@@ -51,13 +51,104 @@ static void test_skip_comments_2(Test_Runner* runner)
 
     assert_base(runner, lexer.tokens->length == 1, 
                 "Invalid number of tokens '%d' expected 1", lexer.tokens->length);
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 3, 1, 3, 1);
-    assert_token(runner, (Token*)*lexer.tokens->items, TOKEN_EOF, "<EoF>");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 3, 1, 3, 1);
+    assert_token(runner, lexer.tokens->items, TOKEN_EOF, "<EoF>");
 
     lexer_free(&lexer);
 }
 
 
+static void test_skip_long_whitespace_and_comments(Test_Runner* runner)
+{
+    Lexer lexer;
+    char source[256];
+
+    // NOTE(timo): The runs are longer than the blocks scanned at once and the
+    // identifier is shifted so that the runs start from every alignment
+    for (int shift = 0; shift < 40; shift++)
+    {
+        int length = 0;
+
+        for (int i = 0; i < shift; i++) source[length++] = 'a';
+        source[length++] = ' ';
+        for (int i = 0; i < 50; i++) source[length++] = i % 7 == 0 ? '\t' : ' ';
+        source[length++] = '\n';
+        for (int i = 0; i < 70; i++) source[length++] = i == 0 ? '#' : '-';
+        source[length++] = '\n';
+        source[length++] = 'b';
+        for (int i = 0; i < 35; i++) source[length++] = '#';
+        source[length] = 0;
+
+        lexer_init(&lexer, source);
+        lex(&lexer);
+
+        int tokens = shift > 0 ? 3 : 2;
+
+        assert_base(runner, lexer.tokens->length == tokens, 
+                    "Invalid number of tokens '%d' expected %d", lexer.tokens->length, tokens);
+
+        lexer.tokens->items += tokens - 2;
+        assert_token(runner, lexer.tokens->items, TOKEN_IDENTIFIER, "b");
+        assert_position(runner, lexer.source, lexer.tokens->items->position, 3, 1, 3, 1);
+        lexer.tokens->items++;
+        assert_token(runner, lexer.tokens->items, TOKEN_EOF, "<EoF>");
+        assert_position(runner, lexer.source, lexer.tokens->items->position, 3, 37, 3, 37);
+
+        lexer.tokens->items -= tokens - 1; // unwind the array
+        lexer_free(&lexer);
+    }
+}
+
+
+static void test_skip_to_end_of_range(Test_Runner* runner)
+{
+    Lexer lexer;
+
+    // NOTE(timo): The buffers are not terminated and they are exactly as long 
+    // as the ranges, so any read past the end is caught by the sanitizers. 
+    // The runs end at every length around the blocks scanned at once.
+    for (int length = 2; length < 80; length++)
+    {
+        for (int comment = 0; comment < 2; comment++)
+        {
+            char* buffer = xmalloc(length);
+
+            buffer[0] = 'a';
+            for (int i = 1; i < length; i++) buffer[i] = comment ? (i == 1 ? '#' : '-') : (i % 5 == 0 ? '\n' : ' ');
+
+            lexer_init_range(&lexer, buffer, buffer, buffer + length);
+            lex(&lexer);
+
+            assert_base(runner, lexer.tokens->length == 2, 
+                        "Invalid number of tokens '%d' expected 2", lexer.tokens->length);
+            assert_base(runner, lexer.tokens->items[1].kind == TOKEN_EOF && lexer.tokens->items[1].position.start == length,
+                        "Invalid end of file at %d with %d characters, expected %d", 
+                        lexer.tokens->items[1].position.start, length, length);
+
+            lexer_free(&lexer);
+            free(buffer);
+        }
+    }
+
+    // The range ends in the middle of the whitespace and the comment
+    const char* source = "a                                                    b\n"
+                         "#-------------------------------------------------------\n"
+                         "c";
+
+    for (int end = 2; end < 100; end += 7)
+    {
+        lexer_init_range(&lexer, source, source, source + end);
+        lex(&lexer);
+
+        Token* last = &lexer.tokens->items[lexer.tokens->length - 1];
+
+        assert_base(runner, last->kind == TOKEN_EOF && last->position.start == end,
+                    "Invalid end of file at %d, expected %d", last->position.start, end);
+
+        lexer_free(&lexer);
+    }
+}
+
 static void test_arithmetic_operators(Test_Runner* runner)
 {
     Lexer lexer;
@@ -67,16 +158,16 @@ static void test_arithmetic_operators(Test_Runner* runner)
 
     assert_base(runner, lexer.tokens->length == 5, 
                 "Invalid number of tokens '%d' expected 5", lexer.tokens->length);
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 1, 1, 1);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_PLUS, "+");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 3, 1, 3);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_MINUS, "-");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 5, 1, 5);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_MULTIPLY, "*");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 7, 1, 7);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_DIVIDE, "/");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 8, 1, 8);
-    assert_token(runner, (Token*)*lexer.tokens->items, TOKEN_EOF, "<EoF>");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 1, 1, 1);
+    assert_token(runner, lexer.tokens->items++, TOKEN_PLUS, "+");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 3, 1, 3);
+    assert_token(runner, lexer.tokens->items++, TOKEN_MINUS, "-");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 5, 1, 5);
+    assert_token(runner, lexer.tokens->items++, TOKEN_MULTIPLY, "*");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 7, 1, 7);
+    assert_token(runner, lexer.tokens->items++, TOKEN_DIVIDE, "/");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 8, 1, 8);
+    assert_token(runner, lexer.tokens->items, TOKEN_EOF, "<EoF>");
 
     lexer.tokens->items -= 4; // unwinding of the array
     lexer_free(&lexer);
@@ -92,20 +183,20 @@ static void test_comparison_operators(Test_Runner* runner)
 
     assert_base(runner, lexer.tokens->length == 7, 
                 "Invalid number of tokens '%d' expected 7", lexer.tokens->length);
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 1, 1, 2);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_IS_EQUAL, "==");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 4, 1, 5);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_NOT_EQUAL, "!=");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 7, 1, 7);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_LESS_THAN, "<");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 9, 1, 10);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_LESS_THAN_EQUAL, "<=");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 12, 1, 12);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_GREATER_THAN, ">");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 14, 1, 15);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_GREATER_THAN_EQUAL, ">=");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 16, 1, 16);
-    assert_token(runner, (Token*)*lexer.tokens->items, TOKEN_EOF, "<EoF>");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 1, 1, 2);
+    assert_token(runner, lexer.tokens->items++, TOKEN_IS_EQUAL, "==");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 4, 1, 5);
+    assert_token(runner, lexer.tokens->items++, TOKEN_NOT_EQUAL, "!=");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 7, 1, 7);
+    assert_token(runner, lexer.tokens->items++, TOKEN_LESS_THAN, "<");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 9, 1, 10);
+    assert_token(runner, lexer.tokens->items++, TOKEN_LESS_THAN_EQUAL, "<=");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 12, 1, 12);
+    assert_token(runner, lexer.tokens->items++, TOKEN_GREATER_THAN, ">");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 14, 1, 15);
+    assert_token(runner, lexer.tokens->items++, TOKEN_GREATER_THAN_EQUAL, ">=");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 16, 1, 16);
+    assert_token(runner, lexer.tokens->items, TOKEN_EOF, "<EoF>");
 
     lexer.tokens->items -= 6; // unwinding of the array
     lexer_free(&lexer);
@@ -121,14 +212,14 @@ static void test_assignment_operators(Test_Runner* runner)
 
     assert_base(runner, lexer.tokens->length == 4,
                 "Invalid number of tokens '%d' expected 4", lexer.tokens->length);
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 1, 1, 1);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_COLON, ":");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 3, 1, 3);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_EQUAL, "=");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 5, 1, 6);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_COLON_ASSIGN, ":=");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 7, 1, 7);
-    assert_token(runner, (Token*)*lexer.tokens->items, TOKEN_EOF, "<EoF>");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 1, 1, 1);
+    assert_token(runner, lexer.tokens->items++, TOKEN_COLON, ":");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 3, 1, 3);
+    assert_token(runner, lexer.tokens->items++, TOKEN_EQUAL, "=");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 5, 1, 6);
+    assert_token(runner, lexer.tokens->items++, TOKEN_COLON_ASSIGN, ":=");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 7, 1, 7);
+    assert_token(runner, lexer.tokens->items, TOKEN_EOF, "<EoF>");
 
     lexer.tokens->items -= 3; // unwinding of the array
     lexer_free(&lexer);
@@ -144,24 +235,24 @@ static void test_punctuations(Test_Runner* runner)
 
     assert_base(runner, lexer.tokens->length == 9,
                 "Invalid number of tokens '%d' expected 9", lexer.tokens->length);
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 1, 1, 1);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_LEFT_PARENTHESIS, "(");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 3, 1, 3);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_RIGHT_PARENTHESIS, ")");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 5, 1, 5);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_LEFT_BRACKET, "[");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 7, 1, 7);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_RIGHT_BRACKET, "]");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 9, 1, 9);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_LEFT_CURLYBRACE, "{");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 11, 1, 11);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_RIGHT_CURLYBRACE, "}");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 13, 1, 13);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_COMMA, ",");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 15, 1, 15);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_SEMICOLON, ";");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 16, 1, 16);
-    assert_token(runner, (Token*)*lexer.tokens->items, TOKEN_EOF, "<EoF>");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 1, 1, 1);
+    assert_token(runner, lexer.tokens->items++, TOKEN_LEFT_PARENTHESIS, "(");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 3, 1, 3);
+    assert_token(runner, lexer.tokens->items++, TOKEN_RIGHT_PARENTHESIS, ")");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 5, 1, 5);
+    assert_token(runner, lexer.tokens->items++, TOKEN_LEFT_BRACKET, "[");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 7, 1, 7);
+    assert_token(runner, lexer.tokens->items++, TOKEN_RIGHT_BRACKET, "]");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 9, 1, 9);
+    assert_token(runner, lexer.tokens->items++, TOKEN_LEFT_CURLYBRACE, "{");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 11, 1, 11);
+    assert_token(runner, lexer.tokens->items++, TOKEN_RIGHT_CURLYBRACE, "}");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 13, 1, 13);
+    assert_token(runner, lexer.tokens->items++, TOKEN_COMMA, ",");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 15, 1, 15);
+    assert_token(runner, lexer.tokens->items++, TOKEN_SEMICOLON, ";");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 16, 1, 16);
+    assert_token(runner, lexer.tokens->items, TOKEN_EOF, "<EoF>");
 
     lexer.tokens->items -= 8; // unwinding of the array
     lexer_free(&lexer);
@@ -177,8 +268,8 @@ static void test_misc_operators(Test_Runner* runner)
 
     assert_base(runner, lexer.tokens->length == 2,
                 "Invalid number of tokens '%d' expected 2", lexer.tokens->length);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_ARROW, "=>");
-    assert_token(runner, (Token*)*lexer.tokens->items, TOKEN_EOF, "<EoF>");
+    assert_token(runner, lexer.tokens->items++, TOKEN_ARROW, "=>");
+    assert_token(runner, lexer.tokens->items, TOKEN_EOF, "<EoF>");
 
     lexer.tokens->items -= 1; // unwinding of the array
     lexer_free(&lexer);
@@ -194,18 +285,42 @@ static void test_integer_literals(Test_Runner* runner)
 
     assert_base(runner, lexer.tokens->length == 3,
                 "Invalid number of tokens '%d' expected 3", lexer.tokens->length);
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 1, 1, 1);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_INTEGER_LITERAL, "7");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 3, 1, 4);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_INTEGER_LITERAL, "42");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 5, 1, 5);
-    assert_token(runner, (Token*)*lexer.tokens->items, TOKEN_EOF, "<EoF>");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 1, 1, 1);
+    assert_token(runner, lexer.tokens->items++, TOKEN_INTEGER_LITERAL, "7");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 3, 1, 4);
+    assert_token(runner, lexer.tokens->items++, TOKEN_INTEGER_LITERAL, "42");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 5, 1, 5);
+    assert_token(runner, lexer.tokens->items, TOKEN_EOF, "<EoF>");
 
     lexer.tokens->items -= 2; // unwinding of the array
     lexer_free(&lexer);
 }
 
 
+static void test_integer_literal_values(Test_Runner* runner)
+{
+    Lexer lexer;
+
+    lexer_init(&lexer, "0 2147483648 9223372036854775807 9223372036854775808 123456789012345678901234567890");
+    lex(&lexer);
+
+    int64_t values[] = { 0, 2147483648, INT64_MAX, INT64_MAX, INT64_MAX };
+
+    assert_base(runner, lexer.tokens->length == 6,
+                "Invalid number of tokens '%d' expected 6", lexer.tokens->length);
+
+    for (int i = 0; i < sizeof (values) / sizeof (*values); i++)
+    {
+        Token* _token = &lexer.tokens->items[i];
+
+        assert_base(runner, _token->kind == TOKEN_INTEGER_LITERAL && _token->integer == values[i],
+                    "Invalid integer value '%lld' for '%s', expected '%lld'", (long long)_token->integer, _token->lexeme, (long long)values[i]);
+    }
+
+    lexer_free(&lexer);
+}
+
+
 static void test_boolean_literals(Test_Runner* runner)
 {
     Lexer lexer;
@@ -215,12 +330,12 @@ static void test_boolean_literals(Test_Runner* runner)
 
     assert_base(runner, lexer.tokens->length == 3,
                 "Invalid number of tokens '%d' expected 3", lexer.tokens->length);
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 1, 1, 4);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_BOOLEAN_LITERAL, "true");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 6, 1, 10);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_BOOLEAN_LITERAL, "false");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 11, 1, 11);
-    assert_token(runner, (Token*)*lexer.tokens->items, TOKEN_EOF, "<EoF>");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 1, 1, 4);
+    assert_token(runner, lexer.tokens->items++, TOKEN_BOOLEAN_LITERAL, "true");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 6, 1, 10);
+    assert_token(runner, lexer.tokens->items++, TOKEN_BOOLEAN_LITERAL, "false");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 11, 1, 11);
+    assert_token(runner, lexer.tokens->items, TOKEN_EOF, "<EoF>");
 
     lexer.tokens->items -= 2; // unwinding of the array
     lexer_free(&lexer);
@@ -236,34 +351,34 @@ static void test_keywords(Test_Runner* runner)
 
     assert_base(runner, lexer.tokens->length == 14,
                 "Invalid number of tokens '%d' expected 14", lexer.tokens->length);
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 1, 1, 2);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_IF, "if");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 4, 1, 7);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_THEN, "then");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 9, 1, 12);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_ELSE, "else");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 14, 1, 18);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_WHILE, "while");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 20, 1, 21);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_DO, "do");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 23, 1, 27);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_BREAK, "break");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 29, 1, 36);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_CONTINUE, "continue");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 38, 1, 43);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_RETURN, "return");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 45, 1, 47);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_AND, "and");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 49, 1, 50);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_OR, "or");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 52, 1, 54);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_NOT, "not");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 56, 1, 58);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_INT, "int");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 60, 1, 63);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_BOOL, "bool");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 64, 1, 64);
-    assert_token(runner, (Token*)*lexer.tokens->items, TOKEN_EOF, "<EoF>");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 1, 1, 2);
+    assert_token(runner, lexer.tokens->items++, TOKEN_IF, "if");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 4, 1, 7);
+    assert_token(runner, lexer.tokens->items++, TOKEN_THEN, "then");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 9, 1, 12);
+    assert_token(runner, lexer.tokens->items++, TOKEN_ELSE, "else");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 14, 1, 18);
+    assert_token(runner, lexer.tokens->items++, TOKEN_WHILE, "while");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 20, 1, 21);
+    assert_token(runner, lexer.tokens->items++, TOKEN_DO, "do");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 23, 1, 27);
+    assert_token(runner, lexer.tokens->items++, TOKEN_BREAK, "break");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 29, 1, 36);
+    assert_token(runner, lexer.tokens->items++, TOKEN_CONTINUE, "continue");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 38, 1, 43);
+    assert_token(runner, lexer.tokens->items++, TOKEN_RETURN, "return");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 45, 1, 47);
+    assert_token(runner, lexer.tokens->items++, TOKEN_AND, "and");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 49, 1, 50);
+    assert_token(runner, lexer.tokens->items++, TOKEN_OR, "or");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 52, 1, 54);
+    assert_token(runner, lexer.tokens->items++, TOKEN_NOT, "not");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 56, 1, 58);
+    assert_token(runner, lexer.tokens->items++, TOKEN_INT, "int");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 60, 1, 63);
+    assert_token(runner, lexer.tokens->items++, TOKEN_BOOL, "bool");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 64, 1, 64);
+    assert_token(runner, lexer.tokens->items, TOKEN_EOF, "<EoF>");
 
     lexer.tokens->items -= 13; // unwinding of the array
     lexer_free(&lexer);
@@ -279,14 +394,14 @@ static void test_identifiers(Test_Runner* runner)
 
     assert_base(runner, lexer.tokens->length == 4,
                 "Invalid number of tokens '%d' expected 4", lexer.tokens->length);
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 1, 1, 3);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_IDENTIFIER, "foo");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 5, 1, 8);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_IDENTIFIER, "_bar");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 10, 1, 15);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_IDENTIFIER, "FOOBAR");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 16, 1, 16);
-    assert_token(runner, (Token*)*lexer.tokens->items, TOKEN_EOF, "<EoF>");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 1, 1, 3);
+    assert_token(runner, lexer.tokens->items++, TOKEN_IDENTIFIER, "foo");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 5, 1, 8);
+    assert_token(runner, lexer.tokens->items++, TOKEN_IDENTIFIER, "_bar");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 10, 1, 15);
+    assert_token(runner, lexer.tokens->items++, TOKEN_IDENTIFIER, "FOOBAR");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 16, 1, 16);
+    assert_token(runner, lexer.tokens->items, TOKEN_EOF, "<EoF>");
 
     lexer.tokens->items -= 3; // unwinding of the array
     lexer_free(&lexer);
@@ -303,24 +418,48 @@ static void test_identifier_edge_cases(Test_Runner* runner)
 
     assert_base(runner, lexer.tokens->length == 6,
                 "Invalid number of tokens '%d' expected 6", lexer.tokens->length);
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 1, 1, 6);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_IDENTIFIER, "_while");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 8, 1, 10);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_IDENTIFIER, "doo");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 12, 1, 18);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_IDENTIFIER, "integer");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 20, 1, 21);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_INTEGER_LITERAL, "17");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 22, 1, 23);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_IF, "if");
-    assert_position(runner, ((Token*)(*lexer.tokens->items))->position, 1, 24, 1, 24);
-    assert_token(runner, (Token*)*lexer.tokens->items, TOKEN_EOF, "<EoF>");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 1, 1, 6);
+    assert_token(runner, lexer.tokens->items++, TOKEN_IDENTIFIER, "_while");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 8, 1, 10);
+    assert_token(runner, lexer.tokens->items++, TOKEN_IDENTIFIER, "doo");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 12, 1, 18);
+    assert_token(runner, lexer.tokens->items++, TOKEN_IDENTIFIER, "integer");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 20, 1, 21);
+    assert_token(runner, lexer.tokens->items++, TOKEN_INTEGER_LITERAL, "17");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 22, 1, 23);
+    assert_token(runner, lexer.tokens->items++, TOKEN_IF, "if");
+    assert_position(runner, lexer.source, lexer.tokens->items->position, 1, 24, 1, 24);
+    assert_token(runner, lexer.tokens->items, TOKEN_EOF, "<EoF>");
 
     lexer.tokens->items -= 5; // unwind the array
     lexer_free(&lexer);
 }
 
 
+static void test_keyword_lookalikes(Test_Runner* runner)
+{
+    Lexer lexer;
+    // NOTE(timo): Names which share the length and the first and the last 
+    // character with the keywords end up into the same slot of the keyword
+    // table, so they have to be compared as a whole
+    const char* names[] = { "ant", "boil", "bleak", "cologne", "dxo", "eave", "fable", "in", "it", 
+                            "nut", "oar", "reborn", "thin", "tree", "whale", "if1", "int2", "true_", "Do" };
+    const int length = sizeof (names) / sizeof (*names);
+
+    for (int i = 0; i < length; i++)
+    {
+        lexer_init(&lexer, names[i]);
+        lex(&lexer);
+
+        assert_base(runner, lexer.tokens->length == 2,
+                    "Invalid number of tokens '%d' expected 2", lexer.tokens->length);
+        assert_token(runner, lexer.tokens->items, TOKEN_IDENTIFIER, names[i]);
+
+        lexer_free(&lexer);
+    }
+}
+
+
 static void test_sequential_arithmetic_operators(Test_Runner* runner)
 {
     Lexer lexer;
@@ -331,19 +470,19 @@ static void test_sequential_arithmetic_operators(Test_Runner* runner)
 
     assert_base(runner, lexer.tokens->length == 13,
                 "Invalid number of tokens '%d' expected 13", lexer.tokens->length);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_PLUS, "+");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_PLUS, "+");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_MINUS, "-");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_MINUS, "-");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_MULTIPLY, "*");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_MULTIPLY, "*");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_DIVIDE, "/");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_DIVIDE, "/");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_PLUS, "+");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_MINUS, "-");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_MULTIPLY, "*");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_DIVIDE, "/");
-    assert_token(runner, (Token*)*lexer.tokens->items, TOKEN_EOF, "<EoF>");
+    assert_token(runner, lexer.tokens->items++, TOKEN_PLUS, "+");
+    assert_token(runner, lexer.tokens->items++, TOKEN_PLUS, "+");
+    assert_token(runner, lexer.tokens->items++, TOKEN_MINUS, "-");
+    assert_token(runner, lexer.tokens->items++, TOKEN_MINUS, "-");
+    assert_token(runner, lexer.tokens->items++, TOKEN_MULTIPLY, "*");
+    assert_token(runner, lexer.tokens->items++, TOKEN_MULTIPLY, "*");
+    assert_token(runner, lexer.tokens->items++, TOKEN_DIVIDE, "/");
+    assert_token(runner, lexer.tokens->items++, TOKEN_DIVIDE, "/");
+    assert_token(runner, lexer.tokens->items++, TOKEN_PLUS, "+");
+    assert_token(runner, lexer.tokens->items++, TOKEN_MINUS, "-");
+    assert_token(runner, lexer.tokens->items++, TOKEN_MULTIPLY, "*");
+    assert_token(runner, lexer.tokens->items++, TOKEN_DIVIDE, "/");
+    assert_token(runner, lexer.tokens->items, TOKEN_EOF, "<EoF>");
 
     lexer.tokens->items -= 12; // unwind the array
     lexer_free(&lexer);
@@ -361,27 +500,61 @@ static void test_sequential_comparison_operators(Test_Runner* runner)
 
     assert_base(runner, lexer.tokens->length == 15,
                 "Invalid number of tokens '%d' expected 15", lexer.tokens->length);
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_IS_EQUAL, "==");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_EQUAL, "=");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_IS_EQUAL, "==");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_IS_EQUAL, "==");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_LESS_THAN, "<");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_LESS_THAN, "<");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_GREATER_THAN, ">");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_GREATER_THAN, ">");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_LESS_THAN_EQUAL, "<=");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_EQUAL, "=");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_IS_EQUAL, "==");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_GREATER_THAN, ">");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_EQUAL, "=");
-    assert_token(runner, (Token*)*lexer.tokens->items++, TOKEN_NOT_EQUAL, "!=");
-    assert_token(runner, (Token*)*lexer.tokens->items, TOKEN_EOF, "<EoF>");
+    assert_token(runner, lexer.tokens->items++, TOKEN_IS_EQUAL, "==");
+    assert_token(runner, lexer.tokens->items++, TOKEN_EQUAL, "=");
+    assert_token(runner, lexer.tokens->items++, TOKEN_IS_EQUAL, "==");
+    assert_token(runner, lexer.tokens->items++, TOKEN_IS_EQUAL, "==");
+    assert_token(runner, lexer.tokens->items++, TOKEN_LESS_THAN, "<");
+    assert_token(runner, lexer.tokens->items++, TOKEN_LESS_THAN, "<");
+    assert_token(runner, lexer.tokens->items++, TOKEN_GREATER_THAN, ">");
+    assert_token(runner, lexer.tokens->items++, TOKEN_GREATER_THAN, ">");
+    assert_token(runner, lexer.tokens->items++, TOKEN_LESS_THAN_EQUAL, "<=");
+    assert_token(runner, lexer.tokens->items++, TOKEN_EQUAL, "=");
+    assert_token(runner, lexer.tokens->items++, TOKEN_IS_EQUAL, "==");
+    assert_token(runner, lexer.tokens->items++, TOKEN_GREATER_THAN, ">");
+    assert_token(runner, lexer.tokens->items++, TOKEN_EQUAL, "=");
+    assert_token(runner, lexer.tokens->items++, TOKEN_NOT_EQUAL, "!=");
+    assert_token(runner, lexer.tokens->items, TOKEN_EOF, "<EoF>");
 
     lexer.tokens->items -= 14; // unwind the array
     lexer_free(&lexer);
 }
 
 
+static void test_token_spans(Test_Runner* runner)
+{
+    Lexer lexer;
+    const char* source = "foo := 42;\n# comment\n  bar <= foo";
+    
+    lexer_init(&lexer, source);
+    lex(&lexer);
+
+    const int offsets[] = { 0, 4, 7, 9, 23, 27, 30, 33 };
+    const int lengths[] = { 3, 2, 2, 1, 3, 2, 3, 5 };
+    const int length = sizeof (offsets) / sizeof (*offsets);
+
+    assert_base(runner, lexer.tokens->length == length, 
+                "Invalid number of tokens '%d' expected %d", lexer.tokens->length, length);
+
+    for (int i = 0; i < length; i++)
+    {
+        Token* token = &lexer.tokens->items[i];
+
+        assert_base(runner, token->position.start == offsets[i],
+                    "Invalid offset '%d' expected %d", token->position.start, offsets[i]);
+        assert_base(runner, token->lexeme_length == lengths[i],
+                    "Invalid length '%d' expected %d", token->lexeme_length, lengths[i]);
+
+        if (token->kind != TOKEN_EOF)
+            assert_base(runner, strncmp(source + token->position.start, token->lexeme, token->lexeme_length) == 0,
+                        "Span '%.*s' does not match the lexeme '%s'", 
+                        token->lexeme_length, source + token->position.start, token->lexeme);
+    }
+
+    lexer_free(&lexer);
+}
+
+
 static void test_diagnose_invalid_character(Test_Runner* runner)
 {
     Lexer lexer;
@@ -400,7 +573,7 @@ static void test_diagnose_invalid_character(Test_Runner* runner)
 
     assert_base(runner, strcmp(diagnostic->message, message) == 0,
                 "Invalid message '%s', expected '%s'", diagnostic->message, message);
-    assert_position(runner, diagnostic->position, 1, 4, 1, 4);
+    assert_position(runner, lexer.source, diagnostic->position, 1, 4, 1, 4);
 
     lexer_free(&lexer);
 }
@@ -425,7 +598,7 @@ static void test_diagnose_invalid_not_equal(Test_Runner* runner)
 
     assert_base(runner, strcmp(diagnostic->message, message) == 0,
                 "Invalid message '%s', expected '%s'", diagnostic->message, message);
-    assert_position(runner, diagnostic->position, 1, 5, 1, 6);
+    assert_position(runner, lexer.source, diagnostic->position, 1, 5, 1, 6);
 
     lexer_free(&lexer);
 }
@@ -449,25 +622,87 @@ static void test_multiple_diagnostics(Test_Runner* runner)
     message = ":LEXER - SyntaxError: Invalid character '.'";
     assert_base(runner, strcmp(diagnostic->message, message) == 0,
                 "Invalid message '%s', expected '%s'", diagnostic->message, message);
-    assert_position(runner, diagnostic->position, 1, 4, 1, 4);
+    assert_position(runner, lexer.source, diagnostic->position, 1, 4, 1, 4);
 
     diagnostic = lexer.diagnostics->items[1];
     // message = ":LEXER - SyntaxError: Invalid character ' ', expected '='";
     message = ":LEXER - SyntaxError: Invalid character 'f'";
     assert_base(runner, strcmp(diagnostic->message, message) == 0,
                 "Invalid message '%s', expected '%s'", diagnostic->message, message);
-    assert_position(runner, diagnostic->position, 1, 9, 1, 10);
+    assert_position(runner, lexer.source, diagnostic->position, 1, 9, 1, 10);
 
     diagnostic = lexer.diagnostics->items[2];
     message = ":LEXER - SyntaxError: Invalid character '&'";
     assert_base(runner, strcmp(diagnostic->message, message) == 0,
                 "Invalid message '%s', expected '%s'", diagnostic->message, message);
-    assert_position(runner, diagnostic->position, 1, 13, 1, 13);
+    assert_position(runner, lexer.source, diagnostic->position, 1, 13, 1, 13);
 
     lexer_free(&lexer);
 }
 
 
+static void test_parallel_lexing(Test_Runner* runner)
+{
+    const char* source = "# Parallel lexing\n"
+                         "main: () -> int => {\n"
+                         "    x: int = 42; # answer\n"
+                         "    y: bool := !x;\n"
+                         "\n"
+                         "    while x > 0 do x := x - 1; done\n"
+                         "    z := x . y & 1;\n"
+                         "    return x != 0 == false;\n"
+                         "}\n"
+                         "$\n";
+
+    Lexer serial;
+    lexer_init(&serial, source);
+    lex(&serial);
+
+    for (int chunks = 1; chunks <= 12; chunks++)
+    {
+        Lexer lexer;
+        lexer_init(&lexer, source);
+        lex_parallel(&lexer, chunks);
+
+        assert_base(runner, lexer.tokens->length == serial.tokens->length,
+                    "Invalid number of tokens '%d' with %d chunks, expected %d", 
+                    lexer.tokens->length, chunks, serial.tokens->length);
+        assert_base(runner, lexer.diagnostics->length == serial.diagnostics->length,
+                    "Invalid number of diagnostics '%d' with %d chunks, expected %d", 
+                    lexer.diagnostics->length, chunks, serial.diagnostics->length);
+
+        for (int i = 0; i < lexer.tokens->length && i < serial.tokens->length; i++)
+        {
+            Token* token = &lexer.tokens->items[i];
+            Token* expected = &serial.tokens->items[i];
+
+            assert_base(runner, token->kind == expected->kind && 
+                                token->lexeme == expected->lexeme &&
+                                token->position.start == expected->position.start &&
+                                token->position.end == expected->position.end,
+                        "Invalid token '%s' at index %d with %d chunks, expected '%s'", 
+                        token->lexeme, i, chunks, expected->lexeme);
+        }
+
+        for (int i = 0; i < lexer.diagnostics->length && i < serial.diagnostics->length; i++)
+        {
+            Diagnostic* diagnostic = lexer.diagnostics->items[i];
+            Diagnostic* expected = serial.diagnostics->items[i];
+
+            assert_base(runner, strcmp(diagnostic->message, expected->message) == 0 &&
+                                diagnostic->position.start == expected->position.start &&
+                                diagnostic->position.end == expected->position.end,
+                        "Invalid diagnostic '%s' at index %d with %d chunks, expected '%s'", 
+                        diagnostic->message, i, chunks, expected->message);
+        }
+
+        lexer_free(&lexer);
+    }
+
+    lexer_free(&serial);
+}
+
+
 Test_Set* lexer_test_set()
 {
     Test_Set* set = test_set("Lexer");
@@ -476,25 +711,33 @@ Test_Set* lexer_test_set()
     array_push(set->tests, test_case("Skip whitespace", test_skip_whitespace));
     array_push(set->tests, test_case("Skip comments 1", test_skip_comments_1));
     array_push(set->tests, test_case("Skip comments 2", test_skip_comments_2));
+    array_push(set->tests, test_case("Skip long whitespace and comments", test_skip_long_whitespace_and_comments));
+    array_push(set->tests, test_case("Skip to the end of the range", test_skip_to_end_of_range));
     array_push(set->tests, test_case("Arithmetic operators", test_arithmetic_operators));
     array_push(set->tests, test_case("Comparison operators", test_comparison_operators));
     array_push(set->tests, test_case("Assignment operators", test_assignment_operators));
     array_push(set->tests, test_case("Misc operators", test_misc_operators));
     array_push(set->tests, test_case("Integer literals", test_integer_literals));
+    array_push(set->tests, test_case("Integer literal values", test_integer_literal_values));
     array_push(set->tests, test_case("Boolean literals", test_boolean_literals));
     array_push(set->tests, test_case("Keywords", test_keywords));
     array_push(set->tests, test_case("Identifiers", test_identifiers));
 
     // Edge cases
     array_push(set->tests, test_case("Identifier edge cases", test_identifier_edge_cases));
+    array_push(set->tests, test_case("Keyword lookalikes", test_keyword_lookalikes));
     array_push(set->tests, test_case("Sequential arithmetic operators", test_sequential_arithmetic_operators));
     array_push(set->tests, test_case("Sequential comparison operators", test_sequential_comparison_operators));
+    array_push(set->tests, test_case("Token spans", test_token_spans));
 
     // Diagnostics
     array_push(set->tests, test_case("Diagnose invalid character", test_diagnose_invalid_character));
     array_push(set->tests, test_case("Diagnose invalid not equal operator", test_diagnose_invalid_not_equal));
     array_push(set->tests, test_case("Diagnose multiple diagnostics", test_multiple_diagnostics));
 
+    // Parallel lexing
+    array_push(set->tests, test_case("Parallel lexing", test_parallel_lexing));
+
     set->length = set->tests->length;
 
     return set;
@@ -6,6 +6,7 @@
 #include "tests.h"
 #include "../src/t.h"
 #include "../src/stringbuilder.h"
+#include <dirent.h>
 
 
 static void test_literal_expression_integer(Test_Runner* runner)
@@ -577,7 +578,7 @@ static void test_diagnose_invalid_parameters_missing_type(Test_Runner* runner)
     parser_init(&parser, lexer.tokens);
     expression = parse_expression(&parser);
 
-    print_diagnostics(parser.diagnostics);
+    print_diagnostics(parser.diagnostics, source);
     /*
     assert_base(runner, parser.diagnostics->length == 1,
         "Invalid number of parser diagnostics: %d, expected 1", parser.diagnostics->length);
@@ -599,7 +600,7 @@ static void test_diagnose_invalid_parameters_missing_type(Test_Runner* runner)
     parser_init(&parser, lexer.tokens);
     expression = parse_expression(&parser);
 
-    print_diagnostics(parser.diagnostics);
+    print_diagnostics(parser.diagnostics, source);
     /*
     assert_base(runner, parser.diagnostics->length == 1,
         "Invalid number of parser diagnostics: %d, expected 1", parser.diagnostics->length);
@@ -634,7 +635,7 @@ static void test_diagnose_invalid_parameters_missing_identifier(Test_Runner* run
     parser_init(&parser, lexer.tokens);
     expression = parse_expression(&parser);
 
-    // print_diagnostics(parser.diagnostics);
+    // print_diagnostics(parser.diagnostics, source);
 
     assert_base(runner, parser.diagnostics->length == 1,
         "Invalid number of parser diagnostics: %d, expected 1", parser.diagnostics->length);
@@ -655,7 +656,7 @@ static void test_diagnose_invalid_parameters_missing_identifier(Test_Runner* run
     parser_init(&parser, lexer.tokens);
     expression = parse_expression(&parser);
 
-    // print_diagnostics(parser.diagnostics);
+    // print_diagnostics(parser.diagnostics, source);
 
     assert_base(runner, parser.diagnostics->length == 1,
         "Invalid number of parser diagnostics: %d, expected 1", parser.diagnostics->length);
@@ -689,7 +690,7 @@ static void test_diagnose_invalid_parameters_extra_commas(Test_Runner* runner)
     parser_init(&parser, lexer.tokens);
     expression = parse_expression(&parser);
 
-    // print_diagnostics(parser.diagnostics);
+    // print_diagnostics(parser.diagnostics, source);
 
     assert_base(runner, parser.diagnostics->length == 1,
         "Invalid number of parser diagnostics: %d, expected 1", parser.diagnostics->length);
@@ -713,7 +714,7 @@ static void test_diagnose_invalid_parameters_extra_commas(Test_Runner* runner)
     parser_init(&parser, lexer.tokens);
     expression = parse_expression(&parser);
 
-    // print_diagnostics(parser.diagnostics);
+    // print_diagnostics(parser.diagnostics, source);
 
     assert_base(runner, parser.diagnostics->length == 1,
         "Invalid number of parser diagnostics: %d, expected 1", parser.diagnostics->length);
@@ -737,7 +738,7 @@ static void test_diagnose_invalid_parameters_extra_commas(Test_Runner* runner)
     parser_init(&parser, lexer.tokens);
     expression = parse_expression(&parser);
 
-    // print_diagnostics(parser.diagnostics);
+    // print_diagnostics(parser.diagnostics, source);
 
     assert_base(runner, parser.diagnostics->length == 1,
         "Invalid number of parser diagnostics: %d, expected 1", parser.diagnostics->length);
@@ -774,7 +775,7 @@ static void test_diagnose_invalid_parameters_commas_only(Test_Runner* runner)
     parser_init(&parser, lexer.tokens);
     expression = parse_expression(&parser);
 
-    // print_diagnostics(parser.diagnostics);
+    // print_diagnostics(parser.diagnostics, source);
     
     assert_base(runner, parser.diagnostics->length == 1,
         "Invalid number of parser diagnostics: %d, expected 1", parser.diagnostics->length);
@@ -798,7 +799,7 @@ static void test_diagnose_invalid_parameters_commas_only(Test_Runner* runner)
     parser_init(&parser, lexer.tokens);
     expression = parse_expression(&parser);
 
-    // print_diagnostics(parser.diagnostics);
+    // print_diagnostics(parser.diagnostics, source);
 
     assert_base(runner, parser.diagnostics->length == 3,
         "Invalid number of parser diagnostics: %d, expected 3", parser.diagnostics->length);
@@ -1932,6 +1933,32 @@ static void test_diagnose_invalid_if_statement(Test_Runner* runner)
 }
 
 
+static void test_string_builder(Test_Runner* runner)
+{
+    // NOTE(timo): The appended strings are longer than the doubled capacity,
+    // so the buffer has to grow more than once during a single append
+    const char* pieces[] = { "(", "1 + 2 + 3 + 4 + 5 + 6 + 7 + 8 + 9 + 10 + 11 + 12 + 13 + 14 + 15 + 16", ")",
+                             " * 1234567890123456789012345678901234567890123456789012345678901234567890" };
+    const char* expected = "(1 + 2 + 3 + 4 + 5 + 6 + 7 + 8 + 9 + 10 + 11 + 12 + 13 + 14 + 15 + 16)"
+                           " * 1234567890123456789012345678901234567890123456789012345678901234567890";
+    stringbuilder* sb = sb_init();
+
+    for (int i = 0; i < sizeof (pieces) / sizeof (*pieces); i++)
+    {
+        sb_append(sb, pieces[i]);
+
+        assert_base(runner, sb->capacity > sb->length,
+            "Invalid capacity of the string %d, expected more than %d", sb->capacity, sb->length);
+    }
+
+    assert_string(runner, sb_to_string(sb), expected);
+    assert_base(runner, sb->length == strlen(expected),
+        "Invalid length of the string %d, expected %d", sb->length, (int)strlen(expected));
+
+    sb_free(sb);
+}
+
+
 static void test_small_program(Test_Runner* runner)
 {
     Lexer lexer;
@@ -1980,6 +2007,718 @@ static void test_small_program(Test_Runner* runner)
 }
 
 
+static void test_streaming_parser(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parser;
+    AST_Expression* expression;
+    // NOTE(timo): The sources are long enough to go around the lookahead ring
+    // buffer multiple times while the operators are still being kept
+    const char* sources[] = { "1 + 2 * 3 - 4 / 5 * 6 + 7",
+                              "(1 + 2) * (3 - 4) == -5 and not true or 6 <= 7",
+                              "-(-(1 + 2)) * ((3))",
+                              "1 + 2 + 3 + 4 + 5 + 6 + 7 + 8 + 9" };
+    const char* results[] = { "(((1+(2*3))-((4/5)*6))+7)",
+                              "(((((1+2)*(3-4))==(-5))and(nottrue))or(6<=7))",
+                              "((-(-(1+2)))*3)",
+                              "((((((((1+2)+3)+4)+5)+6)+7)+8)+9)" };
+    const int length = sizeof (sources) / sizeof (*sources);
+
+    for (int i = 0; i < length; i++)
+    {
+        lexer_init(&lexer, sources[i]);
+
+        parser_init_streaming(&parser, &lexer);
+        expression = parse_expression(&parser);
+        const char* result = expression_to_string(expression);
+
+        assert_string(runner, result, results[i]);
+        assert_base(runner, lexer.tokens->length == 0,
+            "Invalid number of tokens in the token stream %d, expected 0", lexer.tokens->length);
+        
+        free((char*)result);
+        expression_free(expression);
+        parser_free(&parser);
+        lexer_free(&lexer);
+    }
+}
+
+
+static void test_ast_pool(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parser;
+    AST_Pool pool, expanded_pool;
+    arena expanded_arena;
+    const char* source = 
+        "foo: int = (a: int, b: bool) => {\n"
+        "    if b then { return a + 1; } else if not b then { return -a; }\n"
+        "    while a > 0 do { a := a - 1; if a == 5 then break; else continue; }\n"
+        "    c: int = foo(a * 2, b);\n"
+        "    return c;\n"
+        "};\n"
+        "main: int = (argc: int, argv: [int]) => { return foo(argv[0], true); };";
+
+    lexer_init(&lexer, source);
+    lex(&lexer);
+    parser_init(&parser, lexer.tokens);
+    parse(&parser);
+
+    assert_base(runner, parser.diagnostics->length == 0,
+        "Invalid number of parser diagnostics %d, expected 0", parser.diagnostics->length);
+
+    ast_pool_init(&pool);
+    ast_pool_flatten(&pool, parser.declarations);
+
+    // Parent nodes come before their children and the first node is reserved
+    assert_base(runner, AST_NODE_CLASS(pool.kinds[0]) == NODE_NONE,
+        "Invalid class of the reserved node %d, expected %d", AST_NODE_CLASS(pool.kinds[0]), NODE_NONE);
+    assert_base(runner, pool.kinds[1] == AST_NODE_KIND(NODE_DECLARATION, DECLARATION_FUNCTION),
+        "Invalid kind of the first node %d, expected %d", pool.kinds[1], AST_NODE_KIND(NODE_DECLARATION, DECLARATION_FUNCTION));
+    assert_base(runner, pool.extra.items[pool.declarations] == 2,
+        "Invalid number of declarations %d, expected 2", pool.extra.items[pool.declarations]);
+
+    // Expanding the pool and flattening it again gives the same pool
+    array* declarations = array_init(sizeof (AST_Declaration*));
+    arena_init(&expanded_arena, 0);
+    ast_pool_expand(&pool, &expanded_arena, declarations);
+
+    AST_Declaration* main = declarations->items[1];
+    assert_base(runner, strcmp(main->identifier->lexeme, "main") == 0 && main->kind == DECLARATION_FUNCTION,
+        "Invalid declaration '%s', expected function declaration 'main'", main->identifier->lexeme);
+
+    ast_pool_init(&expanded_pool);
+    ast_pool_flatten(&expanded_pool, declarations);
+
+    assert_base(runner, pool.length == expanded_pool.length && pool.extra.length == expanded_pool.extra.length,
+        "Invalid number of nodes %d, expected %d", expanded_pool.length, pool.length);
+    assert_base(runner, memcmp(pool.kinds, expanded_pool.kinds, pool.length * sizeof (uint8_t)) == 0 &&
+                        memcmp(pool.positions, expanded_pool.positions, pool.length * sizeof (Position)) == 0 &&
+                        memcmp(pool.data, expanded_pool.data, pool.length * sizeof (AST_Node_Data)) == 0 &&
+                        memcmp(pool.extra.items, expanded_pool.extra.items, pool.extra.length * sizeof (AST_Index)) == 0,
+        "Expanded tree doesn't match the flattened tree");
+
+    for (int i = 0; i < pool.tokens.length; i++)
+    {
+        Token* token = &pool.tokens.items[i];
+        Token* expanded = &expanded_pool.tokens.items[i];
+
+        assert_base(runner, token->kind == expanded->kind && token->lexeme == expanded->lexeme && 
+                            token->position.start == expanded->position.start,
+            "Invalid token '%s', expected '%s'", expanded->lexeme, token->lexeme);
+    }
+
+    ast_pool_free(&expanded_pool);
+    ast_pool_free(&pool);
+    array_free(declarations);
+    arena_free(&expanded_arena);
+    parser_free(&parser);
+    lexer_free(&lexer);
+}
+
+
+static void test_deeply_nested_expressions(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parser;
+    AST_Expression* expression;
+    stringbuilder* sb = sb_init();
+    const int depth = 100000;
+
+    // ((((1 + 1) + 1) + 1) ... ) + - - - ... - 1
+    for (int i = 0; i < depth; i++)
+        sb_append(sb, "(");
+    sb_append(sb, "1");
+    for (int i = 0; i < depth; i++)
+        sb_append(sb, " + 1)");
+    sb_append(sb, " + ");
+    for (int i = 0; i < depth; i++)
+        sb_append(sb, "- ");
+    sb_append(sb, "1");
+
+    lexer_init(&lexer, sb->string);
+    lex(&lexer);
+    parser_init(&parser, lexer.tokens);
+    expression = parse_expression(&parser);
+
+    assert_base(runner, parser.diagnostics->length == 0,
+        "Invalid number of parser diagnostics %d, expected 0", parser.diagnostics->length);
+    assert_expression(runner, expression->kind, EXPRESSION_BINARY);
+
+    int binaries = 0;
+    AST_Expression* current = expression->binary.left;
+    while (current->kind == EXPRESSION_BINARY)
+    {
+        binaries++;
+        current = current->binary.left;
+    }
+
+    int unaries = 0;
+    current = expression->binary.right;
+    while (current->kind == EXPRESSION_UNARY)
+    {
+        unaries++;
+        current = current->unary.operand;
+    }
+
+    assert_base(runner, binaries == depth && unaries == depth,
+        "Invalid depth of the expression %d and %d, expected %d", binaries, unaries, depth);
+
+    expression_free(expression);
+    parser_free(&parser);
+    lexer_free(&lexer);
+    sb_free(sb);
+}
+
+
+// Checks that the trees and the diagnostics of the parsers are identical.
+static void assert_same_parse(Test_Runner* runner, Parser* parser, Parser* expected)
+{
+    AST_Pool pool, expected_pool;
+    ast_pool_init(&pool);
+    ast_pool_init(&expected_pool);
+    ast_pool_flatten(&pool, parser->declarations);
+    ast_pool_flatten(&expected_pool, expected->declarations);
+
+    assert_base(runner, parser->declarations->length == expected->declarations->length,
+        "Invalid number of declarations %d, expected %d", parser->declarations->length, expected->declarations->length);
+    assert_base(runner, pool.length == expected_pool.length && pool.extra.length == expected_pool.extra.length &&
+                        memcmp(pool.kinds, expected_pool.kinds, pool.length * sizeof (uint8_t)) == 0 &&
+                        memcmp(pool.positions, expected_pool.positions, pool.length * sizeof (Position)) == 0 &&
+                        memcmp(pool.data, expected_pool.data, pool.length * sizeof (AST_Node_Data)) == 0,
+        "Parsed tree doesn't match the expected tree");
+    assert_base(runner, parser->diagnostics->length == expected->diagnostics->length,
+        "Invalid number of parser diagnostics %d, expected %d", parser->diagnostics->length, expected->diagnostics->length);
+
+    for (int i = 0; i < parser->diagnostics->length && i < expected->diagnostics->length; i++)
+    {
+        Diagnostic* diagnostic = parser->diagnostics->items[i];
+        Diagnostic* expected_diagnostic = expected->diagnostics->items[i];
+
+        assert_base(runner, strcmp(diagnostic->message, expected_diagnostic->message) == 0 &&
+                            diagnostic->position.start == expected_diagnostic->position.start,
+            "Invalid diagnostic '%s', expected '%s'", diagnostic->message, expected_diagnostic->message);
+    }
+
+    ast_pool_free(&pool);
+    ast_pool_free(&expected_pool);
+}
+
+
+static void test_parallel_parsing(Test_Runner* runner)
+{
+    const char* declarations[] = {
+        "foo_%d: int = (a: int, b: [int]) => { if a > 0 then { return b[a - 1]; } return (a + 1) * 2; };\n",
+        "bar_%d: bool = (x: bool) => { while not x do { x := true; } return x or false; };\n",
+        "baz_%d: int = 42;\n",
+    };
+    // NOTE(timo): The error recovery of the broken declarations goes past 
+    // the ends of the declarations, so the chunks fall out of sync
+    const char* broken[] = {
+        "qux_%d: int = (a: int) => { return a + ; };\n",
+        "quux_%d: int = (a: int => { return a; };\n",
+    };
+    stringbuilder* sources[] = { sb_init(), sb_init() };
+    char line[256];
+
+    for (int i = 0; i < 3000; i++)
+    {
+        snprintf(line, sizeof (line), declarations[i % 3], i);
+        sb_append(sources[0], line);
+        sb_append(sources[1], line);
+
+        if (i % 500 == 250)
+        {
+            snprintf(line, sizeof (line), broken[i % 2], i);
+            sb_append(sources[1], line);
+        }
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        Lexer lexer;
+        Parser serial, parallel;
+
+        lexer_init(&lexer, sources[i]->string);
+        lex(&lexer);
+
+        parser_init(&serial, lexer.tokens);
+        while (serial.current_token->kind != TOKEN_EOF)
+            array_push(serial.declarations, parse_top_level_declaration(&serial));
+
+        for (int chunks = 1; chunks <= 7; chunks += 3)
+        {
+            parser_init(&parallel, lexer.tokens);
+            parse_parallel(&parallel, chunks);
+
+            assert_same_parse(runner, &parallel, &serial);
+            assert_base(runner, parallel.current_token->kind == TOKEN_EOF,
+                "Invalid current token '%s', expected '<EoF>'", parallel.current_token->lexeme);
+
+            parser_free(&parallel);
+        }
+
+        parser_free(&serial);
+        lexer_free(&lexer);
+        sb_free(sources[i]);
+    }
+}
+
+
+static void test_ast_cache(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parser, loaded, changed;
+    hashtable* type_tables[3];
+    Resolver resolver, loaded_resolver, changed_resolver;
+    IR_Generator generator, loaded_generator;
+    char directory[] = "/tmp/t_cache_XXXXXX";
+    const char* source = "foo: int = (a: int, b: bool) => { c: int = 0; if a > 0 and b then { c := a - 1; } else { c := -(a + 1) * 2; } return c; };\n"
+                         "bar: bool = true;\n"
+                         "main: int = (argc: int, argv: [int]) => { x: int = foo(argc, bar); while x < 10 do { x := x + 1; } return x + argv[0]; };\n";
+    // NOTE(timo): Any change in the source invalidates the cache
+    const char* changed_source = "foo: int = (a: int, b: bool) => { c: int = 0; if a > 0 and b then { c := a - 1; } else { c := -(a + 1) * 2; } return c; };\n"
+                                 "bar: bool = false;\n"
+                                 "main: int = (argc: int, argv: [int]) => { x: int = foo(argc, bar); while x < 10 do { x := x + 1; } return x + argv[0]; };\n";
+
+    assert_base(runner, mkdtemp(directory) != NULL, "Failed to create the cache directory");
+
+    for (int i = 0; i < 3; i++)
+        type_tables[i] = type_table_init();
+
+    lexer_init(&lexer, source);
+    lex(&lexer);
+    parser_init(&parser, lexer.tokens);
+    parse(&parser);
+    resolver_init(&resolver, type_tables[0]);
+
+    assert_base(runner, ! ast_cache_load(directory, source, &parser.arena, parser.declarations, &resolver),
+        "Loaded the tree from an empty cache");
+
+    resolve(&resolver, parser.declarations);
+    assert_base(runner, resolver.diagnostics->length == 0,
+        "Invalid number of resolver diagnostics %d, expected 0", resolver.diagnostics->length);
+    ast_cache_save(directory, source, parser.declarations, &resolver);
+
+    // The loaded tree is resolved already
+    parser_init(&loaded, lexer.tokens);
+    resolver_init(&loaded_resolver, type_tables[1]);
+    assert_base(runner, ast_cache_load(directory, source, &loaded.arena, loaded.declarations, &loaded_resolver),
+        "Failed to load the tree from the cache");
+    assert_same_parse(runner, &loaded, &parser);
+
+    AST_Declaration* declaration = loaded.declarations->items[0];
+    AST_Declaration* expected = parser.declarations->items[0];
+
+    assert_base(runner, declaration->identifier->lexeme == expected->identifier->lexeme,
+        "Identifier '%s' of the loaded tree is not interned", declaration->identifier->lexeme);
+    assert_base(runner, declaration->symbol != NULL && declaration->symbol == scope_get(loaded_resolver.global, str_intern("foo")),
+        "Declaration '%s' of the loaded tree is not bound to its symbol", declaration->identifier->lexeme);
+
+    ir_generator_init(&generator, resolver.global);
+    ir_generate(&generator, parser.declarations);
+    ir_generator_init(&loaded_generator, loaded_resolver.global);
+    ir_generate(&loaded_generator, loaded.declarations);
+    assert_same_instructions(runner, loaded_generator.instructions, generator.instructions);
+
+    parser_init(&changed, lexer.tokens);
+    resolver_init(&changed_resolver, type_tables[2]);
+    assert_base(runner, ! ast_cache_load(directory, changed_source, &changed.arena, changed.declarations, &changed_resolver),
+        "Loaded the tree of a different source from the cache");
+
+    ir_generator_free(&loaded_generator);
+    ir_generator_free(&generator);
+    resolver_free(&changed_resolver);
+    resolver_free(&loaded_resolver);
+    resolver_free(&resolver);
+    parser_free(&changed);
+    parser_free(&loaded);
+    parser_free(&parser);
+
+    for (int i = 0; i < 3; i++)
+        type_table_free(type_tables[i]);
+
+    // Broken cache files are ignored. Parts of the file are overwritten one at
+    // a time and the file is loaded, which fails and leaves nothing behind
+    // unless the overwritten part stayed the same, but never reads outside of
+    // the file.
+    char path[256];
+    DIR* cache = opendir(directory);
+    struct dirent* entry;
+
+    while ((entry = readdir(cache)) != NULL)
+    {
+        if (entry->d_name[0] != '.')
+            snprintf(path, sizeof (path), "%s/%s", directory, entry->d_name);
+    }
+
+    closedir(cache);
+
+    FILE* file = fopen(path, "rb");
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    char* contents = malloc(size);
+    fseek(file, 0, SEEK_SET);
+    assert_base(runner, fread(contents, 1, size, file) == (size_t)size, "Failed to read the cache file");
+    fclose(file);
+
+    for (long offset = 0; offset <= size; offset += 13)
+    {
+        bool truncated = offset == size;
+        bool broken = truncated || offset + 4 > size || memcmp(contents + offset, "\xff\xff\xff\x7f", 4) != 0;
+        file = fopen(path, "wb");
+        fwrite(contents, 1, truncated ? size / 2 : size, file);
+
+        if (! truncated)
+        {
+            fseek(file, offset, SEEK_SET);
+            fwrite("\xff\xff\xff\x7f", 1, 4, file);
+        }
+
+        fclose(file);
+
+        hashtable* type_table = type_table_init();
+        parser_init(&loaded, lexer.tokens);
+        resolver_init(&loaded_resolver, type_table);
+
+        if (! ast_cache_load(directory, source, &loaded.arena, loaded.declarations, &loaded_resolver))
+            assert_base(runner, loaded.declarations->length == 0,
+                "Broken cache file at offset %ld left %d declarations", offset, loaded.declarations->length);
+        else
+            assert_base(runner, ! broken, "Loaded the tree from a cache file broken at offset %ld", offset);
+
+        resolver_free(&loaded_resolver);
+        type_table_free(type_table);
+        parser_free(&loaded);
+    }
+
+    free(contents);
+    lexer_free(&lexer);
+
+    // Clean up the cache directory
+    char command[64];
+    snprintf(command, sizeof (command), "rm -rf %s", directory);
+    system(command);
+}
+
+
+static void test_ast_cache_deep_expression(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parser, loaded;
+    hashtable* type_tables[2];
+    Resolver resolver, loaded_resolver;
+    IR_Generator generator, loaded_generator;
+    char directory[] = "/tmp/t_cache_XXXXXX";
+    stringbuilder* sb = sb_init();
+    const int depth = 100000;
+
+    // argc + argc + ... + argc + - - ... - argc
+    sb_append(sb, "main: int = (argc: int, argv: [int]) => { return argc");
+    for (int i = 1; i < depth; i++)
+        sb_append(sb, " + argc");
+    sb_append(sb, " + ");
+    for (int i = 0; i < depth; i++)
+        sb_append(sb, "- ");
+    sb_append(sb, "argc; };");
+
+    assert_base(runner, mkdtemp(directory) != NULL, "Failed to create the cache directory");
+
+    for (int i = 0; i < 2; i++)
+        type_tables[i] = type_table_init();
+
+    lexer_init(&lexer, sb->string);
+    lex(&lexer);
+    parser_init(&parser, lexer.tokens);
+    parse(&parser);
+    resolver_init(&resolver, type_tables[0]);
+    resolve(&resolver, parser.declarations);
+
+    assert_base(runner, resolver.diagnostics->length == 0,
+        "Invalid number of resolver diagnostics %d, expected 0", resolver.diagnostics->length);
+    ast_cache_save(directory, sb->string, parser.declarations, &resolver);
+
+    parser_init(&loaded, lexer.tokens);
+    resolver_init(&loaded_resolver, type_tables[1]);
+    assert_base(runner, ast_cache_load(directory, sb->string, &loaded.arena, loaded.declarations, &loaded_resolver),
+        "Failed to load the tree from the cache");
+    assert_same_parse(runner, &loaded, &parser);
+
+    ir_generator_init(&generator, resolver.global);
+    ir_generate(&generator, parser.declarations);
+    ir_generator_init(&loaded_generator, loaded_resolver.global);
+    ir_generate(&loaded_generator, loaded.declarations);
+    assert_same_instructions(runner, loaded_generator.instructions, generator.instructions);
+
+    ir_generator_free(&loaded_generator);
+    ir_generator_free(&generator);
+    resolver_free(&loaded_resolver);
+    resolver_free(&resolver);
+    parser_free(&loaded);
+    parser_free(&parser);
+    lexer_free(&lexer);
+    sb_free(sb);
+
+    for (int i = 0; i < 2; i++)
+        type_table_free(type_tables[i]);
+
+    // Clean up the cache directory
+    char command[64];
+    snprintf(command, sizeof (command), "rm -rf %s", directory);
+    system(command);
+}
+
+
+static void test_ast_cache_shared(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parser, loaded, unshared;
+    hashtable* type_tables[3];
+    Resolver resolver, loaded_resolver, unshared_resolver;
+    IR_Generator generator, loaded_generator;
+    AST_Pool pool;
+    char directory[] = "/tmp/t_cache_XXXXXX";
+    const char* source = "main: int = (argc: int, argv: [int]) => {\n"
+                         "    x: int = argc * 2 + (argc * 2) / 2;\n"
+                         "    return x;\n"
+                         "};\n";
+
+    assert_base(runner, mkdtemp(directory) != NULL, "Failed to create the cache directory");
+
+    for (int i = 0; i < 3; i++)
+        type_tables[i] = type_table_init();
+
+    lexer_init(&lexer, source);
+    lex(&lexer);
+    parser_init(&parser, lexer.tokens);
+    parser.share = true;
+    parse(&parser);
+    resolver_init(&resolver, type_tables[0]);
+    resolver.shared = true;
+    resolve(&resolver, parser.declarations);
+
+    assert_base(runner, resolver.diagnostics->length == 0,
+        "Invalid number of resolver diagnostics %d, expected 0", resolver.diagnostics->length);
+    ast_cache_save(directory, source, parser.declarations, &resolver);
+
+    // The shared expressions are shared in the loaded tree too
+    parser_init(&loaded, lexer.tokens);
+    resolver_init(&loaded_resolver, type_tables[1]);
+    loaded_resolver.shared = true;
+    assert_base(runner, ast_cache_load(directory, source, &loaded.arena, loaded.declarations, &loaded_resolver),
+        "Failed to load the shared tree from the cache");
+    assert_same_parse(runner, &loaded, &parser);
+
+    AST_Declaration* main = loaded.declarations->items[0];
+    AST_Statement* statement = main->initializer->function.body->block.statements->items[0];
+    AST_Expression* x = statement->declaration->initializer;
+
+    assert_base(runner, x->binary.left == x->binary.right->binary.left,
+        "Shared expressions 'argc * 2' are not shared in the loaded tree");
+
+    ir_generator_init(&generator, resolver.global);
+    generator.shared = true;
+    ir_generate(&generator, parser.declarations);
+    ir_generator_init(&loaded_generator, loaded_resolver.global);
+    loaded_generator.shared = true;
+    ir_generate(&loaded_generator, loaded.declarations);
+    assert_same_instructions(runner, loaded_generator.instructions, generator.instructions);
+
+    // The tree saved with the sharing is not used without it
+    parser_init(&unshared, lexer.tokens);
+    resolver_init(&unshared_resolver, type_tables[2]);
+    assert_base(runner, ! ast_cache_load(directory, source, &unshared.arena, unshared.declarations, &unshared_resolver),
+        "Loaded the shared tree from the cache without sharing");
+
+    // The shared nodes can't form cycles
+    ast_pool_init(&pool);
+    ast_pool_flatten(&pool, parser.declarations);
+
+    assert_base(runner, pool.shared && ast_pool_valid(&pool), "Valid shared pool was rejected");
+
+    for (int i = 1; i < pool.length; i++)
+    {
+        if (pool.kinds[i] == AST_NODE_KIND(NODE_EXPRESSION, EXPRESSION_BINARY))
+        {
+            pool.data[i].rhs = i;
+            break;
+        }
+    }
+
+    assert_base(runner, ! ast_pool_valid(&pool), "Shared pool with a cycle was accepted");
+
+    ast_pool_free(&pool);
+    ir_generator_free(&loaded_generator);
+    ir_generator_free(&generator);
+    resolver_free(&unshared_resolver);
+    resolver_free(&loaded_resolver);
+    resolver_free(&resolver);
+    parser_free(&unshared);
+    parser_free(&loaded);
+    parser_free(&parser);
+    lexer_free(&lexer);
+
+    for (int i = 0; i < 3; i++)
+        type_table_free(type_tables[i]);
+
+    // Clean up the cache directory
+    char command[64];
+    snprintf(command, sizeof (command), "rm -rf %s", directory);
+    system(command);
+}
+
+
+static void test_shared_expressions(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parser;
+
+    const char* source = "foo: int = (a: int, b: int) => {\n"
+                         "    x: int = a * b + (a * b) / 2;\n"
+                         "    a: bool = a * b == x;\n"
+                         "    return a * b;\n"
+                         "};\n"
+                         "bar: int = (a: int, b: int) => { return a * b; };\n";
+
+    lexer_init(&lexer, source);
+    parser_init_streaming(&parser, &lexer);
+    parser.share = true;
+    parse(&parser);
+
+    assert_base(runner, parser.diagnostics->length == 0,
+        "Invalid number of parser diagnostics %d, expected 0", parser.diagnostics->length);
+
+    AST_Declaration* foo = parser.declarations->items[0];
+    AST_Declaration* bar = parser.declarations->items[1];
+    array* statements = foo->initializer->function.body->block.statements;
+
+    AST_Expression* x = ((AST_Statement*)statements->items[0])->declaration->initializer;
+    AST_Expression* a = ((AST_Statement*)statements->items[1])->declaration->initializer;
+    AST_Expression* returned = ((AST_Statement*)statements->items[2])->_return.value;
+    AST_Expression* other = ((AST_Statement*)bar->initializer->function.body->block.statements->items[0])->_return.value;
+
+    assert_base(runner, x->binary.left == x->binary.right->binary.left,
+        "Identical expressions 'a * b' in the same statement are not shared");
+    assert_base(runner, x->binary.left == a->binary.left,
+        "Identical expressions 'a * b' before the redeclaration of 'a' are not shared");
+    assert_base(runner, a->binary.left != returned,
+        "Expressions 'a * b' before and after the redeclaration of 'a' are shared");
+    assert_base(runner, returned != other && returned->binary.left != other->binary.left,
+        "Expressions of different declarations are shared");
+
+    parser_free(&parser);
+    lexer_free(&lexer);
+
+    // The bodies parsed lazily are shared too
+    lexer_init(&lexer, source);
+    parser_init_streaming(&parser, &lexer);
+    parser.share = true;
+    parser.lazy = true;
+    parse(&parser);
+
+    foo = parser.declarations->items[0];
+    statements = parse_function_body(foo->initializer, parser.diagnostics)->block.statements;
+    x = ((AST_Statement*)statements->items[0])->declaration->initializer;
+
+    assert_base(runner, parser.diagnostics->length == 0,
+        "Invalid number of parser diagnostics %d, expected 0", parser.diagnostics->length);
+    assert_base(runner, x->binary.left == x->binary.right->binary.left,
+        "Identical expressions 'a * b' in the lazily parsed body are not shared");
+
+    parser_free(&parser);
+    lexer_free(&lexer);
+
+    // The names declared in a block are not shared after the block
+    source = "baz: int = (a: int, b: int) => {\n"
+             "    while a > b do { b: int = 1; a := a - b; }\n"
+             "    return a - b;\n"
+             "};\n";
+
+    lexer_init(&lexer, source);
+    parser_init_streaming(&parser, &lexer);
+    parser.share = true;
+    parse(&parser);
+
+    AST_Declaration* baz = parser.declarations->items[0];
+    statements = baz->initializer->function.body->block.statements;
+    AST_Statement* body = ((AST_Statement*)statements->items[0])->_while.body;
+    AST_Expression* inner = ((AST_Statement*)body->block.statements->items[1])->expression->assignment.value;
+    returned = ((AST_Statement*)statements->items[1])->_return.value;
+
+    assert_base(runner, parser.diagnostics->length == 0,
+        "Invalid number of parser diagnostics %d, expected 0", parser.diagnostics->length);
+    assert_base(runner, inner != returned && inner->binary.right != returned->binary.right,
+        "Expressions 'a - b' inside and after the block declaring 'b' are shared");
+
+    parser_free(&parser);
+    lexer_free(&lexer);
+}
+
+
+static void test_lazy_syntax_errors(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parser;
+    // NOTE(timo): The first source has errors only in the body of the unused
+    // function and the second one also at the top level
+    const char* sources[] = { "unused: int = (a: int) => { b: int = a +; return b };\n"
+                              "main: int = () => { return 0; };",
+                              "x: int = ;\n"
+                              "unused: int = (a: int) => { while a do { a := ; } return a; };\n"
+                              "main: int = () => { return 0; };" };
+    const int length = sizeof (sources) / sizeof (*sources);
+
+    for (int i = 0; i < length; i++)
+    {
+        lexer_init(&lexer, sources[i]);
+        parser_init_streaming(&parser, &lexer);
+        parse(&parser);
+
+        int count = parser.diagnostics->length;
+        Position positions[8];
+
+        assert_base(runner, count > i && count <= 8,
+            "Invalid number of parser diagnostics %d in source %d", count, i);
+
+        for (int j = 0; j < count && j < 8; j++)
+            positions[j] = ((Diagnostic*)parser.diagnostics->items[j])->position;
+
+        parser_free(&parser);
+        lexer_free(&lexer);
+
+        lexer_init(&lexer, sources[i]);
+        parser_init_streaming(&parser, &lexer);
+        parser.lazy = true;
+        parse(&parser);
+
+        AST_Declaration* unused = NULL;
+        for (int j = 0; j < parser.declarations->length; j++)
+        {
+            AST_Declaration* declaration = parser.declarations->items[j];
+            if (declaration->initializer && declaration->initializer->kind == EXPRESSION_FUNCTION &&
+                declaration->identifier && strncmp(sources[i] + declaration->identifier->position.start, "unused", 6) == 0)
+                unused = declaration;
+        }
+
+        assert_base(runner, parser.diagnostics->length == count,
+            "Invalid number of lazy parser diagnostics %d in source %d, expected %d",
+            parser.diagnostics->length, i, count);
+        for (int j = 0; j < parser.diagnostics->length && j < count && j < 8; j++)
+        {
+            Position position = ((Diagnostic*)parser.diagnostics->items[j])->position;
+            assert_base(runner, position.start == positions[j].start && position.end == positions[j].end,
+                "Lazy parser diagnostic %d in source %d is at %d-%d, expected %d-%d", j, i,
+                position.start, position.end, positions[j].start, positions[j].end);
+        }
+        assert_base(runner, unused != NULL && unused->initializer->function.lazy == NULL,
+            "The body with syntax errors in source %d was skipped", i);
+
+        parser_free(&parser);
+        lexer_free(&lexer);
+    }
+}
+
+
 Test_Set* parser_test_set()
 {
     Test_Set* set = test_set("Parser");
@@ -2066,7 +2805,17 @@ Test_Set* parser_test_set()
     array_push(set->tests, test_case("Diagnose invalid if statement", test_diagnose_invalid_if_statement));
 
     // Other
+    array_push(set->tests, test_case("String builder", test_string_builder));
     array_push(set->tests, test_case("Parse small main program", test_small_program));
+    array_push(set->tests, test_case("Streaming parser", test_streaming_parser));
+    array_push(set->tests, test_case("Flat AST pool", test_ast_pool));
+    array_push(set->tests, test_case("Deeply nested expressions", test_deeply_nested_expressions));
+    array_push(set->tests, test_case("Parallel parsing", test_parallel_parsing));
+    array_push(set->tests, test_case("AST cache", test_ast_cache));
+    array_push(set->tests, test_case("AST cache (deep expression)", test_ast_cache_deep_expression));
+    array_push(set->tests, test_case("AST cache (shared expressions)", test_ast_cache_shared));
+    array_push(set->tests, test_case("Shared expressions", test_shared_expressions));
+    array_push(set->tests, test_case("Lazy parsing (syntax errors)", test_lazy_syntax_errors));
 
     set->length = set->tests->length;
 
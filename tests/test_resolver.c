@@ -338,6 +338,128 @@ static void test_diagnose_invalid_operand_types_binary_expression(Test_Runner* r
 }
 
 
+static void test_fold_constant_expression(Test_Runner* runner)
+{
+    const char* tests[] =
+    {
+        "-(2 + 3) * 4",
+        "7 / 2 - 1",
+        "2147483647 - 1 + 1",
+        "1 + 2 == 3 and not false",
+        "10 < 2 * 5",
+    };
+
+    Value results[] =
+    {
+        { .type = VALUE_INTEGER, .integer = -20 },
+        { .type = VALUE_INTEGER, .integer = 2 },
+        { .type = VALUE_INTEGER, .integer = 2147483647 },
+        { .type = VALUE_BOOLEAN, .boolean = true },
+        { .type = VALUE_BOOLEAN, .boolean = false },
+    };
+
+    Lexer lexer;
+    Parser parser;
+    Resolver resolver;
+    hashtable* type_table;
+    AST_Expression* expression;
+
+    for (size_t i = 0; i < sizeof (tests) / sizeof (*tests); i++)
+    {
+        lexer_init(&lexer, tests[i]);
+        lex(&lexer);
+
+        parser_init(&parser, lexer.tokens);
+        expression = parse_expression(&parser);
+        
+        type_table = type_table_init();
+        resolver_init(&resolver, type_table);
+        resolve_expression(&resolver, expression);
+
+        assert_base(runner, resolver.diagnostics->length == 0,
+            "Invalid number of resolver diagnostics: %d, expected 0", resolver.diagnostics->length);
+        assert_base(runner, expression->value.type == results[i].type,
+            "Invalid type of folded value '%s', expected '%s'", 
+            value_str(expression->value.type), value_str(results[i].type));
+
+        if (value_is_integer(results[i]))
+            assert_base(runner, expression->value.integer == results[i].integer,
+                "Invalid folded value %lld, expected %lld", 
+                (long long)expression->value.integer, (long long)results[i].integer);
+        else
+            assert_base(runner, expression->value.boolean == results[i].boolean,
+                "Invalid folded value %d, expected %d", expression->value.boolean, results[i].boolean);
+
+        expression_free(expression);
+        resolver_free(&resolver);
+        type_table_free(type_table);
+        parser_free(&parser);
+        lexer_free(&lexer);
+    }
+}
+
+
+static void test_diagnose_constant_expression(Test_Runner* runner)
+{
+    const char* tests[] =
+    {
+        "2147483647 + 1",
+        "-2147483647 - 2",
+        "65536 * 65536",
+        "1 / (2 - 2)",
+        "9223372036854775807 + 1",
+        "99999999999 * 2",
+    };
+
+    const char* results[] =
+    {
+        ":RESOLVER - OverflowError: Integer overflow in constant expression. Integer values are between -2147483648 and 2147483647",
+        ":RESOLVER - OverflowError: Integer overflow in constant expression. Integer values are between -2147483648 and 2147483647",
+        ":RESOLVER - OverflowError: Integer overflow in constant expression. Integer values are between -2147483648 and 2147483647",
+        ":RESOLVER - ZeroDivisionError: Integer division by zero",
+        // NOTE(timo): The overflowing literals are not folded at all
+        ":RESOLVER - OverflowError: Integer overflow in integer literal. Maximum integer value is abs(2147483647)",
+        ":RESOLVER - OverflowError: Integer overflow in integer literal. Maximum integer value is abs(2147483647)",
+    };
+
+    Lexer lexer;
+    Parser parser;
+    Resolver resolver;
+    hashtable* type_table;
+    AST_Expression* expression;
+    Diagnostic* diagnostic;
+
+    for (size_t i = 0; i < sizeof (tests) / sizeof (*tests); i++)
+    {
+        lexer_init(&lexer, tests[i]);
+        lex(&lexer);
+
+        parser_init(&parser, lexer.tokens);
+        expression = parse_expression(&parser);
+        
+        type_table = type_table_init();
+        resolver_init(&resolver, type_table);
+        resolve_expression(&resolver, expression);
+
+        assert_base(runner, resolver.diagnostics->length == 1,
+            "Invalid number of resolver diagnostics: %d, expected 1", resolver.diagnostics->length);
+
+        diagnostic = resolver.diagnostics->items[0];
+
+        assert_base(runner, strcmp(diagnostic->message, results[i]) == 0,
+            "Invalid diagnostic '%s', expected '%s'", diagnostic->message, results[i]);
+        assert_base(runner, value_is_none(expression->value),
+            "Invalid folded value of type '%s', expected 'none'", value_str(expression->value.type));
+
+        expression_free(expression);
+        resolver_free(&resolver);
+        type_table_free(type_table);
+        parser_free(&parser);
+        lexer_free(&lexer);
+    }
+}
+
+
 static void test_resolve_logical_expression(Test_Runner* runner)
 {
     const char* tests[] =
@@ -466,6 +588,47 @@ static void test_diagnose_referencing_identifier_before_declaring_variable(Test_
 }
 
 
+static void test_diagnose_referencing_identifier_prefix_of_declared(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parser;
+    Resolver resolver;
+    hashtable* type_table;
+    AST_Statement* statement;
+    Diagnostic* diagnostic;
+    char* message;
+
+    const char* source = "{\n    foobar: int = 42;\n    foo;\n}";
+
+    lexer_init(&lexer, source); 
+    lex(&lexer);
+
+    parser_init(&parser, lexer.tokens);
+    statement = parse_statement(&parser);
+    array* statements = statement->block.statements;
+
+    type_table = type_table_init();
+    resolver_init(&resolver, type_table);
+    resolve_statement(&resolver, statements->items[0]);
+    resolve_expression(&resolver, ((AST_Statement*)(statements->items[1]))->expression);
+
+    assert_base(runner, resolver.diagnostics->length == 1,
+        "Invalid number of resolver diagnostics: %d, expected 1", resolver.diagnostics->length);
+    
+    message = ":RESOLVER - SyntaxError: Referencing identifier 'foo' before declaring it";
+    diagnostic = resolver.diagnostics->items[0];
+
+    assert_base(runner, strcmp(diagnostic->message, message) == 0,
+        "Invalid diagnostic '%s', expected '%s'", diagnostic->message, message);
+    
+    statement_free(statement);
+    resolver_free(&resolver);
+    type_table_free(type_table);
+    parser_free(&parser);
+    lexer_free(&lexer);
+}
+
+
 static void test_resolve_assignment_expression(Test_Runner* runner)
 {
     Lexer lexer;
@@ -1012,10 +1175,10 @@ static void test_resolve_function_expression(Test_Runner* runner)
     assert_type(runner, type->kind, TYPE_FUNCTION);
     assert_base(runner, type->function.return_type->kind == TYPE_INTEGER,
         "Unexpected function return type '%s', expected 'int'", type_as_string(type->function.return_type->kind));
-    assert_base(runner, type->function.scope->symbols->count == 2,
-        "Invalid number of symbols in functions scope: %d, expected 2", type->function.scope->symbols->count);
+    assert_base(runner, expression->function.scope->symbols->count == 2,
+        "Invalid number of symbols in functions scope: %d, expected 2", expression->function.scope->symbols->count);
     
-    type_free(type);
+    scope_free(expression->function.scope);
     expression_free(expression);
     resolver_free(&resolver);
     type_table_free(type_table);
@@ -1049,10 +1212,10 @@ static void test_resolve_function_expression(Test_Runner* runner)
     assert_type(runner, type->kind, TYPE_FUNCTION);
     assert_base(runner, type->function.return_type->kind == TYPE_INTEGER,
         "Unexpected function return type '%s', expected 'int'", type_as_string(type->function.return_type->kind));
-    assert_base(runner, type->function.scope->symbols->count == 1,
-        "Invalid number of symbols in functions scope: %d, expected 1", type->function.scope->symbols->count);
+    assert_base(runner, expression->function.scope->symbols->count == 1,
+        "Invalid number of symbols in functions scope: %d, expected 1", expression->function.scope->symbols->count);
     
-    type_free(type);
+    scope_free(expression->function.scope);
     expression_free(expression);
     resolver_free(&resolver);
     type_table_free(type_table);
@@ -1597,7 +1760,7 @@ static void test_resolve_declaration_statement_variable(Test_Runner* runner)
     assert_base(runner, resolver.global->symbols->count == 1,
         "Invalid number of symbols in the symbol table: %d, expected 1", resolver.global->symbols->count);
 
-    symbol = scope_lookup(resolver.global, "foo");
+    symbol = scope_lookup(resolver.global, str_intern("foo"));
 
     assert_base(runner, symbol->kind == SYMBOL_VARIABLE,
         "Invalid symbol kind");
@@ -1632,7 +1795,7 @@ static void test_resolve_declaration_statement_variable(Test_Runner* runner)
     assert_base(runner, resolver.global->symbols->count == 1,
         "Invalid number of symbols in the symbol table: %d, expected 1", resolver.global->symbols->count);
 
-    symbol = scope_lookup(resolver.global, "_bar");
+    symbol = scope_lookup(resolver.global, str_intern("_bar"));
 
     assert_base(runner, symbol->kind == SYMBOL_VARIABLE,
         "Invalid symbol kind");
@@ -2182,7 +2345,7 @@ static void test_resolve_variable_declaration(Test_Runner* runner)
     assert_base(runner, resolver.global->symbols->count == 1,
         "Invalid number of symbols in the symbol table: %d, expected 1", resolver.global->symbols->count);
 
-    symbol = scope_lookup(resolver.global, "foo");
+    symbol = scope_lookup(resolver.global, str_intern("foo"));
 
     assert_base(runner, symbol->kind == SYMBOL_VARIABLE,
         "Invalid symbol kind");
@@ -2218,7 +2381,7 @@ static void test_resolve_variable_declaration(Test_Runner* runner)
     assert_base(runner, resolver.global->symbols->count == 1,
         "Invalid number of symbols in the symbol table: %d, expected 1", resolver.global->symbols->count);
 
-    symbol = scope_lookup(resolver.global, "_bar");
+    symbol = scope_lookup(resolver.global, str_intern("_bar"));
 
     assert_base(runner, symbol->kind == SYMBOL_VARIABLE,
         "Invalid symbol kind");
@@ -2269,7 +2432,7 @@ static void test_resolve_multiple_global_variable_declarations(Test_Runner* runn
 
     // ---- symbol 1
     declaration = declarations->items[0];
-    symbol = scope_lookup(resolver.global, "foo");
+    symbol = scope_lookup(resolver.global, str_intern("foo"));
 
     assert_type(runner, declaration->initializer->literal->kind, TOKEN_INTEGER_LITERAL);
     assert_base(runner, declaration->initializer->value.integer == 42,
@@ -2283,7 +2446,7 @@ static void test_resolve_multiple_global_variable_declarations(Test_Runner* runn
 
     // ---- symbol 2
     declaration = declarations->items[1];
-    symbol = scope_lookup(resolver.global, "_bar");
+    symbol = scope_lookup(resolver.global, str_intern("_bar"));
 
     assert_type(runner, declaration->initializer->literal->kind, TOKEN_BOOLEAN_LITERAL);
     assert_base(runner, declaration->initializer->value.boolean == false,
@@ -2297,7 +2460,7 @@ static void test_resolve_multiple_global_variable_declarations(Test_Runner* runn
 
     // ---- symbol 3
     declaration = declarations->items[2];
-    symbol = scope_lookup(resolver.global, "FOOBAR");
+    symbol = scope_lookup(resolver.global, str_intern("FOOBAR"));
 
     assert_type(runner, declaration->initializer->literal->kind, TOKEN_INTEGER_LITERAL);
     assert_base(runner, declaration->initializer->value.integer == 0,
@@ -2461,6 +2624,389 @@ static void test_resolve_function_declaration(Test_Runner* runner)
 }
 
 
+static void test_bind_symbols(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parser;
+    hashtable* type_table;
+    Resolver resolver;
+
+    const char* source = "x: int = 1;\n"
+                         "foo: int = (a: int) => { return a; };\n"
+                         "main: int = (argc: int, argv: [int]) => {\n"
+                         "    y: int = x;\n"
+                         "    x: int = 2;\n"
+                         "    y := foo(x);\n"
+                         "    return y;\n"
+                         "};";
+
+    lexer_init(&lexer, source);
+    lex(&lexer);
+    
+    parser_init(&parser, lexer.tokens);
+    parse(&parser);
+
+    type_table = type_table_init();
+    resolver_init(&resolver, type_table);
+    resolve(&resolver, parser.declarations);
+    
+    assert_base(runner, resolver.diagnostics->length == 0,
+        "Invalid number of resolver diagnostics: %d, expected 0", resolver.diagnostics->length);
+
+    AST_Declaration* global_x = parser.declarations->items[0];
+    AST_Declaration* foo = parser.declarations->items[1];
+    AST_Declaration* main = parser.declarations->items[2];
+    array* statements = main->initializer->function.body->block.statements;
+    AST_Declaration* local_y = ((AST_Statement*)statements->items[0])->declaration;
+    AST_Declaration* local_x = ((AST_Statement*)statements->items[1])->declaration;
+    AST_Expression* assignment = ((AST_Statement*)statements->items[2])->expression;
+    AST_Expression* call = assignment->assignment.value;
+    AST_Expression* argument = call->call.arguments->items[0];
+    Scope* scope = main->symbol->local;
+
+    assert_base(runner, global_x->symbol == scope_get(resolver.global, str_intern("x")),
+        "Global declaration 'x' is not bound to its symbol");
+    assert_base(runner, foo->symbol == scope_get(resolver.global, str_intern("foo")),
+        "Function declaration 'foo' is not bound to its symbol");
+    assert_base(runner, local_x->symbol == scope_get(scope, str_intern("x")),
+        "Local declaration 'x' is not bound to its symbol");
+    assert_base(runner, local_y->initializer->symbol == global_x->symbol,
+        "Variable 'x' before the local declaration is not bound to the global 'x'");
+    assert_base(runner, assignment->assignment.variable->symbol == local_y->symbol,
+        "Assigned variable 'y' is not bound to the local 'y'");
+    assert_base(runner, call->call.variable->symbol == foo->symbol,
+        "Called function 'foo' is not bound to the function 'foo'");
+    assert_base(runner, argument->symbol == local_x->symbol,
+        "Variable 'x' after the local declaration is not bound to the local 'x'");
+
+    resolver_free(&resolver);
+    type_table_free(type_table);
+    parser_free(&parser);
+    lexer_free(&lexer);
+}
+
+
+static void test_assign_frame_slots(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parser;
+    hashtable* type_table;
+    Resolver resolver;
+
+    const char* source = "g: int = 1;\n"
+                         "foo: int = (a: int, b: int) => {\n"
+                         "    c: int = a + b;\n"
+                         "    d: bool = c > g;\n"
+                         "    return c;\n"
+                         "};\n"
+                         "main: int = (argc: int, argv: [int]) => {\n"
+                         "    x: int = foo(1, 2);\n"
+                         "    return x;\n"
+                         "};";
+
+    const char* identifiers[] = { "a", "b", "c", "d" };
+
+    lexer_init(&lexer, source);
+    lex(&lexer);
+    
+    parser_init(&parser, lexer.tokens);
+    parse(&parser);
+
+    type_table = type_table_init();
+    resolver_init(&resolver, type_table);
+    resolve(&resolver, parser.declarations);
+    
+    assert_base(runner, resolver.diagnostics->length == 0,
+        "Invalid number of resolver diagnostics: %d, expected 0", resolver.diagnostics->length);
+
+    Symbol* global = scope_get(resolver.global, str_intern("g"));
+    Symbol* foo = scope_get(resolver.global, str_intern("foo"));
+    Symbol* main = scope_get(resolver.global, str_intern("main"));
+    Scope* scope = foo->local;
+
+    assert_base(runner, global->slot == -1,
+        "Invalid slot of global variable 'g': %d, expected -1", global->slot);
+    assert_base(runner, foo->slot == -1,
+        "Invalid slot of function 'foo': %d, expected -1", foo->slot);
+    assert_base(runner, scope->frame_size == 4,
+        "Invalid frame size of 'foo': %d, expected 4", scope->frame_size);
+
+    // NOTE(timo): The parameters come first and the local variables after
+    // them in the order of declaration
+    for (int i = 0; i < sizeof (identifiers) / sizeof (*identifiers); i++)
+    {
+        Symbol* symbol = scope_get(scope, str_intern(identifiers[i]));
+
+        assert_base(runner, symbol->slot == i,
+            "Invalid slot of '%s': %d, expected %d", identifiers[i], symbol->slot, i);
+    }
+
+    // NOTE(timo): Each of the functions has its own frame
+    scope = main->local;
+
+    assert_base(runner, scope->frame_size == 3,
+        "Invalid frame size of 'main': %d, expected 3", scope->frame_size);
+    assert_base(runner, scope_get(scope, str_intern("x"))->slot == 2,
+        "Invalid slot of 'x': %d, expected 2", scope_get(scope, str_intern("x"))->slot);
+
+    resolver_free(&resolver);
+    type_table_free(type_table);
+    parser_free(&parser);
+    lexer_free(&lexer);
+}
+
+
+static void test_resolve_parallel(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parsers[2];
+    hashtable* type_table;
+    Resolver resolvers[2];
+
+    const char* source = "a: int = (x: int) => {\n"
+                         "    y: bool = x;\n"
+                         "    return x;\n"
+                         "};\n"
+                         "b: int = () => {\n"
+                         "    return later();\n"
+                         "};\n"
+                         "g: int = 1;\n"
+                         "later: int = () => {\n"
+                         "    return g;\n"
+                         "};\n"
+                         "c: bool = () => {\n"
+                         "    return 1;\n"
+                         "};\n"
+                         "a: int = () => {\n"
+                         "    return 0;\n"
+                         "};\n"
+                         "main: int = (argc: int, argv: [int]) => {\n"
+                         "    return a(later()) + h;\n"
+                         "};\n"
+                         "h: int = 2;";
+
+    lexer_init(&lexer, source);
+    lex(&lexer);
+    
+    type_table = type_table_init();
+
+    // NOTE(timo): The same source is resolved serially and in parallel, and 
+    // the parallel resolving has to report the same diagnostics in the same 
+    // order as the serial one
+    for (int i = 0; i < 2; i++)
+    {
+        parser_init(&parsers[i], lexer.tokens);
+        parse(&parsers[i]);
+
+        resolver_init(&resolvers[i], type_table);
+
+        if (i == 0)
+            resolve(&resolvers[i], parsers[i].declarations);
+        else
+            resolve_parallel(&resolvers[i], parsers[i].declarations, 4);
+    }
+
+    array* expected = resolvers[0].diagnostics;
+    array* actual = resolvers[1].diagnostics;
+
+    assert_base(runner, expected->length == 7,
+        "Invalid number of serial resolver diagnostics: %d, expected 7", expected->length);
+    assert_base(runner, actual->length == expected->length,
+        "Invalid number of parallel resolver diagnostics: %d, expected %d", actual->length, expected->length);
+
+    for (int i = 0; i < actual->length && i < expected->length; i++)
+    {
+        const char* message = ((Diagnostic*)actual->items[i])->message;
+        const char* expected_message = ((Diagnostic*)expected->items[i])->message;
+
+        assert_base(runner, str_equals(message, expected_message),
+            "Invalid diagnostic %d: '%s', expected '%s'", i, message, expected_message);
+    }
+
+    // NOTE(timo): The bodies are done, so none of the functions is left 
+    // resolving
+    const char* identifiers[] = { "a", "b", "later", "c", "main" };
+
+    for (int i = 0; i < sizeof (identifiers) / sizeof (*identifiers); i++)
+    {
+        Symbol* symbol = scope_get(resolvers[1].global, str_intern(identifiers[i]));
+
+        assert_base(runner, symbol->state == STATE_RESOLVED,
+            "Invalid state of '%s': %d, expected %d", identifiers[i], symbol->state, STATE_RESOLVED);
+        assert_base(runner, symbol->index == i + (i > 1),
+            "Invalid index of '%s': %d, expected %d", identifiers[i], symbol->index, i + (i > 1));
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        resolver_free(&resolvers[i]);
+        parser_free(&parsers[i]);
+    }
+
+    type_table_free(type_table);
+    lexer_free(&lexer);
+}
+
+
+static void test_resolve_parallel_return_types(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parsers[2];
+    hashtable* type_table;
+    Resolver resolvers[2];
+
+    // NOTE(timo): The callers see the type returned by the body of 'f', so 
+    // the errors of the body are carried to the callers, the callers of the
+    // callers and the global using 'f'
+    const char* source = "f: int = (x: int) => {\n"
+                         "    return true;\n"
+                         "};\n"
+                         "k: int = (x: int) => {\n"
+                         "    y: int = f(x);\n"
+                         "    return y;\n"
+                         "};\n"
+                         "g: int = (x: int) => {\n"
+                         "    return f(x) + 1;\n"
+                         "};\n"
+                         "n: bool = f(1);\n"
+                         "h: int = (x: int) => {\n"
+                         "    return k(x) + g(x);\n"
+                         "};\n"
+                         "main: int = (argc: int, argv: [int]) => {\n"
+                         "    return h(1);\n"
+                         "};";
+
+    lexer_init(&lexer, source);
+    lex(&lexer);
+    
+    type_table = type_table_init();
+
+    for (int i = 0; i < 2; i++)
+    {
+        parser_init(&parsers[i], lexer.tokens);
+        parse(&parsers[i]);
+
+        resolver_init(&resolvers[i], type_table);
+
+        if (i == 0)
+            resolve(&resolvers[i], parsers[i].declarations);
+        else
+            resolve_parallel(&resolvers[i], parsers[i].declarations, 4);
+    }
+
+    array* expected = resolvers[0].diagnostics;
+    array* actual = resolvers[1].diagnostics;
+
+    assert_base(runner, expected->length == 6,
+        "Invalid number of serial resolver diagnostics: %d, expected 6", expected->length);
+    assert_base(runner, actual->length == expected->length,
+        "Invalid number of parallel resolver diagnostics: %d, expected %d", actual->length, expected->length);
+
+    for (int i = 0; i < actual->length && i < expected->length; i++)
+    {
+        const char* message = ((Diagnostic*)actual->items[i])->message;
+        const char* expected_message = ((Diagnostic*)expected->items[i])->message;
+
+        assert_base(runner, str_equals(message, expected_message),
+            "Invalid diagnostic %d: '%s', expected '%s'", i, message, expected_message);
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        Symbol* symbol = scope_get(resolvers[i].global, str_intern("f"));
+
+        assert_base(runner, symbol->type->function.return_type == hashtable_get(type_table, "bool"),
+            "Invalid return type of 'f' in resolver %d", i);
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        resolver_free(&resolvers[i]);
+        parser_free(&parsers[i]);
+    }
+
+    type_table_free(type_table);
+    lexer_free(&lexer);
+}
+
+
+static void test_canonical_types(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parser;
+    hashtable* type_table;
+    Resolver resolver;
+
+    const char* source = "foo: int = (a: int, b: bool) => {\n"
+                         "    return a;\n"
+                         "};\n"
+                         "bar: int = (x: int, y: bool) => {\n"
+                         "    return x;\n"
+                         "};\n"
+                         "baz: int = (a: bool, b: int) => {\n"
+                         "    return b;\n"
+                         "};\n"
+                         "main: int = (argc: int, argv: [int]) => {\n"
+                         "    return foo(argc, true) + baz(false, 0);\n"
+                         "};";
+
+    lexer_init(&lexer, source);
+    lex(&lexer);
+    
+    parser_init(&parser, lexer.tokens);
+    parse(&parser);
+
+    type_table = type_table_init();
+    resolver_init(&resolver, type_table);
+    resolve(&resolver, parser.declarations);
+    
+    assert_base(runner, resolver.diagnostics->length == 0,
+        "Invalid number of resolver diagnostics: %d, expected 0", resolver.diagnostics->length);
+
+    Symbol* foo = scope_get(resolver.global, str_intern("foo"));
+    Symbol* bar = scope_get(resolver.global, str_intern("bar"));
+    Symbol* baz = scope_get(resolver.global, str_intern("baz"));
+    Symbol* argv = scope_get(scope_get(resolver.global, str_intern("main"))->local, str_intern("argv"));
+
+    // NOTE(timo): The functions with the same signature share the type, but 
+    // each of them has its own local scope
+    assert_base(runner, foo->type == bar->type,
+        "Functions 'foo' and 'bar' have different types, expected the same type");
+    assert_base(runner, foo->type != baz->type,
+        "Functions 'foo' and 'baz' have the same type, expected different types");
+    assert_base(runner, foo->local != bar->local,
+        "Functions 'foo' and 'bar' have the same local scope");
+    assert_base(runner, foo->type->function.parameters->items[0] == hashtable_get(type_table, "int"),
+        "Invalid type of the first parameter of 'foo', expected 'int'");
+    assert_base(runner, argv->type == resolve_type_specifier(&resolver, TYPE_SPECIFIER_ARRAY_INT),
+        "Invalid type of 'argv', expected the type of the specifier '[int]'");
+    assert_base(runner, argv->type == type_array(type_table, hashtable_get(type_table, "int")),
+        "Array types of the same element type are not the same type");
+
+    // NOTE(timo): The key of a function with many parameters doesn't fit in
+    // the stack, and the function without a return type is not the function
+    // returning none
+    Type* parameters[20];
+
+    for (int i = 0; i < 20; i++)
+        parameters[i] = hashtable_get(type_table, i % 2 ? "int" : "bool");
+
+    Type* none = hashtable_get(type_table, "none");
+
+    assert_base(runner, type_function(type_table, none, parameters, 20) == type_function(type_table, none, parameters, 20),
+        "Function types of the same signature are not the same type");
+    assert_base(runner, type_function(type_table, none, parameters, 20) != type_function(type_table, none, parameters, 19),
+        "Function types of different arities are the same type");
+    assert_base(runner, type_function(type_table, NULL, parameters, 2) != type_function(type_table, none, parameters, 2),
+        "Function without a return type has the type of the function returning none");
+
+    resolver_free(&resolver);
+    type_table_free(type_table);
+    parser_free(&parser);
+    lexer_free(&lexer);
+}
+
+
 static void test_diagnose_redeclaration_of_identifier_function_declaration(Test_Runner* runner)
 {
     Lexer lexer;
@@ -2501,6 +3047,142 @@ static void test_diagnose_redeclaration_of_identifier_function_declaration(Test_
 }
 
 
+static void test_resolve_lazy_function_bodies(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parser;
+    hashtable* type_table;
+    Resolver resolver;
+    Diagnostic* diagnostic;
+    AST_Declaration* unused;
+    AST_Declaration* twice;
+    Symbol* symbol;
+    char* message;
+    char* source;
+
+    // Unused function with type errors is never looked at
+    source = "unused: bool = (a: int) => { b: int = a + true; return b; };\n"
+             "twice: int = (a: int) => { return a * 2; };\n"
+             "main: int = () => { return twice(21); };\n";
+
+    lexer_init(&lexer, source);
+    parser_init_streaming(&parser, &lexer);
+    parser.lazy = true;
+    parse(&parser);
+
+    assert_base(runner, parser.diagnostics->length == 0,
+        "Invalid number of parser diagnostics: %d, expected 0", parser.diagnostics->length);
+
+    unused = parser.declarations->items[0];
+    twice = parser.declarations->items[1];
+
+    assert_base(runner, unused->initializer->function.body == NULL && unused->initializer->function.lazy != NULL,
+        "Body of the function 'unused' is parsed, expected it to be skipped");
+
+    type_table = type_table_init();
+    resolver_init(&resolver, type_table);
+    resolver.lazy = true;
+    resolve(&resolver, parser.declarations);
+
+    assert_base(runner, resolver.diagnostics->length == 0,
+        "Invalid number of resolver diagnostics: %d, expected 0", resolver.diagnostics->length);
+    assert_base(runner, unused->initializer->function.body == NULL,
+        "Body of the function 'unused' is parsed, expected it to be skipped");
+    assert_base(runner, twice->initializer->function.body != NULL && twice->initializer->function.lazy == NULL,
+        "Body of the function 'twice' is not parsed");
+
+    symbol = scope_lookup(resolver.global, str_intern("unused"));
+    assert_base(runner, symbol->state == STATE_UNRESOLVED,
+        "Invalid state %d of the function 'unused', expected %d", symbol->state, STATE_UNRESOLVED);
+    symbol = scope_lookup(resolver.global, str_intern("twice"));
+    assert_base(runner, symbol->state == STATE_RESOLVED,
+        "Invalid state %d of the function 'twice', expected %d", symbol->state, STATE_RESOLVED);
+
+    resolver_free(&resolver);
+    type_table_free(type_table);
+    parser_free(&parser);
+    lexer_free(&lexer);
+
+    // Syntax errors are diagnosed by the parser and type errors of the used
+    // functions when they are used
+    source = "broken: int = (a: int) => { return a +* 2; };\n"
+             "conflict: bool = (a: int) => { return a; };\n"
+             "main: int = () => { x: int = broken(1); y: bool = conflict(2); return x; };\n";
+
+    lexer_init(&lexer, source);
+    parser_init_streaming(&parser, &lexer);
+    parser.lazy = true;
+    parse(&parser);
+
+    assert_base(runner, parser.diagnostics->length == 2,
+        "Invalid number of parser diagnostics: %d, expected 2", parser.diagnostics->length);
+
+    if (parser.diagnostics->length == 2)
+    {
+        message = ":PARSER - SyntaxError: Invalid token '*' in primary expression";
+        diagnostic = parser.diagnostics->items[0];
+
+        assert_base(runner, strcmp(diagnostic->message, message) == 0,
+            "Invalid diagnostic '%s', expected '%s'", diagnostic->message, message);
+    }
+
+    type_table = type_table_init();
+    resolver_init(&resolver, type_table);
+    resolver.lazy = true;
+    resolve(&resolver, parser.declarations);
+
+    assert_base(runner, resolver.diagnostics->length == 3,
+        "Invalid number of resolver diagnostics: %d, expected 3", resolver.diagnostics->length);
+
+    if (resolver.diagnostics->length == 3)
+    {
+        message = ":RESOLVER - TypeError: Conflicting types in function declaration. Declaring type 'int' to 'bool'";
+        diagnostic = resolver.diagnostics->items[2];
+
+        assert_base(runner, strcmp(diagnostic->message, message) == 0,
+            "Invalid diagnostic '%s', expected '%s'", diagnostic->message, message);
+    }
+
+    resolver_free(&resolver);
+    type_table_free(type_table);
+    parser_free(&parser);
+    lexer_free(&lexer);
+
+    // The globals declared after the function are not visible to its body,
+    // even though the body is resolved after them
+    source = "early: int = () => { return late; };\n"
+             "late: int = 42;\n"
+             "main: int = () => { return early(); };\n";
+
+    lexer_init(&lexer, source);
+    parser_init_streaming(&parser, &lexer);
+    parser.lazy = true;
+    parse(&parser);
+
+    type_table = type_table_init();
+    resolver_init(&resolver, type_table);
+    resolver.lazy = true;
+    resolve(&resolver, parser.declarations);
+
+    assert_base(runner, resolver.diagnostics->length == 1,
+        "Invalid number of resolver diagnostics: %d, expected 1", resolver.diagnostics->length);
+
+    if (resolver.diagnostics->length == 1)
+    {
+        message = ":RESOLVER - SyntaxError: Referencing identifier 'late' before declaring it";
+        diagnostic = resolver.diagnostics->items[0];
+
+        assert_base(runner, strcmp(diagnostic->message, message) == 0,
+            "Invalid diagnostic '%s', expected '%s'", diagnostic->message, message);
+    }
+
+    resolver_free(&resolver);
+    type_table_free(type_table);
+    parser_free(&parser);
+    lexer_free(&lexer);
+}
+
+
 static void test_resolve_type_specifier(Test_Runner* runner)
 {
     const char* tests[] =
@@ -2542,9 +3224,6 @@ static void test_resolve_type_specifier(Test_Runner* runner)
             "Invalid number of resolver diagnostics: %d, expected 0", resolver.diagnostics->length);
         assert_type(runner, type->kind, expected[i][1]);
 
-        if (type->kind == TYPE_ARRAY)
-            type_free(type);
-
         resolver_free(&resolver);
         type_table_free(type_table);
         parser_free(&parser);
@@ -2553,6 +3232,367 @@ static void test_resolve_type_specifier(Test_Runner* runner)
 }
 
 
+static void test_resolve_long_chain_of_operators(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parser;
+    Resolver resolver;
+    hashtable* type_table;
+    AST_Expression* expression;
+    stringbuilder* sb = sb_init();
+    const int length = 100000;
+
+    // - - ... - (1 + 1 + ... + 1)
+    for (int i = 0; i < length; i++)
+        sb_append(sb, "- ");
+    sb_append(sb, "(1");
+    for (int i = 1; i < length; i++)
+        sb_append(sb, " + 1");
+    sb_append(sb, ")");
+
+    lexer_init(&lexer, sb->string);
+    lex(&lexer);
+
+    parser_init(&parser, lexer.tokens);
+    expression = parse_expression(&parser);
+
+    type_table = type_table_init();
+    resolver_init(&resolver, type_table);
+    Type* type = resolve_expression(&resolver, expression);
+
+    assert_base(runner, resolver.diagnostics->length == 0,
+        "Invalid number of resolver diagnostics: %d, expected 0", resolver.diagnostics->length);
+    assert_type(runner, type->kind, TYPE_INTEGER);
+    assert_base(runner, expression->value.integer == length,
+        "Invalid integer value %d, expected %d", expression->value.integer, length);
+
+    expression_free(expression);
+    resolver_free(&resolver);
+    type_table_free(type_table);
+    parser_free(&parser);
+    lexer_free(&lexer);
+    sb_free(sb);
+}
+
+
+static void test_resolve_deeply_nested_calls(Test_Runner* runner)
+{
+    Lexer lexer;
+    Parser parser;
+    Resolver resolver;
+    hashtable* type_table;
+    stringbuilder* sb = sb_init();
+    const int depth = 20000;
+
+    // f(f(... argv[f(f(... argc ...))] ...))
+    sb_append(sb, "f: int = (x: int) => { return x; };\n");
+    sb_append(sb, "main: int = (argc: int, argv: [int]) => { return ");
+    for (int i = 0; i < depth; i++)
+        sb_append(sb, "f(");
+    sb_append(sb, "argv[");
+    for (int i = 0; i < depth; i++)
+        sb_append(sb, "f(");
+    sb_append(sb, "argc");
+    for (int i = 0; i < depth; i++)
+        sb_append(sb, ")");
+    sb_append(sb, "]");
+    for (int i = 0; i < depth; i++)
+        sb_append(sb, ")");
+    sb_append(sb, "; };");
+
+    lexer_init(&lexer, sb->string);
+    lex(&lexer);
+
+    parser_init(&parser, lexer.tokens);
+    parse(&parser);
+
+    type_table = type_table_init();
+    resolver_init(&resolver, type_table);
+    resolve(&resolver, parser.declarations);
+
+    assert_base(runner, resolver.diagnostics->length == 0,
+        "Invalid number of resolver diagnostics: %d, expected 0", resolver.diagnostics->length);
+
+    AST_Declaration* declaration = parser.declarations->items[1];
+    AST_Statement* body = declaration->initializer->function.body;
+    AST_Statement* _return = body->block.statements->items[0];
+
+    assert_expression(runner, _return->_return.value->kind, EXPRESSION_CALL);
+    assert_type(runner, _return->_return.value->type->kind, TYPE_INTEGER);
+
+    resolver_free(&resolver);
+    type_table_free(type_table);
+    parser_free(&parser);
+    lexer_free(&lexer);
+    sb_free(sb);
+}
+
+
+static void test_resolve_shared_expressions_with_errors(Test_Runner* runner)
+{
+    const char* source = "f: int = (a: int) => { return a; };\n"
+                         "main: int = (argc: int) => {\n"
+                         "    x: int = y + 1;\n"
+                         "    z: int = y  +  1;\n"
+                         "    v: int = f(argc, y + 1) + f(true);\n"
+                         "    if argc then { x := y + 1; }\n"
+                         "    if argc then { x := 1; }\n"
+                         "    return f(true) + 2147483647 * 2;\n"
+                         "};\n";
+    array* diagnostics[2];
+    Lexer lexer[2];
+    Parser parser[2];
+    Resolver resolver[2];
+    hashtable* type_table[2];
+
+    // The source is resolved without and with the sharing of the expressions
+    for (int i = 0; i < 2; i++)
+    {
+        lexer_init(&lexer[i], source);
+        lex(&lexer[i]);
+
+        parser_init(&parser[i], lexer[i].tokens);
+        parser[i].share = i == 1;
+        parse(&parser[i]);
+
+        type_table[i] = type_table_init();
+        resolver_init(&resolver[i], type_table[i]);
+        resolver[i].shared = i == 1;
+        resolve(&resolver[i], parser[i].declarations);
+
+        diagnostics[i] = resolver[i].diagnostics;
+    }
+
+    assert_base(runner, diagnostics[1]->length == diagnostics[0]->length,
+        "Invalid number of resolver diagnostics: %d, expected %d", diagnostics[1]->length, diagnostics[0]->length);
+
+    for (int i = 0; i < diagnostics[0]->length && i < diagnostics[1]->length; i++)
+    {
+        Diagnostic* diagnostic = diagnostics[1]->items[i];
+        Diagnostic* expected = diagnostics[0]->items[i];
+
+        assert_base(runner, strcmp(diagnostic->message, expected->message) == 0,
+            "Invalid diagnostic '%s', expected '%s'", diagnostic->message, expected->message);
+        assert_base(runner, diagnostic->position.start == expected->position.start && diagnostic->position.end == expected->position.end,
+            "Invalid diagnostic position %d..%d, expected %d..%d",
+            diagnostic->position.start, diagnostic->position.end, expected->position.start, expected->position.end);
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        resolver_free(&resolver[i]);
+        type_table_free(type_table[i]);
+        parser_free(&parser[i]);
+        lexer_free(&lexer[i]);
+    }
+}
+
+
+// Checks that the diagnostics of the document are the same as the ones of
+// a document checked from the scratch with the same source.
+static void assert_document_diagnostics(Test_Runner* runner, Document* document)
+{
+    Document fresh;
+    document_init(&fresh, document->source);
+
+    assert_base(runner, document->diagnostics->length == fresh.diagnostics->length,
+        "Invalid number of document diagnostics: %d, expected %d", document->diagnostics->length, fresh.diagnostics->length);
+
+    for (int i = 0; i < document->diagnostics->length && i < fresh.diagnostics->length; i++)
+    {
+        Diagnostic* diagnostic = document->diagnostics->items[i];
+        Diagnostic* expected = fresh.diagnostics->items[i];
+
+        assert_base(runner, strcmp(diagnostic->message, expected->message) == 0,
+            "Invalid diagnostic '%s', expected '%s'", diagnostic->message, expected->message);
+        assert_base(runner, diagnostic->position.start == expected->position.start && diagnostic->position.end == expected->position.end,
+            "Invalid diagnostic position %d..%d, expected %d..%d",
+            diagnostic->position.start, diagnostic->position.end, expected->position.start, expected->position.end);
+    }
+
+    document_free(&fresh);
+}
+
+
+static void test_document_edit_function_body(Test_Runner* runner)
+{
+    const char* source =
+        "foo: int = (a: int) => { return a + 1; };\n"
+        "bar: int = (b: int) => { return b * 2; };\n"
+        "main: int = (argc: int, argv: [int]) => { return foo(bar(argc)); };\n";
+
+    Document document;
+    document_init(&document, source);
+
+    assert_base(runner, document.units.length == 3,
+        "Invalid number of units: %d, expected 3", document.units.length);
+    assert_base(runner, document.diagnostics->length == 0,
+        "Invalid number of document diagnostics: %d, expected 0", document.diagnostics->length);
+
+    AST_Declaration* bar = document.units.items[1].declaration;
+    AST_Declaration* main = document.units.items[2].declaration;
+    Symbol* bar_symbol = document.units.items[1].symbol;
+    Symbol* main_symbol = document.units.items[2].symbol;
+
+    // a + 1 -> a + 10000
+    const char* edit = strstr(document.source, "1;");
+    int start = edit - document.source;
+    document_edit(&document, start, start + 1, "10000");
+
+    assert_base(runner, document.units.items[1].declaration == bar && document.units.items[2].declaration == main,
+        "Declarations after the edited function were parsed again");
+    assert_base(runner, document.units.items[1].symbol == bar_symbol,
+        "Independent declaration after the edited function was resolved again");
+    assert_base(runner, document.units.items[2].symbol != main_symbol,
+        "Dependent declaration after the edited function was not resolved again");
+    assert_document_diagnostics(runner, &document);
+
+    // Breaking the return type of the edited function resolves the dependent
+    // function again
+    edit = strstr(document.source, "a + 10000");
+    start = edit - document.source;
+    document_edit(&document, start, start + 9, "a > 1");
+
+    assert_base(runner, document.units.items[2].declaration == main,
+        "Declaration after the edited function was parsed again");
+    assert_base(runner, document.diagnostics->length > 0,
+        "Invalid number of document diagnostics: %d, expected more than 0", document.diagnostics->length);
+    assert_document_diagnostics(runner, &document);
+
+    document_free(&document);
+}
+
+
+static void test_document_edit_declarations(Test_Runner* runner)
+{
+    const char* source =
+        "main: int = (argc: int, argv: [int]) => { return foo(argc); };\n";
+
+    Document document;
+    document_init(&document, source);
+
+    char* message = ":RESOLVER - SyntaxError: Referencing identifier 'foo' before declaring it";
+
+    assert_base(runner, document.diagnostics->length > 0 && strcmp(((Diagnostic*)document.diagnostics->items[0])->message, message) == 0,
+        "Expected diagnostic '%s'", message);
+
+    // Declaring the missing function clears the diagnostics of the main
+    // program even though the main program itself is not edited
+    document_edit(&document, 0, 0, "foo: int = (a: int) => { return a; };\n");
+
+    assert_base(runner, document.units.length == 2,
+        "Invalid number of units: %d, expected 2", document.units.length);
+    assert_base(runner, document.diagnostics->length == 0,
+        "Invalid number of document diagnostics: %d, expected 0", document.diagnostics->length);
+
+    // Removing it again brings the diagnostics back with positions shifted
+    // back to the original source
+    document_edit(&document, 0, strchr(document.source, '\n') - document.source + 1, "");
+
+    assert_base(runner, document.units.length == 1,
+        "Invalid number of units: %d, expected 1", document.units.length);
+    assert_base(runner, strcmp(document.source, source) == 0,
+        "Invalid source '%s', expected '%s'", document.source, source);
+    assert_document_diagnostics(runner, &document);
+
+    document_free(&document);
+}
+
+
+static void test_document_edit_comment(Test_Runner* runner)
+{
+    const char* source =
+        "foo: int = (a: int) => { return a; };\n"
+        "bar: int = (b: int) => { return b; };\n"
+        "main: int = (argc: int, argv: [int]) => { return foo(bar(argc)); };\n";
+
+    Document document;
+    document_init(&document, source);
+
+    // Commenting out the declaration of foo swallows it into a comment, and
+    // the main program is left referencing an undeclared identifier
+    document_edit(&document, 0, 0, "#");
+
+    assert_base(runner, document.units.length == 3 && document.units.items[0].declaration == NULL,
+        "Expected the commented declaration to be left without declaration");
+    assert_base(runner, document.diagnostics->length > 0,
+        "Invalid number of document diagnostics: %d, expected more than 0", document.diagnostics->length);
+    assert_document_diagnostics(runner, &document);
+
+    // Uncommenting brings it back
+    document_edit(&document, 0, 1, "");
+
+    assert_base(runner, document.units.length == 3,
+        "Invalid number of units: %d, expected 3", document.units.length);
+    assert_base(runner, document.diagnostics->length == 0,
+        "Invalid number of document diagnostics: %d, expected 0", document.diagnostics->length);
+
+    document_free(&document);
+}
+
+
+static void test_document_edit_redeclarations(Test_Runner* runner)
+{
+    const char* source =
+        "baz: int = (d: int) => { return d; };\n"
+        "foo: int = (a: int) => { return a; };\n"
+        "main: int = (argc: int, argv: [int]) => { return foo(bar(argc)); };\n"
+        "bar: int = (b: int) => { return b; };\n";
+
+    Document document;
+    document_init(&document, source);
+
+    Symbol* baz_symbol = document.units.items[0].symbol;
+
+    assert_base(runner, document.diagnostics->length > 0,
+        "Invalid number of document diagnostics: %d, expected more than 0", document.diagnostics->length);
+    assert_document_diagnostics(runner, &document);
+
+    // Declaring bar before the existing declaration makes the existing
+    // declaration the redeclaration
+    int start = strstr(document.source, "main") - document.source;
+    document_edit(&document, start, start, "bar: int = (c: int) => { return c; };\n");
+
+    assert_base(runner, document.units.length == 5,
+        "Invalid number of units: %d, expected 5", document.units.length);
+    assert_base(runner, document.units.items[0].symbol == baz_symbol,
+        "Declaration before the edit was resolved again");
+    assert_base(runner, document.units.items[4].symbol == NULL,
+        "Expected the declaration after the edit to be a redeclaration");
+    assert_document_diagnostics(runner, &document);
+
+    // Breaking the syntax reports only the syntax errors and fixing it brings
+    // the resolver diagnostics back
+    start = strstr(document.source, "return c;") - document.source;
+    document_edit(&document, start + 8, start + 9, "");
+    assert_document_diagnostics(runner, &document);
+
+    start = strstr(document.source, "return b;") - document.source;
+    document_edit(&document, start, start + 6, "");
+    assert_document_diagnostics(runner, &document);
+
+    start = strstr(document.source, "return c") - document.source;
+    document_edit(&document, start + 8, start + 8, ";");
+    assert_document_diagnostics(runner, &document);
+
+    start = strstr(document.source, " b;") - document.source;
+    document_edit(&document, start, start, "return");
+    assert_document_diagnostics(runner, &document);
+
+    // Removing the first declaration of bar leaves the last one declaring it
+    start = strstr(document.source, "bar") - document.source;
+    document_edit(&document, start, strchr(document.source + start, '\n') - document.source + 1, "");
+
+    assert_base(runner, document.units.length == 4 && document.units.items[3].symbol != NULL,
+        "Expected the last declaration to declare the identifier");
+    assert_base(runner, document.units.items[0].symbol == baz_symbol,
+        "Declaration before the edit was resolved again");
+    assert_document_diagnostics(runner, &document);
+
+    document_free(&document);
+}
+
+
 Test_Set* resolver_test_set()
 {
     Test_Set* set = test_set("Resolver");
@@ -2569,7 +3609,8 @@ Test_Set* resolver_test_set()
     // Binary
     array_push(set->tests, test_case("Binary expression", test_resolve_binary_expression));
     array_push(set->tests, test_case("Diagnose invalid binary operands", test_diagnose_invalid_operand_types_binary_expression));
-    // TODO(timo): Integer overflow checks in binary (positive and negative)
+    array_push(set->tests, test_case("Constant folding", test_fold_constant_expression));
+    array_push(set->tests, test_case("Diagnose overflow and division by zero in constants", test_diagnose_constant_expression));
 
     // Logical expressions
     array_push(set->tests, test_case("Logical expression", test_resolve_logical_expression));
@@ -2577,6 +3618,7 @@ Test_Set* resolver_test_set()
     // Variable
     array_push(set->tests, test_case("Variable expression", test_resolve_variable_expression));
     array_push(set->tests, test_case("Diagnose referencing identifier before declaring it (variable)", test_diagnose_referencing_identifier_before_declaring_variable));
+    array_push(set->tests, test_case("Diagnose referencing identifier which is a prefix of declared identifier", test_diagnose_referencing_identifier_prefix_of_declared));
 
     // Assignment
     array_push(set->tests, test_case("Assignment expression", test_resolve_assignment_expression));
@@ -2610,6 +3652,9 @@ Test_Set* resolver_test_set()
 
     // Constant folding
     array_push(set->tests, test_case("Constant folding (binary arithmetics)", test_constant_folding_binary_arithmetics));
+    array_push(set->tests, test_case("Long chain of operators", test_resolve_long_chain_of_operators));
+    array_push(set->tests, test_case("Deeply nested calls", test_resolve_deeply_nested_calls));
+    array_push(set->tests, test_case("Shared expressions with errors", test_resolve_shared_expressions_with_errors));
     array_push(set->tests, test_case("Constant folding (binary equality)", test_constant_folding_binary_equality));
     array_push(set->tests, test_case("Constant folding (binary relation)", test_constant_folding_binary_relation));
     array_push(set->tests, test_case("Constant folding (binary logical)", test_constant_folding_binary_logical));
@@ -2653,14 +3698,26 @@ Test_Set* resolver_test_set()
     // Function declarations
     array_push(set->tests, test_case("Function declaration", test_resolve_function_declaration));
     array_push(set->tests, test_case("Diagnose redeclaration of identifier (function declaration)", test_diagnose_redeclaration_of_identifier_function_declaration));
+    array_push(set->tests, test_case("Lazy function bodies", test_resolve_lazy_function_bodies));
+    array_push(set->tests, test_case("Bind symbols", test_bind_symbols));
+    array_push(set->tests, test_case("Frame slots", test_assign_frame_slots));
+    array_push(set->tests, test_case("Parallel resolving", test_resolve_parallel));
+    array_push(set->tests, test_case("Parallel resolving (return types)", test_resolve_parallel_return_types));
     // TODO(timo): Diagnose invalid type of the return value.
     // TODO(timo): Function cannot be declared inside a function
 
     // Type specifiers
     array_push(set->tests, test_case("Type specifier", test_resolve_type_specifier));
+    array_push(set->tests, test_case("Canonical types", test_canonical_types));
 
     // Scoping
     // TODO(timo): test_resolve_local_scopes();
+
+    // Incremental checking
+    array_push(set->tests, test_case("Document edit (function body)", test_document_edit_function_body));
+    array_push(set->tests, test_case("Document edit (declarations)", test_document_edit_declarations));
+    array_push(set->tests, test_case("Document edit (comment)", test_document_edit_comment));
+    array_push(set->tests, test_case("Document edit (redeclarations)", test_document_edit_redeclarations));
     
     set->length = set->tests->length;
 